@@ -0,0 +1,42 @@
+# royalbed_add_asset_bundle(<target> OUTPUT <file> [BASE_DIR <dir>] FILES <files>...)
+#
+# Собирает бандл ресурсов (royalbed::server::AssetBundle) из файлов FILES.
+# Пути файлов в бандле отсчитываются от BASE_DIR (по умолчанию CMAKE_CURRENT_SOURCE_DIR), как в cmrc.
+# Файл name.gz становится сжатым вариантом файла name.
+# Бандл собирается утилитой ROYALBED_BUNDLE_TOOL, если она задана (например, при кросс-компиляции),
+# иначе - целью royalbed-bundle (ROYALBED_ASSET_BUNDLE_ENABLED).
+function(royalbed_add_asset_bundle target)
+    cmake_parse_arguments(ARG "" "OUTPUT;BASE_DIR" "FILES" ${ARGN})
+    if(NOT ARG_OUTPUT)
+        message(FATAL_ERROR "royalbed_add_asset_bundle: OUTPUT is required")
+    endif()
+    if(NOT ARG_BASE_DIR)
+        set(ARG_BASE_DIR "${CMAKE_CURRENT_SOURCE_DIR}")
+    endif()
+    get_filename_component(base_dir "${ARG_BASE_DIR}" ABSOLUTE)
+
+    set(files)
+    foreach(file IN LISTS ARG_FILES)
+        get_filename_component(file "${file}" ABSOLUTE)
+        list(APPEND files "${file}")
+    endforeach()
+
+    if(ROYALBED_BUNDLE_TOOL)
+        set(tool "${ROYALBED_BUNDLE_TOOL}")
+        set(tool_depends)
+    elseif(TARGET royalbed-bundle)
+        set(tool royalbed-bundle)
+        set(tool_depends royalbed-bundle)
+    else()
+        message(FATAL_ERROR "royalbed_add_asset_bundle: needs ROYALBED_ASSET_BUNDLE_ENABLED or ROYALBED_BUNDLE_TOOL")
+    endif()
+
+    add_custom_command(
+        OUTPUT "${ARG_OUTPUT}"
+        COMMAND ${tool} "${ARG_OUTPUT}" "${base_dir}" ${files}
+        DEPENDS ${tool_depends} ${files}
+        COMMENT "Building asset bundle ${ARG_OUTPUT}"
+        VERBATIM
+    )
+    add_custom_target(${target} ALL DEPENDS "${ARG_OUTPUT}")
+endfunction()
@@ -1,3 +1,6 @@
+#include <ranges>
+#include <utility>
+
 #include "../vru/storage.h"
 
 #include "activate.h"
@@ -6,6 +9,7 @@
 #include "freq.h"
 #include "params.h"
 #include "prearranged-freqs.h"
+#include "royalbed/server/json-stream.h"
 #include "royalbed/server/router.h"
 #include "sample-rate.h"
 #include "status.h"
@@ -18,8 +22,9 @@ namespace {
 void publicAllVruEndpoint(royalbed::server::Router& router)
 {
     router.get("/", [] {
-        const auto& storage = vru::Storage::instance();
-        return storage.getAllVru();
+        // The states may change while the response is being sent, so a snapshot taken under the lock is streamed
+        auto states = vru::Storage::instance().getAllVru();
+        return royalbed::server::streamJsonArray(std::move(states) | std::views::values);
     });
 }
 
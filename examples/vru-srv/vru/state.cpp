@@ -23,4 +23,24 @@ void to_json(nlohmann::json& jsonValue, StateMap& stateMap)
     };
 }
 
+void writeJson(royalbed::common::JsonWriter& out, const State& state)
+{
+    out.beginObject()
+      .field("id", state.id)
+      .field("status", toString(state.status))
+      .field("emissionClass", "RAW")
+      .field("sampleRate", state.sampleRate)
+      .field("hfChannelCount", 3)
+      .endObject();
+}
+
+void writeJson(royalbed::common::JsonWriter& out, const StateMap& stateMap)
+{
+    out.beginArray();
+    for (const auto& [id, info] : stateMap) {
+        writeJson(out, info);
+    }
+    out.endArray();
+}
+
 }   // namespace vru_srv::vru
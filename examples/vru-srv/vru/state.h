@@ -2,6 +2,8 @@
 
 #include <string>
 
+#include "royalbed/common/json-writer.h"
+
 #include "fsp.h"
 #include "status.h"
 
@@ -23,4 +25,7 @@ using StateMap = std::map<std::string, State>;
 void to_json(nlohmann::json& jsonValue, const State& state);
 void to_json(nlohmann::json& jsonValue, StateMap& stateMap);
 
+void writeJson(royalbed::common::JsonWriter& out, const State& state);
+void writeJson(royalbed::common::JsonWriter& out, const StateMap& stateMap);
+
 }   // namespace vru_srv::vru
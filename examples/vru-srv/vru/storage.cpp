@@ -1,4 +1,5 @@
 #include <memory>
+#include <mutex>
 #include <stdexcept>
 #include <string>
 #include <string_view>
@@ -28,46 +29,55 @@ Storage& Storage::instance()
 
 StateMap Storage::getAllVru() const
 {
+    const std::lock_guard lock(m_mutex);
     return m_storage;
 }
 
 void Storage::activate(std::string_view idVru)
 {
+    const std::lock_guard lock(m_mutex);
     m_storage.at(std::string(idVru)).status = Status::Active;
 }
 
 void Storage::deactivate(std::string_view idVru)
 {
+    const std::lock_guard lock(m_mutex);
     m_storage.at(std::string(idVru)).status = Status::NotActive;
 }
 
 Status Storage::status(std::string_view idVru) const
 {
+    const std::lock_guard lock(m_mutex);
     return m_storage.at(std::string(idVru)).status;
 }
 
 void Storage::setSampleRate(std::string_view idVru, int value)
 {
+    const std::lock_guard lock(m_mutex);
     m_storage.at(std::string(idVru)).sampleRate = value;
 }
 
 [[nodiscard]] int Storage::getSampleRate(std::string_view idVru) const
 {
+    const std::lock_guard lock(m_mutex);
     return m_storage.at(std::string(idVru)).sampleRate;
 }
 
 void Storage::setPrearrangedFreqs(std::string_view idVru, FspMap value)
 {
+    const std::lock_guard lock(m_mutex);
     m_storage.at(std::string(idVru)).prearrangedFreqList = std::move(value);
 }
 
 void Storage::setHfChannelNum(std::string_view idVru, int value)
 {
+    const std::lock_guard lock(m_mutex);
     m_storage.at(std::string(idVru)).hfChannelNum = value;
 }
 
 void Storage::setFreq(std::string_view idVru, long long freq, int hfChannelNum)
 {
+    const std::lock_guard lock(m_mutex);
     if (hfChannelNum != m_storage.at(std::string(idVru)).hfChannelNum) {
         throw std::runtime_error("incorrect hfChannelNum");
     }
@@ -76,6 +86,7 @@ void Storage::setFreq(std::string_view idVru, long long freq, int hfChannelNum)
 
 void Storage::useFreqForPrearranged(std::string_view idVru, short prearrangedFreqNum, int hfChannelNum)
 {
+    const std::lock_guard lock(m_mutex);
     if (hfChannelNum != m_storage.at(std::string(idVru)).hfChannelNum) {
         throw std::runtime_error("incorrect hfChannelNum");
     }
@@ -84,11 +95,13 @@ void Storage::useFreqForPrearranged(std::string_view idVru, short prearrangedFre
 
 void Storage::setBandWidth(std::string_view idVru, int value)
 {
+    const std::lock_guard lock(m_mutex);
     m_storage.at(std::string(idVru)).bandWidth = value;
 }
 
 [[nodiscard]] int Storage::getBandWidth(std::string_view idVru) const
 {
+    const std::lock_guard lock(m_mutex);
     return m_storage.at(std::string(idVru)).bandWidth;
 }
 
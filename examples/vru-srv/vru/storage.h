@@ -4,6 +4,7 @@
 #include <list>
 #include <map>
 #include <memory>
+#include <mutex>
 #include <string>
 #include <string_view>
 
@@ -41,6 +42,7 @@ public:
     [[nodiscard]] int getBandWidth(std::string_view idVru) const;
 
 private:
+    mutable std::mutex m_mutex;
     StateMap m_storage;
 };
 
@@ -2,12 +2,12 @@
 
 #include "nhope/async/ao-context.h"
 #include "nhope/async/future.h"
-#include "nhope/io/pushback-reader.h"
 
 #include "royalbed/client/response.h"
+#include "royalbed/common/detail/connection-buffer.h"
 
 namespace royalbed::client::detail {
 
-nhope::Future<Response> receiveResponse(nhope::AOContext& aoCtx, nhope::PushbackReader& device);
+nhope::Future<Response> receiveResponse(nhope::AOContext& aoCtx, common::detail::ConnectionBuffer& device);
 
 }   // namespace royalbed::client::detail
@@ -0,0 +1,10 @@
+#pragma once
+
+#include "royalbed/common/tcp.h"
+
+namespace royalbed::client {
+
+using common::connectTcp;
+using common::SocketOptions;
+
+}   // namespace royalbed::client
@@ -0,0 +1,10 @@
+#pragma once
+
+#include "royalbed/common/unix-socket.h"
+
+namespace royalbed::client {
+
+using common::UnixSocket;
+using common::UnixSocketPtr;
+
+}   // namespace royalbed::client
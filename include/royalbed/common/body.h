@@ -1,12 +1,15 @@
 #pragma once
 
+#include <cstdint>
 #include <exception>
 #include <memory>
+#include <string>
 #include <string_view>
 #include <type_traits>
 #include <typeinfo>
 #include <utility>
 #include <variant>
+#include <vector>
 
 #include "fmt/core.h"
 #include "nlohmann/json.hpp"
@@ -15,10 +18,12 @@
 #include "nhope/io/io-device.h"
 #include "nhope/utils/noncopyable.h"
 
+#include "royalbed/common/detail/json-body-parser.h"
 #include "royalbed/common/detail/traits.h"
 #include "royalbed/common/headers.h"
 #include "royalbed/common/http-error.h"
 #include "royalbed/common/http-status.h"
+#include "royalbed/common/json-writer.h"
 
 namespace royalbed::common {
 
@@ -26,21 +31,53 @@ enum class BodyType
 {
     Json,
     Xml,
-    Plain
+    Plain,
+    Cbor,
+    MsgPack,
 };
+
+/**
+ * Определяет тип тела по заголовку Content-Type, параметры (например, charset) не учитываются.
+ * Для неподдерживаемого типа бросает HttpError 415 (Unsupported Media Type).
+ */
 BodyType extractBodyType(const Headers& headers);
 
+/**
+ * JSON, CBOR и MessagePack - это представления одной модели данных,
+ * поэтому Body<T> принимает тело в любом из них.
+ */
+constexpr bool isJsonModel(BodyType type) noexcept
+{
+    return type == BodyType::Json || type == BodyType::Cbor || type == BodyType::MsgPack;
+}
+
+/**
+ * Можно ли тело типа actual передать в аргумент Body<T, declared>.
+ */
+constexpr bool isCompatibleBodyType(BodyType actual, BodyType declared) noexcept
+{
+    return actual == declared || (declared == BodyType::Json && isJsonModel(actual));
+}
+
+std::string_view mimeType(BodyType type);
+
+/**
+ * Выбирает формат тела ответа (JSON, CBOR или MessagePack) по заголовку Accept с учётом q-значений.
+ * Если заголовка Accept нет или ни один из форматов клиенту не подходит, выбирается JSON.
+ */
+BodyType negotiateBodyType(const Headers& requestHeaders);
+
 template<typename T, BodyType B = BodyType::Json>
 class Body final : public nhope::Noncopyable
 {
 public:
     using Type = T;
 
-    Body(Body<T>&& b) noexcept
+    Body(Body&& b) noexcept
       : m_data(std::move(b.m_data))
     {}
 
-    Body& operator=(Body<T>&& b) noexcept
+    Body& operator=(Body&& b) noexcept
     {
         m_data = std::move(b.m_data);
         return *this;
@@ -87,6 +124,10 @@ template<typename T>
 static constexpr bool isBody<Body<T, BodyType::Plain>> = true;
 template<typename T>
 static constexpr bool isBody<Body<T, BodyType::Xml>> = true;
+template<typename T>
+static constexpr bool isBody<Body<T, BodyType::Cbor>> = true;
+template<typename T>
+static constexpr bool isBody<Body<T, BodyType::MsgPack>> = true;
 
 template<typename T>
 struct IsBodyType
@@ -94,8 +135,64 @@ struct IsBodyType
     static constexpr bool value = common::isBody<std::decay_t<T>>;
 };
 
+namespace detail {
+
+// Representation of the request body: CBOR and MessagePack by Content-Type, JSON for any other or no type
+BodyType requestBodyType(const Headers& headers);
+
 template<typename T>
-Body<T> parseBody(const Headers& /*headers*/, const std::vector<std::uint8_t>& rawBody)
+T parseJsonModel(BodyType type, const std::vector<std::uint8_t>& rawBody)
+{
+    switch (type) {
+    case BodyType::Json:
+        return nlohmann::json::parse(rawBody.begin(), rawBody.end()).get<T>();
+    case BodyType::Cbor:
+        return nlohmann::json::from_cbor(rawBody).get<T>();
+    case BodyType::MsgPack:
+        return nlohmann::json::from_msgpack(rawBody).get<T>();
+    default:
+        throw HttpError(HttpStatus::UnsupportedMediaType, fmt::format("{} is not supported for {}", mimeType(type),
+                                                                      typeid(T).name()));
+    }
+}
+
+}   // namespace detail
+
+/**
+ * Сериализует value в формат type (JSON, CBOR или MessagePack).
+ * JSON пишется напрямую через JsonWriter, для двоичных форматов строится nlohmann::json.
+ */
+template<typename T>
+std::string serializeBody(const T& value, BodyType type)
+{
+    if (type == BodyType::Json) {
+        return serializeJson(value);
+    }
+
+    nlohmann::json jsonValue;
+    if constexpr (detail::canSerializeJson<T>) {
+        jsonValue = value;
+    } else {
+        // Only writeJson is defined for T
+        jsonValue = nlohmann::json::parse(serializeJson(value));
+    }
+
+    std::string result;
+    switch (type) {
+    case BodyType::Cbor:
+        nlohmann::json::to_cbor(jsonValue, result);
+        break;
+    case BodyType::MsgPack:
+        nlohmann::json::to_msgpack(jsonValue, result);
+        break;
+    default:
+        throw HttpError(HttpStatus::NotAcceptable, fmt::format("{} is not supported", mimeType(type)));
+    }
+    return result;
+}
+
+template<typename T, BodyType B = BodyType::Json>
+Body<T, B> parseBody(const Headers& headers, const std::vector<std::uint8_t>& rawBody)
 {
     if constexpr (!detail::canDeserializeJson<T>) {
         static_assert(!std::is_same_v<T, T>, "T cannot be retrived from json."
@@ -104,9 +201,9 @@ Body<T> parseBody(const Headers& /*headers*/, const std::vector<std::uint8_t>& r
     }
 
     try {
-        // TODO parse content
-        const auto jsonValue = nlohmann::json::parse(rawBody.begin(), rawBody.end());
-        return jsonValue.get<T>();
+        return detail::parseJsonModel<T>(detail::requestBodyType(headers), rawBody);
+    } catch (const HttpError&) {
+        throw;
     } catch (const std::exception& ex) {
         const auto message = fmt::format("Failed to parse request body for {0}: {1}", typeid(T).name(), ex.what());
         throw HttpError(HttpStatus::BadRequest, message);
@@ -116,6 +213,48 @@ Body<T> parseBody(const Headers& /*headers*/, const std::vector<std::uint8_t>& r
     }
 }
 
+namespace detail {
+
+template<typename T>
+nhope::Future<T> parseJsonModel(BodyType type, nhope::Reader& body)
+{
+    if (type == BodyType::Json) {
+        auto parser = std::make_shared<JsonBodyParser<T>>(body);
+        return parser->start();
+    }
+
+    return nhope::readAll(body).then([type](std::vector<std::uint8_t> rawBody) {
+        try {
+            return parseJsonModel<T>(type, rawBody);
+        } catch (...) {
+            rethrowBodyParseError<T>(std::current_exception());
+        }
+    });
+}
+
+}   // namespace detail
+
+/**
+ * Parses the body while it is being read from body.
+ * JSON is parsed incrementally (see detail::JsonBodyParser),
+ * CBOR and MessagePack are parsed once the whole body is received, a body of any other Content-Type is read as JSON.
+ * Parse errors are reported as HttpError (400), errors of the reader are passed unchanged.
+ */
+template<typename T, BodyType B = BodyType::Json>
+nhope::Future<Body<T, B>> parseBody(const Headers& headers, nhope::Reader& body)
+{
+    if constexpr (!detail::canDeserializeJson<T>) {
+        static_assert(!std::is_same_v<T, T>, "T cannot be retrived from json."
+                                             "need implement: void from_json(const nlohmann::json&, T& )"
+                                             "See https://github.com/nlohmann/json#basic-usage");
+    }
+
+    return detail::parseJsonModel<T>(detail::requestBodyType(headers), body)
+      .then([](T value) {
+          return Body<T, B>(std::move(value));
+      });
+}
+
 }   // namespace royalbed::common
 
 template<typename T>
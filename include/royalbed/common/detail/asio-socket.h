@@ -0,0 +1,91 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <system_error>
+#include <utility>
+
+#include <gsl/span>
+
+#include "asio/error.hpp"
+
+#include "nhope/async/ao-context.h"
+#include "nhope/io/io-device.h"
+
+namespace royalbed::common::detail {
+
+// A socket that exposes its descriptor, see nativeSocketHandle
+class NativeSocket
+{
+public:
+    virtual ~NativeSocket() = default;
+
+    [[nodiscard]] virtual int nativeHandle() noexcept = 0;
+};
+
+inline std::exception_ptr makeAsioError(const asio::error_code& ec)
+{
+    return std::make_exception_ptr(std::system_error(ec));
+}
+
+// Reading and writing of a connected asio stream socket (TCP or Unix domain), shared by the socket devices.
+// The handlers are called in the context of the device, the socket is closed with it.
+template<typename Device, typename Socket>
+class AsioStreamSocket
+  : public Device
+  , public NativeSocket
+{
+public:
+    AsioStreamSocket(nhope::AOContext& parent, Socket&& sock)
+      : m_sock(std::move(sock))
+      , m_aoCtx(parent)
+    {}
+
+    ~AsioStreamSocket() override
+    {
+        m_aoCtx.close();
+
+        asio::error_code ec;
+        m_sock.close(ec);
+    }
+
+    void read(gsl::span<std::uint8_t> buf, nhope::IOHandler handler) override
+    {
+        m_sock.async_read_some(asio::buffer(buf.data(), buf.size()),
+                               [aoCtx = nhope::AOContextRef(m_aoCtx), handler = std::move(handler)](
+                                 const asio::error_code& ec, std::size_t n) mutable {
+                                   aoCtx.exec([handler = std::move(handler), ec, n] {
+                                       if (ec == asio::error::eof) {
+                                           handler(nullptr, 0);
+                                       } else if (ec) {
+                                           handler(makeAsioError(ec), n);
+                                       } else {
+                                           handler(nullptr, n);
+                                       }
+                                   });
+                               });
+    }
+
+    void write(gsl::span<const std::uint8_t> data, nhope::IOHandler handler) override
+    {
+        m_sock.async_write_some(asio::buffer(data.data(), data.size()),
+                                [aoCtx = nhope::AOContextRef(m_aoCtx), handler = std::move(handler)](
+                                  const asio::error_code& ec, std::size_t n) mutable {
+                                    aoCtx.exec([handler = std::move(handler), ec, n] {
+                                        handler(ec ? makeAsioError(ec) : nullptr, n);
+                                    });
+                                });
+    }
+
+    [[nodiscard]] int nativeHandle() noexcept override
+    {
+        return static_cast<int>(m_sock.native_handle());
+    }
+
+protected:
+    Socket m_sock;
+    nhope::AOContext m_aoCtx;
+};
+
+}   // namespace royalbed::common::detail
@@ -5,7 +5,9 @@
 
 #include "3rdparty/llhttp/llhttp.h"
 #include "nhope/async/ao-context.h"
-#include "nhope/io/pushback-reader.h"
+#include "nhope/io/io-device.h"
+
+#include "royalbed/common/detail/connection-buffer.h"
 
 namespace royalbed::common::detail {
 
@@ -15,7 +17,8 @@ using BodyReaderPtr = std::unique_ptr<BodyReader>;
 class BodyReader : public nhope::Reader
 {
 public:
-    static BodyReaderPtr create(nhope::AOContextRef& aoCtx, nhope::PushbackReader& device,
+    // The body of the message whose head has been consumed from the device
+    static BodyReaderPtr create(nhope::AOContextRef& aoCtx, ConnectionBuffer& device,
                                 std::unique_ptr<llhttp_t> httpParser);
 };
 
@@ -0,0 +1,54 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include <gsl/span>
+
+namespace royalbed::common::detail {
+
+// Strips the chunked transfer coding (RFC 9112, 7.1), the framing may be split across portions.
+// Chunk extensions and trailer fields are skipped.
+class ChunkedDecoder final
+{
+public:
+    struct Result
+    {
+        // Body bytes written to the output
+        std::size_t bodySize;
+
+        // Bytes of the input taken by the decoder. The decoder stops when the output is full,
+        // after the end of the chunked body the rest of the input belongs to the next message.
+        std::size_t consumed;
+    };
+
+    // Throws HttpError(BadRequest) if the framing is invalid
+    Result decode(gsl::span<const std::uint8_t> input, gsl::span<std::uint8_t> output);
+
+    // Decodes in place, the body is moved to the beginning of the portion
+    Result decode(gsl::span<std::uint8_t> portion);
+
+    [[nodiscard]] bool done() const noexcept;
+
+private:
+    enum class State
+    {
+        Size,
+        Extension,
+        SizeLf,
+        Data,
+        DataCr,
+        DataLf,
+        TrailerStart,
+        Trailer,
+        TrailerLf,
+        LastLf,
+        Done,
+    };
+
+    State m_state = State::Size;
+    std::uint64_t m_chunkSize = 0;
+    bool m_haveSizeDigits = false;
+};
+
+}   // namespace royalbed::common::detail
@@ -0,0 +1,16 @@
+#pragma once
+
+#include "nhope/async/ao-context.h"
+#include "nhope/io/io-device.h"
+
+#include "royalbed/common/response.h"
+
+namespace royalbed::common::detail {
+
+// Wraps the body into the chunked transfer coding (RFC 9112, 7.1).
+// Portions read from the body are coalesced into chunks of params.minChunkSize..params.maxChunkSize bytes,
+// the last-chunk followed by the trailer fields is emitted when the body is over.
+nhope::ReaderPtr makeChunkedEncoder(nhope::AOContext& aoCtx, nhope::ReaderPtr body, const ChunkedParams& params,
+                                    TrailersProvider trailers = nullptr);
+
+}   // namespace royalbed::common::detail
@@ -0,0 +1,56 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include <gsl/span>
+
+#include "nhope/async/ao-context.h"
+#include "nhope/io/io-device.h"
+
+namespace royalbed::common::detail {
+
+class ConnectionBuffer;
+using ConnectionBufferPtr = std::unique_ptr<ConnectionBuffer>;
+
+// The bytes received from a connection and not consumed yet.
+// The parsing stages look at the buffered bytes in place and consume them by advancing the read offset,
+// so the request head, the body and the next pipelined request share the same bytes and nothing is put back.
+// The bytes are moved to the beginning of the storage only when a fill finds no free space at its end.
+class ConnectionBuffer final : public nhope::Reader
+{
+public:
+    static constexpr std::size_t defaultCapacity = 16 * 1024;
+
+    ConnectionBuffer(nhope::AOContext& parent, nhope::Reader& device, std::size_t capacity = defaultCapacity);
+    ConnectionBuffer(nhope::AOContext& parent, nhope::ReaderPtr device, std::size_t capacity = defaultCapacity);
+    ~ConnectionBuffer() override;
+
+    // The buffered bytes, valid until the next fill
+    [[nodiscard]] gsl::span<const std::uint8_t> data() const noexcept;
+    void consume(std::size_t n) noexcept;
+
+    // Appends the next portion received from the device to the buffered bytes, n == 0 at the end of the stream.
+    // The storage grows when the buffered bytes take all of it.
+    void fill(nhope::IOHandler handler);
+
+    // Gives the buffered bytes first, with nothing buffered reads from the device straight into buf
+    void read(gsl::span<std::uint8_t> buf, nhope::IOHandler handler) override;
+
+    static ConnectionBufferPtr create(nhope::AOContext& aoCtx, nhope::Reader& device);
+    static ConnectionBufferPtr create(nhope::AOContext& aoCtx, nhope::ReaderPtr device);
+
+private:
+    nhope::ReaderPtr m_ownDevice;
+    nhope::Reader& m_device;
+
+    std::vector<std::uint8_t> m_storage;
+    std::size_t m_begin = 0;
+    std::size_t m_end = 0;
+
+    nhope::AOContext m_aoCtx;
+};
+
+}   // namespace royalbed::common::detail
@@ -0,0 +1,16 @@
+#pragma once
+
+#include "nhope/async/ao-context.h"
+#include "nhope/io/tcp.h"
+
+#include "royalbed/common/tcp.h"
+
+namespace royalbed::common::detail {
+
+// A TCP server on top of io_uring: multishot accept and receives into the buffers provided to the kernel.
+// Throws std::runtime_error if royalbed is built without io_uring support,
+// std::system_error if the kernel does not support it
+nhope::TcpServerPtr startIoUringTcpServer(nhope::AOContext& aoCtx, const nhope::TcpServerParams& params,
+                                          const SocketOptions& options);
+
+}   // namespace royalbed::common::detail
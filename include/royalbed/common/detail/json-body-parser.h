@@ -0,0 +1,145 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <memory>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <typeinfo>
+#include <utility>
+#include <variant>
+
+#include "fmt/core.h"
+#include "nlohmann/json.hpp"
+
+#include "nhope/async/future.h"
+#include "nhope/io/io-device.h"
+
+#include "royalbed/common/detail/json-stream-splitter.h"
+#include "royalbed/common/detail/traits.h"
+#include "royalbed/common/http-error.h"
+#include "royalbed/common/http-status.h"
+
+namespace royalbed::common::detail {
+
+// Turns an error of parsing the body into T into HttpError (400)
+template<typename T>
+[[noreturn]] void rethrowBodyParseError(std::exception_ptr ex)
+{
+    try {
+        std::rethrow_exception(std::move(ex));
+    } catch (const HttpError&) {
+        throw;
+    } catch (const std::exception& e) {
+        const auto message = fmt::format("Failed to parse request body for {0}: {1}", typeid(T).name(), e.what());
+        throw HttpError(HttpStatus::BadRequest, message);
+    } catch (...) {
+        const auto message = fmt::format("Failed to parse request body for {0}", typeid(T).name());
+        throw HttpError(HttpStatus::BadRequest, message);
+    }
+}
+
+/**
+ * Parses a JSON request body while it is being received.
+ *
+ * If T is a sequence container and the body is a JSON array, the array is split by JsonStreamSplitter and
+ * every element is converted to T::value_type as soon as it is received, so a DOM for the whole
+ * document is never built. Otherwise the body is collected and parsed once the last chunk arrives.
+ * Parse errors are reported as HttpError (400), errors of the body reader are passed unchanged.
+ */
+template<typename T>
+class JsonBodyParser final : public std::enable_shared_from_this<JsonBodyParser<T>>
+{
+public:
+    explicit JsonBodyParser(nhope::Reader& body)
+      : m_body(body)
+    {}
+
+    nhope::Future<T> start()
+    {
+        this->readNextPortion();
+        return m_promise.future();
+    }
+
+private:
+    static constexpr std::size_t readBufSize = 4096;
+    static constexpr bool splitArray = JsonSequence<T>;
+
+    void readNextPortion()
+    {
+        m_body.read(m_readBuf, [self = this->shared_from_this()](std::exception_ptr err, std::size_t n) {
+            if (err) {
+                self->m_promise.setException(std::move(err));
+                return;
+            }
+
+            try {
+                if (n == 0) {
+                    self->m_promise.setValue(self->finish());
+                    return;
+                }
+                self->processData(std::span(self->m_readBuf.data(), n));
+            } catch (...) {
+                self->m_promise.setException(parseError(std::current_exception()));
+                return;
+            }
+
+            self->readNextPortion();
+        });
+    }
+
+    static std::exception_ptr parseError(std::exception_ptr ex)
+    {
+        try {
+            rethrowBodyParseError<T>(std::move(ex));
+        } catch (...) {
+            return std::current_exception();
+        }
+    }
+
+    void processData(std::span<const std::uint8_t> data)
+    {
+        if constexpr (splitArray) {
+            m_splitter.feed(data);
+        } else {
+            m_document.append(data.begin(), data.end());
+        }
+    }
+
+    T finish()
+    {
+        if constexpr (splitArray) {
+            m_splitter.finish();
+            return std::move(m_value);
+        } else {
+            return nlohmann::json::parse(m_document).template get<T>();
+        }
+    }
+
+    void addElement(std::string_view element)
+    {
+        m_value.push_back(nlohmann::json::parse(element).template get<typename T::value_type>());
+    }
+
+    using Value = std::conditional_t<splitArray, T, std::monostate>;
+
+    nhope::Reader& m_body;
+    nhope::Promise<T> m_promise;
+
+    std::array<std::uint8_t, readBufSize> m_readBuf{};
+
+    Value m_value{};
+    JsonStreamSplitter m_splitter{[this](std::string_view element) {
+        if constexpr (splitArray) {
+            this->addElement(element);
+        }
+    }};
+    std::string m_document;
+};
+
+}   // namespace royalbed::common::detail
@@ -0,0 +1,54 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <span>
+#include <string>
+#include <string_view>
+
+namespace royalbed::common::detail {
+
+/**
+ * Incrementally splits a top-level JSON array into its elements as bytes arrive.
+ * Every complete element is passed to the handler while the rest of the document is still being received,
+ * so only one element has to be kept in memory at a time.
+ *
+ * The splitter validates only the structure required to find element boundaries,
+ * the element itself must be parsed by the handler.
+ */
+class JsonStreamSplitter final
+{
+public:
+    using ElementHandler = std::function<void(std::string_view element)>;
+
+    explicit JsonStreamSplitter(ElementHandler handler);
+
+    void feed(std::span<const std::uint8_t> data);
+    void finish();
+
+    [[nodiscard]] std::size_t elementCount() const noexcept;
+
+private:
+    enum class State
+    {
+        BeforeArray,
+        BeforeElement,
+        InElement,
+        AfterArray,
+    };
+
+    void processChar(char ch);
+    void processElementChar(char ch);
+    void completeElement();
+
+    ElementHandler m_handler;
+
+    State m_state = State::BeforeArray;
+    std::string m_element;
+    std::size_t m_depth = 0;
+    bool m_inString = false;
+    bool m_escaped = false;
+    std::size_t m_elementCount = 0;
+};
+
+}   // namespace royalbed::common::detail
@@ -0,0 +1,21 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+#include <gsl/span>
+
+namespace royalbed::common::detail {
+
+using Sha1Digest = std::array<std::uint8_t, 20>;
+
+// SHA-1 (RFC 3174). Used only where a protocol requires it (the WebSocket handshake),
+// it must not be used for security purposes.
+Sha1Digest sha1(std::string_view data);
+
+std::string toBase64(gsl::span<const std::uint8_t> data);
+
+}   // namespace royalbed::common::detail
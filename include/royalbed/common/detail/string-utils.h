@@ -61,6 +61,13 @@ struct LowercaseEqual final
     }
 };
 
+// Removes the optional whitespace (spaces and tabs, RFC 9110, 5.6.3) around a header value or its part.
+std::string_view trim(std::string_view str) noexcept;
+
+// Checks that the comma-separated list (a value of Connection, Upgrade, etc.) contains the token.
+// The comparison is case-insensitive.
+bool containsToken(std::string_view list, std::string_view token);
+
 template<typename T>
 T fromString(std::string_view /*unused*/)
 {
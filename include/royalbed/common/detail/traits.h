@@ -2,7 +2,9 @@
 
 #include <cstdlib>
 #include <type_traits>
+#include <string>
 #include <string_view>
+#include <utility>
 
 #include <nlohmann/json.hpp>
 
@@ -20,4 +22,24 @@ inline constexpr bool canSerializeJson = nlohmann::detail::has_to_json<nlohmann:
 template<>
 inline constexpr bool canSerializeJson<nlohmann::json> = true;
 
+// from_json is defined for T itself and is found by ADL (nlohmann's own converters are not functions)
+template<typename T>
+concept HasOwnFromJson = requires(const nlohmann::json& json, T& value) {
+    from_json(json, value);
+};
+
+// to_json is defined for T itself and is found by ADL
+template<typename T>
+concept HasOwnToJson = requires(nlohmann::json& json, const T& value) {
+    to_json(json, value);
+};
+
+// The container can be filled element by element from a JSON array.
+// A container with its own from_json is parsed by it.
+template<typename T>
+concept JsonSequence = !std::is_same_v<T, std::string> && !std::is_same_v<T, nlohmann::json> &&
+                       !HasOwnFromJson<T> && requires(T& container, typename T::value_type value) {
+                           container.push_back(std::move(value));
+                       } && canDeserializeJson<typename T::value_type>;
+
 }   // namespace royalbed::common::detail
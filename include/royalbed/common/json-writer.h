@@ -0,0 +1,177 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <optional>
+#include <ranges>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <unordered_map>
+#include <vector>
+
+#include "nlohmann/json.hpp"
+
+#include "royalbed/common/detail/traits.h"
+
+namespace royalbed::common {
+
+class JsonWriter;
+
+/**
+ * Тип T можно сериализовать без построения nlohmann::json, если для него определена функция
+ *   void writeJson(royalbed::common::JsonWriter& out, const T& value);
+ * в пространстве имён типа T (функция ищется через ADL, аналогично to_json).
+ */
+template<typename T>
+concept JsonWritable = requires(JsonWriter& out, const T& value)
+{
+    writeJson(out, value);
+};
+
+/**
+ * Пишет JSON непосредственно в строку, которая затем становится телом ответа.
+ * Промежуточный nlohmann::json не строится.
+ *
+ * Стандартные типы (числа, строки, std::optional, контейнеры) пишутся напрямую,
+ * остальные - через writeJson, а при его отсутствии через to_json (с построением DOM только для этого значения).
+ * Собственный to_json, найденный через ADL, используется и для контейнеров.
+ *
+ * Пример:
+ *   void writeJson(JsonWriter& out, const State& state)
+ *   {
+ *       out.beginObject()
+ *         .field("id", state.id)
+ *         .field("sampleRate", state.sampleRate)
+ *         .endObject();
+ *   }
+ */
+class JsonWriter final
+{
+public:
+    JsonWriter() = default;
+    explicit JsonWriter(std::string& out);
+
+    JsonWriter(const JsonWriter&) = delete;
+    JsonWriter& operator=(const JsonWriter&) = delete;
+
+    JsonWriter& beginObject();
+    JsonWriter& endObject();
+
+    JsonWriter& beginArray();
+    JsonWriter& endArray();
+
+    JsonWriter& key(std::string_view name);
+
+    JsonWriter& null();
+    JsonWriter& boolean(bool val);
+    JsonWriter& integer(std::int64_t val);
+    JsonWriter& unsignedInteger(std::uint64_t val);
+    JsonWriter& number(double val);
+    JsonWriter& string(std::string_view val);
+
+    // Appends an already serialized JSON value
+    JsonWriter& raw(std::string_view json);
+
+    template<typename T>
+    JsonWriter& value(const T& val);
+
+    template<typename T>
+    JsonWriter& field(std::string_view name, const T& val)
+    {
+        key(name);
+        return value(val);
+    }
+
+    [[nodiscard]] std::string& buffer() noexcept;
+    [[nodiscard]] std::string takeBuffer() noexcept;
+
+private:
+    void beforeValue();
+
+    std::string m_ownBuffer;
+    std::string* m_out = &m_ownBuffer;
+
+    // For each opened object/array: whether a value has already been written
+    std::vector<bool> m_hasValues;
+    bool m_afterKey = false;
+};
+
+namespace detail {
+
+template<typename T>
+inline constexpr bool isStringMap = false;
+template<typename V, typename C, typename A>
+inline constexpr bool isStringMap<std::map<std::string, V, C, A>> = true;
+template<typename V, typename H, typename E, typename A>
+inline constexpr bool isStringMap<std::unordered_map<std::string, V, H, E, A>> = true;
+
+template<typename T>
+inline constexpr bool isOptional = false;
+template<typename T>
+inline constexpr bool isOptional<std::optional<T>> = true;
+
+}   // namespace detail
+
+template<typename T>
+JsonWriter& JsonWriter::value(const T& val)
+{
+    if constexpr (JsonWritable<T>) {
+        writeJson(*this, val);
+    } else if constexpr (std::is_same_v<T, nlohmann::json>) {
+        raw(val.dump());
+    } else if constexpr (std::is_same_v<T, bool>) {
+        boolean(val);
+    } else if constexpr (std::is_integral_v<T> && std::is_signed_v<T>) {
+        integer(val);
+    } else if constexpr (std::is_integral_v<T>) {
+        unsignedInteger(val);
+    } else if constexpr (std::is_floating_point_v<T>) {
+        number(static_cast<double>(val));
+    } else if constexpr (std::is_same_v<T, std::nullptr_t>) {
+        null();
+    } else if constexpr (std::is_convertible_v<const T&, std::string_view>) {
+        string(val);
+    } else if constexpr (detail::HasOwnToJson<T>) {
+        // The type has its own representation, it is written through the DOM
+        raw(nlohmann::json(val).dump());
+    } else if constexpr (detail::isOptional<T>) {
+        if (val.has_value()) {
+            value(*val);
+        } else {
+            null();
+        }
+    } else if constexpr (detail::isStringMap<T>) {
+        beginObject();
+        for (const auto& [name, item] : val) {
+            field(name, item);
+        }
+        endObject();
+    } else if constexpr (std::ranges::range<T>) {
+        beginArray();
+        for (const auto& item : val) {
+            value(item);
+        }
+        endArray();
+    } else {
+        static_assert(detail::canSerializeJson<T>, "T cannot be written as json."
+                                                   "Please define a writeJson or to_json function for it.");
+        // Fallback through the DOM
+        raw(nlohmann::json(val).dump());
+    }
+    return *this;
+}
+
+/**
+ * Сериализует value в JSON-строку через JsonWriter.
+ */
+template<typename T>
+std::string serializeJson(const T& value)
+{
+    JsonWriter writer;
+    writer.value(value);
+    return writer.takeBuffer();
+}
+
+}   // namespace royalbed::common
@@ -1,5 +1,7 @@
 #pragma once
 
+#include <cstddef>
+#include <functional>
 #include <memory>
 #include <string>
 #include <string_view>
@@ -11,12 +13,40 @@
 
 namespace royalbed::common {
 
+/**
+ * Параметры отправки тела частями (Transfer-Encoding: chunked).
+ * Тело отправляется частями, если для него не задан заголовок Content-Length.
+ */
+struct ChunkedParams final
+{
+    // Прочитанные из тела порции меньшего размера объединяются в одну часть,
+    // пока её размер не достигнет minChunkSize или тело не закончится.
+    // 0 - каждая порция отправляется сразу (например, для потока событий).
+    std::size_t minChunkSize = defaultMinChunkSize;
+
+    // Максимальный размер одной части.
+    std::size_t maxChunkSize = defaultMaxChunkSize;
+
+    static constexpr std::size_t defaultMinChunkSize = 4 * 1024;
+    static constexpr std::size_t defaultMaxChunkSize = 16 * 1024;
+};
+
+/**
+ * Возвращает заголовки, которые отправляются после тела (trailer fields).
+ * Вызывается после того, как тело прочитано целиком.
+ */
+using TrailersProvider = std::function<Headers()>;
+
 struct Response final
 {
     int status = HttpStatus::Ok;
     std::string statusMessage;
     Headers headers;
     nhope::ReaderPtr body;
+
+    // Используются только при отправке тела частями
+    TrailersProvider trailers;
+    ChunkedParams chunked;
 };
 
 Response makePlainTextResponse(nhope::AOContext& ctx, int status, std::string_view msg);
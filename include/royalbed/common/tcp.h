@@ -0,0 +1,62 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <string_view>
+
+#include "nhope/async/ao-context.h"
+#include "nhope/async/future.h"
+#include "nhope/io/tcp.h"
+
+namespace royalbed::common {
+
+/**
+ * Настройки TCP сокетов.
+ * Для сервера применяются к слушающему сокету и к каждому принятому соединению,
+ * для клиента - к устанавливаемому соединению.
+ * Нулевые значения оставляют системные настройки.
+ */
+struct SocketOptions
+{
+    // Отключить алгоритм Нейгла (TCP_NODELAY), иначе короткие ответы задерживаются до ~40 мс
+    bool noDelay = true;
+
+    // TCP Fast Open: данные передаются уже в SYN (только Linux)
+    bool fastOpen = false;
+
+    // Длина очереди соединений TCP Fast Open на сервере
+    int fastOpenQueueLength = 256;   // NOLINT(readability-magic-numbers)
+
+    // TCP_DEFER_ACCEPT: соединение принимается, когда от клиента пришли данные (только Linux, только сервер)
+    std::chrono::seconds deferAccept{0};
+
+    // Длина очереди ожидающих принятия соединений, 0 - SOMAXCONN
+    int backlog = 0;
+
+    // Размеры буферов SO_SNDBUF и SO_RCVBUF
+    int sendBufferSize = 0;
+    int receiveBufferSize = 0;
+};
+
+/**
+ * Реализация ввода-вывода TCP сервера.
+ * IoUring доступен только в Linux при сборке с опцией ROYALBED_IO_URING_ENABLED (требуется liburing 2.4 и новее).
+ */
+enum class IoBackend
+{
+    Asio,
+    IoUring,
+};
+
+nhope::TcpServerPtr startTcpServer(nhope::AOContext& aoCtx, const nhope::TcpServerParams& params,
+                                   const SocketOptions& options, IoBackend backend = IoBackend::Asio);
+
+// Дескриптор сокета, созданного startTcpServer или connectTcp, -1 для сокетов других реализаций.
+// Позволяет прочитать или задать опции, которых нет в SocketOptions
+int nativeSocketHandle(nhope::TcpSocket& sock) noexcept;
+int nativeSocketHandle(nhope::TcpServer& server) noexcept;
+
+nhope::Future<nhope::TcpSocketPtr> connectTcp(nhope::AOContext& aoCtx, std::string_view hostName, std::uint16_t port,
+                                              const SocketOptions& options);
+
+}   // namespace royalbed::common
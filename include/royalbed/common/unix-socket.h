@@ -0,0 +1,47 @@
+#pragma once
+
+#include <memory>
+#include <string>
+#include <string_view>
+
+#include "nhope/async/ao-context.h"
+#include "nhope/async/future.h"
+#include "nhope/io/io-device.h"
+
+namespace royalbed::common {
+
+/**
+ * Сокеты домена Unix (AF_UNIX).
+ * Путь, начинающийся с '@', задаёт адрес в абстрактном пространстве имён Linux,
+ * такой сокет не создаёт файла и удаляется вместе с последним дескриптором.
+ */
+
+class UnixSocket;
+using UnixSocketPtr = std::unique_ptr<UnixSocket>;
+
+class UnixSocket : public nhope::IODevice
+{
+public:
+    // Путь сервера, к которому подключен сокет
+    [[nodiscard]] virtual std::string path() const = 0;
+
+    static nhope::Future<UnixSocketPtr> connect(nhope::AOContext& aoCtx, std::string_view path);
+};
+
+class UnixServer;
+using UnixServerPtr = std::unique_ptr<UnixServer>;
+
+class UnixServer
+{
+public:
+    virtual ~UnixServer() = default;
+
+    virtual nhope::Future<UnixSocketPtr> accept() = 0;
+
+    [[nodiscard]] virtual std::string path() const = 0;
+
+    // Файл оставшегося от предыдущего запуска сокета удаляется, файл сокета удаляется и при остановке сервера
+    static UnixServerPtr start(nhope::AOContext& aoCtx, std::string_view path);
+};
+
+}   // namespace royalbed::common
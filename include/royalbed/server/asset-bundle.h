@@ -0,0 +1,78 @@
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <optional>
+#include <string_view>
+#include <vector>
+
+#include <gsl/span>
+
+namespace royalbed::server {
+
+namespace detail {
+class MappedBundle;
+}   // namespace detail
+
+struct AssetVariant final
+{
+    gsl::span<const std::uint8_t> data;
+
+    // Пусто, если содержимое не сжато
+    std::string_view contentEncoding;
+
+    std::string_view etag;
+};
+
+struct Asset final
+{
+    // Путь относительно базового каталога бандла, например "swagger/index.html"
+    std::string_view path;
+    std::string_view contentType;
+
+    AssetVariant content;
+
+    // Содержимое файла path.gz, если он был собран в бандл вместе с path
+    std::optional<AssetVariant> gzip;
+};
+
+/**
+ * Бандл ресурсов - альтернатива встраиванию файлов в программу с помощью cmrc.
+ * Собирается функцией CMake royalbed_add_asset_bundle и при запуске отображается в память.
+ * Индекс бандла содержит MIME-типы, ETag-и и сжатые варианты файлов, содержимое файлов при открытии не читается.
+ *
+ * Копии AssetBundle разделяют одно отображение, оно существует, пока есть копии или owner().
+ */
+class AssetBundle final
+{
+public:
+    /**
+     * Бросает std::runtime_error, если файл не является бандлом или повреждён.
+     */
+    static AssetBundle open(const std::filesystem::path& path);
+
+    /**
+     * Собирает бандл из files, пути в бандле отсчитываются от baseDir.
+     * Файл name.gz становится сжатым вариантом name, а без name - отдаётся вместо него.
+     * Бандл записывается в output.tmp и переименовывается в output, поэтому открытый бандл не изменяется.
+     */
+    static void build(const std::filesystem::path& output, const std::filesystem::path& baseDir,
+                      const std::vector<std::filesystem::path>& files);
+
+    // Отсортированы по path
+    [[nodiscard]] gsl::span<const Asset> assets() const noexcept;
+
+    // nullptr, если ресурса нет
+    [[nodiscard]] const Asset* find(std::string_view path) const noexcept;
+
+    // Удерживает отображение бандла
+    [[nodiscard]] std::shared_ptr<const void> owner() const noexcept;
+
+private:
+    explicit AssetBundle(std::shared_ptr<const detail::MappedBundle> bundle);
+
+    std::shared_ptr<const detail::MappedBundle> m_bundle;
+};
+
+}   // namespace royalbed::server
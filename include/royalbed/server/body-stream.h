@@ -0,0 +1,62 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <type_traits>
+
+#include <gsl/span>
+
+#include "nhope/async/ao-context.h"
+#include "nhope/async/future.h"
+#include "nhope/io/io-device.h"
+
+#include "royalbed/server/request-context.h"
+
+namespace royalbed::server {
+
+/**
+ * Аргумент обработчика, предоставляющий потоковый доступ к телу запроса.
+ * В отличие от Body<T> тело не буферизуется целиком: обработчик сам читает его порциями,
+ * поэтому потребление памяти ограничено размером буфера чтения, а не размером тела.
+ *
+ * BodyStream не владеет телом запроса (оно принадлежит RequestContext),
+ * поэтому его можно свободно копировать и захватывать в продолжения.
+ */
+class BodyStream final
+{
+public:
+    BodyStream(RequestContext& ctx);
+
+    [[nodiscard]] nhope::Reader& reader() const noexcept;
+
+    /**
+     * Читает очередную порцию тела. Возвращает 0 по достижении конца тела.
+     */
+    [[nodiscard]] nhope::Future<std::size_t> read(gsl::span<std::uint8_t> buf) const;
+
+    /**
+     * Перекачивает оставшуюся часть тела в dest (например, в сокет).
+     * Возвращает число переданных байт.
+     */
+    [[nodiscard]] nhope::Future<std::size_t> pipeTo(nhope::Writter& dest) const;
+
+    /**
+     * Сохраняет оставшуюся часть тела в файл filePath (файл перезаписывается).
+     * Файл открывается, пишется и закрывается в пуле потоков; результат готов после закрытия файла.
+     * Возвращает число записанных байт, ошибки открытия, записи и закрытия - std::system_error.
+     */
+    [[nodiscard]] nhope::Future<std::size_t> saveToFile(const std::filesystem::path& filePath) const;
+
+private:
+    nhope::Reader* m_reader;
+    nhope::AOContext* m_aoCtx;
+};
+
+template<typename T>
+struct IsBodyStreamType
+{
+    static constexpr bool value = std::is_same_v<std::decay_t<T>, BodyStream>;
+};
+
+}   // namespace royalbed::server
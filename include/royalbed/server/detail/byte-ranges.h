@@ -0,0 +1,27 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string_view>
+#include <vector>
+
+namespace royalbed::server::detail {
+
+struct ByteRange final
+{
+    std::uint64_t offset;
+    std::uint64_t length;
+
+    bool operator==(const ByteRange&) const = default;
+};
+
+// More ranges in one request are not served, the whole representation is sent instead
+constexpr std::size_t maxByteRanges = 16;
+
+// Parses the Range header value (RFC 9110, 14.1.2) for a representation of the given size.
+// std::nullopt means the header is invalid or too long and must be ignored,
+// an empty vector means that no range is satisfiable (416).
+std::optional<std::vector<ByteRange>> parseByteRanges(std::string_view value, std::uint64_t size);
+
+}   // namespace royalbed::server::detail
@@ -9,7 +9,12 @@
 #include "nhope/io/tcp.h"
 #include "spdlog/logger.h"
 
+#include "royalbed/server/detail/timer-wheel.h"
+#include "royalbed/server/detail/tls-stream.h"
+#include "royalbed/server/http2.h"
+#include "royalbed/server/request-limits.h"
 #include "royalbed/server/router.h"
+#include "royalbed/server/timeouts.h"
 
 namespace royalbed::server::detail {
 
@@ -50,7 +55,16 @@ struct ConnectionParams
     KeepAliveParams keepAlive;
     ConnectionCtx& ctx;
     std::shared_ptr<spdlog::logger> log;
-    nhope::TcpSocketPtr sock;
+    nhope::IODevicePtr sock;
+    Http2Params http2{};
+
+    // nullptr - the connection without TLS
+    TlsContextPtr tls{};
+
+    // nullptr - the stages of the connection are not limited in time
+    TimerWheelPtr timers{};
+    Timeouts timeouts{};
+    RequestLimits limits{};
 };
 
 void openConnection(nhope::AOContext& aoCtx, ConnectionParams&& params);
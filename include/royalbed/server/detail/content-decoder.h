@@ -0,0 +1,16 @@
+#pragma once
+
+#include <string_view>
+
+#include "nhope/async/ao-context.h"
+#include "nhope/io/io-device.h"
+
+namespace royalbed::server::detail {
+
+// Decodes a request body sent with Content-Encoding (RFC 9110, 8.4), the codings are undone in reverse order.
+// gzip and deflate require ROYALBED_ZLIB_ENABLED, br requires ROYALBED_BROTLI_ENABLED.
+// Throws HttpError(UnsupportedMediaType) for any other coding, a corrupted or truncated body or data after
+// the compressed stream fail the reads with HttpError(BadRequest).
+nhope::ReaderPtr makeContentDecoder(nhope::AOContext& aoCtx, nhope::ReaderPtr body, std::string_view contentEncoding);
+
+}   // namespace royalbed::server::detail
@@ -25,16 +25,29 @@
 #include "royalbed/common/request.h"
 #include "royalbed/common/detail/traits.h"
 #include "royalbed/common/body.h"
+#include "royalbed/common/json-writer.h"
+#include "royalbed/server/body-stream.h"
+#include "royalbed/server/multipart.h"
 #include "royalbed/server/param.h"
 #include "royalbed/server/error.h"
+#include "royalbed/server/event-stream.h"
+#include "royalbed/server/json-stream.h"
 #include "royalbed/server/low-level-handler.h"
 #include "royalbed/server/request-context.h"
+#include "royalbed/server/spooled-body.h"
 #include "royalbed/server/string-literal.h"
+#include "royalbed/server/websocket.h"
 
 namespace royalbed::server::detail {
 
 template<typename T>
-static constexpr bool isRequstHandlerArg = isQueryOrParam<T> || common::isBody<T> || std::same_as<T, RequestContext>;
+static constexpr bool isRequstHandlerArg = isQueryOrParam<T> || common::isBody<T> || std::same_as<T, BodyStream> ||
+                                           std::same_as<T, MultipartBody> || std::same_as<T, SpooledBody> ||
+                                           std::same_as<T, RequestContext>;
+
+// The argument that takes the whole received body
+template<typename T>
+concept HandlerBody = BodyTypename<T> || std::same_as<T, SpooledBody>;
 
 template<typename Fn, std::size_t... I>
 constexpr bool checkFunctionArgs(std::index_sequence<I...> /*unused*/)
@@ -44,17 +57,48 @@ constexpr bool checkFunctionArgs(std::index_sequence<I...> /*unused*/)
     return ((isRequstHandlerArg<std::decay_t<typename FnProps::template ArgumentType<I>>>)&&...);
 }
 
-void addContent(RequestContext& ctx, std::string content);
+void addContent(RequestContext& ctx, common::BodyType type, std::string content);
+void addContent(RequestContext& ctx, JsonArrayStream stream);
+void addContent(RequestContext& ctx, EventStream stream);
+void addContent(RequestContext& ctx, WebSocketUpgrade upgrade);
+
+template<typename R>
+static constexpr bool isStreamResult =
+  std::is_same_v<R, JsonArrayStream> || std::is_same_v<R, EventStream> || std::is_same_v<R, WebSocketUpgrade>;
+
+template<typename R>
+void addResult(RequestContext& ctx, R&& result)
+{
+    if constexpr (isStreamResult<std::decay_t<R>>) {
+        addContent(ctx, std::forward<R>(result));
+    } else {
+        const auto type = common::negotiateBodyType(ctx.request.headers);
+        addContent(ctx, type, common::serializeBody(result, type));
+    }
+}
 
 template<typename R>
 constexpr void checkRequestHandlerResult()
 {
-    static_assert(std::is_void_v<R> || common::detail::canSerializeJson<R>,
+    static_assert(std::is_void_v<R> || isStreamResult<R> || common::JsonWritable<R> ||
+                    common::detail::canSerializeJson<R>,
                   "The handler result cannot be converted to json."
-                  "Please define a to_json function for it."
+                  "Please define a writeJson or to_json function for it."
                   "See https://github.com/nlohmann/json");
 }
 
+template<typename Handler, typename T>
+constexpr bool handlerReturns()
+{
+    using FnProps = nhope::FunctionProps<decltype(std::function(std::declval<Handler>()))>;
+    using R = typename FnProps::ReturnType;
+    if constexpr (nhope::isFuture<R>) {
+        return std::is_same_v<typename R::Type, T>;
+    } else {
+        return std::is_same_v<R, T>;
+    }
+}
+
 template<typename FnProps, int Index>
 constexpr int nextPathParamIndex()
 {
@@ -135,7 +179,10 @@ constexpr void checkRequestHandler()
     static_assert(checkFunctionArgs<Handler>(std::make_index_sequence<FnProps::argumentCount>{}),
                   "RequestHandler argument must be one of\n"
                   "\tParam <royalbed/server/param.h>)"
-                  "\tBody <royalbed/common/body.h>");
+                  "\tBody <royalbed/common/body.h>"
+                  "\tBodyStream <royalbed/server/body-stream.h>"
+                  "\tMultipartBody <royalbed/server/multipart.h>"
+                  "\tSpooledBody <royalbed/server/spooled-body.h>");
     using R = typename FnProps::ReturnType;
 
     constexpr int bodyIndex = nhope::findArgument<FnProps, common::IsBodyType>();
@@ -144,6 +191,29 @@ constexpr void checkRequestHandler()
         static_assert(invalidIndex == -1, "The handler must have only one body");
     }
 
+    constexpr int bodyStreamIndex = nhope::findArgument<FnProps, IsBodyStreamType>();
+    if constexpr (bodyStreamIndex != -1) {
+        static_assert(bodyIndex == -1, "The handler can't take both Body and BodyStream");
+        constexpr int invalidIndex = nhope::findArgument<FnProps, IsBodyStreamType, bodyStreamIndex + 1>();
+        static_assert(invalidIndex == -1, "The handler must have only one BodyStream");
+    }
+
+    constexpr int multipartIndex = nhope::findArgument<FnProps, IsMultipartBodyType>();
+    if constexpr (multipartIndex != -1) {
+        static_assert(bodyIndex == -1 && bodyStreamIndex == -1,
+                      "The handler can't take MultipartBody together with Body or BodyStream");
+        constexpr int invalidIndex = nhope::findArgument<FnProps, IsMultipartBodyType, multipartIndex + 1>();
+        static_assert(invalidIndex == -1, "The handler must have only one MultipartBody");
+    }
+
+    constexpr int spooledIndex = nhope::findArgument<FnProps, IsSpooledBodyType>();
+    if constexpr (spooledIndex != -1) {
+        static_assert(bodyIndex == -1 && bodyStreamIndex == -1 && multipartIndex == -1,
+                      "The handler can't take SpooledBody together with another body argument");
+        constexpr int invalidIndex = nhope::findArgument<FnProps, IsSpooledBodyType, spooledIndex + 1>();
+        static_assert(invalidIndex == -1, "The handler must have only one SpooledBody");
+    }
+
     if constexpr (isFuture<R>) {
         checkRequestHandlerResult<typename R::Type>();
     } else {
@@ -157,10 +227,10 @@ auto constructParams(Params&&... p)
     return std::make_tuple(std::forward<Params>(p)...);
 }
 
-template<BodyTypename BType, typename Type>
+template<HandlerBody BType, typename Type>
 auto initParam(RequestContext& ctx, BType& body)
 {
-    if constexpr (common::isBody<std::decay_t<Type>>) {
+    if constexpr (common::isBody<std::decay_t<Type>> || IsSpooledBodyType<Type>::value) {
         return BType(std::move(body));   // call move constructor
     } else if constexpr (std::is_same_v<Type, RequestContext&>) {
         return std::ref(ctx);
@@ -171,7 +241,7 @@ auto initParam(RequestContext& ctx, BType& body)
     }
 }
 
-template<typename Handler, BodyTypename BodyT, std::size_t... IArg>
+template<typename Handler, HandlerBody BodyT, std::size_t... IArg>
 auto callUserHandler(RequestContext& ctx, BodyT&& body, Handler&& handler, std::index_sequence<IArg...> /*unused*/)
 {
     using namespace nhope;
@@ -185,7 +255,7 @@ auto callUserHandler(RequestContext& ctx, BodyT&& body, Handler&& handler, std::
     }
 }
 
-template<typename Handler, BodyTypename BodyT>
+template<typename Handler, HandlerBody BodyT>
 nhope::Future<void> callHandler(Handler&& handler, RequestContext& ctx, BodyT&& body)
 {
     using FnProps = nhope::FunctionProps<decltype(std::function(std::declval<Handler>()))>;
@@ -203,11 +273,11 @@ nhope::Future<void> callHandler(Handler&& handler, RequestContext& ctx, BodyT&&
                 return result;
             } else {
                 return result.then(ctx.aoCtx, [&ctx](FR v) mutable {
-                    addContent(ctx, nlohmann::to_string(nlohmann::json(v)));
+                    addResult(ctx, std::move(v));
                 });
             }
         } else {
-            addContent(ctx, nlohmann::to_string(nlohmann::json(result)));
+            addResult(ctx, std::move(result));
         }
     }
     return nhope::makeReadyFuture();
@@ -216,13 +286,21 @@ nhope::Future<void> callHandler(Handler&& handler, RequestContext& ctx, BodyT&&
 template<typename Handler, BodyTypename BodyT>
 nhope::Future<void> fetchBodyAndCallHandler(Handler handler, RequestContext& ctx)
 {
-    return nhope::readAll(*ctx.request.body)
-      .then(ctx.aoCtx, [&ctx, handler = std::move(handler)](const auto& rawBody) mutable {
-          BodyT body = common::parseBody<typename BodyT::Type>(ctx.request.headers, rawBody);
+    return common::parseBody<typename BodyT::Type, BodyT::type()>(ctx.request.headers, *ctx.request.body)
+      .then(ctx.aoCtx, [&ctx, handler = std::move(handler)](auto parsedBody) mutable {
+          BodyT body = std::move(parsedBody);
           return callHandler(std::move(handler), ctx, std::move(body));
       });
 }
 
+template<typename Handler>
+nhope::Future<void> spoolBodyAndCallHandler(Handler handler, RequestContext& ctx)
+{
+    return SpooledBody::receive(ctx).then(ctx.aoCtx, [&ctx, handler = std::move(handler)](SpooledBody body) mutable {
+        return callHandler(std::move(handler), ctx, std::move(body));
+    });
+}
+
 template<typename Handler>
 LowLevelHandler makeLowLevelHandler(Handler&& handler, int defaultStatus)
 {
@@ -235,10 +313,12 @@ LowLevelHandler makeLowLevelHandler(Handler&& handler, int defaultStatus)
         constexpr bool paramHasBody = bodyIndex != -1;
         if constexpr (paramHasBody) {
             using BType = std::decay_t<typename FnProps::template ArgumentType<bodyIndex>>;
-            if (common::extractBodyType(ctx.request.headers) != BType::type()) {
-                throw HttpError(HttpStatus::BadRequest, "request body has incompatible content type");
+            if (!common::isCompatibleBodyType(common::extractBodyType(ctx.request.headers), BType::type())) {
+                throw HttpError(HttpStatus::UnsupportedMediaType, "request body has incompatible content type");
             }
             return fetchBodyAndCallHandler<Handler, BType>(handler, ctx);
+        } else if constexpr (nhope::findArgument<FnProps, IsSpooledBodyType>() != -1) {
+            return spoolBodyAndCallHandler<Handler>(handler, ctx);
         } else {
             return callHandler(handler, ctx, common::NoneBody{});
         }
@@ -0,0 +1,107 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <limits>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include <gsl/span>
+
+namespace royalbed::server::detail {
+
+// HPACK header compression for HTTP/2 (RFC 7541)
+
+struct HpackHeader final
+{
+    std::string name;
+    std::string value;
+};
+
+using HpackHeaderRef = std::pair<std::string_view, std::string_view>;
+
+class HpackError final : public std::runtime_error
+{
+public:
+    using std::runtime_error::runtime_error;
+};
+
+constexpr std::size_t hpackDefaultTableSize = 4096;
+
+// The static table followed by the dynamic one, indices start at 1 (RFC 7541, 2.3.3)
+class HpackTable final
+{
+public:
+    explicit HpackTable(std::size_t maxSize = hpackDefaultTableSize);
+
+    [[nodiscard]] std::size_t maxSize() const noexcept;
+    [[nodiscard]] std::size_t size() const noexcept;
+    void setMaxSize(std::size_t maxSize);
+
+    void add(std::string name, std::string value);
+
+    // Returns nullptr if there is no entry with this index
+    [[nodiscard]] const HpackHeader* get(std::size_t index) const;
+
+    struct Match
+    {
+        std::size_t index = 0;   // 0 - not found
+        bool valueMatches = false;
+    };
+    [[nodiscard]] Match find(std::string_view name, std::string_view value) const;
+
+private:
+    void evict(std::size_t needSize);
+
+    std::deque<HpackHeader> m_entries;   // the newest first
+    std::size_t m_size = 0;
+    std::size_t m_maxSize;
+};
+
+class HpackDecoder final
+{
+public:
+    // maxTableSize - the SETTINGS_HEADER_TABLE_SIZE sent to the peer,
+    // maxHeaderListSize - the SETTINGS_MAX_HEADER_LIST_SIZE
+    explicit HpackDecoder(std::size_t maxTableSize = hpackDefaultTableSize,
+                          std::size_t maxHeaderListSize = std::numeric_limits<std::size_t>::max());
+
+    // Returns std::nullopt if the header list is larger than maxHeaderListSize (RFC 9113, 6.5.2).
+    // The fields past the limit are not copied, but the block is processed to the end to keep the dynamic table.
+    // Throws HpackError, after that the decoder state is broken and the connection must be closed
+    std::optional<std::vector<HpackHeader>> decode(gsl::span<const std::uint8_t> block);
+
+private:
+    HpackTable m_table;
+    std::size_t m_maxTableSize;
+    std::size_t m_maxHeaderListSize;
+};
+
+class HpackEncoder final
+{
+public:
+    // Called when the peer sends SETTINGS_HEADER_TABLE_SIZE
+    void setMaxTableSize(std::size_t size);
+
+    void encode(std::string& out, const std::vector<HpackHeaderRef>& headers);
+
+private:
+    void encodeHeader(std::string& out, std::string_view name, std::string_view value);
+
+    HpackTable m_table;
+    std::optional<std::size_t> m_pendingSizeUpdate;
+};
+
+void hpackEncodeInteger(std::string& out, std::uint64_t value, int prefixBits, std::uint8_t flags = 0);
+void hpackEncodeString(std::string& out, std::string_view str);
+
+void huffmanEncode(std::string& out, std::string_view str);
+std::string huffmanDecode(gsl::span<const std::uint8_t> data);
+std::size_t huffmanEncodedSize(std::string_view str) noexcept;
+
+}   // namespace royalbed::server::detail
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <string>
+
+#include <gsl/span>
+
+#include "spdlog/logger.h"
+
+#include "nhope/async/ao-context.h"
+#include "nhope/async/future.h"
+#include "nhope/io/io-device.h"
+
+#include "royalbed/server/detail/connection.h"
+#include "royalbed/server/detail/timer-wheel.h"
+#include "royalbed/server/http2.h"
+#include "royalbed/server/request-limits.h"
+#include "royalbed/server/request.h"
+#include "royalbed/server/timeouts.h"
+
+namespace royalbed::server::detail {
+
+struct Http2ConnectionParams
+{
+    std::uint32_t num;
+    ConnectionCtx& ctx;
+    std::shared_ptr<spdlog::logger> log;
+    Http2Params http2;
+
+    nhope::Reader& in;
+    nhope::Writter& out;
+
+    // After the h2c upgrade: the request that becomes stream 1 and the HTTP2-Settings of the client
+    std::optional<Request> upgradeRequest;
+    std::string upgradeSettings;
+
+    // Only the body size is checked here, the header block is limited by the HTTP/2 settings
+    RequestLimits limits{};
+
+    // nullptr - the connection is not limited in time.
+    // idle - no open streams or, while streams are open, silence of the client before a PING;
+    // header - the SETTINGS exchange, an incomplete header block and the PING answer
+    TimerWheelPtr timers{};
+    Timeouts timeouts{};
+
+    // The rest of the keep-alive time and the number of streams, then the connection is closed with GOAWAY
+    KeepAliveParams keepAlive{};
+};
+
+// Serves the connection over HTTP/2, every stream is processed as a separate session.
+// The future is resolved when the connection must be closed.
+nhope::Future<void> serveHttp2(nhope::AOContext& aoCtx, Http2ConnectionParams&& params);
+
+// Checks whether the data received first on a connection starts the HTTP/2 connection preface
+bool startsWithHttp2Preface(gsl::span<const std::uint8_t> data) noexcept;
+
+// Returns the decoded HTTP2-Settings if the request asks for the h2c upgrade and it can be done (RFC 7540, 3.2)
+std::optional<std::string> h2cUpgradeSettings(const Request& request);
+
+}   // namespace royalbed::server::detail
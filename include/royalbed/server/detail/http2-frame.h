@@ -0,0 +1,114 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include <gsl/span>
+
+namespace royalbed::server::detail {
+
+// HTTP/2 framing (RFC 9113, 4 and 6)
+
+enum class Http2FrameType : std::uint8_t
+{
+    Data = 0x0,
+    Headers = 0x1,
+    Priority = 0x2,
+    RstStream = 0x3,
+    Settings = 0x4,
+    PushPromise = 0x5,
+    Ping = 0x6,
+    GoAway = 0x7,
+    WindowUpdate = 0x8,
+    Continuation = 0x9,
+};
+
+namespace http2Flags {
+constexpr std::uint8_t endStream = 0x1;
+constexpr std::uint8_t ack = 0x1;
+constexpr std::uint8_t endHeaders = 0x4;
+constexpr std::uint8_t padded = 0x8;
+constexpr std::uint8_t priority = 0x20;
+}   // namespace http2Flags
+
+enum class Http2ErrorCode : std::uint32_t
+{
+    NoError = 0x0,
+    ProtocolError = 0x1,
+    InternalError = 0x2,
+    FlowControlError = 0x3,
+    SettingsTimeout = 0x4,
+    StreamClosed = 0x5,
+    FrameSizeError = 0x6,
+    RefusedStream = 0x7,
+    Cancel = 0x8,
+    CompressionError = 0x9,
+    ConnectError = 0xa,
+    EnhanceYourCalm = 0xb,
+    InadequateSecurity = 0xc,
+    Http11Required = 0xd,
+};
+
+enum class Http2Setting : std::uint16_t
+{
+    HeaderTableSize = 0x1,
+    EnablePush = 0x2,
+    MaxConcurrentStreams = 0x3,
+    InitialWindowSize = 0x4,
+    MaxFrameSize = 0x5,
+    MaxHeaderListSize = 0x6,
+};
+
+using Http2Settings = std::vector<std::pair<Http2Setting, std::uint32_t>>;
+
+// streamId == 0 - a connection error, otherwise only the stream is reset
+class Http2Error final : public std::runtime_error
+{
+public:
+    Http2Error(Http2ErrorCode code, const std::string& message, std::uint32_t streamId = 0);
+
+    [[nodiscard]] Http2ErrorCode code() const noexcept;
+    [[nodiscard]] std::uint32_t streamId() const noexcept;
+
+private:
+    Http2ErrorCode m_code;
+    std::uint32_t m_streamId;
+};
+
+struct Http2FrameHeader final
+{
+    std::uint32_t length = 0;
+    Http2FrameType type = Http2FrameType::Data;
+    std::uint8_t flags = 0;
+    std::uint32_t streamId = 0;
+};
+
+constexpr std::string_view http2Preface = "PRI * HTTP/2.0\r\n\r\nSM\r\n\r\n";
+constexpr std::size_t http2FrameHeaderSize = 9;
+constexpr std::uint32_t http2DefaultWindowSize = 65535;
+constexpr std::uint32_t http2MaxWindowSize = 0x7fffffff;
+constexpr std::uint32_t http2MinMaxFrameSize = 16384;
+constexpr std::uint32_t http2MaxMaxFrameSize = 16777215;
+
+// data must contain at least http2FrameHeaderSize bytes
+Http2FrameHeader parseHttp2FrameHeader(gsl::span<const std::uint8_t> data);
+void appendHttp2FrameHeader(std::string& out, const Http2FrameHeader& header);
+
+// Throws Http2Error if the payload is malformed or a value is out of range
+Http2Settings parseHttp2Settings(gsl::span<const std::uint8_t> payload);
+
+std::string encodeHttp2Settings(const Http2Settings& settings);
+std::string encodeHttp2SettingsAck();
+std::string encodeHttp2WindowUpdate(std::uint32_t streamId, std::uint32_t increment);
+std::string encodeHttp2RstStream(std::uint32_t streamId, Http2ErrorCode code);
+std::string encodeHttp2GoAway(std::uint32_t lastStreamId, Http2ErrorCode code);
+std::string encodeHttp2Ping(gsl::span<const std::uint8_t> payload, bool ack);
+
+std::uint32_t readHttp2Uint32(gsl::span<const std::uint8_t> data);
+
+}   // namespace royalbed::server::detail
@@ -0,0 +1,12 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+
+namespace royalbed::server::detail {
+
+// The path without "." and ".." segments, repeated slashes and the leading and trailing slashes,
+// the form in which the router and the response cache compare paths
+std::string normalizePath(std::string_view path);
+
+}   // namespace royalbed::server::detail
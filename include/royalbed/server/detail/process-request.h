@@ -0,0 +1,22 @@
+#pragma once
+
+#include <exception>
+#include <string>
+
+#include "nhope/async/future.h"
+
+#include "royalbed/server/request-context.h"
+
+namespace royalbed::server::detail {
+
+// Routes ctx.request, then calls the middlewares and the handler.
+// The same processing is used by HTTP/1.1 sessions and HTTP/2 streams.
+nhope::Future<void> processRequest(RequestContext& ctx);
+
+// Fills ctx.response with the description of an error thrown while receiving or processing the request
+void makeResponseFromError(RequestContext& ctx, std::exception_ptr ex);
+
+// The value of the Date header
+std::string gmtDateTime();
+
+}   // namespace royalbed::server::detail
@@ -2,12 +2,15 @@
 
 #include "nhope/async/ao-context.h"
 #include "nhope/async/future.h"
-#include "nhope/io/pushback-reader.h"
 
+#include "royalbed/common/detail/connection-buffer.h"
+#include "royalbed/server/request-limits.h"
 #include "royalbed/server/request.h"
 
 namespace royalbed::server::detail {
 
-nhope::Future<Request> receiveRequest(nhope::AOContext& aoCtx, nhope::PushbackReader& device);
+// Fails with HttpError 414 or 431 as soon as the request line or the headers exceed the limits
+nhope::Future<Request> receiveRequest(nhope::AOContext& aoCtx, common::detail::ConnectionBuffer& device,
+                                      const RequestLimits& limits = {});
 
 }   // namespace royalbed::server::detail
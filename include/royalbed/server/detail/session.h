@@ -9,22 +9,44 @@
 #include "nhope/async/ao-context-close-handler.h"
 #include "nhope/async/ao-context.h"
 #include "nhope/io/io-device.h"
-#include "nhope/io/pushback-reader.h"
 
+#include "royalbed/common/detail/connection-buffer.h"
 #include "royalbed/server/request-context.h"
+#include "royalbed/server/request-limits.h"
+#include "royalbed/server/request.h"
 #include "royalbed/server/router.h"
 
 namespace royalbed::server::detail {
 
+// The stages of a session, each of them has its own deadline
+enum class SessionStage
+{
+    WaitRequest,
+    ReceiveHeaders,
+    ProcessRequest,
+    SendResponse,
+};
+
 class SessionCtx
 {
 public:
     [[nodiscard]] virtual const Router& router() const noexcept = 0;
 
     virtual void sessionReceivedRequest(std::uint32_t sessionNum) noexcept = 0;
+    virtual void sessionStage(std::uint32_t sessionNum, SessionStage stage) noexcept = 0;
+
+    // The handler started (waiting == true) or finished waiting for the next portion of the request body
+    virtual void sessionBodyWait(std::uint32_t sessionNum, bool waiting) noexcept = 0;
     virtual void sessionFinished(std::uint32_t sessionNum, bool keepALive) noexcept = 0;
 
+    // The session has sent 101 Switching Protocols, the connection is passed to the upgrade handler
+    virtual void sessionUpgraded(std::uint32_t sessionNum, UpgradeHandler upgrade) noexcept = 0;
+
     virtual bool sessionNeedClose() noexcept = 0;
+
+    // Returns the handler that continues the connection over HTTP/2 if the request asks for the h2c upgrade
+    // and it can be done, otherwise nullptr. On success the request is moved out to become stream 1.
+    virtual UpgradeHandler sessionH2cUpgrade(Request& request) = 0;
 };
 
 struct SessionParams
@@ -32,9 +54,10 @@ struct SessionParams
     std::uint32_t num;
     SessionCtx& ctx;
 
-    nhope::PushbackReader& in;
+    common::detail::ConnectionBuffer& in;
     nhope::Writter& out;
     std::shared_ptr<spdlog::logger> log;
+    RequestLimits limits{};
 };
 
 void startSession(nhope::AOContext& aoCtx, SessionParams&& params);
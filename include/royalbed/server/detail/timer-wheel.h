@@ -0,0 +1,96 @@
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+#include "nhope/async/ao-context.h"
+
+namespace royalbed::server::detail {
+
+// A hierarchical timer wheel shared by all connections of a server. Scheduling and cancelling are O(1),
+// a tick only touches the entries of one slot, and the wheel ticks only while it has timers.
+// The callbacks are called on the wheel context, outside of the wheel lock.
+class TimerWheel final
+{
+public:
+    using TimerId = std::uint64_t;
+    using Callback = std::function<void()>;
+
+    TimerWheel(nhope::AOContext& parent, std::chrono::milliseconds tick);
+    ~TimerWheel();
+
+    TimerWheel(const TimerWheel&) = delete;
+    TimerWheel& operator=(const TimerWheel&) = delete;
+
+    // The delay is rounded up to whole ticks
+    TimerId schedule(std::chrono::milliseconds delay, Callback callback);
+    void cancel(TimerId id);
+
+    [[nodiscard]] std::size_t size() const;
+
+    // Moves the wheel forward by the given number of ticks and calls the expired callbacks
+    void advance(std::uint64_t ticks);
+
+private:
+    static constexpr unsigned slotBits = 6;
+    static constexpr unsigned slotCount = 1U << slotBits;
+    static constexpr unsigned levelCount = 4;
+
+    struct Timer
+    {
+        std::uint64_t expire;
+        Callback callback;
+    };
+
+    void place(TimerId id, std::uint64_t expire);
+    void cascade(unsigned level, std::vector<Callback>& expired);
+    void startTicking();
+    void onTimer();
+
+    const std::chrono::milliseconds m_tick;
+
+    mutable std::mutex m_mutex;
+    std::uint64_t m_now = 0;
+    TimerId m_nextId = 1;
+    std::unordered_map<TimerId, Timer> m_timers;
+    // Cancelled timers are removed from m_timers only, their ids are skipped when the slot is reached
+    std::array<std::array<std::vector<TimerId>, slotCount>, levelCount> m_slots;
+    std::vector<TimerId> m_overflow;
+
+    bool m_ticking = false;
+    std::chrono::steady_clock::time_point m_epoch;
+
+    nhope::AOContext m_aoCtx;
+};
+
+using TimerWheelPtr = std::shared_ptr<TimerWheel>;
+
+// A single timer of a connection, rearming replaces the previous timer.
+// The callback is called on the owner context and never after the deadline is rearmed or cancelled.
+class Deadline final
+{
+public:
+    Deadline(TimerWheelPtr wheel, nhope::AOContext& owner);
+    ~Deadline();
+
+    Deadline(const Deadline&) = delete;
+    Deadline& operator=(const Deadline&) = delete;
+
+    // A zero timeout only cancels the deadline, without a wheel the deadline never expires
+    void arm(std::chrono::milliseconds timeout, std::function<void()> callback);
+    void cancel();
+
+private:
+    TimerWheelPtr m_wheel;
+    nhope::AOContextRef m_owner;
+    TimerWheel::TimerId m_id = 0;
+    std::uint64_t m_generation = 0;
+};
+
+}   // namespace royalbed::server::detail
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <chrono>
+#include <memory>
+#include <string>
+
+#include "nhope/async/ao-context.h"
+#include "nhope/async/future.h"
+#include "nhope/io/io-device.h"
+
+#include "royalbed/server/tls.h"
+
+namespace royalbed::server::detail {
+
+// The OpenSSL context shared by all connections of a server: the certificate, the session cache
+// and the session ticket keys
+class TlsContext
+{
+public:
+    virtual ~TlsContext() = default;
+
+    [[nodiscard]] virtual std::chrono::milliseconds handshakeTimeout() const noexcept = 0;
+};
+
+using TlsContextPtr = std::shared_ptr<TlsContext>;
+
+// Throws std::runtime_error if the certificate or the key cannot be loaded
+// or royalbed is built without TLS support
+TlsContextPtr makeTlsContext(const TlsParams& params, bool http2);
+
+// The server side of a TLS connection over a socket, the records are encrypted in user space
+class TlsStream : public nhope::IODevice
+{
+public:
+    // Must be finished before the stream is read or written
+    virtual nhope::Future<void> handshake() = 0;
+
+    // The protocol selected with ALPN, empty if the client did not offer one
+    [[nodiscard]] virtual std::string alpnProtocol() const = 0;
+};
+
+using TlsStreamPtr = std::unique_ptr<TlsStream>;
+
+// sock must outlive the stream
+TlsStreamPtr makeTlsStream(nhope::AOContext& aoCtx, const TlsContextPtr& ctx, nhope::IODevice& sock);
+
+}   // namespace royalbed::server::detail
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <string_view>
+
+#include <gsl/span>
+
+#include "royalbed/server/websocket.h"
+
+namespace royalbed::server::detail {
+
+// The header of a WebSocket frame (RFC 6455, 5.2)
+struct WsFrameHeader final
+{
+    bool fin = true;
+    std::uint8_t rsv = 0;
+    WsOpcode opcode = WsOpcode::Text;
+    bool masked = false;
+    std::array<std::uint8_t, 4> mask{};
+    std::uint64_t payloadSize = 0;
+
+    // The size of the encoded header itself
+    std::size_t headerSize = 0;
+};
+
+constexpr std::size_t wsMaxHeaderSize = 14;
+constexpr std::size_t wsMaxControlPayloadSize = 125;
+
+// Returns nullopt if data does not contain the whole header yet
+std::optional<WsFrameHeader> parseWsFrameHeader(gsl::span<const std::uint8_t> data);
+
+// Server frames are never masked
+std::string encodeWsFrame(WsOpcode opcode, std::string_view payload, bool fin = true);
+std::string encodeWsCloseFrame(WsCloseCode code, std::string_view reason);
+
+// XORs data with the mask, offset is the position of data[0] in the frame payload.
+// The data is processed by 64-bit words, which compilers turn into vector instructions.
+void unmaskWsPayload(gsl::span<std::uint8_t> data, const std::array<std::uint8_t, 4>& mask, std::size_t offset = 0);
+
+bool isValidUtf8(std::string_view str) noexcept;
+
+}   // namespace royalbed::server::detail
@@ -0,0 +1,170 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+
+#include "nhope/async/ao-context.h"
+#include "nhope/async/future.h"
+#include "nhope/io/io-device.h"
+
+#include "royalbed/server/request-context.h"
+
+namespace royalbed::server {
+
+/**
+ * Событие потока text/event-stream (Server-Sent Events).
+ */
+struct Event final
+{
+    // Идентификатор события, клиент вернёт его в заголовке Last-Event-ID при переподключении.
+    // Пустой идентификатор не отправляется.
+    std::string id;
+
+    // Тип события, если не задан, то клиент считает его "message"
+    std::string event;
+
+    // Данные события, могут быть многострочными
+    std::string data;
+
+    // Задержка переподключения для клиента
+    std::optional<std::chrono::milliseconds> retry;
+};
+
+/**
+ * Сериализованное событие. Одно и то же событие можно отправить многим подписчикам без копирования.
+ */
+using EventFrame = std::shared_ptr<const std::string>;
+
+EventFrame makeEventFrame(const Event& event);
+
+/**
+ * Асинхронный источник событий. Пустое значение означает конец потока.
+ * Следующее событие запрашивается только после того, как предыдущее было отправлено клиенту.
+ */
+using EventSource = std::function<nhope::Future<std::optional<Event>>()>;
+
+struct EventStreamParams final
+{
+    // Если за это время клиенту ничего не было отправлено, то отправляется комментарий,
+    // чтобы промежуточные узлы не закрыли соединение.
+    std::chrono::milliseconds heartbeatInterval = defaultHeartbeatInterval;
+
+    // Максимальный объём событий, ожидающих отправки. Если клиент не успевает их забирать,
+    // то поток закрывается, и клиент переподключается с Last-Event-ID.
+    std::size_t maxQueuedBytes = defaultMaxQueuedBytes;
+
+    static constexpr auto defaultHeartbeatInterval = std::chrono::milliseconds(15000);
+    static constexpr std::size_t defaultMaxQueuedBytes = 256 * 1024;
+};
+
+namespace detail {
+class EventQueue;
+}
+
+/**
+ * Позволяет отправлять события в поток из любого потока выполнения.
+ */
+class EventSink final
+{
+public:
+    explicit EventSink(std::shared_ptr<detail::EventQueue> queue);
+
+    /**
+     * Ставит событие в очередь на отправку.
+     * Возвращает false, если поток уже закрыт (клиент отключился или не успевал забирать события).
+     */
+    bool send(const Event& event) const;
+    bool send(EventFrame frame) const;
+
+    /**
+     * Завершает поток после отправки событий из очереди.
+     */
+    void close() const;
+
+    [[nodiscard]] bool isOpen() const;
+
+private:
+    std::shared_ptr<detail::EventQueue> m_queue;
+};
+
+/**
+ * Результат обработчика, который держит соединение открытым и отправляет клиенту события
+ * в формате text/event-stream. События поступают через EventSink или из EventSource.
+ *
+ * Пример:
+ *   router.sse("/events", [&broadcaster](RequestContext& ctx) {
+ *       EventStream stream(ctx);
+ *       broadcaster.subscribe(stream.sink(), stream.lastEventId());
+ *       return stream;
+ *   });
+ */
+class EventStream final
+{
+public:
+    explicit EventStream(RequestContext& ctx, EventStreamParams params = {});
+
+    [[nodiscard]] EventSink sink() const;
+
+    /**
+     * Значение заголовка Last-Event-ID: идентификатор последнего события, полученного клиентом до переподключения.
+     */
+    [[nodiscard]] const std::optional<std::string>& lastEventId() const noexcept;
+
+    /**
+     * Задаёт источник, из которого события запрашиваются по мере отправки предыдущих.
+     * Поток закрывается, когда источник вернёт пустое значение.
+     */
+    EventStream& setSource(EventSource source);
+
+    [[nodiscard]] nhope::ReaderPtr makeReader(nhope::AOContext& aoCtx) &&;
+
+private:
+    std::shared_ptr<detail::EventQueue> m_queue;
+    std::optional<std::string> m_lastEventId;
+    EventSource m_source;
+    std::chrono::milliseconds m_heartbeatInterval;
+};
+
+/**
+ * Рассылает события всем подписчикам. Каждое событие сериализуется один раз.
+ * Последние historySize событий с идентификаторами сохраняются, чтобы переподключившийся клиент
+ * получил пропущенные события после Last-Event-ID.
+ */
+class EventBroadcaster final
+{
+public:
+    explicit EventBroadcaster(std::size_t historySize = defaultHistorySize);
+
+    void subscribe(EventSink sink, const std::optional<std::string>& lastEventId = std::nullopt);
+
+    /**
+     * Отправляет событие всем подписчикам, закрытые подписки удаляются.
+     */
+    void publish(const Event& event);
+
+    [[nodiscard]] std::size_t subscriberCount() const;
+
+    static constexpr std::size_t defaultHistorySize = 64;
+
+private:
+    struct HistoryItem
+    {
+        std::string id;
+        EventFrame frame;
+    };
+
+    mutable std::mutex m_mutex;
+    std::list<EventSink> m_subscribers;
+    std::deque<HistoryItem> m_history;
+    const std::size_t m_historySize;
+};
+
+}   // namespace royalbed::server
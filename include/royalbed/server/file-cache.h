@@ -0,0 +1,97 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+
+#include <gsl/span>
+
+#include "nhope/utils/noncopyable.h"
+
+#include "royalbed/server/request-context.h"
+#include "royalbed/server/send-content.h"
+
+namespace royalbed::server {
+
+namespace detail {
+class FileCacheImpl;
+}   // namespace detail
+
+// Содержимое файла, готовое к отправке с помощью sendContent(ctx, content)
+struct FileContent final
+{
+    // Содержимое из кеша. Пусто, если файл не кешируется: тогда он читается из fd при отправке
+    gsl::span<const std::uint8_t> data;
+
+    // Открытый файл, если содержимое не в памяти, иначе -1
+    int fd = -1;
+    std::uint64_t size = 0;
+
+    // Content-Type по имени файла, Content-Encoding для файлов *.gz и ETag по размеру и времени изменения.
+    // Удерживает data и fd
+    std::shared_ptr<const ContentInfo> info;
+};
+
+/**
+ * Открывает файл path для отправки, не читая его. Бросает HttpError(NotFound), если файла нет.
+ * Выполняет блокирующие системные вызовы, поэтому вызывается вне AO-потока.
+ */
+FileContent loadFile(const std::filesystem::path& path);
+
+/**
+ * Отвечает содержимым файла: из памяти с помощью sendContent либо чтением файла с помощью sendFile.
+ */
+void sendContent(RequestContext& ctx, const FileContent& content);
+
+struct FileCacheOptions final
+{
+    // Суммарный размер содержимого файлов в кеше
+    std::size_t maxBytes = 64 * 1024 * 1024;
+
+    // Файлы до smallFileSize кешируются при первом запросе
+    std::size_t smallFileSize = 16 * 1024;
+
+    // Файлы до maxFileSize кешируются при повторном запросе, большие файлы не кешируются
+    std::size_t maxFileSize = 1024 * 1024;
+};
+
+struct FileCacheStats final
+{
+    std::uint64_t hits = 0;
+    std::uint64_t misses = 0;
+    std::uint64_t evictions = 0;
+    std::uint64_t invalidations = 0;
+
+    // Размер содержимого и количество файлов в кеше
+    std::size_t bytes = 0;
+    std::size_t files = 0;
+};
+
+/**
+ * LRU-кеш содержимого часто запрашиваемых файлов с диска.
+ * Записи удаляются при изменении файлов (inotify; если он недоступен - проверяется время изменения файла).
+ * Потокобезопасен.
+ */
+class FileCache final : public nhope::Noncopyable
+{
+public:
+    explicit FileCache(FileCacheOptions options = {});
+    ~FileCache();
+
+    /**
+     * Содержимое файла path из кеша, при промахе читается с диска (см. loadFile).
+     * Как и loadFile, вызывается вне AO-потока.
+     */
+    FileContent get(const std::filesystem::path& path);
+
+    void invalidate(const std::filesystem::path& path);
+    void clear();
+
+    [[nodiscard]] FileCacheStats stats() const;
+
+private:
+    std::unique_ptr<detail::FileCacheImpl> m_impl;
+};
+
+}   // namespace royalbed::server
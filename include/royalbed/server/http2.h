@@ -0,0 +1,40 @@
+#pragma once
+
+#include <cstdint>
+
+namespace royalbed::server {
+
+/**
+ * Параметры HTTP/2 без TLS (h2c).
+ * Соединение переходит на HTTP/2, если клиент начинает его с преамбулы HTTP/2 (prior knowledge)
+ * или запрашивает переход заголовком Upgrade: h2c.
+ */
+struct Http2Params final
+{
+    bool enabled = true;
+
+    // Максимальное число одновременно обрабатываемых запросов в одном соединении
+    std::uint32_t maxConcurrentStreams = defaultMaxConcurrentStreams;
+
+    // Объём данных тела запроса, который клиент может отправить, не дожидаясь их чтения обработчиком.
+    // Действует и для каждого запроса, и для соединения в целом. Не может быть меньше 65535.
+    std::uint32_t initialWindowSize = defaultInitialWindowSize;
+
+    // Максимальный размер кадра, который готов принять сервер
+    std::uint32_t maxFrameSize = defaultMaxFrameSize;
+
+    // Максимальный суммарный размер заголовков запроса, при превышении отправляется ответ 431
+    std::uint32_t maxHeaderListSize = defaultMaxHeaderListSize;
+
+    // Максимальное число запросов в секунду, отменённых клиентом или сброшенных из-за его ошибок.
+    // При превышении соединение закрывается (защита от rapid reset)
+    std::uint32_t maxStreamResets = defaultMaxStreamResets;
+
+    static constexpr std::uint32_t defaultMaxConcurrentStreams = 100;
+    static constexpr std::uint32_t defaultInitialWindowSize = 1024 * 1024;
+    static constexpr std::uint32_t defaultMaxFrameSize = 16 * 1024;
+    static constexpr std::uint32_t defaultMaxHeaderListSize = 64 * 1024;
+    static constexpr std::uint32_t defaultMaxStreamResets = 200;
+};
+
+}   // namespace royalbed::server
@@ -0,0 +1,122 @@
+#pragma once
+
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <optional>
+#include <ranges>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "nhope/async/ao-context.h"
+#include "nhope/async/future.h"
+#include "nhope/io/io-device.h"
+
+#include "royalbed/common/json-writer.h"
+
+namespace royalbed::server {
+
+/**
+ * Результат обработчика, который отправляется клиенту как JSON-массив частями
+ * (Transfer-Encoding: chunked). Элементы сериализуются по мере отправки ответа,
+ * поэтому ни коллекция целиком, ни её JSON-представление в памяти не собираются.
+ *
+ * Создаётся функциями streamJsonArray.
+ */
+class JsonArrayStream final
+{
+public:
+    /**
+     * Дописывает в out очередную порцию элементов массива.
+     * Возвращает false, если элементов больше нет.
+     */
+    using Producer = std::function<nhope::Future<bool>(nhope::AOContext& aoCtx, common::JsonWriter& out)>;
+
+    /**
+     * Примерный размер порции JSON, после которого производитель отдаёт её на отправку.
+     */
+    static constexpr std::size_t batchSize = 16 * 1024;
+
+    explicit JsonArrayStream(Producer producer);
+
+    [[nodiscard]] nhope::ReaderPtr makeReader(nhope::AOContext& aoCtx) &&;
+
+private:
+    Producer m_producer;
+};
+
+/**
+ * Отправляет элементы диапазона range как JSON-массив.
+ * Если range - lvalue, то он не копируется и должен существовать до окончания отправки ответа.
+ */
+template<std::ranges::input_range R>
+JsonArrayStream streamJsonArray(R&& range)
+{
+    using View = std::views::all_t<R>;
+
+    struct State
+    {
+        View view;
+        std::optional<std::ranges::iterator_t<View>> it;
+    };
+
+    auto state = std::make_shared<State>(State{std::views::all(std::forward<R>(range)), std::nullopt});
+    return JsonArrayStream([state](nhope::AOContext& /*aoCtx*/, common::JsonWriter& out) {
+        if (!state->it.has_value()) {
+            state->it = std::ranges::begin(state->view);
+        }
+
+        auto& it = *state->it;
+        const auto end = std::ranges::end(state->view);
+        while (it != end && out.buffer().size() < JsonArrayStream::batchSize) {
+            out.value(*it);
+            ++it;
+        }
+        return nhope::makeReadyFuture<bool>(it != end);
+    });
+}
+
+/**
+ * Отправляет как JSON-массив элементы, которые возвращает генератор.
+ * Генератор вызывается синхронно и возвращает std::optional<T>, пустое значение означает конец массива.
+ */
+template<typename Generator>
+    requires std::is_invocable_v<Generator&> && common::detail::isOptional<std::invoke_result_t<Generator&>>
+JsonArrayStream streamJsonArray(Generator generator)
+{
+    return JsonArrayStream(
+      [generator = std::move(generator)](nhope::AOContext& /*aoCtx*/, common::JsonWriter& out) mutable {
+          while (out.buffer().size() < JsonArrayStream::batchSize) {
+              auto item = generator();
+              if (!item.has_value()) {
+                  return nhope::makeReadyFuture<bool>(false);
+              }
+              out.value(*item);
+          }
+          return nhope::makeReadyFuture<bool>(true);
+      });
+}
+
+/**
+ * Отправляет как JSON-массив элементы, которые асинхронно возвращает производитель.
+ * Производитель возвращает nhope::Future<std::vector<T>> с очередной порцией элементов,
+ * пустая порция означает конец массива. Следующая порция запрашивается только после отправки предыдущей.
+ */
+template<typename AsyncProducer, typename T = typename std::invoke_result_t<AsyncProducer&>::Type::value_type>
+    requires std::is_invocable_v<AsyncProducer&> &&
+             std::is_same_v<std::invoke_result_t<AsyncProducer&>, nhope::Future<std::vector<T>>>
+JsonArrayStream streamJsonArray(AsyncProducer producer)
+{
+    return JsonArrayStream(
+      [producer = std::move(producer)](nhope::AOContext& aoCtx, common::JsonWriter& out) mutable {
+          return producer().then(aoCtx, [&out](std::vector<T> items) {
+              for (const auto& item : items) {
+                  out.value(item);
+              }
+              return !items.empty();
+          });
+      });
+}
+
+}   // namespace royalbed::server
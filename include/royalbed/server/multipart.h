@@ -0,0 +1,127 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <optional>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#include "nhope/async/future.h"
+#include "nhope/io/io-device.h"
+
+#include "royalbed/server/headers.h"
+#include "royalbed/server/request-context.h"
+
+namespace royalbed::server {
+
+namespace detail {
+class MultipartParser;
+class MultipartPartReader;
+}   // namespace detail
+
+struct MultipartOptions final
+{
+    // Суммарный размер заголовков одной части, при превышении - ответ 400
+    std::size_t maxPartHeadersSize = 16 * 1024;   // NOLINT(readability-magic-numbers)
+
+    // Число частей, при превышении - ответ 413
+    std::size_t maxParts = 1000;   // NOLINT(readability-magic-numbers)
+
+    // readForm сохраняет части больше порога во временные файлы, меньшие части остаются в памяти
+    std::size_t spoolThreshold = 1024 * 1024;   // NOLINT(readability-magic-numbers)
+
+    // Суммарный размер частей, которые readForm держит в памяти. Части, не поместившиеся в него,
+    // сохраняются во временные файлы независимо от spoolThreshold
+    std::size_t maxFormMemorySize = 8 * 1024 * 1024;   // NOLINT(readability-magic-numbers)
+
+    // Каталог временных файлов, по умолчанию - std::filesystem::temp_directory_path()
+    std::filesystem::path spoolDir;
+};
+
+/**
+ * Часть тела multipart/form-data.
+ * Содержимое части читается из body() порциями, конец части - чтение 0 байт.
+ * После перехода к следующей части (MultipartBody::next) непрочитанный остаток пропускается.
+ */
+class MultipartPart final
+{
+public:
+    MultipartPart(std::shared_ptr<detail::MultipartPartReader> reader, Headers headers);
+
+    [[nodiscard]] const Headers& headers() const noexcept;
+
+    // Параметр name заголовка Content-Disposition
+    [[nodiscard]] std::string name() const;
+
+    // Параметр filename заголовка Content-Disposition, есть только у частей с файлами
+    [[nodiscard]] std::optional<std::string> fileName() const;
+
+    [[nodiscard]] nhope::Reader& body() const noexcept;
+
+private:
+    std::shared_ptr<detail::MultipartPartReader> m_reader;
+    Headers m_headers;
+};
+
+/**
+ * Поле формы, прочитанное MultipartBody::readForm.
+ */
+struct FormField final
+{
+    Headers headers;
+    std::string name;
+    std::optional<std::string> fileName;
+
+    // Содержимое, если часть не превысила MultipartOptions::spoolThreshold и поместилась в maxFormMemorySize
+    std::string value;
+
+    // Иначе - временный файл с содержимым. Файл удаляется вместе с последней копией поля,
+    // обработчик может переместить его на постоянное место.
+    std::shared_ptr<const std::filesystem::path> file;
+};
+
+/**
+ * Аргумент обработчика для тела multipart/form-data (RFC 7578).
+ * Тело разбирается потоково: в памяти находится только буфер чтения и заголовки текущей части,
+ * поэтому потребление памяти не зависит от размера загрузки.
+ *
+ * Пример:
+ *   router.post("/upload", [](MultipartBody body) {
+ *       return body.next().then([](std::optional<MultipartPart> part) { ... });
+ *   });
+ *
+ * Для параметров, отличных от MultipartOptions по умолчанию, обработчик принимает RequestContext
+ * и создаёт MultipartBody сам. Если тело не multipart/form-data, выбрасывается HttpError(415).
+ * MultipartBody копируется свободно, все копии разбирают одно и то же тело.
+ */
+class MultipartBody final
+{
+public:
+    explicit MultipartBody(RequestContext& ctx);
+    MultipartBody(RequestContext& ctx, MultipartOptions options);
+
+    /**
+     * Переходит к следующей части. Возвращает std::nullopt после последней части.
+     * Нельзя вызывать, пока не завершено чтение текущей части.
+     */
+    [[nodiscard]] nhope::Future<std::optional<MultipartPart>> next() const;
+
+    /**
+     * Читает все оставшиеся части, большие части сохраняются во временные файлы.
+     */
+    [[nodiscard]] nhope::Future<std::vector<FormField>> readForm() const;
+
+private:
+    std::shared_ptr<detail::MultipartParser> m_parser;
+};
+
+template<typename T>
+struct IsMultipartBodyType
+{
+    static constexpr bool value = std::is_same_v<std::decay_t<T>, MultipartBody>;
+};
+
+}   // namespace royalbed::server
@@ -8,6 +8,7 @@ class embedded_filesystem;
 
 namespace royalbed::server {
 
+class AssetBundle;
 class Router;
 
 /**
@@ -16,4 +17,15 @@ class Router;
  */
 void redoc(Router& router, const cmrc::embedded_filesystem& fs, std::string_view openApiFilePath);
 
+/**
+ * То же, но документ с описанием API берётся из бандла bundle.
+ * Файлы redoc встроены в библиотеку.
+ */
+void redoc(Router& router, const AssetBundle& bundle, std::string_view openApiFilePath);
+
+/**
+ * То же, но файлы redoc берутся из бандла ui (royalbed-redoc.bundle, собирается вместе с библиотекой).
+ */
+void redoc(Router& router, const AssetBundle& bundle, std::string_view openApiFilePath, const AssetBundle& ui);
+
 }   // namespace royalbed::server
@@ -1,6 +1,9 @@
 #pragma once
 
+#include <cstddef>
 #include <cstdint>
+#include <functional>
+#include <limits>
 #include <memory>
 #include <string>
 #include <utility>
@@ -9,6 +12,8 @@
 #include "spdlog/logger.h"
 
 #include "nhope/async/ao-context.h"
+#include "nhope/async/future.h"
+#include "nhope/io/io-device.h"
 
 #include "royalbed/server/request.h"
 #include "royalbed/server/response.h"
@@ -18,6 +23,20 @@ namespace royalbed::server {
 class Router;
 using RawPathParams = std::vector<std::pair<std::string, std::string>>;
 
+/**
+ * Обработчик соединения после ответа 101 Switching Protocols.
+ * Соединение закрывается, когда возвращённая Future будет выполнена.
+ */
+using UpgradeHandler =
+  std::function<nhope::Future<void>(nhope::AOContext& aoCtx, nhope::Reader& in, nhope::Writter& out)>;
+
+struct RequestContext;
+
+/**
+ * Вызывается после успешного выполнения обработчика маршрута и может изменить ответ.
+ */
+using ResponseFilter = std::function<nhope::Future<void>(RequestContext& ctx)>;
+
 struct RequestContext final
 {
     const std::uint64_t num;
@@ -32,6 +51,21 @@ struct RequestContext final
     Response response;
 
     nhope::AOContext aoCtx;
+
+    // Задаётся вместе с ответом 101, чтобы продолжить работу с соединением по другому протоколу
+    UpgradeHandler upgrade;
+
+    // Допустимый размер тела запроса, см. RequestLimits и limitBodySize
+    std::uint64_t maxBodySize = std::numeric_limits<std::uint64_t>::max();
+
+    // Допустимый размер распакованного тела запроса, см. RequestLimits::maxDecodedBodySize
+    std::uint64_t maxDecodedBodySize = 64 * 1024 * 1024;   // NOLINT(readability-magic-numbers)
+
+    // Размер тела, начиная с которого SpooledBody записывает его во временный файл, см. spoolBodyAbove
+    std::size_t spoolThreshold = 1024 * 1024;   // NOLINT(readability-magic-numbers)
+
+    // Добавляются middleware, вызываются в обратном порядке после обработчика (например, cacheResponses)
+    std::vector<ResponseFilter> responseFilters;
 };
 
 }   // namespace royalbed::server
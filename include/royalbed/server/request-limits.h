@@ -0,0 +1,46 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+
+#include "royalbed/server/middleware.h"
+
+namespace royalbed::server {
+
+/**
+ * Ограничения размеров запроса.
+ * Проверяются при разборе запроса, при превышении ответ отправляется сразу, без чтения остатка запроса,
+ * после чего соединение закрывается.
+ */
+struct RequestLimits final
+{
+    // Длина цели запроса (путь и параметры), при превышении - ответ 414
+    std::size_t maxUriSize = 8 * 1024;   // NOLINT(readability-magic-numbers)
+
+    // Число заголовков, при превышении - ответ 431
+    std::size_t maxHeaderCount = 100;   // NOLINT(readability-magic-numbers)
+
+    // Суммарный размер имён и значений заголовков, при превышении - ответ 431
+    std::size_t maxHeadersSize = 64 * 1024;   // NOLINT(readability-magic-numbers)
+
+    // Размер тела, при превышении - ответ 413. По умолчанию не ограничен, как и RequestContext::maxBodySize.
+    // Ограничение распространяется и на распакованное тело (Content-Encoding).
+    // Для отдельных маршрутов меняется с помощью limitBodySize
+    std::uint64_t maxBodySize = std::numeric_limits<std::uint64_t>::max();
+
+    // Размер распакованного тела (Content-Encoding), при превышении - ответ 413. Ограничен и тогда,
+    // когда maxBodySize не задан, чтобы небольшое сжатое тело не распаковалось в гигабайты.
+    // limitBodySize задаёт оба ограничения
+    std::uint64_t maxDecodedBodySize = 64 * 1024 * 1024;   // NOLINT(readability-magic-numbers)
+};
+
+/**
+ * Middleware, задающий ограничение размера тела запроса (и распакованного тела) для маршрутов роутера,
+ * в который он добавлен.
+ * Например, для роутера загрузки файлов:
+ *   uploadRouter.addMiddleware(limitBodySize(1024 * 1024 * 1024));
+ */
+Middleware limitBodySize(std::uint64_t maxSize);
+
+}   // namespace royalbed::server
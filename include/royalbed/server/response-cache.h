@@ -0,0 +1,91 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "nhope/utils/noncopyable.h"
+
+#include "royalbed/server/middleware.h"
+
+namespace royalbed::server {
+
+namespace detail {
+class ResponseCacheImpl;
+}   // namespace detail
+
+struct ResponseCacheOptions final
+{
+    // Время жизни ответа в кеше
+    std::chrono::milliseconds ttl = std::chrono::seconds(1);
+
+    // Суммарный размер ответов в кеше
+    std::size_t maxBytes = 16 * 1024 * 1024;
+
+    // Ответы с телом большего размера не кешируются
+    std::size_t maxEntrySize = 1024 * 1024;
+
+    // Параметры запроса, от которых зависит ответ. Остальные параметры не входят в ключ
+    std::vector<std::string> queryParams;
+
+    // Заголовки запроса, от которых зависит ответ (например, Accept-Encoding).
+    // Ответ, в заголовке Vary которого есть другие заголовки, не кешируется
+    std::vector<std::string> varyHeaders;
+};
+
+struct ResponseCacheStats final
+{
+    std::uint64_t hits = 0;
+    std::uint64_t misses = 0;
+    std::uint64_t expirations = 0;
+    std::uint64_t evictions = 0;
+    std::uint64_t invalidations = 0;
+
+    // Размер ответов и количество ответов в кеше
+    std::size_t bytes = 0;
+    std::size_t entries = 0;
+};
+
+/**
+ * Кеш ответов на GET и HEAD запросы (см. cacheResponses).
+ * Ключ - нормализованный путь, значения параметров queryParams и заголовков varyHeaders.
+ * При превышении maxBytes вытесняются давно запрошенные ответы. Потокобезопасен.
+ */
+class ResponseCache final : public nhope::Noncopyable
+{
+public:
+    explicit ResponseCache(ResponseCacheOptions options = {});
+    ~ResponseCache();
+
+    // Удаляет ответы для пути path
+    void invalidate(std::string_view path);
+
+    // Удаляет ответы для пути path и вложенных в него путей
+    void invalidateSubtree(std::string_view path);
+
+    void clear();
+
+    [[nodiscard]] ResponseCacheStats stats() const;
+
+private:
+    friend Middleware cacheResponses(std::shared_ptr<ResponseCache> cache);
+
+    std::unique_ptr<detail::ResponseCacheImpl> m_impl;
+};
+
+/**
+ * Middleware, отвечающий на GET и HEAD запросы из cache без вызова обработчика.
+ * При промахе ответ обработчика сохраняется в кеше вместе с телом, если его статус 200,
+ * у него нет Set-Cookie, трейлеров, Cache-Control: no-store, no-cache или private, это не поток событий,
+ * а тело не больше maxEntrySize. HEAD запросы получают заголовки сохранённого ответа на GET.
+ * Запросы с Authorization или Cookie, не входящими в varyHeaders, получают и сохраняют
+ * только ответы с Cache-Control: public.
+ * Обработчики, изменяющие данные, удаляют устаревшие ответы с помощью ResponseCache::invalidate.
+ */
+Middleware cacheResponses(std::shared_ptr<ResponseCache> cache);
+
+}   // namespace royalbed::server
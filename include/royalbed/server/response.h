@@ -6,6 +6,8 @@
 
 namespace royalbed::server {
 
+using common::ChunkedParams;
 using common::Response;
+using common::TrailersProvider;
 
 }   // namespace royalbed::server
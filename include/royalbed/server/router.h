@@ -148,6 +148,44 @@ public:
         return this->del(resource, detail::makeLowLevelHandler(std::forward<Handler>(handler), statusCode));
     }
 
+    /**
+     * Регистрирует GET-обработчик потока событий (Server-Sent Events).
+     * Обработчик должен вернуть EventStream, соединение остаётся открытым, пока поток не будет закрыт.
+     */
+    template<StringLiteral resource, HightLevelHandler Handler>
+    constexpr Router& sse(Handler&& handler)
+    {
+        static_assert(detail::handlerReturns<Handler, EventStream>(), "The SSE handler must return EventStream");
+        return this->get<resource>(std::forward<Handler>(handler));
+    }
+
+    template<HightLevelHandler Handler>
+    Router& sse(std::string_view resource, Handler&& handler)
+    {
+        static_assert(detail::handlerReturns<Handler, EventStream>(), "The SSE handler must return EventStream");
+        return this->get(resource, std::forward<Handler>(handler));
+    }
+
+    /**
+     * Регистрирует GET-обработчик, переводящий соединение на протокол WebSocket.
+     * Обработчик должен вернуть WebSocketUpgrade.
+     */
+    template<StringLiteral resource, HightLevelHandler Handler>
+    constexpr Router& ws(Handler&& handler)
+    {
+        static_assert(detail::handlerReturns<Handler, WebSocketUpgrade>(),
+                      "The WebSocket handler must return WebSocketUpgrade");
+        return this->get<resource>(std::forward<Handler>(handler));
+    }
+
+    template<HightLevelHandler Handler>
+    Router& ws(std::string_view resource, Handler&& handler)
+    {
+        static_assert(detail::handlerReturns<Handler, WebSocketUpgrade>(),
+                      "The WebSocket handler must return WebSocketUpgrade");
+        return this->get(resource, std::forward<Handler>(handler));
+    }
+
     [[nodiscard]] std::vector<std::string> resources() const;
 
 private:
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <string>
+
+#include <gsl/span>
+
+#include "royalbed/server/request-context.h"
+
+namespace royalbed::server {
+
+struct ContentInfo final
+{
+    std::string contentType;
+
+    // Пусто, если содержимое не сжато
+    std::string contentEncoding;
+
+    // Строгий ETag в кавычках, используется для проверки If-Range. Пусто - частичные ответы только без If-Range
+    std::string etag;
+};
+
+/**
+ * Отвечает содержимым content с учётом заголовков Range и If-Range запроса (RFC 9110, 14):
+ * один диапазон - ответ 206 с Content-Range, несколько - 206 multipart/byteranges,
+ * неудовлетворимые диапазоны - 416. Поддержка диапазонов объявляется заголовком Accept-Ranges.
+ *
+ * Содержимое не копируется: оно должно существовать до окончания отправки ответа
+ * (например, встроенные файлы) либо удерживаться owner.
+ */
+void sendContent(RequestContext& ctx, gsl::span<const std::uint8_t> content, const ContentInfo& info,
+                 std::shared_ptr<const void> owner = nullptr);
+
+/**
+ * Отвечает содержимым открытого файла fd размером size так же, как sendContent.
+ * Файл читается (pread) в пуле потоков по мере отправки; если файл усечён, отправка завершается ошибкой.
+ * owner должен удерживать дескриптор до окончания отправки ответа.
+ */
+void sendFile(RequestContext& ctx, int fd, std::uint64_t size, const ContentInfo& info,
+              std::shared_ptr<const void> owner);
+
+/**
+ * Строгий ETag, вычисленный по содержимому.
+ */
+std::string contentETag(gsl::span<const std::uint8_t> content);
+
+}   // namespace royalbed::server
@@ -2,24 +2,68 @@
 
 #include <cstdint>
 #include <memory>
+#include <optional>
 #include <string>
+#include <variant>
+#include <vector>
 
 #include "nhope/io/sock-addr.h"
 #include "spdlog/logger.h"
 #include "nhope/async/ao-context.h"
 
+#include "royalbed/server/http2.h"
+#include "royalbed/server/request-limits.h"
 #include "royalbed/server/router.h"
+#include "royalbed/server/tcp.h"
+#include "royalbed/server/timeouts.h"
+#include "royalbed/server/tls.h"
 
 namespace royalbed::server {
 
+// Адрес TCP, на котором принимаются соединения
+struct TcpListener
+{
+    std::string bindAddress;
+    std::uint16_t port;
+};
+
+// Сокет домена Unix, путь, начинающийся с '@', задаёт абстрактный адрес (Linux)
+struct UnixListener
+{
+    std::string path;
+};
+
+using Listener = std::variant<TcpListener, UnixListener>;
+
 struct ServerParams
 {
+    // Если bindAddress пуст, соединения принимаются только на адресах из listeners
     std::string bindAddress;
     std::uint16_t port;
 
     Router router;
 
     std::shared_ptr<spdlog::logger> log;
+
+    // Параметры HTTP/2 без TLS
+    Http2Params http2{};
+
+    // Если задано, соединения принимаются только по TLS
+    std::optional<TlsParams> tls{};
+
+    // Дополнительные адреса, все они обслуживаются одним маршрутизатором
+    std::vector<Listener> listeners{};
+
+    // Настройки всех TCP адресов сервера и принятых на них соединений
+    SocketOptions socketOptions{};
+
+    // Реализация ввода-вывода TCP адресов
+    IoBackend ioBackend = IoBackend::Asio;
+
+    Timeouts timeouts{};
+
+    // Ограничения размеров запросов, для отдельных маршрутов размер тела меняется с помощью limitBodySize
+    RequestLimits limits{};
 };
 
 class Server;
@@ -30,6 +74,7 @@ class Server
 public:
     virtual ~Server() = default;
 
+    // Адрес первого из TCP адресов
     [[nodiscard]] virtual nhope::SockAddr bindAddress() const = 0;
 
     static ServerPtr start(nhope::AOContext& aoCtx, ServerParams&& params);
@@ -0,0 +1,78 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <type_traits>
+#include <vector>
+
+#include <gsl/span>
+
+#include "nhope/async/ao-context.h"
+#include "nhope/async/future.h"
+#include "nhope/io/io-device.h"
+#include "nhope/utils/noncopyable.h"
+
+#include "royalbed/server/middleware.h"
+#include "royalbed/server/request-context.h"
+
+namespace royalbed::server {
+
+namespace detail {
+class SpooledStorage;
+}   // namespace detail
+
+/**
+ * Аргумент обработчика, получающий тело запроса целиком, для случаев, когда нужен произвольный доступ
+ * к телу (контрольные суммы, разбор форматов с индексом в конце и т.п.).
+ * Тело размером до порога хранится в памяти, большее тело записывается в безымянный временный файл
+ * (O_TMPFILE), который отображается в память только для чтения. Файл исчезает вместе с SpooledBody.
+ *
+ * Порог по умолчанию - RequestContext::spoolThreshold, для маршрутов роутера меняется с помощью spoolBodyAbove.
+ * Размер тела по-прежнему ограничен RequestLimits::maxBodySize и limitBodySize.
+ */
+class SpooledBody final : public nhope::Noncopyable
+{
+public:
+    SpooledBody(SpooledBody&&) noexcept;
+    SpooledBody& operator=(SpooledBody&&) noexcept;
+    ~SpooledBody();
+
+    [[nodiscard]] gsl::span<const std::uint8_t> data() const noexcept;
+    [[nodiscard]] std::size_t size() const noexcept;
+
+    // Тело записано во временный файл
+    [[nodiscard]] bool spooled() const noexcept;
+
+    /**
+     * Читает body до конца. Тело больше threshold записывается во временный файл в каталоге dir.
+     * Запись в файл выполняется в пуле потоков, чтение продолжается в контексте aoCtx.
+     */
+    static nhope::Future<SpooledBody> receive(
+      nhope::AOContext& aoCtx, nhope::Reader& body, std::size_t threshold,
+      const std::filesystem::path& dir = std::filesystem::temp_directory_path());
+
+    /**
+     * Читает тело запроса ctx с порогом ctx.spoolThreshold.
+     */
+    static nhope::Future<SpooledBody> receive(RequestContext& ctx);
+
+private:
+    explicit SpooledBody(std::unique_ptr<detail::SpooledStorage> storage);
+
+    std::unique_ptr<detail::SpooledStorage> m_storage;
+};
+
+/**
+ * Middleware, задающий порог записи SpooledBody во временный файл для маршрутов роутера, в который он добавлен.
+ */
+Middleware spoolBodyAbove(std::size_t threshold);
+
+template<typename T>
+struct IsSpooledBodyType
+{
+    static constexpr bool value = std::is_same_v<std::decay_t<T>, SpooledBody>;
+};
+
+}   // namespace royalbed::server
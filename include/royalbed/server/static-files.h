@@ -1,5 +1,10 @@
 #pragma once
 
+#include <filesystem>
+#include <memory>
+
+#include "royalbed/server/asset-bundle.h"
+#include "royalbed/server/file-cache.h"
 #include "royalbed/server/router.h"
 
 namespace cmrc {
@@ -10,4 +15,18 @@ namespace royalbed::server {
 
 Router staticFiles(const cmrc::embedded_filesystem& fs);
 
+/**
+ * Роутер для ресурсов бандла. Сжатый вариант ресурса отдаётся клиентам, принимающим gzip.
+ * Содержимое не копируется, роутер удерживает отображение бандла.
+ */
+Router staticFiles(const AssetBundle& bundle);
+
+/**
+ * Роутер для файлов каталога root, маршруты создаются для файлов, существующих на момент вызова.
+ * Файл name.gz отдаётся вместо name клиентам, принимающим gzip.
+ * Содержимое файлов берётся из cache, без него файлы читаются при каждом запросе.
+ * Файлы открываются и читаются в пуле потоков.
+ */
+Router staticFiles(const std::filesystem::path& root, std::shared_ptr<FileCache> cache = nullptr);
+
 }   // namespace royalbed::server
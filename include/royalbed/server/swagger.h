@@ -8,6 +8,7 @@ class embedded_filesystem;
 
 namespace royalbed::server {
 
+class AssetBundle;
 class Router;
 
 /**
@@ -16,4 +17,15 @@ class Router;
  */
 void swagger(Router& router, const cmrc::embedded_filesystem& fs, std::string_view openApiFilePath);
 
+/**
+ * То же, но документ с описанием API берётся из бандла bundle.
+ * Файлы swagger встроены в библиотеку.
+ */
+void swagger(Router& router, const AssetBundle& bundle, std::string_view openApiFilePath);
+
+/**
+ * То же, но файлы swagger берутся из бандла ui (royalbed-swagger.bundle, собирается вместе с библиотекой).
+ */
+void swagger(Router& router, const AssetBundle& bundle, std::string_view openApiFilePath, const AssetBundle& ui);
+
 }   // namespace royalbed::server
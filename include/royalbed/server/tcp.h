@@ -0,0 +1,10 @@
+#pragma once
+
+#include "royalbed/common/tcp.h"
+
+namespace royalbed::server {
+
+using common::IoBackend;
+using common::SocketOptions;
+
+}   // namespace royalbed::server
@@ -0,0 +1,32 @@
+#pragma once
+
+#include <chrono>
+
+namespace royalbed::server {
+
+/**
+ * Ограничения времени этапов обработки запроса в HTTP/1 соединении.
+ * По истечении соединение закрывается (при приёме заголовков перед этим отправляется ответ 408).
+ * Нулевое значение отключает ограничение. Точность - 100 мс.
+ * В HTTP/2 соединении idle ограничивает простой без открытых потоков и молчание клиента до проверки PING,
+ * header - обмен SETTINGS, приём блока заголовков и ответ на PING.
+ */
+struct Timeouts final
+{
+    // Ожидание следующего запроса в keep-alive соединении
+    std::chrono::milliseconds idle = std::chrono::seconds(75);
+
+    // Приём стартовой строки и заголовков запроса, отсчитывается от первого байта запроса
+    std::chrono::milliseconds header = std::chrono::seconds(10);
+
+    // Ожидание очередной порции тела запроса, пока обработчик читает тело
+    std::chrono::milliseconds bodyRead = std::chrono::seconds(30);
+
+    // Обработка запроса, включая чтение тела. По умолчанию не ограничена
+    std::chrono::milliseconds handler{};
+
+    // Отправка ответа целиком. По умолчанию не ограничена, так как ответ может быть потоком событий
+    std::chrono::milliseconds write{};
+};
+
+}   // namespace royalbed::server
@@ -0,0 +1,28 @@
+#pragma once
+
+#include <chrono>
+#include <string>
+
+namespace royalbed::server {
+
+/**
+ * Параметры TLS.
+ * Поддержка TLS включается при сборке опцией ROYALBED_TLS_ENABLED (требуется OpenSSL 1.1.1 и новее).
+ * Если клиент поддерживает ALPN и HTTP/2 не отключен, протокол выбирается при установлении соединения.
+ */
+struct TlsParams final
+{
+    // Файл с сертификатом сервера в формате PEM, за которым могут следовать промежуточные сертификаты
+    std::string certificateFile;
+
+    // Файл с закрытым ключом в формате PEM
+    std::string privateKeyFile;
+
+    // Разрешает клиентам возобновлять сессии (session tickets и кэш сессий), избегая полного рукопожатия
+    bool sessionResumption = true;
+
+    // Время, за которое клиент должен завершить рукопожатие, иначе соединение закрывается
+    std::chrono::milliseconds handshakeTimeout = std::chrono::seconds(10);
+};
+
+}   // namespace royalbed::server
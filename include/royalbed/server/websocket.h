@@ -0,0 +1,170 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+
+#include <gsl/span>
+
+#include "royalbed/server/request-context.h"
+
+namespace royalbed::server {
+
+enum class WsOpcode : std::uint8_t
+{
+    Continuation = 0x0,
+    Text = 0x1,
+    Binary = 0x2,
+    Close = 0x8,
+    Ping = 0x9,
+    Pong = 0xA,
+};
+
+/**
+ * Коды закрытия соединения (RFC 6455, 7.4.1).
+ */
+enum class WsCloseCode : std::uint16_t
+{
+    Normal = 1000,
+    GoingAway = 1001,
+    ProtocolError = 1002,
+    UnsupportedData = 1003,
+    NoStatus = 1005,
+    Abnormal = 1006,
+    InvalidPayload = 1007,
+    PolicyViolation = 1008,
+    MessageTooBig = 1009,
+    InternalError = 1011,
+};
+
+struct WsMessage final
+{
+    bool binary = false;
+    std::string data;
+};
+
+/**
+ * Закодированный кадр. Одно и то же сообщение можно отправить многим клиентам без повторного кодирования.
+ */
+using WsFrame = std::shared_ptr<const std::string>;
+
+WsFrame makeWsTextFrame(std::string_view text);
+WsFrame makeWsBinaryFrame(gsl::span<const std::uint8_t> data);
+
+/**
+ * Открытое WebSocket-соединение. Методы можно вызывать из любого потока выполнения.
+ */
+class WebSocket
+{
+public:
+    virtual ~WebSocket() = default;
+
+    virtual void send(std::string_view text) = 0;
+    virtual void sendBinary(gsl::span<const std::uint8_t> data) = 0;
+    virtual void sendFrame(WsFrame frame) = 0;
+
+    /**
+     * Начинает закрытие соединения. Соединение закрывается после отправки сообщений из очереди
+     * и ответа клиента на кадр Close.
+     */
+    virtual void close(WsCloseCode code = WsCloseCode::Normal, std::string_view reason = {}) = 0;
+
+    [[nodiscard]] virtual bool isOpen() const = 0;
+};
+
+using WebSocketPtr = std::shared_ptr<WebSocket>;
+
+struct WebSocketParams final
+{
+    // Максимальный размер сообщения (с учётом всех фрагментов), при превышении соединение закрывается с кодом 1009
+    std::size_t maxMessageSize = defaultMaxMessageSize;
+
+    // Максимальный объём сообщений, ожидающих отправки. Если клиент не успевает их забирать,
+    // то соединение закрывается.
+    std::size_t maxQueuedBytes = defaultMaxQueuedBytes;
+
+    // Период отправки Ping. Если за период от клиента ничего не пришло, то соединение закрывается.
+    // 0 - Ping не отправляются.
+    std::chrono::milliseconds pingInterval = defaultPingInterval;
+
+    static constexpr std::size_t defaultMaxMessageSize = 16 * 1024 * 1024;
+    static constexpr std::size_t defaultMaxQueuedBytes = 4 * 1024 * 1024;
+    static constexpr auto defaultPingInterval = std::chrono::milliseconds(30000);
+};
+
+/**
+ * Результат обработчика, который переводит соединение на протокол WebSocket (ответ 101 Switching Protocols).
+ * Конструктор проверяет заголовки рукопожатия и бросает HttpError, если запрос не является запросом на WebSocket.
+ * На запрос с неподдерживаемой версией протокола отвечается 426 с заголовком Sec-WebSocket-Version: 13.
+ * Обработчики событий вызываются в контексте соединения.
+ *
+ * Расширение permessage-deflate не согласуется: WsBroadcaster кодирует сообщение один раз для всех подписчиков,
+ * а сжатие с контекстом на каждое соединение потребовало бы кодировать его отдельно для каждого.
+ *
+ * Пример:
+ *   router.ws("/echo", [](RequestContext& ctx) {
+ *       WebSocketUpgrade upgrade(ctx);
+ *       upgrade.onMessage([](const WebSocketPtr& ws, WsMessage msg) {
+ *           ws->send(msg.data);
+ *       });
+ *       return upgrade;
+ *   });
+ */
+class WebSocketUpgrade final
+{
+public:
+    using OpenHandler = std::function<void(const WebSocketPtr& ws)>;
+    using MessageHandler = std::function<void(const WebSocketPtr& ws, WsMessage msg)>;
+    using CloseHandler = std::function<void(WsCloseCode code, const std::string& reason)>;
+
+    explicit WebSocketUpgrade(RequestContext& ctx, WebSocketParams params = {});
+
+    WebSocketUpgrade& onOpen(OpenHandler handler);
+    WebSocketUpgrade& onMessage(MessageHandler handler);
+    WebSocketUpgrade& onClose(CloseHandler handler);
+
+    /**
+     * Заполняет ответ 101 и передаёт соединение WebSocket после его отправки.
+     */
+    void accept(RequestContext& ctx) &&;
+
+private:
+    std::string m_acceptKey;
+    bool m_rejected = false;
+    WebSocketParams m_params;
+    OpenHandler m_onOpen;
+    MessageHandler m_onMessage;
+    CloseHandler m_onClose;
+};
+
+/**
+ * Рассылает сообщения всем подписанным соединениям. Каждое сообщение кодируется один раз.
+ * Закрытые соединения удаляются при очередной рассылке.
+ */
+class WsBroadcaster final
+{
+public:
+    void subscribe(const WebSocketPtr& ws);
+
+    void broadcast(std::string_view text);
+    void broadcast(WsFrame frame);
+
+    [[nodiscard]] std::size_t subscriberCount() const;
+
+private:
+    mutable std::mutex m_mutex;
+    std::list<std::weak_ptr<WebSocket>> m_subscribers;
+};
+
+/**
+ * Вычисляет значение заголовка Sec-WebSocket-Accept по значению Sec-WebSocket-Key.
+ */
+std::string wsAcceptKey(std::string_view key);
+
+}   // namespace royalbed::server
@@ -1,20 +1,18 @@
-#include <array>
 #include <cassert>
 #include <cstddef>
 #include <cstdint>
 #include <exception>
 #include <memory>
-#include <span>
 #include <string>
 
 #include "nhope/async/ao-context-error.h"
 #include "nhope/async/ao-context.h"
 #include "nhope/async/future.h"
 #include "nhope/async/safe-callback.h"
-#include "nhope/io/pushback-reader.h"
 
 #include "3rdparty/llhttp/llhttp.h"
 #include "royalbed/common/detail/body-reader.h"
+#include "royalbed/common/detail/connection-buffer.h"
 
 #include "royalbed/client/response.h"
 #include "royalbed/client/http-error.h"
@@ -26,14 +24,13 @@ namespace {
 
 using common::detail::BodyReader;
 using common::detail::BodyReaderPtr;
-
-constexpr std::size_t receiveBufSize = 4096;
+using common::detail::ConnectionBuffer;
 
 // FIXME: Duplicates RequestReceiver
 class ResponseReceiver final : public std::enable_shared_from_this<ResponseReceiver>
 {
 public:
-    ResponseReceiver(nhope::AOContext& aoCtx, nhope::PushbackReader& device)
+    ResponseReceiver(nhope::AOContext& aoCtx, ConnectionBuffer& device)
       : m_aoCtx(aoCtx)
       , m_device(device)
       , m_httpParser(std::make_unique<llhttp_t>())
@@ -51,23 +48,31 @@ public:
 
     nhope::Future<Response> start()
     {
-        this->readNextPortion();
-        return m_promise.future();
+        auto future = m_promise.future();
+
+        // A pipelined message may be buffered already
+        if (m_device.data().empty() || this->processData(m_device.data())) {
+            this->readNextPortion();
+        }
+        return future;
     }
 
 private:
-    bool processData(std::span<std::uint8_t> data)
+    // The parsed bytes are consumed from the device, the head is copied out by the llhttp callbacks
+    bool processData(gsl::span<const std::uint8_t> data)
     {
         assert(!m_headersComplete);   // NOLINT
 
+        // NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast)
+        const auto* begin = reinterpret_cast<const char*>(data.data());
         if (!data.empty()) {
-            // NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast)
-            llhttp_execute(m_httpParser.get(), reinterpret_cast<char*>(data.data()), data.size());
+            llhttp_execute(m_httpParser.get(), begin, data.size());
         } else {
             llhttp_finish(m_httpParser.get());
         }
 
         if (m_httpParser->error == HPE_OK) {
+            m_device.consume(data.size());
             return true;
         }
 
@@ -86,9 +91,7 @@ private:
         m_httpParser->data = nullptr;
         llhttp_resume(m_httpParser.get());
 
-        // NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast)
-        const auto* beginBody = reinterpret_cast<const std::uint8_t*>(llhttp_get_error_pos(m_httpParser.get()));
-        m_device.unread({std::to_address(beginBody), std::to_address(data.end())});
+        m_device.consume(static_cast<std::size_t>(llhttp_get_error_pos(m_httpParser.get()) - begin));
         m_response.body = BodyReader::create(m_aoCtx, m_device, std::move(m_httpParser));
 
         m_promise.setValue(std::move(m_response));
@@ -98,9 +101,10 @@ private:
 
     void readNextPortion()
     {
-        m_device.read(m_receiveBuf, [self = shared_from_this()](std::exception_ptr err, std::size_t n) {
+        m_device.fill([self = shared_from_this()](std::exception_ptr err, std::size_t n) {
             self->m_aoCtx.exec([self, err = std::move(err), n] {
-                if (!self->processData(std::span(self->m_receiveBuf.begin(), n))) {
+                const auto data = n == 0 ? gsl::span<const std::uint8_t>() : self->m_device.data();
+                if (!self->processData(data)) {
                     return;
                 }
 
@@ -181,7 +185,7 @@ private:
     };
 
     nhope::AOContextRef m_aoCtx;
-    nhope::PushbackReader& m_device;
+    ConnectionBuffer& m_device;
 
     nhope::Promise<Response> m_promise;
 
@@ -191,14 +195,13 @@ private:
     std::string m_curHeaderValue;
     bool m_headersComplete = false;
 
-    std::array<std::uint8_t, receiveBufSize> m_receiveBuf{};
 
     Response m_response;
 };
 
 }   // namespace
 
-nhope::Future<Response> receiveResponse(nhope::AOContext& aoCtx, nhope::PushbackReader& device)
+nhope::Future<Response> receiveResponse(nhope::AOContext& aoCtx, ConnectionBuffer& device)
 {
     auto receiver = std::make_shared<ResponseReceiver>(aoCtx, device);
     return receiver->start();
@@ -1,25 +1,145 @@
+#include <algorithm>
 #include <cassert>
 #include <cstddef>
+#include <cstdint>
+#include <cstring>
 #include <exception>
 #include <memory>
 #include <span>
 
 #include "nhope/async/ao-context.h"
 #include "nhope/async/safe-callback.h"
-#include "nhope/io/pushback-reader.h"
+#include "nhope/io/io-device.h"
 
 #include "royalbed/common/http-error.h"
 #include "royalbed/common/http-status.h"
 
 #include "royalbed/common/detail/body-reader.h"
+#include "royalbed/common/detail/chunked-decoder.h"
+#include "royalbed/common/detail/connection-buffer.h"
 
 namespace royalbed::common::detail {
 namespace {
 
+std::exception_ptr unexpectedEndOfBody()
+{
+    return std::make_exception_ptr(HttpError(HttpStatus::BadRequest, "Unexpected end of body"));
+}
+
+// Reads exactly the declared number of bytes, nothing of the next message is taken from the connection.
+// With nothing buffered the body is read straight into the caller buffer.
+class ContentLengthBodyReader final : public BodyReader
+{
+public:
+    ContentLengthBodyReader(nhope::AOContextRef& aoCtx, ConnectionBuffer& device, std::uint64_t length)
+      : m_aoCtxRef(aoCtx)
+      , m_device(device)
+      , m_left(length)
+    {}
+
+    void read(gsl::span<std::uint8_t> buf, nhope::IOHandler handler) override
+    {
+        // The device would answer an empty read with 0, which looks like the end of the connection
+        if (m_left == 0 || buf.empty()) {
+            m_aoCtxRef.exec([handler = std::move(handler)] {
+                handler(nullptr, 0);
+            });
+            return;
+        }
+
+        const auto size = static_cast<std::size_t>(std::min<std::uint64_t>(buf.size(), m_left));
+        m_device.read(buf.first(size), [this, aoCtxRef = m_aoCtxRef, handler = std::move(handler)](auto err,
+                                                                                                   auto n) mutable {
+            aoCtxRef.exec([this, err, n, handler = std::move(handler)] {
+                if (err) {
+                    handler(std::move(err), n);
+                    return;
+                }
+                if (n == 0) {
+                    handler(unexpectedEndOfBody(), 0);
+                    return;
+                }
+
+                m_left -= n;
+                handler(nullptr, n);
+            });
+        });
+    }
+
+private:
+    nhope::AOContextRef m_aoCtxRef;
+    ConnectionBuffer& m_device;
+    std::uint64_t m_left;
+};
+
+// Decodes the buffered bytes into the caller buffer and consumes the framing with them
+class ChunkedBodyReader final : public BodyReader
+{
+public:
+    ChunkedBodyReader(nhope::AOContextRef& aoCtx, ConnectionBuffer& device)
+      : m_aoCtxRef(aoCtx)
+      , m_device(device)
+    {}
+
+    void read(gsl::span<std::uint8_t> buf, nhope::IOHandler handler) override
+    {
+        if (m_decoder.done() || buf.empty()) {
+            m_aoCtxRef.exec([handler = std::move(handler)] {
+                handler(nullptr, 0);
+            });
+            return;
+        }
+
+        if (m_device.data().empty()) {
+            m_device.fill([this, aoCtxRef = m_aoCtxRef, buf, handler = std::move(handler)](auto err, auto n) mutable {
+                aoCtxRef.exec([this, buf, err, n, handler = std::move(handler)]() mutable {
+                    if (err) {
+                        handler(std::move(err), 0);
+                        return;
+                    }
+                    if (n == 0) {
+                        handler(unexpectedEndOfBody(), 0);
+                        return;
+                    }
+                    this->read(buf, std::move(handler));
+                });
+            });
+            return;
+        }
+
+        ChunkedDecoder::Result result{};
+        try {
+            result = m_decoder.decode(m_device.data(), buf);
+        } catch (...) {
+            m_aoCtxRef.exec([err = std::current_exception(), handler = std::move(handler)] {
+                handler(err, 0);
+            });
+            return;
+        }
+        m_device.consume(result.consumed);
+
+        if (result.bodySize == 0 && !m_decoder.done()) {
+            // The buffered bytes held only the framing
+            this->read(buf, std::move(handler));
+            return;
+        }
+
+        m_aoCtxRef.exec([n = result.bodySize, handler = std::move(handler)] {
+            handler(nullptr, n);
+        });
+    }
+
+private:
+    nhope::AOContextRef m_aoCtxRef;
+    ConnectionBuffer& m_device;
+    ChunkedDecoder m_decoder;
+};
+
+// Any other body is framed by llhttp, e.g. a response body that lasts until the connection is closed
 class BodyReaderImpl final : public BodyReader
 {
 public:
-    BodyReaderImpl(nhope::AOContextRef& aoCtx, nhope::PushbackReader& device, std::unique_ptr<llhttp_t> httpParser)
+    BodyReaderImpl(nhope::AOContextRef& aoCtx, ConnectionBuffer& device, std::unique_ptr<llhttp_t> httpParser)
       : m_aoCtxRef(aoCtx)
       , m_device(device)
       , m_httpParser(std::move(httpParser))
@@ -31,48 +151,86 @@ public:
 
     void read(gsl::span<std::uint8_t> buf, nhope::IOHandler handler) override
     {
-        if (m_eof) {
+        if (m_eof || buf.empty()) {
             m_aoCtxRef.exec([handler = std::move(handler)] {
                 handler(nullptr, 0);
             });
             return;
         }
 
-        m_device.read(buf, [this, aoCtxRef = m_aoCtxRef, buf, handler = std::move(handler)](auto err, auto n) mutable {
-            aoCtxRef.exec([this, buf, err, n, handler = std::move(handler)] {
-                if (err) {
-                    handler(std::move(err), n);
-                    return;
-                }
+        if (m_device.data().empty()) {
+            m_device.fill([this, aoCtxRef = m_aoCtxRef, buf, handler = std::move(handler)](auto err, auto n) mutable {
+                aoCtxRef.exec([this, buf, err, n, handler = std::move(handler)]() mutable {
+                    if (err) {
+                        handler(std::move(err), 0);
+                        return;
+                    }
+                    if (n == 0) {
+                        this->finish(std::move(handler));
+                        return;
+                    }
+                    this->read(buf, std::move(handler));
+                });
+            });
+            return;
+        }
 
-                // NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast)
-                llhttp_execute(m_httpParser.get(), reinterpret_cast<const char*>(buf.data()), n);
-                if (n == 0) {
-                    llhttp_finish(m_httpParser.get());
-                }
+        // The body pieces cannot be longer than the input, so they fit into buf
+        const auto data = m_device.data();
+        const auto input = data.first(std::min(data.size(), buf.size()));
+        m_out = buf;
+        m_outSize = 0;
 
-                if (m_httpParser->error != HPE_OK && m_httpParser->error != HPE_PAUSED) {
-                    const auto* reason = llhttp_get_error_reason(m_httpParser.get());
-                    handler(std::make_exception_ptr(HttpError(HttpStatus::BadRequest, reason)), n);
-                    return;
-                }
+        // NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast)
+        const auto* begin = reinterpret_cast<const char*>(input.data());
+        llhttp_execute(m_httpParser.get(), begin, input.size());
 
-                if (n > m_bodyPieceSize) {
-                    const auto remains = buf.subspan(m_bodyPieceSize, n - m_bodyPieceSize);
-                    m_device.unread(remains);
-                }
+        if (m_httpParser->error != HPE_OK && m_httpParser->error != HPE_PAUSED) {
+            this->fail(std::move(handler));
+            return;
+        }
 
-                handler(nullptr, m_bodyPieceSize);
-            });
+        const auto consumed = m_httpParser->error == HPE_PAUSED
+                                ? static_cast<std::size_t>(llhttp_get_error_pos(m_httpParser.get()) - begin)
+                                : input.size();
+        m_device.consume(consumed);
+
+        if (m_outSize == 0 && !m_eof) {
+            this->read(buf, std::move(handler));
+            return;
+        }
+
+        m_aoCtxRef.exec([n = m_outSize, handler = std::move(handler)] {
+            handler(nullptr, n);
         });
     }
 
 private:
-    static int onBodyData(llhttp_t* httpParser, const char* /*at*/, std::size_t size)
+    void finish(nhope::IOHandler handler)
+    {
+        llhttp_finish(m_httpParser.get());
+        if (m_httpParser->error != HPE_OK && m_httpParser->error != HPE_PAUSED) {
+            this->fail(std::move(handler));
+            return;
+        }
+        m_eof = true;
+        handler(nullptr, 0);
+    }
+
+    void fail(nhope::IOHandler handler)
+    {
+        const auto* reason = llhttp_get_error_reason(m_httpParser.get());
+        m_aoCtxRef.exec([err = std::make_exception_ptr(HttpError(HttpStatus::BadRequest, reason)),
+                         handler = std::move(handler)] {
+            handler(err, 0);
+        });
+    }
+
+    static int onBodyData(llhttp_t* httpParser, const char* at, std::size_t size)
     {
         auto* self = static_cast<BodyReaderImpl*>(httpParser->data);
-        // NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast)
-        self->m_bodyPieceSize = size;
+        std::memcpy(self->m_out.data() + self->m_outSize, at, size);
+        self->m_outSize += size;
         return HPE_OK;
     }
 
@@ -89,18 +247,39 @@ private:
     };
 
     nhope::AOContextRef m_aoCtxRef;
-    nhope::PushbackReader& m_device;
+    ConnectionBuffer& m_device;
 
     std::unique_ptr<llhttp_t> m_httpParser;
-    std::size_t m_bodyPieceSize = 0;
+    gsl::span<std::uint8_t> m_out;
+    std::size_t m_outSize = 0;
     bool m_eof = false;
 };
 
 }   // namespace
 
-BodyReaderPtr BodyReader::create(nhope::AOContextRef& aoCtx, nhope::PushbackReader& device,
+BodyReaderPtr BodyReader::create(nhope::AOContextRef& aoCtx, ConnectionBuffer& device,
                                  std::unique_ptr<llhttp_t> httpParser)
 {
+    const auto& parser = *httpParser;
+    const bool responseWithoutBody =
+      parser.type == HTTP_RESPONSE &&
+      (parser.status_code < HttpStatus::Ok || parser.status_code == HttpStatus::NoContent ||
+       parser.status_code == HttpStatus::NotModified);
+
+    if (!responseWithoutBody) {
+        if ((parser.flags & F_CHUNKED) != 0) {
+            return std::make_unique<ChunkedBodyReader>(aoCtx, device);
+        }
+        if ((parser.flags & F_CONTENT_LENGTH) != 0) {
+            return std::make_unique<ContentLengthBodyReader>(aoCtx, device, parser.content_length);
+        }
+    }
+
+    // A request without Content-Length and Transfer-Encoding has no body (RFC 9112, 6.3)
+    if (parser.type == HTTP_REQUEST) {
+        return std::make_unique<ContentLengthBodyReader>(aoCtx, device, 0);
+    }
+
     return std::make_unique<BodyReaderImpl>(aoCtx, device, std::move(httpParser));
 }
 
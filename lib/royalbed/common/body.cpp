@@ -1,9 +1,14 @@
+#include <algorithm>
+#include <array>
+#include <charconv>
 #include <string>
 #include <string_view>
+#include <utility>
 
 #include "nhope/async/future.h"
 #include "nhope/io/io-device.h"
 
+#include "royalbed/common/detail/string-utils.h"
 #include "royalbed/server/request-context.h"
 #include <royalbed/common/body.h>
 #include <royalbed/common/http-error.h>
@@ -13,22 +18,187 @@ namespace royalbed::common {
 namespace {
 
 using namespace std::literals;
+using namespace royalbed::common::detail;
+
 constexpr auto jsonContent{"application/json"sv};
 constexpr auto plainContent{"text/plain"sv};
+constexpr auto xmlContent{"application/xml"sv};
+constexpr auto cborContent{"application/cbor"sv};
+constexpr auto msgPackContent{"application/msgpack"sv};
+constexpr auto msgPackAliases = std::array{msgPackContent, "application/x-msgpack"sv, "application/vnd.msgpack"sv};
 const auto content = "Content-Type"s;
+const auto accept = "Accept"s;
+
+// The formats a handler result can be sent in, in the order of preference
+constexpr auto negotiableTypes = std::array{BodyType::Json, BodyType::Cbor, BodyType::MsgPack};
+
+// Cuts off the parameters of a media type: "application/json; charset=utf-8" -> "application/json"
+std::string_view mediaTypeOf(std::string_view value)
+{
+    return trim(value.substr(0, value.find(';')));
+}
+
+std::pair<std::string_view, std::string_view> splitMediaType(std::string_view mediaType)
+{
+    const auto slash = mediaType.find('/');
+    if (slash == std::string_view::npos) {
+        return {mediaType, {}};
+    }
+    return {mediaType.substr(0, slash), mediaType.substr(slash + 1)};
+}
+
+double qualityOf(std::string_view params)
+{
+    while (!params.empty()) {
+        const auto end = params.find(';');
+        const auto param = trim(params.substr(0, end));
+        params = end == std::string_view::npos ? ""sv : params.substr(end + 1);
+
+        if (param.size() < 2 || toLower(param.substr(0, 2)) != "q=") {
+            continue;
+        }
+
+        const auto value = trim(param.substr(2));
+        double q = 0;
+        const auto [ptr, ec] = std::from_chars(value.data(), value.data() + value.size(), q);
+        if (ec != std::errc{} || ptr != value.data() + value.size() || q < 0 || q > 1) {
+            return 0;
+        }
+        return q;
+    }
+    return 1;
+}
+
+// The quality of mimeType according to the Accept header,
+// it is taken from the most specific media range that matches mimeType (RFC 9110, 12.5.1)
+double acceptQuality(std::string_view acceptValue, std::string_view mimeType)
+{
+    const auto [type, subtype] = splitMediaType(mimeType);
+
+    int bestSpecificity = -1;
+    double quality = 0;
+    while (!acceptValue.empty()) {
+        const auto end = acceptValue.find(',');
+        const auto item = acceptValue.substr(0, end);
+        acceptValue = end == std::string_view::npos ? ""sv : acceptValue.substr(end + 1);
+
+        const auto paramsPos = item.find(';');
+        const auto range = toLower(mediaTypeOf(item));
+        const auto [rangeType, rangeSubtype] = splitMediaType(range);
+
+        int specificity = -1;
+        if (rangeType == "*" && rangeSubtype == "*") {
+            specificity = 0;
+        } else if (rangeType == type && rangeSubtype == "*") {
+            specificity = 1;
+        } else if (rangeType == type && rangeSubtype == subtype) {
+            specificity = 2;
+        }
+
+        if (specificity > bestSpecificity) {
+            bestSpecificity = specificity;
+            quality = paramsPos == std::string_view::npos ? 1 : qualityOf(item.substr(paramsPos + 1));
+        }
+    }
+    return quality;
+}
+
+double acceptQuality(std::string_view acceptValue, BodyType type)
+{
+    if (type != BodyType::MsgPack) {
+        return acceptQuality(acceptValue, mimeType(type));
+    }
+
+    // MessagePack has no registered media type, so every widespread name is accepted
+    double quality = 0;
+    for (const auto alias : msgPackAliases) {
+        quality = std::max(quality, acceptQuality(acceptValue, alias));
+    }
+    return quality;
+}
 
 }   // namespace
 
 BodyType extractBodyType(const Headers& headers)
 {
     const auto& contentType = headers.at(content);
-    if (contentType == jsonContent) {
+    const auto mediaType = toLower(mediaTypeOf(contentType));
+    if (mediaType == jsonContent) {
         return BodyType::Json;
     }
-    if (contentType == plainContent) {
+    if (mediaType == plainContent) {
         return BodyType::Plain;
     }
-    throw HttpError(HttpStatus::BadRequest, fmt::format("{0} \"{1}\" not supported yet", content, contentType));
+    if (mediaType == xmlContent) {
+        return BodyType::Xml;
+    }
+    if (mediaType == cborContent) {
+        return BodyType::Cbor;
+    }
+    if (std::find(msgPackAliases.begin(), msgPackAliases.end(), mediaType) != msgPackAliases.end()) {
+        return BodyType::MsgPack;
+    }
+    throw HttpError(HttpStatus::UnsupportedMediaType,
+                    fmt::format("{0} \"{1}\" not supported yet", content, contentType));
+}
+
+std::string_view mimeType(BodyType type)
+{
+    switch (type) {
+    case BodyType::Json:
+        return jsonContent;
+    case BodyType::Xml:
+        return xmlContent;
+    case BodyType::Plain:
+        return plainContent;
+    case BodyType::Cbor:
+        return cborContent;
+    case BodyType::MsgPack:
+        return msgPackContent;
+    }
+    return jsonContent;
+}
+
+BodyType negotiateBodyType(const Headers& requestHeaders)
+{
+    const auto it = requestHeaders.find(accept);
+    if (it == requestHeaders.end()) {
+        return BodyType::Json;
+    }
+
+    auto bestType = BodyType::Json;
+    double bestQuality = 0;
+    for (const auto type : negotiableTypes) {
+        const auto quality = acceptQuality(it->second, type);
+        if (quality > bestQuality) {
+            bestType = type;
+            bestQuality = quality;
+        }
+    }
+    return bestType;
 }
 
+namespace detail {
+
+BodyType requestBodyType(const Headers& headers)
+{
+    const auto it = headers.find(content);
+    if (it == headers.end()) {
+        return BodyType::Json;
+    }
+
+    // parseBody has always read JSON whatever the Content-Type (e.g. text/plain or a form from "curl -d"),
+    // only the binary representations of the same model are told apart
+    const auto mediaType = toLower(mediaTypeOf(it->second));
+    if (mediaType == cborContent) {
+        return BodyType::Cbor;
+    }
+    if (std::find(msgPackAliases.begin(), msgPackAliases.end(), mediaType) != msgPackAliases.end()) {
+        return BodyType::MsgPack;
+    }
+    return BodyType::Json;
+}
+
+}   // namespace detail
+
 }   // namespace royalbed::common
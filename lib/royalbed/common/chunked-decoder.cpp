@@ -0,0 +1,153 @@
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#include <gsl/span>
+
+#include "royalbed/common/detail/chunked-decoder.h"
+#include "royalbed/common/http-error.h"
+#include "royalbed/common/http-status.h"
+
+namespace royalbed::common::detail {
+
+namespace {
+
+// A chunk size above it cannot be sent anyway and would overflow on the next digit
+constexpr std::uint64_t maxChunkSize = std::uint64_t(1) << 60;
+
+int hexDigit(std::uint8_t ch) noexcept
+{
+    if (ch >= '0' && ch <= '9') {
+        return ch - '0';
+    }
+    if (ch >= 'a' && ch <= 'f') {
+        return ch - 'a' + 10;   // NOLINT(readability-magic-numbers)
+    }
+    if (ch >= 'A' && ch <= 'F') {
+        return ch - 'A' + 10;   // NOLINT(readability-magic-numbers)
+    }
+    return -1;
+}
+
+[[noreturn]] void invalidChunk()
+{
+    throw HttpError(HttpStatus::BadRequest, "Invalid chunked encoding");
+}
+
+void expect(std::uint8_t ch, char expected)
+{
+    if (ch != static_cast<std::uint8_t>(expected)) {
+        invalidChunk();
+    }
+}
+
+}   // namespace
+
+ChunkedDecoder::Result ChunkedDecoder::decode(gsl::span<const std::uint8_t> input, gsl::span<std::uint8_t> output)
+{
+    std::size_t in = 0;
+    std::size_t out = 0;
+
+    while (in < input.size() && m_state != State::Done) {
+        if (m_state == State::Data) {
+            if (out == output.size()) {
+                break;
+            }
+
+            // The input and the output may be the same memory, the data is moved over the consumed framing
+            const auto n = static_cast<std::size_t>(
+              std::min<std::uint64_t>(m_chunkSize, std::min(input.size() - in, output.size() - out)));
+            if (output.data() + out != input.data() + in) {
+                std::memmove(output.data() + out, input.data() + in, n);
+            }
+            in += n;
+            out += n;
+            m_chunkSize -= n;
+            if (m_chunkSize == 0) {
+                m_state = State::DataCr;
+            }
+            continue;
+        }
+
+        const auto ch = input[in++];
+        switch (m_state) {
+        case State::Size:
+            if (const auto digit = hexDigit(ch); digit >= 0) {
+                if (m_chunkSize >= maxChunkSize) {
+                    invalidChunk();
+                }
+                m_chunkSize = m_chunkSize * 16 + static_cast<std::uint64_t>(digit);   // NOLINT
+                m_haveSizeDigits = true;
+            } else if (!m_haveSizeDigits) {
+                invalidChunk();
+            } else if (ch == ';' || ch == ' ' || ch == '\t') {
+                m_state = State::Extension;
+            } else {
+                expect(ch, '\r');
+                m_state = State::SizeLf;
+            }
+            break;
+
+        case State::Extension:
+            if (ch == '\r') {
+                m_state = State::SizeLf;
+            }
+            break;
+
+        case State::SizeLf:
+            expect(ch, '\n');
+            m_haveSizeDigits = false;
+            m_state = m_chunkSize == 0 ? State::TrailerStart : State::Data;
+            break;
+
+        case State::DataCr:
+            expect(ch, '\r');
+            m_state = State::DataLf;
+            break;
+
+        case State::DataLf:
+            expect(ch, '\n');
+            m_state = State::Size;
+            break;
+
+        case State::TrailerStart:
+            m_state = ch == '\r' ? State::LastLf : State::Trailer;
+            break;
+
+        case State::Trailer:
+            if (ch == '\r') {
+                m_state = State::TrailerLf;
+            }
+            break;
+
+        case State::TrailerLf:
+            expect(ch, '\n');
+            m_state = State::TrailerStart;
+            break;
+
+        case State::LastLf:
+            expect(ch, '\n');
+            m_state = State::Done;
+            break;
+
+        case State::Data:
+        case State::Done:
+            break;
+        }
+    }
+
+    return {.bodySize = out, .consumed = in};
+}
+
+ChunkedDecoder::Result ChunkedDecoder::decode(gsl::span<std::uint8_t> portion)
+{
+    return this->decode(portion, portion);
+}
+
+bool ChunkedDecoder::done() const noexcept
+{
+    return m_state == State::Done;
+}
+
+}   // namespace royalbed::common::detail
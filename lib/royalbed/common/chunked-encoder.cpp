@@ -0,0 +1,162 @@
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <exception>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include <gsl/span>
+
+#include "nhope/async/ao-context.h"
+#include "nhope/io/io-device.h"
+
+#include "royalbed/common/detail/chunked-encoder.h"
+#include "royalbed/common/detail/write-headers.h"
+#include "royalbed/common/response.h"
+
+namespace royalbed::common::detail {
+namespace {
+using namespace std::literals;
+
+constexpr auto crlf = "\r\n"sv;
+
+// Room for the chunk size in hex and CRLF in front of the chunk data
+constexpr std::size_t chunkHeaderCapacity = sizeof(std::size_t) * 2 + crlf.size();
+
+class ChunkedEncoder final : public nhope::Reader
+{
+public:
+    ChunkedEncoder(nhope::AOContext& parent, nhope::ReaderPtr body, const ChunkedParams& params,
+                   TrailersProvider trailers)
+      : m_body(std::move(body))
+      , m_trailers(std::move(trailers))
+      , m_minChunkSize(std::min(params.minChunkSize, params.maxChunkSize))
+      , m_frame(chunkHeaderCapacity + std::max<std::size_t>(params.maxChunkSize, 1) + crlf.size())
+      , m_aoCtx(parent)
+    {}
+
+    void read(gsl::span<std::uint8_t> buf, nhope::IOHandler handler) override
+    {
+        if (m_begin < m_end || m_finished) {
+            m_aoCtx.exec([this, buf, handler = std::move(handler)] {
+                handler(nullptr, this->readFrame(buf));
+            });
+            return;
+        }
+
+        if (m_bodyIsOver) {
+            this->makeLastChunk();
+            m_aoCtx.exec([this, buf, handler = std::move(handler)] {
+                handler(nullptr, this->readFrame(buf));
+            });
+            return;
+        }
+
+        m_chunkSize = 0;
+        this->fillChunk(buf, std::move(handler));
+    }
+
+private:
+    [[nodiscard]] std::size_t maxChunkSize() const noexcept
+    {
+        return m_frame.size() - chunkHeaderCapacity - crlf.size();
+    }
+
+    // Reads the body straight into the frame until the chunk is large enough
+    void fillChunk(gsl::span<std::uint8_t> buf, nhope::IOHandler handler)
+    {
+        const auto chunkData =
+          gsl::span(m_frame).subspan(chunkHeaderCapacity + m_chunkSize, this->maxChunkSize() - m_chunkSize);
+        m_body->read(chunkData, [this, buf, handler = std::move(handler)](std::exception_ptr err, std::size_t n) {
+            if (err) {
+                handler(std::move(err), 0);
+                return;
+            }
+
+            m_chunkSize += n;
+            if (n == 0) {
+                m_bodyIsOver = true;
+            } else if (m_chunkSize < m_minChunkSize) {
+                this->fillChunk(buf, handler);
+                return;
+            }
+
+            if (m_chunkSize == 0) {
+                this->makeLastChunk();
+            } else {
+                this->makeChunk();
+            }
+            handler(nullptr, this->readFrame(buf));
+        });
+    }
+
+    void makeChunk()
+    {
+        constexpr auto hexDigits = "0123456789ABCDEF"sv;
+        constexpr std::size_t bitsPerDigit = 4;
+        constexpr std::size_t digitMask = 0xF;
+
+        assert(m_chunkSize != 0);   // NOLINT
+
+        // The chunk data is already in place, so the header is written right before it
+        m_begin = chunkHeaderCapacity - crlf.size();
+        std::memcpy(&m_frame[m_begin], crlf.data(), crlf.size());
+        for (auto rest = m_chunkSize; rest != 0; rest >>= bitsPerDigit) {
+            m_frame[--m_begin] = static_cast<std::uint8_t>(hexDigits[rest & digitMask]);
+        }
+
+        m_end = chunkHeaderCapacity + m_chunkSize;
+        std::memcpy(&m_frame[m_end], crlf.data(), crlf.size());
+        m_end += crlf.size();
+    }
+
+    void makeLastChunk()
+    {
+        std::string lastChunk = "0\r\n";
+        if (m_trailers) {
+            writeHeaders(m_trailers(), lastChunk);
+        }
+        lastChunk += crlf;
+
+        m_frame.assign(lastChunk.begin(), lastChunk.end());
+        m_begin = 0;
+        m_end = m_frame.size();
+        m_finished = true;
+    }
+
+    std::size_t readFrame(gsl::span<std::uint8_t> buf)
+    {
+        const auto n = std::min(buf.size(), m_end - m_begin);
+        std::memcpy(buf.data(), m_frame.data() + m_begin, n);
+        m_begin += n;
+        return n;
+    }
+
+    nhope::ReaderPtr m_body;
+    TrailersProvider m_trailers;
+    const std::size_t m_minChunkSize;
+
+    std::vector<std::uint8_t> m_frame;
+    std::size_t m_chunkSize = 0;
+    std::size_t m_begin = 0;
+    std::size_t m_end = 0;
+    bool m_bodyIsOver = false;
+    bool m_finished = false;
+
+    nhope::AOContext m_aoCtx;
+};
+
+}   // namespace
+
+nhope::ReaderPtr makeChunkedEncoder(nhope::AOContext& aoCtx, nhope::ReaderPtr body, const ChunkedParams& params,
+                                    TrailersProvider trailers)
+{
+    return std::make_unique<ChunkedEncoder>(aoCtx, std::move(body), params, std::move(trailers));
+}
+
+}   // namespace royalbed::common::detail
@@ -0,0 +1,97 @@
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <exception>
+#include <memory>
+#include <utility>
+
+#include <gsl/span>
+
+#include "nhope/async/ao-context.h"
+#include "nhope/io/io-device.h"
+
+#include "royalbed/common/detail/connection-buffer.h"
+
+namespace royalbed::common::detail {
+
+ConnectionBuffer::ConnectionBuffer(nhope::AOContext& parent, nhope::Reader& device, std::size_t capacity)
+  : m_device(device)
+  , m_storage(capacity)
+  , m_aoCtx(parent)
+{}
+
+ConnectionBuffer::ConnectionBuffer(nhope::AOContext& parent, nhope::ReaderPtr device, std::size_t capacity)
+  : m_ownDevice(std::move(device))
+  , m_device(*m_ownDevice)
+  , m_storage(capacity)
+  , m_aoCtx(parent)
+{}
+
+ConnectionBuffer::~ConnectionBuffer()
+{
+    m_aoCtx.close();
+}
+
+gsl::span<const std::uint8_t> ConnectionBuffer::data() const noexcept
+{
+    return gsl::span<const std::uint8_t>(m_storage).subspan(m_begin, m_end - m_begin);
+}
+
+void ConnectionBuffer::consume(std::size_t n) noexcept
+{
+    m_begin += std::min(n, m_end - m_begin);
+    if (m_begin == m_end) {
+        m_begin = m_end = 0;
+    }
+}
+
+void ConnectionBuffer::fill(nhope::IOHandler handler)
+{
+    if (m_end == m_storage.size()) {
+        if (m_begin > 0) {
+            std::memmove(m_storage.data(), m_storage.data() + m_begin, m_end - m_begin);
+            m_end -= m_begin;
+            m_begin = 0;
+        } else {
+            m_storage.resize(m_storage.size() * 2);
+        }
+    }
+
+    const auto freeSpace = gsl::span<std::uint8_t>(m_storage).subspan(m_end);
+    m_device.read(freeSpace, [this, aoCtx = nhope::AOContextRef(m_aoCtx), handler = std::move(handler)](
+                               std::exception_ptr err, std::size_t n) mutable {
+        aoCtx.exec([this, err = std::move(err), n, handler = std::move(handler)] {
+            m_end += n;
+            handler(err, n);
+        });
+    });
+}
+
+void ConnectionBuffer::read(gsl::span<std::uint8_t> buf, nhope::IOHandler handler)
+{
+    if (m_begin == m_end) {
+        m_device.read(buf, std::move(handler));
+        return;
+    }
+
+    const auto n = std::min(buf.size(), m_end - m_begin);
+    std::memcpy(buf.data(), m_storage.data() + m_begin, n);
+    this->consume(n);
+
+    m_aoCtx.exec([n, handler = std::move(handler)] {
+        handler(nullptr, n);
+    });
+}
+
+ConnectionBufferPtr ConnectionBuffer::create(nhope::AOContext& aoCtx, nhope::Reader& device)
+{
+    return std::make_unique<ConnectionBuffer>(aoCtx, device);
+}
+
+ConnectionBufferPtr ConnectionBuffer::create(nhope::AOContext& aoCtx, nhope::ReaderPtr device)
+{
+    return std::make_unique<ConnectionBuffer>(aoCtx, std::move(device));
+}
+
+}   // namespace royalbed::common::detail
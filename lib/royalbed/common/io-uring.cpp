@@ -0,0 +1,728 @@
+#include <stdexcept>
+
+#include "nhope/async/ao-context.h"
+#include "nhope/io/tcp.h"
+
+#include "royalbed/common/detail/io-uring.h"
+#include "royalbed/common/tcp.h"
+
+#ifdef ROYALBED_IO_URING_ENABLED
+
+#include <algorithm>
+#include <array>
+#include <cerrno>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <system_error>
+#include <tuple>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include <arpa/inet.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <liburing.h>
+
+#include "asio/error.hpp"
+#include "asio/io_context.hpp"
+#include "asio/post.hpp"
+#include "asio/posix/stream_descriptor.hpp"
+
+#include "nhope/async/executor.h"
+#include "nhope/async/future.h"
+#include "nhope/async/timer.h"
+#include "nhope/io/io-device.h"
+#include "nhope/io/sock-addr.h"
+
+#include "royalbed/common/detail/asio-socket.h"
+
+#endif
+
+namespace royalbed::common::detail {
+
+#ifdef ROYALBED_IO_URING_ENABLED
+
+namespace {
+
+constexpr unsigned ringEntries = 1024;
+
+// Receive buffers handed to the kernel, a receive takes one of them only when data arrive,
+// so idle connections do not pin any memory
+constexpr unsigned bufferCount = 512;   // must be a power of two
+constexpr std::size_t bufferSize = 16 * 1024;
+constexpr int bufferGroup = 0;
+
+// The delay before the accept is rearmed after a transient error
+constexpr std::chrono::milliseconds minAcceptDelay{10};
+constexpr std::chrono::milliseconds maxAcceptDelay = std::chrono::seconds(1);
+
+std::system_error sysError(int err, const char* what)
+{
+    return std::system_error(err, std::system_category(), what);
+}
+
+class UniqueFd final
+{
+public:
+    explicit UniqueFd(int fd = -1) noexcept
+      : m_fd(fd)
+    {}
+
+    UniqueFd(const UniqueFd&) = delete;
+    UniqueFd& operator=(const UniqueFd&) = delete;
+
+    UniqueFd(UniqueFd&& other) noexcept
+      : m_fd(std::exchange(other.m_fd, -1))
+    {}
+
+    ~UniqueFd()
+    {
+        if (m_fd >= 0) {
+            ::close(m_fd);
+        }
+    }
+
+    [[nodiscard]] int get() const noexcept
+    {
+        return m_fd;
+    }
+
+private:
+    int m_fd;
+};
+
+nhope::SockAddr toSockAddr(const sockaddr_storage& addr)
+{
+    std::array<char, INET6_ADDRSTRLEN> host{};
+    if (addr.ss_family == AF_INET6) {
+        const auto& in6 = reinterpret_cast<const sockaddr_in6&>(addr);
+        ::inet_ntop(AF_INET6, &in6.sin6_addr, host.data(), host.size());
+        return nhope::SockAddr::ipv6(host.data(), ntohs(in6.sin6_port));
+    }
+
+    const auto& in = reinterpret_cast<const sockaddr_in&>(addr);
+    ::inet_ntop(AF_INET, &in.sin_addr, host.data(), host.size());
+    return nhope::SockAddr::ipv4(host.data(), ntohs(in.sin_port));
+}
+
+template<typename GetName>
+nhope::SockAddr sockAddress(int fd, GetName getName)
+{
+    sockaddr_storage addr{};
+    socklen_t addrLen = sizeof(addr);
+    if (getName(fd, reinterpret_cast<sockaddr*>(&addr), &addrLen) != 0) {
+        throw sysError(errno, "getsockname");
+    }
+    return toSockAddr(addr);
+}
+
+void setIntOption(int fd, int level, int option, int value)
+{
+    if (::setsockopt(fd, level, option, &value, sizeof(value)) != 0) {
+        throw sysError(errno, "setsockopt");
+    }
+}
+
+UniqueFd makeListener(const nhope::TcpServerParams& params, const SocketOptions& options)
+{
+    addrinfo hints{};
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    hints.ai_flags = AI_PASSIVE;
+
+    addrinfo* addrs = nullptr;
+    const auto port = std::to_string(params.port);
+    if (const int ret = ::getaddrinfo(params.address.c_str(), port.c_str(), &hints, &addrs); ret != 0) {
+        throw std::runtime_error(std::string("getaddrinfo: ") + ::gai_strerror(ret));
+    }
+    const std::unique_ptr<addrinfo, decltype(&::freeaddrinfo)> addrsGuard(addrs, ::freeaddrinfo);
+
+    UniqueFd fd(::socket(addrs->ai_family, SOCK_STREAM | SOCK_CLOEXEC, 0));
+    if (fd.get() < 0) {
+        throw sysError(errno, "socket");
+    }
+
+    setIntOption(fd.get(), SOL_SOCKET, SO_REUSEADDR, 1);
+    // Accepted sockets inherit the buffer sizes of the listener
+    if (options.sendBufferSize > 0) {
+        setIntOption(fd.get(), SOL_SOCKET, SO_SNDBUF, options.sendBufferSize);
+    }
+    if (options.receiveBufferSize > 0) {
+        setIntOption(fd.get(), SOL_SOCKET, SO_RCVBUF, options.receiveBufferSize);
+    }
+    if (options.deferAccept.count() > 0) {
+        setIntOption(fd.get(), IPPROTO_TCP, TCP_DEFER_ACCEPT, static_cast<int>(options.deferAccept.count()));
+    }
+    if (options.fastOpen) {
+        setIntOption(fd.get(), IPPROTO_TCP, TCP_FASTOPEN, options.fastOpenQueueLength);
+    }
+
+    if (::bind(fd.get(), addrs->ai_addr, addrs->ai_addrlen) != 0) {
+        throw sysError(errno, "bind");
+    }
+    if (::listen(fd.get(), options.backlog > 0 ? options.backlog : SOMAXCONN) != 0) {
+        throw sysError(errno, "listen");
+    }
+
+    return fd;
+}
+
+class Ring;
+
+// The data of a completed receive, the buffer goes back to the kernel when the object is destroyed
+class ReceivedData final
+{
+public:
+    ReceivedData(std::shared_ptr<Ring> ring, unsigned bufferId, std::size_t size)
+      : m_ring(std::move(ring))
+      , m_bufferId(bufferId)
+      , m_size(size)
+    {}
+
+    ReceivedData(const ReceivedData&) = delete;
+    ReceivedData& operator=(const ReceivedData&) = delete;
+
+    ~ReceivedData();
+
+    [[nodiscard]] gsl::span<const std::uint8_t> data() const;
+
+private:
+    std::shared_ptr<Ring> m_ring;
+    unsigned m_bufferId;
+    std::size_t m_size;
+};
+
+// The submission and completion queues shared by the listener and all accepted sockets of a server.
+// Submissions made while handling one batch of events are sent to the kernel with a single io_uring_enter,
+// the completions are signalled through an eventfd that is waited on the asio io_context
+class Ring final : public std::enable_shared_from_this<Ring>
+{
+public:
+    // res is the result of the operation as returned by the kernel, flags are the flags of the completion
+    using Completion = std::function<void(int res, unsigned flags)>;
+
+    explicit Ring(asio::io_context& ioCtx)
+      : m_ioCtx(ioCtx)
+      , m_event(ioCtx)
+    {
+        if (const int ret = io_uring_queue_init(ringEntries, &m_ring, 0); ret < 0) {
+            throw sysError(-ret, "io_uring_queue_init");
+        }
+
+        try {
+            const int eventFd = ::eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+            if (eventFd < 0) {
+                throw sysError(errno, "eventfd");
+            }
+            m_event.assign(eventFd);
+            if (const int ret = io_uring_register_eventfd(&m_ring, eventFd); ret < 0) {
+                throw sysError(-ret, "io_uring_register_eventfd");
+            }
+
+            int ret = 0;
+            m_bufRing = io_uring_setup_buf_ring(&m_ring, bufferCount, bufferGroup, 0, &ret);
+            if (m_bufRing == nullptr) {
+                throw sysError(-ret, "io_uring_setup_buf_ring");
+            }
+            m_buffers.resize(bufferCount * bufferSize);
+            for (unsigned id = 0; id < bufferCount; ++id) {
+                io_uring_buf_ring_add(m_bufRing, bufferPtr(id), bufferSize, static_cast<unsigned short>(id),
+                                      io_uring_buf_ring_mask(bufferCount), static_cast<int>(id));
+            }
+            io_uring_buf_ring_advance(m_bufRing, bufferCount);
+        } catch (...) {
+            asio::error_code ec;
+            m_event.close(ec);
+            io_uring_queue_exit(&m_ring);
+            throw;
+        }
+    }
+
+    Ring(const Ring&) = delete;
+    Ring& operator=(const Ring&) = delete;
+
+    ~Ring()
+    {
+        asio::error_code ec;
+        m_event.close(ec);
+
+        io_uring_free_buf_ring(&m_ring, m_bufRing, bufferCount, bufferGroup);
+        io_uring_queue_exit(&m_ring);
+    }
+
+    void start()
+    {
+        waitCompletions();
+    }
+
+    // Delivers the accepted descriptors until cancelled or failed, IORING_CQE_F_MORE is set while it is armed
+    std::uint64_t multishotAccept(int fd, Completion completion)
+    {
+        std::scoped_lock lock(m_mutex);
+        const auto id = addOperation(std::move(completion));
+        auto* sqe = nextSqe();
+        io_uring_prep_multishot_accept(sqe, fd, nullptr, nullptr, SOCK_CLOEXEC);
+        io_uring_sqe_set_data64(sqe, id);
+        scheduleSubmit();
+        return id;
+    }
+
+    // The kernel picks one of the provided buffers when the data arrive, see takeData
+    void recv(int fd, std::size_t maxSize, Completion completion)
+    {
+        std::scoped_lock lock(m_mutex);
+        const auto id = addOperation(std::move(completion));
+        auto* sqe = nextSqe();
+        io_uring_prep_recv(sqe, fd, nullptr, std::min(maxSize, bufferSize), 0);
+        sqe->flags |= IOSQE_BUFFER_SELECT;
+        sqe->buf_group = bufferGroup;
+        io_uring_sqe_set_data64(sqe, id);
+        scheduleSubmit();
+    }
+
+    // A receive into the buffer of the caller, used when all the provided buffers are taken
+    void recvInto(int fd, gsl::span<std::uint8_t> buf, Completion completion)
+    {
+        std::scoped_lock lock(m_mutex);
+        const auto id = addOperation(std::move(completion));
+        auto* sqe = nextSqe();
+        io_uring_prep_recv(sqe, fd, buf.data(), buf.size(), 0);
+        io_uring_sqe_set_data64(sqe, id);
+        scheduleSubmit();
+    }
+
+    void send(int fd, gsl::span<const std::uint8_t> data, Completion completion)
+    {
+        std::scoped_lock lock(m_mutex);
+        const auto id = addOperation(std::move(completion));
+        auto* sqe = nextSqe();
+        io_uring_prep_send(sqe, fd, data.data(), data.size(), MSG_NOSIGNAL);
+        io_uring_sqe_set_data64(sqe, id);
+        scheduleSubmit();
+    }
+
+    void cancel(std::uint64_t id)
+    {
+        std::scoped_lock lock(m_mutex);
+        auto* sqe = nextSqe();
+        io_uring_prep_cancel64(sqe, id, 0);
+        io_uring_sqe_set_data64(sqe, 0);
+        scheduleSubmit();
+    }
+
+    // Takes the buffer filled by a completed receive
+    std::shared_ptr<ReceivedData> takeData(int res, unsigned flags)
+    {
+        if ((flags & IORING_CQE_F_BUFFER) == 0) {
+            return nullptr;
+        }
+        const auto bufferId = flags >> IORING_CQE_BUFFER_SHIFT;
+        return std::make_shared<ReceivedData>(shared_from_this(), bufferId, res > 0 ? std::size_t(res) : 0);
+    }
+
+    [[nodiscard]] gsl::span<const std::uint8_t> buffer(unsigned id, std::size_t size) const
+    {
+        return {m_buffers.data() + std::size_t(id) * bufferSize, size};
+    }
+
+    void releaseBuffer(unsigned id)
+    {
+        std::scoped_lock lock(m_mutex);
+        io_uring_buf_ring_add(m_bufRing, bufferPtr(id), bufferSize, static_cast<unsigned short>(id),
+                              io_uring_buf_ring_mask(bufferCount), 0);
+        io_uring_buf_ring_advance(m_bufRing, 1);
+    }
+
+private:
+    std::uint8_t* bufferPtr(unsigned id)
+    {
+        return m_buffers.data() + std::size_t(id) * bufferSize;
+    }
+
+    std::uint64_t addOperation(Completion completion)
+    {
+        const auto id = m_nextId++;
+        m_operations.emplace(id, std::move(completion));
+        return id;
+    }
+
+    io_uring_sqe* nextSqe()
+    {
+        auto* sqe = io_uring_get_sqe(&m_ring);
+        if (sqe == nullptr) {
+            // The submission queue is full, flush it right away
+            io_uring_submit(&m_ring);
+            sqe = io_uring_get_sqe(&m_ring);
+        }
+        if (sqe == nullptr) {
+            throw sysError(EBUSY, "io_uring_get_sqe");
+        }
+        return sqe;
+    }
+
+    void scheduleSubmit()
+    {
+        if (m_submitScheduled) {
+            return;
+        }
+
+        m_submitScheduled = true;
+        asio::post(m_ioCtx, [weak = weak_from_this()] {
+            if (auto self = weak.lock()) {
+                std::scoped_lock lock(self->m_mutex);
+                self->m_submitScheduled = false;
+                io_uring_submit(&self->m_ring);
+            }
+        });
+    }
+
+    void waitCompletions()
+    {
+        m_event.async_read_some(asio::buffer(&m_eventValue, sizeof(m_eventValue)),
+                                [weak = weak_from_this()](const asio::error_code& ec, std::size_t /*n*/) {
+                                    auto self = weak.lock();
+                                    if (self == nullptr || ec == asio::error::operation_aborted) {
+                                        return;
+                                    }
+                                    self->processCompletions();
+                                    self->waitCompletions();
+                                });
+    }
+
+    void processCompletions()
+    {
+        std::vector<std::tuple<Completion, int, unsigned>> completed;
+        std::vector<unsigned> orphanedBuffers;
+
+        {
+            std::scoped_lock lock(m_mutex);
+            io_uring_cqe* cqe = nullptr;
+            while (io_uring_peek_cqe(&m_ring, &cqe) == 0) {
+                const auto id = io_uring_cqe_get_data64(cqe);
+                const int res = cqe->res;
+                const unsigned flags = cqe->flags;
+                io_uring_cqe_seen(&m_ring, cqe);
+
+                const auto it = m_operations.find(id);
+                if (it == m_operations.end()) {
+                    if ((flags & IORING_CQE_F_BUFFER) != 0) {
+                        orphanedBuffers.push_back(flags >> IORING_CQE_BUFFER_SHIFT);
+                    }
+                    continue;
+                }
+
+                if ((flags & IORING_CQE_F_MORE) != 0) {
+                    completed.emplace_back(it->second, res, flags);
+                } else {
+                    completed.emplace_back(std::move(it->second), res, flags);
+                    m_operations.erase(it);
+                }
+            }
+        }
+
+        for (const auto bufferId : orphanedBuffers) {
+            releaseBuffer(bufferId);
+        }
+        for (auto& [completion, res, flags] : completed) {
+            completion(res, flags);
+        }
+    }
+
+    std::mutex m_mutex;
+    io_uring m_ring{};
+    io_uring_buf_ring* m_bufRing = nullptr;
+    std::vector<std::uint8_t> m_buffers;
+    std::unordered_map<std::uint64_t, Completion> m_operations;
+    std::uint64_t m_nextId = 1;
+    bool m_submitScheduled = false;
+
+    asio::io_context& m_ioCtx;
+    asio::posix::stream_descriptor m_event;
+    std::uint64_t m_eventValue = 0;
+};
+
+ReceivedData::~ReceivedData()
+{
+    m_ring->releaseBuffer(m_bufferId);
+}
+
+gsl::span<const std::uint8_t> ReceivedData::data() const
+{
+    return m_ring->buffer(m_bufferId, m_size);
+}
+
+class IoUringSocket final
+  : public nhope::TcpSocket
+  , public NativeSocket
+{
+public:
+    IoUringSocket(nhope::AOContext& parent, std::shared_ptr<Ring> ring, UniqueFd fd)
+      : m_ring(std::move(ring))
+      , m_fd(std::move(fd))
+      , m_aoCtx(parent)
+    {}
+
+    ~IoUringSocket() override
+    {
+        m_aoCtx.close();
+
+        // The kernel keeps the file open while operations are in flight, shutdown completes them
+        ::shutdown(m_fd.get(), SHUT_RDWR);
+    }
+
+    void read(gsl::span<std::uint8_t> buf, nhope::IOHandler handler) override
+    {
+        m_ring->recv(m_fd.get(), buf.size(),
+                     [this, weakRing = std::weak_ptr(m_ring), aoCtx = nhope::AOContextRef(m_aoCtx), buf,
+                      handler = std::move(handler)](int res, unsigned flags) mutable {
+                         const auto ring = weakRing.lock();
+                         auto data = ring != nullptr ? ring->takeData(res, flags) : nullptr;
+                         aoCtx.exec([this, data = std::move(data), buf, handler = std::move(handler), res]() mutable {
+                             if (res == -ENOBUFS) {
+                                 // All the provided buffers are in use, resubmitting would spin until one is
+                                 // returned, so this receive goes straight into the buffer of the caller
+                                 this->readInto(buf, std::move(handler));
+                                 return;
+                             }
+                             if (res < 0) {
+                                 handler(std::make_exception_ptr(sysError(-res, "recv")), 0);
+                                 return;
+                             }
+
+                             const auto received = data != nullptr ? data->data() : gsl::span<const std::uint8_t>();
+                             std::copy(received.begin(), received.end(), buf.begin());
+                             data.reset();
+                             handler(nullptr, received.size());
+                         });
+                     });
+    }
+
+    void readInto(gsl::span<std::uint8_t> buf, nhope::IOHandler handler)
+    {
+        auto aoCtx = nhope::AOContextRef(m_aoCtx);
+        auto completion = [aoCtx, handler = std::move(handler)](int res, unsigned /*flags*/) mutable {
+            aoCtx.exec([handler = std::move(handler), res] {
+                if (res < 0) {
+                    handler(std::make_exception_ptr(sysError(-res, "recv")), 0);
+                    return;
+                }
+                handler(nullptr, static_cast<std::size_t>(res));
+            });
+        };
+        m_ring->recvInto(m_fd.get(), buf, std::move(completion));
+    }
+
+    void write(gsl::span<const std::uint8_t> data, nhope::IOHandler handler) override
+    {
+        // The data is sent without copying, the kernel only reads the buffer
+        // and nothing reaches the peer once the socket is shut down
+        m_ring->send(m_fd.get(), data,
+                     [aoCtx = nhope::AOContextRef(m_aoCtx), handler = std::move(handler)](int res, unsigned) mutable {
+                         aoCtx.exec([handler = std::move(handler), res] {
+                             if (res < 0) {
+                                 handler(std::make_exception_ptr(sysError(-res, "send")), 0);
+                                 return;
+                             }
+                             handler(nullptr, static_cast<std::size_t>(res));
+                         });
+                     });
+    }
+
+    [[nodiscard]] nhope::SockAddr localAddress() const override
+    {
+        return sockAddress(m_fd.get(), ::getsockname);
+    }
+
+    [[nodiscard]] nhope::SockAddr peerAddress() const override
+    {
+        return sockAddress(m_fd.get(), ::getpeername);
+    }
+
+    [[nodiscard]] int nativeHandle() noexcept override
+    {
+        return m_fd.get();
+    }
+
+    void shutdown(Shutdown what) override
+    {
+        switch (what) {
+        case Shutdown::Receive:
+            ::shutdown(m_fd.get(), SHUT_RD);
+            break;
+        case Shutdown::Send:
+            ::shutdown(m_fd.get(), SHUT_WR);
+            break;
+        case Shutdown::Both:
+            ::shutdown(m_fd.get(), SHUT_RDWR);
+            break;
+        }
+    }
+
+private:
+    std::shared_ptr<Ring> m_ring;
+    UniqueFd m_fd;
+    nhope::AOContext m_aoCtx;
+};
+
+class IoUringServer final
+  : public nhope::TcpServer
+  , public NativeSocket
+{
+public:
+    IoUringServer(nhope::AOContext& parent, const nhope::TcpServerParams& params, const SocketOptions& options)
+      : m_options(options)
+      , m_ring(std::make_shared<Ring>(parent.executor().ioCtx()))
+      , m_listener(makeListener(params, options))
+      , m_aoCtx(parent)
+    {
+        m_ring->start();
+        armAccept();
+    }
+
+    ~IoUringServer() override
+    {
+        m_aoCtx.close();
+        m_ring->cancel(m_acceptId);
+    }
+
+    nhope::Future<nhope::TcpSocketPtr> accept() override
+    {
+        nhope::Promise<nhope::TcpSocketPtr> promise;
+        auto future = promise.future();
+
+        if (!m_accepted.empty()) {
+            promise.setValue(makeSocket(std::move(m_accepted.front())));
+            m_accepted.pop_front();
+        } else if (m_error.has_value()) {
+            promise.setException(std::make_exception_ptr(*m_error));
+        } else {
+            m_waiters.push_back(std::move(promise));
+        }
+
+        return future;
+    }
+
+    [[nodiscard]] nhope::SockAddr bindAddress() const override
+    {
+        return sockAddress(m_listener.get(), ::getsockname);
+    }
+
+    [[nodiscard]] int nativeHandle() noexcept override
+    {
+        return m_listener.get();
+    }
+
+private:
+    void armAccept()
+    {
+        m_acceptId = m_ring->multishotAccept(
+          m_listener.get(), [this, aoCtx = nhope::AOContextRef(m_aoCtx)](int res, unsigned flags) mutable {
+              // The descriptor is closed if the server is gone before it is delivered
+              auto fd = std::make_shared<UniqueFd>(res >= 0 ? res : -1);
+              const bool armed = (flags & IORING_CQE_F_MORE) != 0;
+              aoCtx.exec([this, fd, res, armed] {
+                  if (res >= 0) {
+                      m_acceptDelay = std::chrono::milliseconds(0);
+                      this->deliver(std::move(*fd));
+                  } else if (!isTransientAcceptError(-res)) {
+                      // The listener is unusable, rearming would fail again at once
+                      m_error = sysError(-res, "accept");
+                      this->failWaiters();
+                      return;
+                  }
+
+                  if (armed) {
+                      return;
+                  }
+                  if (res >= 0) {
+                      this->armAccept();
+                      return;
+                  }
+
+                  // E.g. EMFILE: the pending connection stays in the backlog and fails again until descriptors
+                  // are freed, so the accept is rearmed with a growing delay and the waiters keep waiting
+                  m_acceptDelay = std::clamp(m_acceptDelay * 2, minAcceptDelay, maxAcceptDelay);
+                  nhope::setTimeout(m_aoCtx, m_acceptDelay, [this](auto) {
+                      this->armAccept();
+                  });
+              });
+          });
+    }
+
+    static bool isTransientAcceptError(int err)
+    {
+        return err != EBADF && err != EINVAL && err != ENOTSOCK && err != EOPNOTSUPP && err != EFAULT;
+    }
+
+    void deliver(UniqueFd fd)
+    {
+        if (m_waiters.empty()) {
+            m_accepted.push_back(std::move(fd));
+            return;
+        }
+
+        auto promise = std::move(m_waiters.front());
+        m_waiters.pop_front();
+        promise.setValue(makeSocket(std::move(fd)));
+    }
+
+    void failWaiters()
+    {
+        auto waiters = std::exchange(m_waiters, {});
+        for (auto& promise : waiters) {
+            promise.setException(std::make_exception_ptr(*m_error));
+        }
+    }
+
+    nhope::TcpSocketPtr makeSocket(UniqueFd fd)
+    {
+        const int noDelay = m_options.noDelay ? 1 : 0;
+        ::setsockopt(fd.get(), IPPROTO_TCP, TCP_NODELAY, &noDelay, sizeof(noDelay));
+        return std::make_unique<IoUringSocket>(m_aoCtx, m_ring, std::move(fd));
+    }
+
+    SocketOptions m_options;
+    std::shared_ptr<Ring> m_ring;
+    UniqueFd m_listener;
+    std::uint64_t m_acceptId = 0;
+    std::chrono::milliseconds m_acceptDelay{0};
+    std::optional<std::system_error> m_error;
+    std::deque<UniqueFd> m_accepted;
+    std::deque<nhope::Promise<nhope::TcpSocketPtr>> m_waiters;
+    nhope::AOContext m_aoCtx;
+};
+
+}   // namespace
+
+nhope::TcpServerPtr startIoUringTcpServer(nhope::AOContext& aoCtx, const nhope::TcpServerParams& params,
+                                          const SocketOptions& options)
+{
+    return std::make_unique<IoUringServer>(aoCtx, params, options);
+}
+
+#else
+
+nhope::TcpServerPtr startIoUringTcpServer(nhope::AOContext& /*aoCtx*/, const nhope::TcpServerParams& /*params*/,
+                                          const SocketOptions& /*options*/)
+{
+    throw std::runtime_error("royalbed is built without io_uring support (ROYALBED_IO_URING_ENABLED)");
+}
+
+#endif
+
+}   // namespace royalbed::common::detail
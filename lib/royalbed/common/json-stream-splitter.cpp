@@ -0,0 +1,139 @@
+#include <cstdint>
+#include <span>
+#include <stdexcept>
+#include <string_view>
+#include <utility>
+
+#include "royalbed/common/detail/json-stream-splitter.h"
+
+namespace royalbed::common::detail {
+
+namespace {
+
+class JsonStructureError final : public std::invalid_argument
+{
+public:
+    explicit JsonStructureError(std::string_view what)
+      : std::invalid_argument(std::string(what))
+    {}
+};
+
+bool isSpace(char ch) noexcept
+{
+    return ch == ' ' || ch == '\t' || ch == '\r' || ch == '\n';
+}
+
+}   // namespace
+
+JsonStreamSplitter::JsonStreamSplitter(ElementHandler handler)
+  : m_handler(std::move(handler))
+{}
+
+void JsonStreamSplitter::feed(std::span<const std::uint8_t> data)
+{
+    for (const auto byte : data) {
+        processChar(static_cast<char>(byte));
+    }
+}
+
+void JsonStreamSplitter::finish()
+{
+    if (m_state != State::AfterArray) {
+        throw JsonStructureError("unexpected end of JSON array");
+    }
+}
+
+std::size_t JsonStreamSplitter::elementCount() const noexcept
+{
+    return m_elementCount;
+}
+
+void JsonStreamSplitter::processChar(char ch)
+{
+    switch (m_state) {
+    case State::BeforeArray:
+        if (isSpace(ch)) {
+            return;
+        }
+        if (ch != '[') {
+            throw JsonStructureError("JSON array expected");
+        }
+        m_state = State::BeforeElement;
+        return;
+
+    case State::BeforeElement:
+        if (isSpace(ch)) {
+            return;
+        }
+        if (ch == ']' && m_elementCount == 0) {
+            // Empty array
+            m_state = State::AfterArray;
+            return;
+        }
+        if (ch == ',' || ch == ']') {
+            throw JsonStructureError("JSON array element expected");
+        }
+        m_state = State::InElement;
+        processElementChar(ch);
+        return;
+
+    case State::InElement:
+        if (!m_inString && m_depth == 0 && (ch == ',' || ch == ']')) {
+            completeElement();
+            m_state = ch == ',' ? State::BeforeElement : State::AfterArray;
+            return;
+        }
+        processElementChar(ch);
+        return;
+
+    case State::AfterArray:
+        if (!isSpace(ch)) {
+            throw JsonStructureError("unexpected data after JSON array");
+        }
+        return;
+    }
+}
+
+void JsonStreamSplitter::processElementChar(char ch)
+{
+    m_element += ch;
+
+    if (m_inString) {
+        if (m_escaped) {
+            m_escaped = false;
+        } else if (ch == '\\') {
+            m_escaped = true;
+        } else if (ch == '"') {
+            m_inString = false;
+        }
+        return;
+    }
+
+    switch (ch) {
+    case '"':
+        m_inString = true;
+        break;
+    case '[':
+    case '{':
+        ++m_depth;
+        break;
+    case ']':
+    case '}':
+        if (m_depth == 0) {
+            throw JsonStructureError("unbalanced brackets in JSON array element");
+        }
+        --m_depth;
+        break;
+    default:
+        break;
+    }
+}
+
+void JsonStreamSplitter::completeElement()
+{
+    ++m_elementCount;
+    m_handler(m_element);
+    m_element.clear();
+}
+
+}   // namespace royalbed::common::detail
@@ -0,0 +1,211 @@
+#include <array>
+#include <cassert>
+#include <charconv>
+#include <cmath>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <utility>
+
+#include "royalbed/common/json-writer.h"
+
+namespace royalbed::common {
+
+namespace {
+using namespace std::literals;
+
+constexpr std::size_t numberBufSize = 32;
+
+template<typename T>
+void appendNumber(std::string& out, T val)
+{
+    std::array<char, numberBufSize> buf{};
+    const auto result = std::to_chars(buf.begin(), buf.end(), val);
+    assert(result.ec == std::errc{});   // NOLINT
+    out.append(buf.data(), result.ptr);
+}
+
+void appendEscaped(std::string& out, std::string_view str)
+{
+    constexpr auto hexDigits = "0123456789abcdef"sv;
+
+    out += '"';
+    auto plainBegin = str.begin();
+    for (auto it = str.begin(); it != str.end(); ++it) {
+        const auto ch = static_cast<unsigned char>(*it);
+        if (ch >= 0x20 && ch != '"' && ch != '\\') {   // NOLINT(readability-magic-numbers)
+            continue;
+        }
+
+        out.append(plainBegin, it);
+        plainBegin = it + 1;
+
+        switch (ch) {
+        case '"':
+            out += "\\\""sv;
+            break;
+        case '\\':
+            out += "\\\\"sv;
+            break;
+        case '\b':
+            out += "\\b"sv;
+            break;
+        case '\f':
+            out += "\\f"sv;
+            break;
+        case '\n':
+            out += "\\n"sv;
+            break;
+        case '\r':
+            out += "\\r"sv;
+            break;
+        case '\t':
+            out += "\\t"sv;
+            break;
+        default:
+            out += "\\u00"sv;
+            out += hexDigits[ch >> 4];     // NOLINT(readability-magic-numbers)
+            out += hexDigits[ch & 0xF];    // NOLINT(readability-magic-numbers)
+            break;
+        }
+    }
+    out.append(plainBegin, str.end());
+    out += '"';
+}
+
+}   // namespace
+
+JsonWriter::JsonWriter(std::string& out)
+  : m_out(&out)
+{}
+
+JsonWriter& JsonWriter::beginObject()
+{
+    beforeValue();
+    *m_out += '{';
+    m_hasValues.push_back(false);
+    return *this;
+}
+
+JsonWriter& JsonWriter::endObject()
+{
+    assert(!m_hasValues.empty() && !m_afterKey);   // NOLINT
+    m_hasValues.pop_back();
+    *m_out += '}';
+    return *this;
+}
+
+JsonWriter& JsonWriter::beginArray()
+{
+    beforeValue();
+    *m_out += '[';
+    m_hasValues.push_back(false);
+    return *this;
+}
+
+JsonWriter& JsonWriter::endArray()
+{
+    assert(!m_hasValues.empty() && !m_afterKey);   // NOLINT
+    m_hasValues.pop_back();
+    *m_out += ']';
+    return *this;
+}
+
+JsonWriter& JsonWriter::key(std::string_view name)
+{
+    assert(!m_hasValues.empty() && !m_afterKey);   // NOLINT
+    if (m_hasValues.back()) {
+        *m_out += ',';
+    }
+    m_hasValues.back() = true;
+
+    appendEscaped(*m_out, name);
+    *m_out += ':';
+    m_afterKey = true;
+    return *this;
+}
+
+JsonWriter& JsonWriter::null()
+{
+    return raw("null"sv);
+}
+
+JsonWriter& JsonWriter::boolean(bool val)
+{
+    return raw(val ? "true"sv : "false"sv);
+}
+
+JsonWriter& JsonWriter::integer(std::int64_t val)
+{
+    beforeValue();
+    appendNumber(*m_out, val);
+    return *this;
+}
+
+JsonWriter& JsonWriter::unsignedInteger(std::uint64_t val)
+{
+    beforeValue();
+    appendNumber(*m_out, val);
+    return *this;
+}
+
+JsonWriter& JsonWriter::number(double val)
+{
+    if (!std::isfinite(val)) {
+        // The same as nlohmann::json does
+        return null();
+    }
+
+    beforeValue();
+    const auto begin = m_out->size();
+    appendNumber(*m_out, val);
+    if (m_out->find_first_of(".e", begin) == std::string::npos) {
+        // Keep the value recognizable as a floating point number, as nlohmann::json does
+        *m_out += ".0"sv;
+    }
+    return *this;
+}
+
+JsonWriter& JsonWriter::string(std::string_view val)
+{
+    beforeValue();
+    appendEscaped(*m_out, val);
+    return *this;
+}
+
+JsonWriter& JsonWriter::raw(std::string_view json)
+{
+    beforeValue();
+    *m_out += json;
+    return *this;
+}
+
+std::string& JsonWriter::buffer() noexcept
+{
+    return *m_out;
+}
+
+std::string JsonWriter::takeBuffer() noexcept
+{
+    return std::move(*m_out);
+}
+
+void JsonWriter::beforeValue()
+{
+    if (m_afterKey) {
+        m_afterKey = false;
+        return;
+    }
+
+    if (m_hasValues.empty()) {
+        // Top level value
+        return;
+    }
+
+    if (m_hasValues.back()) {
+        *m_out += ',';
+    }
+    m_hasValues.back() = true;
+}
+
+}   // namespace royalbed::common
@@ -0,0 +1,136 @@
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+#include <gsl/span>
+
+#include "royalbed/common/detail/sha1.h"
+
+namespace royalbed::common::detail {
+namespace {
+using namespace std::literals;
+
+constexpr std::size_t blockSize = 64;
+constexpr std::size_t roundCount = 80;
+
+constexpr std::uint32_t rotl(std::uint32_t value, int bits) noexcept
+{
+    return (value << bits) | (value >> (32 - bits));   // NOLINT(readability-magic-numbers)
+}
+
+// NOLINTBEGIN(readability-magic-numbers)
+void processBlock(std::array<std::uint32_t, 5>& state, const std::uint8_t* block)
+{
+    std::array<std::uint32_t, roundCount> w{};
+    for (std::size_t i = 0; i < 16; ++i) {
+        w[i] = static_cast<std::uint32_t>(block[i * 4]) << 24 | static_cast<std::uint32_t>(block[i * 4 + 1]) << 16 |
+               static_cast<std::uint32_t>(block[i * 4 + 2]) << 8 | static_cast<std::uint32_t>(block[i * 4 + 3]);
+    }
+    for (std::size_t i = 16; i < roundCount; ++i) {
+        w[i] = rotl(w[i - 3] ^ w[i - 8] ^ w[i - 14] ^ w[i - 16], 1);
+    }
+
+    auto [a, b, c, d, e] = state;
+    for (std::size_t i = 0; i < roundCount; ++i) {
+        std::uint32_t f = 0;
+        std::uint32_t k = 0;
+        if (i < 20) {
+            f = (b & c) | (~b & d);
+            k = 0x5A827999;
+        } else if (i < 40) {
+            f = b ^ c ^ d;
+            k = 0x6ED9EBA1;
+        } else if (i < 60) {
+            f = (b & c) | (b & d) | (c & d);
+            k = 0x8F1BBCDC;
+        } else {
+            f = b ^ c ^ d;
+            k = 0xCA62C1D6;
+        }
+
+        const auto temp = rotl(a, 5) + f + e + k + w[i];
+        e = d;
+        d = c;
+        c = rotl(b, 30);
+        b = a;
+        a = temp;
+    }
+
+    state[0] += a;
+    state[1] += b;
+    state[2] += c;
+    state[3] += d;
+    state[4] += e;
+}
+// NOLINTEND(readability-magic-numbers)
+
+}   // namespace
+
+Sha1Digest sha1(std::string_view data)
+{
+    std::array<std::uint32_t, 5> state{0x67452301, 0xEFCDAB89, 0x98BADCFE, 0x10325476, 0xC3D2E1F0};   // NOLINT
+
+    const auto* bytes = reinterpret_cast<const std::uint8_t*>(data.data());   // NOLINT
+    std::size_t pos = 0;
+    for (; pos + blockSize <= data.size(); pos += blockSize) {
+        processBlock(state, bytes + pos);   // NOLINT
+    }
+
+    // The rest of the data, 0x80, zero padding and the length in bits
+    std::array<std::uint8_t, blockSize * 2> tail{};
+    const auto restSize = data.size() - pos;
+    std::copy(bytes + pos, bytes + data.size(), tail.begin());   // NOLINT
+    tail[restSize] = 0x80;                                         // NOLINT
+    const auto tailSize = restSize + 1 + 8 <= blockSize ? blockSize : blockSize * 2;
+    const std::uint64_t bitLength = static_cast<std::uint64_t>(data.size()) * 8;   // NOLINT
+    for (std::size_t i = 0; i < 8; ++i) {                                          // NOLINT
+        tail[tailSize - 1 - i] = static_cast<std::uint8_t>(bitLength >> (i * 8));   // NOLINT
+    }
+    for (std::size_t offset = 0; offset < tailSize; offset += blockSize) {
+        processBlock(state, tail.data() + offset);   // NOLINT
+    }
+
+    Sha1Digest digest{};
+    for (std::size_t i = 0; i < state.size(); ++i) {
+        digest[i * 4] = static_cast<std::uint8_t>(state[i] >> 24);       // NOLINT
+        digest[i * 4 + 1] = static_cast<std::uint8_t>(state[i] >> 16);   // NOLINT
+        digest[i * 4 + 2] = static_cast<std::uint8_t>(state[i] >> 8);    // NOLINT
+        digest[i * 4 + 3] = static_cast<std::uint8_t>(state[i]);
+    }
+    return digest;
+}
+
+std::string toBase64(gsl::span<const std::uint8_t> data)
+{
+    constexpr auto alphabet = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/"sv;
+
+    std::string result;
+    result.reserve((data.size() + 2) / 3 * 4);
+
+    std::size_t i = 0;
+    for (; i + 3 <= data.size(); i += 3) {
+        const std::uint32_t triple = data[i] << 16 | data[i + 1] << 8 | data[i + 2];   // NOLINT
+        result += alphabet[(triple >> 18) & 0x3F];                                  // NOLINT
+        result += alphabet[(triple >> 12) & 0x3F];                                  // NOLINT
+        result += alphabet[(triple >> 6) & 0x3F];                                   // NOLINT
+        result += alphabet[triple & 0x3F];                                          // NOLINT
+    }
+
+    const auto rest = data.size() - i;
+    if (rest > 0) {
+        std::uint32_t triple = data[i] << 16;   // NOLINT
+        if (rest == 2) {
+            triple |= data[i + 1] << 8;   // NOLINT
+        }
+        result += alphabet[(triple >> 18) & 0x3F];                   // NOLINT
+        result += alphabet[(triple >> 12) & 0x3F];                   // NOLINT
+        result += rest == 2 ? alphabet[(triple >> 6) & 0x3F] : '=';   // NOLINT
+        result += '=';
+    }
+    return result;
+}
+
+}   // namespace royalbed::common::detail
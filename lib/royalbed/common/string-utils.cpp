@@ -73,6 +73,32 @@ T toInteger(std::string_view str)
 
 }   // namespace
 
+std::string_view trim(std::string_view str) noexcept
+{
+    while (!str.empty() && (str.front() == ' ' || str.front() == '\t')) {
+        str.remove_prefix(1);
+    }
+    while (!str.empty() && (str.back() == ' ' || str.back() == '\t')) {
+        str.remove_suffix(1);
+    }
+    return str;
+}
+
+bool containsToken(std::string_view list, std::string_view token)
+{
+    while (!list.empty()) {
+        const auto end = list.find(',');
+        if (LowercaseEqual()(trim(list.substr(0, end)), token)) {
+            return true;
+        }
+        if (end == std::string_view::npos) {
+            break;
+        }
+        list.remove_prefix(end + 1);
+    }
+    return false;
+}
+
 template<>
 std::string fromString(std::string_view str)
 {
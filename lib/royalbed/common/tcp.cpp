@@ -0,0 +1,298 @@
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <utility>
+
+#if defined(__linux__)
+#include <cerrno>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#endif
+
+#include "asio/error.hpp"
+#include "asio/io_context.hpp"
+#include "asio/ip/tcp.hpp"
+
+#include "nhope/async/ao-context.h"
+#include "nhope/async/executor.h"
+#include "nhope/async/future.h"
+#include "nhope/io/io-device.h"
+#include "nhope/io/sock-addr.h"
+#include "nhope/io/tcp.h"
+
+#include "royalbed/common/detail/asio-socket.h"
+#include "royalbed/common/detail/io-uring.h"
+#include "royalbed/common/tcp.h"
+
+namespace royalbed::common {
+
+namespace {
+
+using Tcp = asio::ip::tcp;
+
+using detail::makeAsioError;
+
+nhope::SockAddr toSockAddr(const Tcp::endpoint& endpoint)
+{
+    const auto addr = endpoint.address();
+    if (addr.is_v4()) {
+        return nhope::SockAddr::ipv4(addr.to_string(), endpoint.port());
+    }
+    return nhope::SockAddr::ipv6(addr.to_string(), endpoint.port());
+}
+
+template<typename Socket>
+void setLinuxTcpOption([[maybe_unused]] Socket& sock, [[maybe_unused]] int option, [[maybe_unused]] int value)
+{
+#if defined(__linux__)
+    if (::setsockopt(sock.native_handle(), IPPROTO_TCP, option, &value, sizeof(value)) != 0) {
+        throw std::system_error(errno, std::system_category(), "setsockopt");
+    }
+#endif
+}
+
+template<typename Socket>
+void setBufferSizes(Socket& sock, const SocketOptions& options)
+{
+    if (options.sendBufferSize > 0) {
+        sock.set_option(asio::socket_base::send_buffer_size(options.sendBufferSize));
+    }
+    if (options.receiveBufferSize > 0) {
+        sock.set_option(asio::socket_base::receive_buffer_size(options.receiveBufferSize));
+    }
+}
+
+class TcpSocketImpl final : public detail::AsioStreamSocket<nhope::TcpSocket, Tcp::socket>
+{
+public:
+    using AsioStreamSocket::AsioStreamSocket;
+
+    [[nodiscard]] nhope::SockAddr localAddress() const override
+    {
+        return toSockAddr(m_sock.local_endpoint());
+    }
+
+    [[nodiscard]] nhope::SockAddr peerAddress() const override
+    {
+        return toSockAddr(m_sock.remote_endpoint());
+    }
+
+    void shutdown(Shutdown what) override
+    {
+        asio::error_code ec;
+        switch (what) {
+        case Shutdown::Receive:
+            m_sock.shutdown(Tcp::socket::shutdown_receive, ec);
+            break;
+        case Shutdown::Send:
+            m_sock.shutdown(Tcp::socket::shutdown_send, ec);
+            break;
+        case Shutdown::Both:
+            m_sock.shutdown(Tcp::socket::shutdown_both, ec);
+            break;
+        }
+    }
+};
+
+class TcpServerImpl final
+  : public nhope::TcpServer
+  , public detail::NativeSocket
+{
+public:
+    TcpServerImpl(nhope::AOContext& parent, const nhope::TcpServerParams& params, const SocketOptions& options)
+      : m_options(options)
+      , m_acceptor(parent.executor().ioCtx())
+      , m_aoCtx(parent)
+    {
+        Tcp::resolver resolver(parent.executor().ioCtx());
+        const auto endpoint =
+          resolver.resolve(params.address, std::to_string(params.port), Tcp::resolver::passive)->endpoint();
+
+        m_acceptor.open(endpoint.protocol());
+        m_acceptor.set_option(Tcp::acceptor::reuse_address(true));
+
+        // Accepted sockets inherit the buffer sizes of the listener,
+        // the receive window scale is negotiated in SYN so it has to be set before listen
+        setBufferSizes(m_acceptor, options);
+
+#if defined(__linux__)
+        if (options.deferAccept.count() > 0) {
+            setLinuxTcpOption(m_acceptor, TCP_DEFER_ACCEPT, static_cast<int>(options.deferAccept.count()));
+        }
+        if (options.fastOpen) {
+            setLinuxTcpOption(m_acceptor, TCP_FASTOPEN, options.fastOpenQueueLength);
+        }
+#endif
+
+        m_acceptor.bind(endpoint);
+        m_acceptor.listen(options.backlog > 0 ? options.backlog : asio::socket_base::max_listen_connections);
+    }
+
+    ~TcpServerImpl() override
+    {
+        m_aoCtx.close();
+
+        asio::error_code ec;
+        m_acceptor.close(ec);
+    }
+
+    nhope::Future<nhope::TcpSocketPtr> accept() override
+    {
+        auto promise = std::make_shared<nhope::Promise<nhope::TcpSocketPtr>>();
+        auto future = promise->future();
+
+        m_acceptor.async_accept(
+          [this, aoCtx = nhope::AOContextRef(m_aoCtx), promise](const asio::error_code& ec, Tcp::socket sock) mutable {
+              auto accepted = std::make_shared<Tcp::socket>(std::move(sock));
+              aoCtx.exec([this, promise, accepted, ec] {
+                  if (ec) {
+                      promise->setException(makeAsioError(ec));
+                      return;
+                  }
+
+                  asio::error_code optionError;
+                  accepted->set_option(Tcp::no_delay(m_options.noDelay), optionError);
+                  promise->setValue(std::make_unique<TcpSocketImpl>(m_aoCtx, std::move(*accepted)));
+              });
+          });
+
+        return future;
+    }
+
+    [[nodiscard]] nhope::SockAddr bindAddress() const override
+    {
+        return toSockAddr(m_acceptor.local_endpoint());
+    }
+
+    [[nodiscard]] int nativeHandle() noexcept override
+    {
+        return static_cast<int>(m_acceptor.native_handle());
+    }
+
+private:
+    SocketOptions m_options;
+    Tcp::acceptor m_acceptor;
+    nhope::AOContext m_aoCtx;
+};
+
+// Tries the resolved addresses one by one, the options are applied before every connect
+class Connector final : public std::enable_shared_from_this<Connector>
+{
+public:
+    Connector(nhope::AOContext& aoCtx, const SocketOptions& options)
+      : m_aoCtx(aoCtx)
+      , m_ctxRef(aoCtx)
+      , m_options(options)
+      , m_resolver(aoCtx.executor().ioCtx())
+      , m_sock(aoCtx.executor().ioCtx())
+    {}
+
+    nhope::Future<nhope::TcpSocketPtr> start(std::string_view hostName, std::uint16_t port)
+    {
+        auto future = m_promise.future();
+        m_resolver.async_resolve(std::string(hostName), std::to_string(port),
+                                 [self = shared_from_this()](const asio::error_code& ec, Tcp::resolver::results_type r) {
+                                     if (ec) {
+                                         self->fail(ec);
+                                         return;
+                                     }
+                                     self->m_endpoints = std::move(r);
+                                     self->m_next = self->m_endpoints.begin();
+                                     self->connectNext(asio::error::host_not_found);
+                                 });
+        return future;
+    }
+
+private:
+    void connectNext(const asio::error_code& lastError)
+    {
+        if (m_next == m_endpoints.end()) {
+            fail(lastError);
+            return;
+        }
+
+        const auto endpoint = (m_next++)->endpoint();
+        asio::error_code ec;
+        m_sock.close(ec);
+        m_sock.open(endpoint.protocol(), ec);
+        if (ec) {
+            connectNext(ec);
+            return;
+        }
+
+        try {
+            m_sock.set_option(Tcp::no_delay(m_options.noDelay));
+            setBufferSizes(m_sock, m_options);
+#if defined(__linux__) && defined(TCP_FASTOPEN_CONNECT)
+            if (m_options.fastOpen) {
+                setLinuxTcpOption(m_sock, TCP_FASTOPEN_CONNECT, 1);
+            }
+#endif
+        } catch (const std::system_error& e) {
+            fail(e.code());
+            return;
+        }
+
+        m_sock.async_connect(endpoint, [self = shared_from_this()](const asio::error_code& ec) {
+            if (ec) {
+                self->connectNext(ec);
+                return;
+            }
+            self->m_ctxRef.exec([self] {
+                self->m_promise.setValue(std::make_unique<TcpSocketImpl>(self->m_aoCtx, std::move(self->m_sock)));
+            });
+        });
+    }
+
+    void fail(const std::error_code& ec)
+    {
+        m_ctxRef.exec([self = shared_from_this(), ec] {
+            self->m_promise.setException(std::make_exception_ptr(std::system_error(ec)));
+        });
+    }
+
+    nhope::AOContext& m_aoCtx;
+    nhope::AOContextRef m_ctxRef;
+    SocketOptions m_options;
+    nhope::Promise<nhope::TcpSocketPtr> m_promise;
+    Tcp::resolver m_resolver;
+    Tcp::resolver::results_type m_endpoints;
+    Tcp::resolver::results_type::const_iterator m_next;
+    Tcp::socket m_sock;
+};
+
+}   // namespace
+
+nhope::TcpServerPtr startTcpServer(nhope::AOContext& aoCtx, const nhope::TcpServerParams& params,
+                                   const SocketOptions& options, IoBackend backend)
+{
+    if (backend == IoBackend::IoUring) {
+        return detail::startIoUringTcpServer(aoCtx, params, options);
+    }
+    return std::make_unique<TcpServerImpl>(aoCtx, params, options);
+}
+
+int nativeSocketHandle(nhope::TcpSocket& sock) noexcept
+{
+    auto* native = dynamic_cast<detail::NativeSocket*>(&sock);
+    return native != nullptr ? native->nativeHandle() : -1;
+}
+
+int nativeSocketHandle(nhope::TcpServer& server) noexcept
+{
+    auto* native = dynamic_cast<detail::NativeSocket*>(&server);
+    return native != nullptr ? native->nativeHandle() : -1;
+}
+
+nhope::Future<nhope::TcpSocketPtr> connectTcp(nhope::AOContext& aoCtx, std::string_view hostName, std::uint16_t port,
+                                              const SocketOptions& options)
+{
+    return std::make_shared<Connector>(aoCtx, options)->start(hostName, port);
+}
+
+}   // namespace royalbed::common
@@ -0,0 +1,170 @@
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <filesystem>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <utility>
+
+#include "asio/error.hpp"
+#include "asio/io_context.hpp"
+#include "asio/local/stream_protocol.hpp"
+
+#include "nhope/async/ao-context.h"
+#include "nhope/async/executor.h"
+#include "nhope/async/future.h"
+#include "nhope/io/io-device.h"
+
+#include "royalbed/common/detail/asio-socket.h"
+#include "royalbed/common/unix-socket.h"
+
+namespace royalbed::common {
+
+#if defined(ASIO_HAS_LOCAL_SOCKETS)
+
+namespace {
+
+using Protocol = asio::local::stream_protocol;
+
+bool isAbstract(std::string_view path)
+{
+    return !path.empty() && path.front() == '@';
+}
+
+Protocol::endpoint makeEndpoint(std::string_view path)
+{
+    if (isAbstract(path)) {
+        // The abstract namespace address starts with a zero byte
+        std::string name(path);
+        name.front() = '\0';
+        return Protocol::endpoint(name);
+    }
+    return Protocol::endpoint(std::string(path));
+}
+
+using detail::makeAsioError;
+
+class UnixSocketImpl final : public detail::AsioStreamSocket<UnixSocket, Protocol::socket>
+{
+public:
+    UnixSocketImpl(nhope::AOContext& parent, Protocol::socket&& sock, std::string path)
+      : AsioStreamSocket(parent, std::move(sock))
+      , m_path(std::move(path))
+    {}
+
+    [[nodiscard]] std::string path() const override
+    {
+        return m_path;
+    }
+
+private:
+    std::string m_path;
+};
+
+class UnixServerImpl final : public UnixServer
+{
+public:
+    UnixServerImpl(nhope::AOContext& parent, std::string_view path)
+      : m_path(path)
+      , m_acceptor(parent.executor().ioCtx())
+      , m_aoCtx(parent)
+    {
+        if (!isAbstract(path) && std::filesystem::is_socket(m_path)) {
+            std::filesystem::remove(m_path);
+        }
+
+        const auto endpoint = makeEndpoint(path);
+        m_acceptor.open(endpoint.protocol());
+        m_acceptor.bind(endpoint);
+        m_acceptor.listen();
+    }
+
+    ~UnixServerImpl() override
+    {
+        m_aoCtx.close();
+
+        asio::error_code ec;
+        m_acceptor.close(ec);
+        if (!isAbstract(m_path)) {
+            std::error_code removeError;
+            std::filesystem::remove(m_path, removeError);
+        }
+    }
+
+    nhope::Future<UnixSocketPtr> accept() override
+    {
+        auto promise = std::make_shared<nhope::Promise<UnixSocketPtr>>();
+        auto future = promise->future();
+
+        m_acceptor.async_accept([this, aoCtx = nhope::AOContextRef(m_aoCtx), promise](const asio::error_code& ec,
+                                                                                     Protocol::socket sock) mutable {
+            auto accepted = std::make_shared<Protocol::socket>(std::move(sock));
+            aoCtx.exec([this, promise, accepted, ec] {
+                if (ec) {
+                    promise->setException(makeAsioError(ec));
+                    return;
+                }
+                promise->setValue(std::make_unique<UnixSocketImpl>(m_aoCtx, std::move(*accepted), m_path));
+            });
+        });
+
+        return future;
+    }
+
+    [[nodiscard]] std::string path() const override
+    {
+        return m_path;
+    }
+
+private:
+    std::string m_path;
+    Protocol::acceptor m_acceptor;
+    nhope::AOContext m_aoCtx;
+};
+
+}   // namespace
+
+nhope::Future<UnixSocketPtr> UnixSocket::connect(nhope::AOContext& aoCtx, std::string_view path)
+{
+    auto promise = std::make_shared<nhope::Promise<UnixSocketPtr>>();
+    auto future = promise->future();
+
+    auto sock = std::make_shared<Protocol::socket>(aoCtx.executor().ioCtx());
+    sock->async_connect(makeEndpoint(path), [&aoCtx, ctxRef = nhope::AOContextRef(aoCtx), promise, sock,
+                                             path = std::string(path)](const asio::error_code& ec) mutable {
+        ctxRef.exec([&aoCtx, promise, sock, path, ec] {
+            if (ec) {
+                promise->setException(makeAsioError(ec));
+                return;
+            }
+            promise->setValue(std::make_unique<UnixSocketImpl>(aoCtx, std::move(*sock), path));
+        });
+    });
+
+    return future;
+}
+
+UnixServerPtr UnixServer::start(nhope::AOContext& aoCtx, std::string_view path)
+{
+    return std::make_unique<UnixServerImpl>(aoCtx, path);
+}
+
+#else
+
+nhope::Future<UnixSocketPtr> UnixSocket::connect(nhope::AOContext& /*aoCtx*/, std::string_view /*path*/)
+{
+    return nhope::makeExceptionalFuture<UnixSocketPtr>(
+      std::make_exception_ptr(std::runtime_error("Unix domain sockets are not supported on this platform")));
+}
+
+UnixServerPtr UnixServer::start(nhope::AOContext& /*aoCtx*/, std::string_view /*path*/)
+{
+    throw std::runtime_error("Unix domain sockets are not supported on this platform");
+}
+
+#endif
+
+}   // namespace royalbed::common
@@ -0,0 +1,431 @@
+#include <algorithm>
+#include <array>
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <map>
+#include <memory>
+#include <optional>
+#include <set>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <utility>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <gsl/span>
+
+#include "fmt/format.h"
+
+#include "royalbed/common/mime-type.h"
+#include "royalbed/server/asset-bundle.h"
+#include "royalbed/server/send-content.h"
+
+// Bundle layout, all integers are little-endian:
+//   header:  magic[8], u32 version, u32 asset count, u64 reserved
+//   index:   asset count entries sorted by path, each entry is
+//            u32 offset and u32 size of the path, content type, content encoding, etag, gzip etag strings,
+//            u64 offset and u64 size of the content and of the gzip variant (zero size and offset - no variant)
+//   strings: the strings of the index
+//   data:    contents, each one is aligned to dataAlignment
+// All offsets are from the beginning of the file.
+
+namespace royalbed::server {
+
+namespace detail {
+
+class MappedBundle final
+{
+public:
+    MappedBundle(void* mapping, std::size_t size)
+      : m_mapping(mapping)
+      , m_size(size)
+    {}
+
+    MappedBundle(const MappedBundle&) = delete;
+    MappedBundle& operator=(const MappedBundle&) = delete;
+
+    ~MappedBundle()
+    {
+        if (m_mapping != nullptr) {
+            ::munmap(m_mapping, m_size);
+        }
+    }
+
+    [[nodiscard]] gsl::span<const std::uint8_t> bytes() const noexcept
+    {
+        return {static_cast<const std::uint8_t*>(m_mapping), m_size};
+    }
+
+    std::vector<Asset> assets;
+
+private:
+    void* m_mapping;
+    std::size_t m_size;
+};
+
+}   // namespace detail
+
+namespace {
+
+namespace fs = std::filesystem;
+using namespace std::literals;
+
+constexpr auto magic = "RBBUNDLE"sv;
+constexpr std::uint32_t version = 1;
+constexpr std::size_t headerSize = 24;
+constexpr std::size_t stringCount = 5;
+constexpr std::size_t entrySize = stringCount * 8 + 4 * 8;
+constexpr std::size_t dataAlignment = 64;
+
+[[noreturn]] void throwBadBundle(const fs::path& path, std::string_view reason)
+{
+    throw std::runtime_error(fmt::format("Invalid asset bundle {}: {}", path.string(), reason));
+}
+
+template<typename T>
+T readLE(gsl::span<const std::uint8_t> bytes, std::size_t offset)
+{
+    T value = 0;
+    for (std::size_t i = 0; i < sizeof(T); ++i) {
+        value |= static_cast<T>(bytes[offset + i]) << (8 * i);
+    }
+    return value;
+}
+
+template<typename T>
+void writeLE(std::string& out, T value)
+{
+    for (std::size_t i = 0; i < sizeof(T); ++i) {
+        out.push_back(static_cast<char>((value >> (8 * i)) & 0xff));   // NOLINT(readability-magic-numbers)
+    }
+}
+
+class IndexReader final
+{
+public:
+    IndexReader(gsl::span<const std::uint8_t> bytes, const fs::path& path)
+      : m_bytes(bytes)
+      , m_path(path)
+    {}
+
+    Asset read(std::size_t index)
+    {
+        m_offset = headerSize + index * entrySize;
+
+        Asset asset;
+        asset.path = this->string();
+        asset.contentType = this->string();
+        asset.content.contentEncoding = this->string();
+        asset.content.etag = this->string();
+        const auto gzipEtag = this->string();
+        asset.content.data = this->data();
+        const auto gzipData = this->data();
+        if (gzipData.data() != nullptr) {
+            asset.gzip = AssetVariant{.data = gzipData, .contentEncoding = "gzip"sv, .etag = gzipEtag};
+        }
+        return asset;
+    }
+
+private:
+    gsl::span<const std::uint8_t> range(std::uint64_t offset, std::uint64_t size)
+    {
+        if (offset > m_bytes.size() || size > m_bytes.size() - offset) {
+            throwBadBundle(m_path, "an entry is out of the file");
+        }
+        return m_bytes.subspan(static_cast<std::size_t>(offset), static_cast<std::size_t>(size));
+    }
+
+    std::string_view string()
+    {
+        const auto offset = readLE<std::uint32_t>(m_bytes, m_offset);
+        const auto size = readLE<std::uint32_t>(m_bytes, m_offset + 4);
+        m_offset += 8;
+        const auto str = this->range(offset, size);
+        // NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast)
+        return {reinterpret_cast<const char*>(str.data()), str.size()};
+    }
+
+    gsl::span<const std::uint8_t> data()
+    {
+        const auto offset = readLE<std::uint64_t>(m_bytes, m_offset);
+        const auto size = readLE<std::uint64_t>(m_bytes, m_offset + 8);
+        m_offset += 16;
+        if (offset == 0) {
+            return {};
+        }
+        return this->range(offset, size);
+    }
+
+    gsl::span<const std::uint8_t> m_bytes;
+    const fs::path& m_path;
+    std::size_t m_offset = 0;
+};
+
+std::shared_ptr<detail::MappedBundle> mapBundle(const fs::path& path)
+{
+    // NOLINTNEXTLINE(cppcoreguidelines-pro-type-vararg)
+    const int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        throw std::system_error(errno, std::generic_category(), "open " + path.string());
+    }
+
+    struct stat st = {};
+    void* mapping = nullptr;
+    if (::fstat(fd, &st) == 0 && st.st_size > 0) {
+        mapping = ::mmap(nullptr, static_cast<std::size_t>(st.st_size), PROT_READ, MAP_SHARED, fd, 0);
+    }
+    const int err = errno;
+    ::close(fd);
+    if (mapping == nullptr || mapping == MAP_FAILED) {
+        if (st.st_size == 0) {
+            throwBadBundle(path, "the file is empty");
+        }
+        throw std::system_error(err, std::generic_category(), "mmap " + path.string());
+    }
+    return std::make_shared<detail::MappedBundle>(mapping, static_cast<std::size_t>(st.st_size));
+}
+
+// Builder
+
+struct SourceFile
+{
+    std::optional<fs::path> plain;
+    std::optional<fs::path> gzip;
+};
+
+std::string readFile(const fs::path& path)
+{
+    std::ifstream in(path, std::ios::binary);
+    std::string content{std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>()};
+    if (in.bad() || !in.is_open()) {
+        throw std::runtime_error(fmt::format("Failed to read {}", path.string()));
+    }
+    return content;
+}
+
+std::string etagOf(std::string_view content)
+{
+    // NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast)
+    return contentETag(gsl::span(reinterpret_cast<const std::uint8_t*>(content.data()), content.size()));
+}
+
+std::map<std::string, SourceFile> collectSources(const fs::path& baseDir, const std::vector<fs::path>& files)
+{
+    std::set<std::string> paths;
+    for (const auto& file : files) {
+        auto path = fs::absolute(file).lexically_normal().lexically_relative(fs::absolute(baseDir).lexically_normal());
+        if (path.empty() || *path.begin() == "..") {
+            throw std::runtime_error(fmt::format("{} is out of {}", file.string(), baseDir.string()));
+        }
+        paths.insert(path.generic_string());
+    }
+
+    std::map<std::string, SourceFile> sources;
+    for (const auto& path : paths) {
+        const auto file = baseDir / path;
+        if (path.ends_with(".gz"sv)) {
+            auto plainPath = path.substr(0, path.size() - 3);
+            auto& source = sources[paths.contains(plainPath) ? std::move(plainPath) : path];
+            source.gzip = file;
+        } else {
+            sources[path].plain = file;
+        }
+    }
+    return sources;
+}
+
+class BundleWriter final
+{
+public:
+    void add(const std::string& path, const SourceFile& source)
+    {
+        auto& entry = m_entries.emplace_back();
+        if (source.plain.has_value()) {
+            entry.path = path;
+            entry.content = readFile(*source.plain);
+            if (source.gzip.has_value()) {
+                entry.gzip = readFile(*source.gzip);
+            }
+        } else {
+            // Only the compressed file, it is always sent compressed
+            entry.path = path.substr(0, path.size() - 3);
+            entry.contentEncoding = "gzip";
+            entry.content = readFile(*source.gzip);
+        }
+        entry.contentType = common::mimeTypeForFileName(entry.path);
+    }
+
+    std::string finish()
+    {
+        std::sort(m_entries.begin(), m_entries.end(), [](const auto& a, const auto& b) {
+            return a.path < b.path;
+        });
+
+        std::string strings;
+        const auto indexEnd = headerSize + m_entries.size() * entrySize;
+        auto addString = [&](std::string& index, std::string_view str) {
+            writeLE(index, static_cast<std::uint32_t>(indexEnd + strings.size()));
+            writeLE(index, static_cast<std::uint32_t>(str.size()));
+            strings += str;
+        };
+
+        std::string index;
+        for (const auto& entry : m_entries) {
+            addString(index, entry.path);
+            addString(index, entry.contentType);
+            addString(index, entry.contentEncoding);
+            addString(index, etagOf(entry.content));
+            addString(index, entry.gzip.has_value() ? etagOf(*entry.gzip) : std::string());
+        }
+
+        // Data offsets are known after the strings
+        std::string data;
+        std::uint64_t dataStart = align(indexEnd + strings.size());
+        auto addData = [&](std::string& out, std::string_view content) {
+            data.resize(align(data.size()));
+            writeLE(out, static_cast<std::uint64_t>(dataStart + data.size()));
+            writeLE(out, static_cast<std::uint64_t>(content.size()));
+            data += content;
+        };
+
+        std::string dataIndex;
+        for (const auto& entry : m_entries) {
+            addData(dataIndex, entry.content);
+            if (entry.gzip.has_value()) {
+                addData(dataIndex, *entry.gzip);
+            } else {
+                writeLE(dataIndex, std::uint64_t{0});
+                writeLE(dataIndex, std::uint64_t{0});
+            }
+        }
+
+        std::string out(magic);
+        writeLE(out, version);
+        writeLE(out, static_cast<std::uint32_t>(m_entries.size()));
+        writeLE(out, std::uint64_t{0});
+        for (std::size_t i = 0; i < m_entries.size(); ++i) {
+            constexpr std::size_t stringsPart = stringCount * 8;
+            out.append(index, i * stringsPart, stringsPart);
+            out.append(dataIndex, i * (entrySize - stringsPart), entrySize - stringsPart);
+        }
+        out += strings;
+        out.resize(dataStart);
+        out += data;
+        return out;
+    }
+
+private:
+    struct Entry
+    {
+        std::string path;
+        std::string contentType;
+        std::string contentEncoding;
+        std::string content;
+        std::optional<std::string> gzip;
+    };
+
+    static std::uint64_t align(std::uint64_t offset)
+    {
+        return (offset + dataAlignment - 1) / dataAlignment * dataAlignment;
+    }
+
+    std::vector<Entry> m_entries;
+};
+
+}   // namespace
+
+AssetBundle::AssetBundle(std::shared_ptr<const detail::MappedBundle> bundle)
+  : m_bundle(std::move(bundle))
+{}
+
+AssetBundle AssetBundle::open(const std::filesystem::path& path)
+{
+    auto bundle = mapBundle(path);
+    const auto bytes = bundle->bytes();
+    if (bytes.size() < headerSize || !std::equal(magic.begin(), magic.end(), bytes.begin())) {
+        throwBadBundle(path, "no bundle header");
+    }
+    if (readLE<std::uint32_t>(bytes, magic.size()) != version) {
+        throwBadBundle(path, "unsupported version");
+    }
+
+    const auto count = readLE<std::uint32_t>(bytes, magic.size() + 4);
+    if (count > (bytes.size() - headerSize) / entrySize) {
+        throwBadBundle(path, "the index is out of the file");
+    }
+
+    IndexReader reader(bytes, path);
+    bundle->assets.reserve(count);
+    for (std::size_t i = 0; i < count; ++i) {
+        auto asset = reader.read(i);
+        if (!bundle->assets.empty() && bundle->assets.back().path >= asset.path) {
+            throwBadBundle(path, "the index is not sorted");
+        }
+        bundle->assets.push_back(asset);
+    }
+    return AssetBundle(std::move(bundle));
+}
+
+void AssetBundle::build(const std::filesystem::path& output, const std::filesystem::path& baseDir,
+                        const std::vector<std::filesystem::path>& files)
+{
+    BundleWriter writer;
+    for (const auto& [path, source] : collectSources(baseDir, files)) {
+        writer.add(path, source);
+    }
+    const auto content = writer.finish();
+
+    // The bundle is replaced atomically: a running server keeps the mapping of the old file intact
+    auto temp = output;
+    temp += ".tmp";
+    std::ofstream out(temp, std::ios::binary | std::ios::trunc);
+    out.write(content.data(), static_cast<std::streamsize>(content.size()));
+    out.close();
+    if (!out) {
+        std::error_code ec;
+        std::filesystem::remove(temp, ec);
+        throw std::runtime_error(fmt::format("Failed to write {}", temp.string()));
+    }
+
+    std::error_code ec;
+    std::filesystem::rename(temp, output, ec);
+    if (ec) {
+        std::filesystem::remove(temp, ec);
+        throw std::runtime_error(fmt::format("Failed to replace {}", output.string()));
+    }
+}
+
+gsl::span<const Asset> AssetBundle::assets() const noexcept
+{
+    return m_bundle->assets;
+}
+
+const Asset* AssetBundle::find(std::string_view path) const noexcept
+{
+    const auto& assets = m_bundle->assets;
+    const auto it = std::lower_bound(assets.begin(), assets.end(), path, [](const Asset& asset, std::string_view p) {
+        return asset.path < p;
+    });
+    if (it == assets.end() || it->path != path) {
+        return nullptr;
+    }
+    return &*it;
+}
+
+std::shared_ptr<const void> AssetBundle::owner() const noexcept
+{
+    return m_bundle;
+}
+
+}   // namespace royalbed::server
@@ -0,0 +1,171 @@
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <exception>
+#include <filesystem>
+#include <memory>
+#include <system_error>
+#include <utility>
+#include <vector>
+
+#include "nhope/async/ao-context.h"
+#include "nhope/async/future.h"
+#include "nhope/async/thread-pool-executor.h"
+#include "nhope/io/io-device.h"
+#include "nhope/io/string-reader.h"
+
+#include "royalbed/server/body-stream.h"
+#include "royalbed/server/request-context.h"
+
+namespace royalbed::server {
+namespace {
+
+struct FileCloser final
+{
+    void operator()(std::FILE* file) const noexcept
+    {
+        std::fclose(file);   // NOLINT(cppcoreguidelines-owning-memory)
+    }
+};
+using FilePtr = std::unique_ptr<std::FILE, FileCloser>;
+
+// Runs a file operation on the worker thread pool so that a slow disk does not stall the AO thread
+template<typename Fn>
+nhope::Future<void> execOnPool(Fn fn)
+{
+    auto promise = std::make_shared<nhope::Promise<void>>();
+    nhope::ThreadPoolExecutor::defaultExecutor().exec([promise, fn = std::move(fn)]() mutable {
+        try {
+            fn();
+            promise->setValue();
+        } catch (...) {
+            promise->setException(std::current_exception());
+        }
+    });
+    return promise->future();
+}
+
+// Opens, writes and closes the file on the worker thread pool.
+// The file is shared with the operation in progress, only one runs at a time.
+class FileWritter final : public nhope::Writter
+{
+    struct File
+    {
+        std::filesystem::path path;
+        FilePtr ptr;
+    };
+
+public:
+    FileWritter(nhope::AOContext& parent, std::filesystem::path filePath)
+      : m_file(std::make_shared<File>(File{.path = std::move(filePath), .ptr = nullptr}))
+      , m_aoCtx(parent)
+    {}
+
+    FileWritter(const FileWritter&) = delete;
+    FileWritter& operator=(const FileWritter&) = delete;
+
+    // After a failure the file is still open: the last reference is dropped on the worker pool too
+    ~FileWritter() override
+    {
+        nhope::ThreadPoolExecutor::defaultExecutor().exec([file = std::move(m_file)] {});
+    }
+
+    nhope::Future<void> open()
+    {
+        return execOnPool([file = m_file] {
+            file->ptr.reset(std::fopen(file->path.c_str(), "wb"));   // NOLINT(cppcoreguidelines-owning-memory)
+            if (file->ptr == nullptr) {
+                throw std::system_error(errno, std::generic_category(), "open " + file->path.string());
+            }
+        });
+    }
+
+    void write(gsl::span<const std::uint8_t> data, nhope::IOHandler handler) override
+    {
+        // The data is copied: the caller's buffer may be released when the writer is closed
+        nhope::ThreadPoolExecutor::defaultExecutor().exec(
+          [file = m_file, data = std::vector<std::uint8_t>(data.begin(), data.end()),
+           aoCtx = nhope::AOContextRef(m_aoCtx), handler = std::move(handler)]() mutable {
+              const auto n = std::fwrite(data.data(), 1, data.size(), file->ptr.get());
+              std::exception_ptr err;
+              if (n != data.size()) {
+                  err = std::make_exception_ptr(
+                    std::system_error(errno, std::generic_category(), "write to " + file->path.string()));
+              }
+
+              aoCtx.exec([handler = std::move(handler), err = std::move(err), n] {
+                  handler(err, n);
+              });
+          });
+    }
+
+    // A failed flush of the buffered tail must not leave a truncated file reported as saved
+    nhope::Future<void> close()
+    {
+        return execOnPool([file = m_file] {
+            const bool flushed = std::fflush(file->ptr.get()) == 0;
+            const int flushErr = errno;
+            if (std::fclose(file->ptr.release()) != 0 || !flushed) {   // NOLINT(cppcoreguidelines-owning-memory)
+                throw std::system_error(flushed ? errno : flushErr, std::generic_category(),
+                                        "write to " + file->path.string());
+            }
+        });
+    }
+
+private:
+    std::shared_ptr<File> m_file;
+    nhope::AOContext m_aoCtx;
+};
+
+}   // namespace
+
+BodyStream::BodyStream(RequestContext& ctx)
+  : m_aoCtx(&ctx.aoCtx)
+{
+    if (ctx.request.body == nullptr) {
+        ctx.request.body = nhope::StringReader::create(ctx.aoCtx, {});
+    }
+    m_reader = ctx.request.body.get();
+}
+
+nhope::Reader& BodyStream::reader() const noexcept
+{
+    return *m_reader;
+}
+
+nhope::Future<std::size_t> BodyStream::read(gsl::span<std::uint8_t> buf) const
+{
+    auto promise = std::make_shared<nhope::Promise<std::size_t>>();
+    m_reader->read(buf, [promise](std::exception_ptr err, std::size_t n) {
+        if (err) {
+            promise->setException(std::move(err));
+            return;
+        }
+        promise->setValue(n);
+    });
+    return promise->future();
+}
+
+nhope::Future<std::size_t> BodyStream::pipeTo(nhope::Writter& dest) const
+{
+    return nhope::copy(*m_reader, dest);
+}
+
+nhope::Future<std::size_t> BodyStream::saveToFile(const std::filesystem::path& filePath) const
+{
+    // The future is resolved after the file is closed, so the caller sees the saved file
+    auto file = std::make_shared<FileWritter>(*m_aoCtx, filePath);
+    return file->open()
+      .then(*m_aoCtx,
+            [reader = m_reader, file] {
+                return nhope::copy(*reader, *file);
+            })
+      .then(*m_aoCtx, [file](std::size_t n) {
+          return file->close().then([n] {
+              return n;
+          });
+      });
+}
+
+}   // namespace royalbed::server
@@ -0,0 +1,90 @@
+#include <algorithm>
+#include <charconv>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string_view>
+#include <system_error>
+#include <vector>
+
+#include "royalbed/common/detail/string-utils.h"
+#include "royalbed/server/detail/byte-ranges.h"
+
+namespace royalbed::server::detail {
+
+namespace {
+
+using namespace std::literals;
+using common::detail::trim;
+
+std::optional<std::uint64_t> parsePosition(std::string_view str)
+{
+    std::uint64_t value = 0;
+    const auto* end = str.data() + str.size();
+    const auto [ptr, ec] = std::from_chars(str.data(), end, value);
+    if (str.empty() || ec != std::errc() || ptr != end) {
+        return std::nullopt;
+    }
+    return value;
+}
+
+}   // namespace
+
+std::optional<std::vector<ByteRange>> parseByteRanges(std::string_view value, std::uint64_t size)
+{
+    value = trim(value);
+    const auto eq = value.find('=');
+    if (eq == std::string_view::npos || common::detail::toLower(trim(value.substr(0, eq))) != "bytes"sv) {
+        return std::nullopt;
+    }
+    value.remove_prefix(eq + 1);
+
+    std::vector<ByteRange> ranges;
+    std::size_t specCount = 0;
+    while (!value.empty()) {
+        const auto comma = std::min(value.find(','), value.size());
+        const auto spec = trim(value.substr(0, comma));
+        value.remove_prefix(std::min(comma + 1, value.size()));
+        if (spec.empty()) {
+            continue;
+        }
+        if (++specCount > maxByteRanges) {
+            return std::nullopt;
+        }
+
+        const auto dash = spec.find('-');
+        if (dash == std::string_view::npos) {
+            return std::nullopt;
+        }
+
+        if (dash == 0) {
+            // The last N bytes
+            const auto suffix = parsePosition(spec.substr(1));
+            if (!suffix.has_value()) {
+                return std::nullopt;
+            }
+            if (*suffix > 0 && size > 0) {
+                const auto length = std::min(*suffix, size);
+                ranges.push_back({.offset = size - length, .length = length});
+            }
+            continue;
+        }
+
+        const auto first = parsePosition(spec.substr(0, dash));
+        const auto lastStr = spec.substr(dash + 1);
+        const auto last = lastStr.empty() ? std::optional<std::uint64_t>(size - 1) : parsePosition(lastStr);
+        if (!first.has_value() || !last.has_value() || (!lastStr.empty() && *last < *first)) {
+            return std::nullopt;
+        }
+        if (*first < size) {
+            ranges.push_back({.offset = *first, .length = std::min(*last, size - 1) - *first + 1});
+        }
+    }
+
+    if (specCount == 0) {
+        return std::nullopt;
+    }
+    return ranges;
+}
+
+}   // namespace royalbed::server::detail
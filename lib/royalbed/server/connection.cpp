@@ -1,8 +1,12 @@
+#include <algorithm>
 #include <cassert>
 #include <chrono>
 #include <cstdint>
+#include <exception>
 #include <memory>
 #include <optional>
+#include <string>
+#include <utility>
 
 #include "nhope/async/timer.h"
 #include "nhope/io/tcp.h"
@@ -13,16 +17,24 @@
 
 #include "nhope/async/ao-context-close-handler.h"
 #include "nhope/async/ao-context.h"
+#include "nhope/async/future.h"
 #include "nhope/io/io-device.h"
-#include "nhope/io/pushback-reader.h"
 
+#include "royalbed/common/detail/connection-buffer.h"
 #include "royalbed/common/detail/uptime.h"
-#include "royalbed/server/detail/session.h"
 #include "royalbed/server/detail/connection.h"
+#include "royalbed/server/detail/http2-connection.h"
+#include "royalbed/server/detail/http2-frame.h"
+#include "royalbed/server/detail/session.h"
+#include "royalbed/server/detail/timer-wheel.h"
+#include "royalbed/server/detail/tls-stream.h"
 
 namespace royalbed::server::detail {
 namespace {
 
+using common::detail::ConnectionBuffer;
+using common::detail::ConnectionBufferPtr;
+
 class Connection final
   : public nhope::AOContextCloseHandler
   , public SessionCtx
@@ -33,9 +45,18 @@ public:
       , m_log(std::move(params.log))
       , m_ctx(params.ctx)
       , m_sock(std::move(params.sock))
+      , m_tlsCtx(std::move(params.tls))
       , m_leftRequests(params.keepAlive.requestsCount > 0 ? params.keepAlive.requestsCount : 1)
+      , m_keepAlive(params.keepAlive)
+      , m_expiresAt(std::chrono::steady_clock::now() + params.keepAlive.timeout)
+      , m_http2(params.http2)
+      , m_timeouts(params.timeouts)
+      , m_limits(params.limits)
+      , m_timers(params.timers)
       , m_upTime(m_log, "connection time:")
       , m_aoCtx(parent)
+      , m_deadline(m_timers, m_aoCtx)
+      , m_bodyDeadline(m_timers, m_aoCtx)
     {
         nhope::setTimeout(m_aoCtx, params.keepAlive.timeout, [this](auto) {
             processTimeout();
@@ -43,8 +64,11 @@ public:
 
         m_aoCtx.startCancellableTask(
           [this] {
-              m_sessionIn = nhope::PushbackReader::create(m_aoCtx, *m_sock);
-              this->startSession();
+              if (m_tlsCtx != nullptr) {
+                  this->startTls();
+              } else {
+                  this->startHttp(false);
+              }
           },
           *this);
     }
@@ -61,6 +85,21 @@ private:
         if (m_haveActiveSession) {
             return;
         }
+        if (m_tlsCtx != nullptr && !m_tlsEstablished) {
+            m_aoCtx.close();
+            return;
+        }
+        this->closeWithRequestTimeout();
+    }
+
+    void closeWithRequestTimeout()
+    {
+        if (m_requestTimeoutSent) {
+            return;
+        }
+        m_requestTimeoutSent = true;
+        m_leftRequests = 0;
+
         constexpr auto incomingRequestTimeout = std::chrono::seconds(2);
         // TODO use nhope::race (not implemented yet)
         nhope::setTimeout(m_aoCtx, incomingRequestTimeout, [this](auto) {
@@ -73,7 +112,7 @@ private:
                                .headers = {{"Connection", "close"}},
                                .body = nullptr,
                              },
-                             *m_sock)
+                             this->io())
           .then(m_aoCtx, [this](auto) {
               m_aoCtx.close();
           });
@@ -96,6 +135,49 @@ private:
         m_haveActiveSession = true;
     }
 
+    void sessionStage(std::uint32_t /*sessionNum*/, SessionStage stage) noexcept override
+    {
+        switch (stage) {
+        case SessionStage::WaitRequest:
+            m_deadline.arm(m_timeouts.idle, [this] {
+                m_log->debug("idle timeout");
+                m_aoCtx.close();
+            });
+            break;
+        case SessionStage::ReceiveHeaders:
+            m_deadline.arm(m_timeouts.header, [this] {
+                m_log->debug("request header timeout");
+                this->closeWithRequestTimeout();
+            });
+            break;
+        case SessionStage::ProcessRequest:
+            m_deadline.arm(m_timeouts.handler, [this] {
+                m_log->debug("request handler timeout");
+                m_aoCtx.close();
+            });
+            break;
+        case SessionStage::SendResponse:
+            m_deadline.arm(m_timeouts.write, [this] {
+                m_log->debug("response write timeout");
+                m_aoCtx.close();
+            });
+            break;
+        }
+    }
+
+    void sessionBodyWait(std::uint32_t /*sessionNum*/, bool waiting) noexcept override
+    {
+        if (!waiting) {
+            m_bodyDeadline.cancel();
+            return;
+        }
+
+        m_bodyDeadline.arm(m_timeouts.bodyRead, [this] {
+            m_log->debug("request body timeout");
+            m_aoCtx.close();
+        });
+    }
+
     bool sessionNeedClose() noexcept override
     {
         return m_leftRequests == 0;
@@ -104,6 +186,8 @@ private:
     void sessionFinished(std::uint32_t sessionNum, bool keepAlive) noexcept override
     {
         m_haveActiveSession = false;
+        m_deadline.cancel();
+        m_bodyDeadline.cancel();
         m_ctx.sessionFinished(sessionNum);
         m_log->trace("The session with num={} finished", sessionNum);
 
@@ -118,6 +202,173 @@ private:
         }
     }
 
+    void sessionUpgraded(std::uint32_t sessionNum, UpgradeHandler upgrade) noexcept override
+    {
+        // The connection no longer serves HTTP and lives until the upgrade handler finishes
+        m_leftRequests = 0;
+        m_deadline.cancel();
+        m_bodyDeadline.cancel();
+        m_ctx.sessionFinished(sessionNum);
+        m_log->trace("The session with num={} upgraded the connection", sessionNum);
+
+        try {
+            upgrade(m_aoCtx, *m_sessionIn, this->io())
+              .then(m_aoCtx,
+                    [this] {
+                        m_aoCtx.close();
+                    })
+              .fail(m_aoCtx, [this](auto /*unused*/) {
+                  m_aoCtx.close();
+              });
+        } catch (...) {
+            m_aoCtx.close();
+        }
+    }
+
+    UpgradeHandler sessionH2cUpgrade(Request& request) override
+    {
+        // Over TLS HTTP/2 is only negotiated with ALPN
+        if (!m_http2.enabled || m_tlsCtx != nullptr) {
+            return nullptr;
+        }
+
+        auto settings = h2cUpgradeSettings(request);
+        if (!settings.has_value()) {
+            return nullptr;
+        }
+
+        auto upgradeRequest = std::make_shared<Request>(std::move(request));
+        return [this, upgradeRequest, settings = std::move(*settings)](nhope::AOContext& /*aoCtx*/,
+                                                                       nhope::Reader& /*in*/, nhope::Writter& /*out*/) {
+            return this->serveHttp2(std::move(*upgradeRequest), settings);
+        };
+    }
+
+    nhope::IODevice& io()
+    {
+        if (m_tls != nullptr) {
+            return *m_tls;
+        }
+        return *m_sock;
+    }
+
+    void startTls()
+    {
+        nhope::setTimeout(m_aoCtx, m_tlsCtx->handshakeTimeout(), [this](auto) {
+            if (!m_tlsEstablished) {
+                m_log->debug("TLS handshake timeout");
+                m_aoCtx.close();
+            }
+        });
+
+        try {
+            m_tls = makeTlsStream(m_aoCtx, m_tlsCtx, *m_sock);
+        } catch (const std::exception& e) {
+            m_log->error("{}", e.what());
+            m_aoCtx.close();
+            return;
+        }
+
+        m_tls->handshake()
+          .then(m_aoCtx,
+                [this] {
+                    m_tlsEstablished = true;
+                    this->startHttp(m_tls->alpnProtocol() == "h2");
+                })
+          .fail(m_aoCtx, [this](auto ex) {
+              try {
+                  std::rethrow_exception(std::move(ex));
+              } catch (const std::exception& e) {
+                  m_log->debug("{}", e.what());
+              }
+              m_aoCtx.close();
+          });
+    }
+
+    void startHttp(bool http2)
+    {
+        m_sessionIn = ConnectionBuffer::create(m_aoCtx, this->io());
+        if (http2) {
+            this->startHttp2();
+        } else if (m_http2.enabled && m_tlsCtx == nullptr) {
+            m_deadline.arm(m_timeouts.idle, [this] {
+                m_log->debug("idle timeout");
+                m_aoCtx.close();
+            });
+            this->detectHttp2();
+        } else {
+            this->startSession();
+        }
+    }
+
+    // A client with prior knowledge starts the connection with the HTTP/2 preface
+    void detectHttp2()
+    {
+        m_sessionIn->fill([this, aoCtx = nhope::AOContextRef(m_aoCtx)](std::exception_ptr err, std::size_t n) mutable {
+            aoCtx.exec([this, err = std::move(err), n] {
+                if (err || n == 0) {
+                    m_aoCtx.close();
+                    return;
+                }
+
+                // The first bytes stay buffered for the session or the HTTP/2 connection
+                if (!startsWithHttp2Preface(m_sessionIn->data())) {
+                    this->startSession();
+                    return;
+                }
+
+                this->startHttp2();
+            });
+        });
+    }
+
+    void startHttp2()
+    {
+        this->serveHttp2(std::nullopt, {})
+          .then(m_aoCtx,
+                [this] {
+                    m_aoCtx.close();
+                })
+          .fail(m_aoCtx, [this](auto ex) {
+              try {
+                  std::rethrow_exception(std::move(ex));
+              } catch (const std::exception& e) {
+                  m_log->debug("{}", e.what());
+              }
+              m_aoCtx.close();
+          });
+    }
+
+    nhope::Future<void> serveHttp2(std::optional<Request> upgradeRequest, std::string upgradeSettings)
+    {
+        m_leftRequests = 0;
+        m_haveActiveSession = true;
+        m_deadline.cancel();
+        m_log->trace("The connection switched to HTTP/2");
+
+        // The keep-alive time is counted from the start of the connection
+        const auto left = std::chrono::ceil<std::chrono::seconds>(m_expiresAt - std::chrono::steady_clock::now());
+
+        return detail::serveHttp2(m_aoCtx, {
+                                              .num = m_num,
+                                              .ctx = m_ctx,
+                                              .log = m_log,
+                                              .http2 = m_http2,
+                                              .in = *m_sessionIn,
+                                              .out = this->io(),
+                                              .upgradeRequest = std::move(upgradeRequest),
+                                              .upgradeSettings = std::move(upgradeSettings),
+                                              .limits = m_limits,
+                                              .timers = m_timers,
+                                              .timeouts = m_timeouts,
+                                              .keepAlive =
+                                                {
+                                                  .timeout = std::max(left, std::chrono::seconds(1)),
+                                                  .requestsCount = m_keepAlive.requestsCount,
+                                                },
+                                            });
+    }
+
     void startSession()
     {
         assert(m_leftRequests > 0);   // NOLINT
@@ -129,8 +380,9 @@ private:
                                         .num = sessionNum,
                                         .ctx = *this,
                                         .in = *m_sessionIn,
-                                        .out = *m_sock,
+                                        .out = this->io(),
                                         .log = std::move(sessionLog),
+                                        .limits = m_limits,
                                       });
     }
 
@@ -139,15 +391,31 @@ private:
     std::shared_ptr<spdlog::logger> m_log;
     ConnectionCtx& m_ctx;
 
-    nhope::TcpSocketPtr m_sock;
-    nhope::PushbackReaderPtr m_sessionIn;
+    nhope::IODevicePtr m_sock;
+    TlsContextPtr m_tlsCtx;
+    TlsStreamPtr m_tls;
+    bool m_tlsEstablished{};
+    ConnectionBufferPtr m_sessionIn;
 
     std::uint32_t m_leftRequests;
+    const KeepAliveParams m_keepAlive;
+    const std::chrono::steady_clock::time_point m_expiresAt;
     bool m_haveActiveSession{};
+    bool m_requestTimeoutSent{};
+
+    Http2Params m_http2;
+
+    Timeouts m_timeouts;
+    RequestLimits m_limits;
+    TimerWheelPtr m_timers;
 
     royalbed::common::detail::UpTimeLogger m_upTime;
 
     nhope::AOContext m_aoCtx;
+
+    // Declared after m_aoCtx they are bound to
+    Deadline m_deadline;
+    Deadline m_bodyDeadline;
 };
 
 }   // namespace
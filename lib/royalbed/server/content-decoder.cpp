@@ -0,0 +1,441 @@
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include <gsl/span>
+
+#ifdef ROYALBED_ZLIB_ENABLED
+#include <zlib.h>
+#endif
+
+#ifdef ROYALBED_BROTLI_ENABLED
+#include <brotli/decode.h>
+#endif
+
+#include "nhope/async/ao-context.h"
+#include "nhope/io/io-device.h"
+
+#include "royalbed/common/detail/string-utils.h"
+#include "royalbed/server/detail/content-decoder.h"
+#include "royalbed/server/error.h"
+#include "royalbed/server/http-status.h"
+
+namespace royalbed::server::detail {
+
+namespace {
+
+using namespace std::literals;
+
+constexpr std::size_t inputBufSize = 16 * 1024;
+
+[[noreturn]] void corruptedBody()
+{
+    throw HttpError(HttpStatus::BadRequest, "Corrupted compressed body");
+}
+
+class Codec
+{
+public:
+    struct Result
+    {
+        std::size_t consumed;
+        std::size_t produced;
+        bool finished;
+    };
+
+    virtual ~Codec() = default;
+
+    // Throws HttpError(BadRequest) if the input is corrupted
+    virtual Result decode(gsl::span<const std::uint8_t> input, gsl::span<std::uint8_t> output) = 0;
+
+    // Prepares the codec for the next member of a concatenated stream after the current one is finished.
+    // false - the format has a single member
+    virtual bool nextMember()
+    {
+        return false;
+    }
+};
+
+using CodecPtr = std::unique_ptr<Codec>;
+
+#ifdef ROYALBED_ZLIB_ENABLED
+
+// The inflate state with its 32 KiB window is reset and reused by the next compressed request
+class InflatePool final
+{
+public:
+    using Stream = std::unique_ptr<z_stream>;
+
+    InflatePool() = default;
+    InflatePool(const InflatePool&) = delete;
+    InflatePool& operator=(const InflatePool&) = delete;
+
+    ~InflatePool()
+    {
+        for (auto& stream : m_free) {
+            inflateEnd(stream.get());
+        }
+    }
+
+    static InflatePool& instance()
+    {
+        static InflatePool pool;
+        return pool;
+    }
+
+    Stream acquire(int windowBits)
+    {
+        Stream stream;
+        {
+            std::scoped_lock lock(m_mutex);
+            if (!m_free.empty()) {
+                stream = std::move(m_free.back());
+                m_free.pop_back();
+            }
+        }
+
+        if (stream != nullptr) {
+            if (inflateReset2(stream.get(), windowBits) == Z_OK) {
+                return stream;
+            }
+            inflateEnd(stream.get());
+        }
+
+        stream = std::make_unique<z_stream>();
+        if (inflateInit2(stream.get(), windowBits) != Z_OK) {
+            throw std::bad_alloc();
+        }
+        return stream;
+    }
+
+    void release(Stream stream)
+    {
+        {
+            std::scoped_lock lock(m_mutex);
+            if (m_free.size() < maxFree) {
+                m_free.push_back(std::move(stream));
+                return;
+            }
+        }
+        inflateEnd(stream.get());
+    }
+
+private:
+    static constexpr std::size_t maxFree = 64;
+
+    std::mutex m_mutex;
+    std::vector<Stream> m_free;
+};
+
+class ZlibCodec final : public Codec
+{
+public:
+    ZlibCodec(int windowBits, bool multiMember)
+      : m_stream(InflatePool::instance().acquire(windowBits))
+      , m_multiMember(multiMember)
+    {}
+
+    ZlibCodec(const ZlibCodec&) = delete;
+    ZlibCodec& operator=(const ZlibCodec&) = delete;
+
+    ~ZlibCodec() override
+    {
+        InflatePool::instance().release(std::move(m_stream));
+    }
+
+    Result decode(gsl::span<const std::uint8_t> input, gsl::span<std::uint8_t> output) override
+    {
+        const auto outSize = std::min<std::size_t>(output.size(), std::numeric_limits<uInt>::max());
+
+        // NOLINTNEXTLINE(cppcoreguidelines-pro-type-const-cast)
+        m_stream->next_in = const_cast<Bytef*>(input.data());
+        m_stream->avail_in = static_cast<uInt>(input.size());
+        m_stream->next_out = output.data();
+        m_stream->avail_out = static_cast<uInt>(outSize);
+
+        const auto rc = inflate(m_stream.get(), Z_NO_FLUSH);
+        if (rc != Z_OK && rc != Z_STREAM_END && rc != Z_BUF_ERROR) {
+            corruptedBody();
+        }
+
+        return {
+          .consumed = input.size() - m_stream->avail_in,
+          .produced = outSize - m_stream->avail_out,
+          .finished = rc == Z_STREAM_END,
+        };
+    }
+
+    bool nextMember() override
+    {
+        return m_multiMember && inflateReset(m_stream.get()) == Z_OK;
+    }
+
+private:
+    InflatePool::Stream m_stream;
+    const bool m_multiMember;
+};
+
+constexpr int zlibWindowBits = 15;
+constexpr int gzipWindowBits = zlibWindowBits + 16;
+
+#endif
+
+#ifdef ROYALBED_BROTLI_ENABLED
+
+// The brotli decoder cannot be reset, every body gets a new instance
+class BrotliCodec final : public Codec
+{
+public:
+    BrotliCodec()
+      : m_state(BrotliDecoderCreateInstance(nullptr, nullptr, nullptr))
+    {
+        if (m_state == nullptr) {
+            throw std::bad_alloc();
+        }
+    }
+
+    BrotliCodec(const BrotliCodec&) = delete;
+    BrotliCodec& operator=(const BrotliCodec&) = delete;
+
+    ~BrotliCodec() override
+    {
+        BrotliDecoderDestroyInstance(m_state);
+    }
+
+    Result decode(gsl::span<const std::uint8_t> input, gsl::span<std::uint8_t> output) override
+    {
+        auto availIn = input.size();
+        const auto* nextIn = input.data();
+        auto availOut = output.size();
+        auto* nextOut = output.data();
+
+        const auto rc = BrotliDecoderDecompressStream(m_state, &availIn, &nextIn, &availOut, &nextOut, nullptr);
+        if (rc == BROTLI_DECODER_RESULT_ERROR) {
+            corruptedBody();
+        }
+
+        return {
+          .consumed = input.size() - availIn,
+          .produced = output.size() - availOut,
+          .finished = rc == BROTLI_DECODER_RESULT_SUCCESS,
+        };
+    }
+
+private:
+    BrotliDecoderState* m_state;
+};
+
+#endif
+
+CodecPtr makeCodec(std::string_view coding)
+{
+#ifdef ROYALBED_ZLIB_ENABLED
+    if (coding == "gzip"sv || coding == "x-gzip"sv) {
+        // A gzip body may consist of several members (RFC 1952, 2.2)
+        return std::make_unique<ZlibCodec>(gzipWindowBits, true);
+    }
+    if (coding == "deflate"sv) {
+        return std::make_unique<ZlibCodec>(zlibWindowBits, false);
+    }
+#endif
+
+#ifdef ROYALBED_BROTLI_ENABLED
+    if (coding == "br"sv) {
+        return std::make_unique<BrotliCodec>();
+    }
+#endif
+
+    throw HttpError(HttpStatus::UnsupportedMediaType, "Unsupported Content-Encoding: " + std::string(coding));
+}
+
+class DecodingReader final : public nhope::Reader
+{
+public:
+    DecodingReader(nhope::AOContext& parent, nhope::ReaderPtr body, CodecPtr codec)
+      : m_body(std::move(body))
+      , m_codec(std::move(codec))
+      , m_aoCtx(parent)
+    {}
+
+    ~DecodingReader() override
+    {
+        m_aoCtx.close();
+    }
+
+    void read(gsl::span<std::uint8_t> buf, nhope::IOHandler handler) override
+    {
+        if (buf.empty()) {
+            this->complete(std::move(handler), nullptr, 0);
+            return;
+        }
+        if (m_finished) {
+            this->readEnd(std::move(handler));
+            return;
+        }
+
+        // A full output may leave decoded bytes inside the codec after the whole input is taken
+        if (m_inPos < m_inSize || m_outputFull) {
+            this->decode(buf, std::move(handler));
+            return;
+        }
+
+        m_body->read(m_input, [this, aoCtx = nhope::AOContextRef(m_aoCtx), buf, handler = std::move(handler)](
+                                std::exception_ptr err, std::size_t n) mutable {
+            aoCtx.exec([this, buf, handler = std::move(handler), err = std::move(err), n]() mutable {
+                if (err) {
+                    handler(std::move(err), 0);
+                    return;
+                }
+                if (n == 0) {
+                    if (m_memberEnd) {
+                        m_finished = true;
+                        m_bodyEnd = true;
+                        handler(nullptr, 0);
+                        return;
+                    }
+                    handler(std::make_exception_ptr(HttpError(HttpStatus::BadRequest, "Truncated compressed body")),
+                            0);
+                    return;
+                }
+
+                m_inPos = 0;
+                m_inSize = n;
+                this->decode(buf, std::move(handler));
+            });
+        });
+    }
+
+private:
+    // The compressed stream must end together with the body, otherwise the rest of the body would be left
+    // in the connection and taken for the next request
+    void readEnd(nhope::IOHandler handler)
+    {
+        if (m_inPos < m_inSize) {
+            this->complete(std::move(handler), dataAfterStream(), 0);
+            return;
+        }
+        if (m_bodyEnd) {
+            this->complete(std::move(handler), nullptr, 0);
+            return;
+        }
+
+        m_body->read(m_input, [this, aoCtx = nhope::AOContextRef(m_aoCtx), handler = std::move(handler)](
+                                std::exception_ptr err, std::size_t n) mutable {
+            aoCtx.exec([this, handler = std::move(handler), err = std::move(err), n] {
+                if (err) {
+                    handler(err, 0);
+                    return;
+                }
+                if (n > 0) {
+                    handler(dataAfterStream(), 0);
+                    return;
+                }
+                m_bodyEnd = true;
+                handler(nullptr, 0);
+            });
+        });
+    }
+
+    static std::exception_ptr dataAfterStream()
+    {
+        return std::make_exception_ptr(HttpError(HttpStatus::BadRequest, "Data after the compressed body"));
+    }
+
+    void decode(gsl::span<std::uint8_t> buf, nhope::IOHandler handler)
+    {
+        Codec::Result result{};
+        try {
+            const auto input = gsl::span<const std::uint8_t>(m_input).subspan(m_inPos, m_inSize - m_inPos);
+            result = m_codec->decode(input, buf);
+        } catch (...) {
+            this->complete(std::move(handler), std::current_exception(), 0);
+            return;
+        }
+
+        m_inPos += result.consumed;
+        m_memberEnd = m_memberEnd && result.consumed == 0;
+        m_outputFull = result.produced == buf.size() && !result.finished;
+        if (result.finished) {
+            // The body may end here or continue with the next member
+            m_memberEnd = m_codec->nextMember();
+            m_finished = !m_memberEnd;
+        }
+
+        if (result.produced == 0 && m_finished) {
+            this->readEnd(std::move(handler));
+            return;
+        }
+
+        if (result.produced == 0) {
+            if (result.consumed == 0 && m_inPos < m_inSize) {
+                auto err = std::make_exception_ptr(HttpError(HttpStatus::BadRequest, "Corrupted compressed body"));
+                this->complete(std::move(handler), std::move(err), 0);
+                return;
+            }
+
+            // The input held only headers or block boundaries
+            this->read(buf, std::move(handler));
+            return;
+        }
+
+        this->complete(std::move(handler), nullptr, result.produced);
+    }
+
+    // Many output portions can be decoded from one input portion, the handler is never called recursively
+    void complete(nhope::IOHandler handler, std::exception_ptr err, std::size_t n)
+    {
+        m_aoCtx.exec([handler = std::move(handler), err = std::move(err), n] {
+            handler(err, n);
+        });
+    }
+
+    nhope::ReaderPtr m_body;
+    CodecPtr m_codec;
+
+    std::array<std::uint8_t, inputBufSize> m_input{};
+    std::size_t m_inPos = 0;
+    std::size_t m_inSize = 0;
+    bool m_finished = false;
+    bool m_bodyEnd = false;
+    bool m_memberEnd = false;
+    bool m_outputFull = false;
+
+    nhope::AOContext m_aoCtx;
+};
+
+}   // namespace
+
+nhope::ReaderPtr makeContentDecoder(nhope::AOContext& aoCtx, nhope::ReaderPtr body, std::string_view contentEncoding)
+{
+    std::vector<std::string> codings;
+    std::size_t pos = 0;
+    while (pos <= contentEncoding.size()) {
+        const auto end = std::min(contentEncoding.find(',', pos), contentEncoding.size());
+        const auto coding = common::detail::trim(contentEncoding.substr(pos, end - pos));
+        if (!coding.empty()) {
+            codings.push_back(common::detail::toLower(coding));
+        }
+        pos = end + 1;
+    }
+
+    // The last applied coding is undone first
+    for (auto it = codings.rbegin(); it != codings.rend(); ++it) {
+        if (*it == "identity"sv) {
+            continue;
+        }
+        body = std::make_unique<DecodingReader>(aoCtx, std::move(body), makeCodec(*it));
+    }
+    return body;
+}
+
+}   // namespace royalbed::server::detail
@@ -0,0 +1,373 @@
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <utility>
+
+#include <gsl/span>
+
+#include "nhope/async/ao-context.h"
+#include "nhope/async/future.h"
+#include "nhope/async/timer.h"
+#include "nhope/io/io-device.h"
+
+#include "royalbed/server/event-stream.h"
+#include "royalbed/server/request-context.h"
+
+namespace royalbed::server {
+namespace detail {
+
+// Frames waiting to be sent to one subscriber.
+// Publishers push frames from any thread, the EventStreamReader takes them out in its AOContext.
+class EventQueue final
+{
+public:
+    using Waiter = std::function<void()>;
+
+    explicit EventQueue(std::size_t maxBytes)
+      : m_maxBytes(maxBytes)
+    {}
+
+    // force - push the frame even if the queue is full (heartbeats)
+    bool push(EventFrame frame, bool force = false)
+    {
+        Waiter waiter;
+        bool accepted = false;
+        {
+            std::scoped_lock lock(m_mutex);
+            if (m_closed) {
+                return false;
+            }
+
+            if (!force && m_queuedBytes + frame->size() > m_maxBytes) {
+                // The subscriber is too slow, it will reconnect and resume with Last-Event-ID
+                m_closed = true;
+            } else {
+                m_queuedBytes += frame->size();
+                m_frames.emplace_back(std::move(frame));
+            }
+            accepted = !m_closed;
+            waiter = std::exchange(m_waiter, nullptr);
+        }
+
+        if (waiter) {
+            waiter();
+        }
+        return accepted;
+    }
+
+    void close()
+    {
+        Waiter waiter;
+        {
+            std::scoped_lock lock(m_mutex);
+            m_closed = true;
+            waiter = std::exchange(m_waiter, nullptr);
+        }
+
+        if (waiter) {
+            waiter();
+        }
+    }
+
+    [[nodiscard]] bool isClosed() const
+    {
+        std::scoped_lock lock(m_mutex);
+        return m_closed;
+    }
+
+    // Copies as many queued frames as fit in buf, so several events are sent with one write.
+    // Returns 0 if the queue is closed and empty.
+    // If the queue is empty and still open, returns nullopt and calls the waiter once something is pushed.
+    std::optional<std::size_t> takeOrWait(gsl::span<std::uint8_t> buf, Waiter waiter)
+    {
+        std::scoped_lock lock(m_mutex);
+
+        std::size_t n = 0;
+        while (!m_frames.empty() && n < buf.size()) {
+            const auto& frame = *m_frames.front();
+            const auto size = std::min(buf.size() - n, frame.size() - m_frontOffset);
+            std::memcpy(buf.data() + n, frame.data() + m_frontOffset, size);
+            n += size;
+            m_frontOffset += size;
+            if (m_frontOffset == frame.size()) {
+                m_queuedBytes -= frame.size();
+                m_frontOffset = 0;
+                m_frames.pop_front();
+            }
+        }
+
+        if (n == 0 && !m_closed) {
+            m_waiter = std::move(waiter);
+            return std::nullopt;
+        }
+        return n;
+    }
+
+private:
+    mutable std::mutex m_mutex;
+    std::deque<EventFrame> m_frames;
+    std::size_t m_frontOffset = 0;
+    std::size_t m_queuedBytes = 0;
+    const std::size_t m_maxBytes;
+    bool m_closed = false;
+    Waiter m_waiter;
+};
+
+}   // namespace detail
+
+namespace {
+using namespace std::literals;
+
+const auto lastEventIdHeader = "Last-Event-ID"s;
+
+// A comment line, ignored by clients
+const auto heartbeatFrame = std::make_shared<const std::string>(":\n\n");
+
+// Line breaks are not allowed in the field values other than data
+void appendField(std::string& out, std::string_view name, std::string_view value)
+{
+    out += name;
+    out += ": "sv;
+    for (const auto ch : value) {
+        if (ch != '\r' && ch != '\n') {
+            out += ch;
+        }
+    }
+    out += '\n';
+}
+
+class EventStreamReader final : public nhope::Reader
+{
+public:
+    EventStreamReader(nhope::AOContext& parent, std::shared_ptr<detail::EventQueue> queue, EventSource source,
+                      std::chrono::milliseconds heartbeatInterval)
+      : m_queue(std::move(queue))
+      , m_source(std::move(source))
+      , m_aoCtx(parent)
+    {
+        if (heartbeatInterval.count() > 0) {
+            nhope::setInterval(m_aoCtx, heartbeatInterval, [this](const std::error_code& err) {
+                if (err) {
+                    return false;
+                }
+                if (!m_sentSinceHeartbeat) {
+                    m_queue->push(heartbeatFrame, true);
+                }
+                m_sentSinceHeartbeat = false;
+                return true;
+            });
+        }
+    }
+
+    ~EventStreamReader() override
+    {
+        // The client is gone, publishers will see it on the next send
+        m_aoCtx.close();
+        m_queue->close();
+    }
+
+    void read(gsl::span<std::uint8_t> buf, nhope::IOHandler handler) override
+    {
+        auto waiter = [this, aoCtx = nhope::AOContextRef(m_aoCtx), buf, handler]() mutable {
+            aoCtx.exec([this, buf, handler = std::move(handler)] {
+                this->read(buf, handler);
+            });
+        };
+
+        const auto n = m_queue->takeOrWait(buf, std::move(waiter));
+        if (!n.has_value()) {
+            this->pullSource();
+            return;
+        }
+
+        m_sentSinceHeartbeat = m_sentSinceHeartbeat || *n > 0;
+        m_aoCtx.exec([handler = std::move(handler), n = *n] {
+            handler(nullptr, n);
+        });
+    }
+
+private:
+    // The next event is requested only when the previous ones have been sent
+    void pullSource()
+    {
+        if (!m_source || m_pulling) {
+            return;
+        }
+
+        m_pulling = true;
+        this->nextEvent()
+          .then(m_aoCtx,
+                [this](std::optional<Event> event) {
+                    m_pulling = false;
+                    if (!event.has_value()) {
+                        m_queue->close();
+                        return;
+                    }
+                    m_queue->push(makeEventFrame(*event));
+                })
+          .fail(m_aoCtx, [this](auto /*unused*/) {
+              m_pulling = false;
+              m_queue->close();
+          });
+    }
+
+    nhope::Future<std::optional<Event>> nextEvent()
+    {
+        try {
+            return m_source();
+        } catch (...) {
+            return nhope::makeExceptionalFuture<std::optional<Event>>(std::current_exception());
+        }
+    }
+
+    std::shared_ptr<detail::EventQueue> m_queue;
+    EventSource m_source;
+    bool m_pulling = false;
+    bool m_sentSinceHeartbeat = false;
+
+    nhope::AOContext m_aoCtx;
+};
+
+}   // namespace
+
+EventFrame makeEventFrame(const Event& event)
+{
+    std::string frame;
+    frame.reserve(event.id.size() + event.event.size() + event.data.size() + 32);   // NOLINT
+
+    if (!event.id.empty()) {
+        appendField(frame, "id"sv, event.id);
+    }
+    if (!event.event.empty()) {
+        appendField(frame, "event"sv, event.event);
+    }
+    if (event.retry.has_value()) {
+        appendField(frame, "retry"sv, std::to_string(event.retry->count()));
+    }
+
+    // Every line of the data is sent in its own data field
+    std::string_view data = event.data;
+    while (true) {
+        const auto end = data.find_first_of("\r\n"sv);
+        appendField(frame, "data"sv, data.substr(0, end));
+        if (end == std::string_view::npos) {
+            break;
+        }
+        const auto next = data.compare(end, 2, "\r\n"sv) == 0 ? end + 2 : end + 1;
+        data.remove_prefix(next);
+    }
+    frame += '\n';
+
+    return std::make_shared<const std::string>(std::move(frame));
+}
+
+EventSink::EventSink(std::shared_ptr<detail::EventQueue> queue)
+  : m_queue(std::move(queue))
+{}
+
+bool EventSink::send(const Event& event) const
+{
+    return this->send(makeEventFrame(event));
+}
+
+bool EventSink::send(EventFrame frame) const
+{
+    return m_queue->push(std::move(frame));
+}
+
+void EventSink::close() const
+{
+    m_queue->close();
+}
+
+bool EventSink::isOpen() const
+{
+    return !m_queue->isClosed();
+}
+
+EventStream::EventStream(RequestContext& ctx, EventStreamParams params)
+  : m_queue(std::make_shared<detail::EventQueue>(params.maxQueuedBytes))
+  , m_heartbeatInterval(params.heartbeatInterval)
+{
+    if (auto it = ctx.request.headers.find(lastEventIdHeader); it != ctx.request.headers.end()) {
+        m_lastEventId = it->second;
+    }
+}
+
+EventSink EventStream::sink() const
+{
+    return EventSink(m_queue);
+}
+
+const std::optional<std::string>& EventStream::lastEventId() const noexcept
+{
+    return m_lastEventId;
+}
+
+EventStream& EventStream::setSource(EventSource source)
+{
+    m_source = std::move(source);
+    return *this;
+}
+
+nhope::ReaderPtr EventStream::makeReader(nhope::AOContext& aoCtx) &&
+{
+    return std::make_unique<EventStreamReader>(aoCtx, std::move(m_queue), std::move(m_source), m_heartbeatInterval);
+}
+
+EventBroadcaster::EventBroadcaster(std::size_t historySize)
+  : m_historySize(historySize)
+{}
+
+void EventBroadcaster::subscribe(EventSink sink, const std::optional<std::string>& lastEventId)
+{
+    std::scoped_lock lock(m_mutex);
+
+    if (lastEventId.has_value()) {
+        const auto it = std::find_if(m_history.begin(), m_history.end(), [&lastEventId](const auto& item) {
+            return item.id == *lastEventId;
+        });
+        if (it != m_history.end()) {
+            for (auto missed = std::next(it); missed != m_history.end(); ++missed) {
+                sink.send(missed->frame);
+            }
+        }
+    }
+
+    m_subscribers.emplace_back(std::move(sink));
+}
+
+void EventBroadcaster::publish(const Event& event)
+{
+    const auto frame = makeEventFrame(event);
+
+    std::scoped_lock lock(m_mutex);
+    if (!event.id.empty() && m_historySize > 0) {
+        m_history.push_back({event.id, frame});
+        if (m_history.size() > m_historySize) {
+            m_history.pop_front();
+        }
+    }
+
+    m_subscribers.remove_if([&frame](const EventSink& sink) {
+        return !sink.send(frame);
+    });
+}
+
+std::size_t EventBroadcaster::subscriberCount() const
+{
+    std::scoped_lock lock(m_mutex);
+    return m_subscribers.size();
+}
+
+}   // namespace royalbed::server
@@ -0,0 +1,499 @@
+#include <array>
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <system_error>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#if defined(__linux__)
+#include <sys/inotify.h>
+#endif
+
+#include <gsl/span>
+
+#include "fmt/format.h"
+
+#include "royalbed/common/mime-type.h"
+#include "royalbed/server/error.h"
+#include "royalbed/server/file-cache.h"
+#include "royalbed/server/http-status.h"
+#include "royalbed/server/send-content.h"
+
+namespace royalbed::server {
+
+namespace {
+
+namespace fs = std::filesystem;
+
+// Medium files requested once are remembered to be admitted on the next request
+constexpr std::size_t maxSeenFiles = 4096;
+
+class FileDescriptor final
+{
+public:
+    explicit FileDescriptor(int fd = -1) noexcept
+      : m_fd(fd)
+    {}
+
+    FileDescriptor(const FileDescriptor&) = delete;
+    FileDescriptor& operator=(const FileDescriptor&) = delete;
+
+    ~FileDescriptor()
+    {
+        if (m_fd >= 0) {
+            ::close(m_fd);
+        }
+    }
+
+    [[nodiscard]] int get() const noexcept
+    {
+        return m_fd;
+    }
+
+private:
+    int m_fd = -1;
+};
+
+[[noreturn]] void throwSystemError(const std::string& what)
+{
+    throw std::system_error(errno, std::generic_category(), what);
+}
+
+struct OpenedFile
+{
+    std::unique_ptr<FileDescriptor> fd;
+    struct stat st;
+};
+
+OpenedFile openFile(const fs::path& path)
+{
+    // NOLINTNEXTLINE(cppcoreguidelines-pro-type-vararg)
+    auto fd = std::make_unique<FileDescriptor>(::open(path.c_str(), O_RDONLY | O_CLOEXEC));
+    if (fd->get() < 0) {
+        if (errno == ENOENT || errno == ENOTDIR) {
+            throw HttpError(HttpStatus::NotFound);
+        }
+        throwSystemError("open " + path.string());
+    }
+
+    OpenedFile file{.fd = std::move(fd), .st = {}};
+    if (::fstat(file.fd->get(), &file.st) != 0) {
+        throwSystemError("stat " + path.string());
+    }
+    if (!S_ISREG(file.st.st_mode)) {
+        throw HttpError(HttpStatus::NotFound);
+    }
+    return file;
+}
+
+std::uint64_t modificationTime(const struct stat& st)
+{
+    constexpr std::uint64_t nsInSec = 1'000'000'000;
+    return static_cast<std::uint64_t>(st.st_mtim.tv_sec) * nsInSec + static_cast<std::uint64_t>(st.st_mtim.tv_nsec);
+}
+
+ContentInfo contentInfo(const fs::path& path, const struct stat& st)
+{
+    ContentInfo info;
+    auto name = path.filename().string();
+    if (path.extension() == ".gz") {
+        info.contentEncoding = "gzip";
+        name = path.stem().string();
+    }
+    info.contentType = std::string(common::mimeTypeForFileName(name));
+    // Computed without reading the file, like most servers do
+    info.etag = fmt::format("\"{:x}-{:x}\"", modificationTime(st), st.st_size);
+    return info;
+}
+
+std::vector<std::uint8_t> readFile(const OpenedFile& file, const fs::path& path)
+{
+    std::vector<std::uint8_t> data(static_cast<std::size_t>(file.st.st_size));
+    std::size_t size = 0;
+    while (size < data.size()) {
+        const auto n = ::pread(file.fd->get(), data.data() + size, data.size() - size, static_cast<off_t>(size));
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            throwSystemError("read " + path.string());
+        }
+        if (n == 0) {
+            // The file was truncated after fstat
+            break;
+        }
+        size += static_cast<std::size_t>(n);
+    }
+    data.resize(size);
+    return data;
+}
+
+struct StreamedFile final
+{
+    ContentInfo info;
+    std::unique_ptr<FileDescriptor> fd;
+};
+
+// The file is read while the response is sent instead of being mapped: a mapping of a file truncated by
+// another process raises SIGBUS
+FileContent streamFile(OpenedFile&& file, const fs::path& path)
+{
+    auto streamed = std::make_shared<StreamedFile>();
+    streamed->info = contentInfo(path, file.st);
+    streamed->fd = std::move(file.fd);
+    return {
+      .fd = streamed->fd->get(),
+      .size = static_cast<std::uint64_t>(file.st.st_size),
+      .info = std::shared_ptr<const ContentInfo>(streamed, &streamed->info),
+    };
+}
+
+}   // namespace
+
+FileContent loadFile(const std::filesystem::path& path)
+{
+    return streamFile(openFile(path), path);
+}
+
+void sendContent(RequestContext& ctx, const FileContent& content)
+{
+    if (content.fd < 0) {
+        sendContent(ctx, content.data, *content.info, content.info);
+    } else {
+        sendFile(ctx, content.fd, content.size, *content.info, content.info);
+    }
+}
+
+namespace detail {
+
+class FileCacheImpl final
+{
+public:
+    explicit FileCacheImpl(FileCacheOptions options)
+      : m_options(options)
+    {
+#if defined(__linux__)
+        m_inotifyFd = ::inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+#endif
+    }
+
+    FileCacheImpl(const FileCacheImpl&) = delete;
+    FileCacheImpl& operator=(const FileCacheImpl&) = delete;
+
+    ~FileCacheImpl()
+    {
+        if (m_inotifyFd >= 0) {
+            ::close(m_inotifyFd);
+        }
+    }
+
+    FileContent get(const fs::path& path)
+    {
+        const auto key = path.lexically_normal().string();
+
+        std::unique_lock lock(m_mutex);
+        this->processEvents();
+        if (const auto it = m_entries.find(key); it != m_entries.end()) {
+            if (m_inotifyFd >= 0 || isFresh(*it->second.entry, key)) {
+                ++m_stats.hits;
+                m_lru.splice(m_lru.begin(), m_lru, it->second.lruPos);
+                return content(it->second.entry);
+            }
+            this->erase(it);
+            ++m_stats.invalidations;
+        }
+
+        ++m_stats.misses;
+        // The directory is watched before reading so that no change of the file is missed
+        const bool watched = this->watchDir(fs::path(key).parent_path());
+        const auto epoch = m_epoch;
+        lock.unlock();
+
+        auto file = openFile(key);
+        lock.lock();
+        const bool admitted = watched && this->admit(key, static_cast<std::size_t>(file.st.st_size));
+        lock.unlock();
+        if (!admitted) {
+            return streamFile(std::move(file), key);
+        }
+
+        auto entry = std::make_shared<Entry>();
+        entry->info = contentInfo(key, file.st);
+        entry->data = readFile(file, key);
+        entry->mtime = modificationTime(file.st);
+        entry->size = file.st.st_size;
+
+        lock.lock();
+        // Skip caching if a file was changed while reading
+        if (epoch == m_epoch && !m_entries.contains(key)) {
+            this->insert(key, entry);
+        }
+        return content(std::move(entry));
+    }
+
+    void invalidate(const fs::path& path)
+    {
+        std::lock_guard lock(m_mutex);
+        this->invalidateLocked(path.lexically_normal().string(), true);
+    }
+
+    void clear()
+    {
+        std::lock_guard lock(m_mutex);
+        this->clearLocked();
+    }
+
+    FileCacheStats stats() const
+    {
+        std::lock_guard lock(m_mutex);
+        return m_stats;
+    }
+
+private:
+    struct Entry final
+    {
+        std::vector<std::uint8_t> data;
+        ContentInfo info;
+        std::uint64_t mtime = 0;
+        off_t size = 0;
+    };
+
+    using Lru = std::list<std::string>;
+
+    struct Slot final
+    {
+        std::shared_ptr<const Entry> entry;
+        Lru::iterator lruPos;
+    };
+
+    using Entries = std::unordered_map<std::string, Slot>;
+
+    static FileContent content(const std::shared_ptr<const Entry>& entry)
+    {
+        return {
+          .data = entry->data,
+          .size = entry->data.size(),
+          .info = std::shared_ptr<const ContentInfo>(entry, &entry->info),
+        };
+    }
+
+    // Used when inotify is not available
+    static bool isFresh(const Entry& entry, const std::string& path)
+    {
+        struct stat st = {};
+        return ::stat(path.c_str(), &st) == 0 && modificationTime(st) == entry.mtime && st.st_size == entry.size;
+    }
+
+    bool admit(const std::string& key, std::size_t size)
+    {
+        if (size > m_options.maxFileSize || size > m_options.maxBytes) {
+            return false;
+        }
+        if (size <= m_options.smallFileSize) {
+            return true;
+        }
+
+        // Medium files are admitted on the second request, so one-off reads do not flush hot files
+        if (m_seen.erase(key) > 0) {
+            return true;
+        }
+        if (m_seen.size() >= maxSeenFiles) {
+            m_seen.clear();
+        }
+        m_seen.insert(key);
+        return false;
+    }
+
+    void insert(const std::string& key, std::shared_ptr<const Entry> entry)
+    {
+        m_lru.push_front(key);
+        m_stats.bytes += entry->data.size();
+        ++m_stats.files;
+        m_entries.emplace(key, Slot{.entry = std::move(entry), .lruPos = m_lru.begin()});
+
+        while (m_stats.bytes > m_options.maxBytes) {
+            this->erase(m_entries.find(m_lru.back()));
+            ++m_stats.evictions;
+        }
+    }
+
+    void erase(Entries::iterator it)
+    {
+        m_stats.bytes -= it->second.entry->data.size();
+        --m_stats.files;
+        m_lru.erase(it->second.lruPos);
+        m_entries.erase(it);
+    }
+
+    void invalidateLocked(const std::string& path, bool withChildren)
+    {
+        ++m_epoch;
+        if (const auto it = m_entries.find(path); it != m_entries.end()) {
+            this->erase(it);
+            ++m_stats.invalidations;
+        }
+        if (!withChildren) {
+            return;
+        }
+
+        const auto prefix = path + '/';
+        for (auto it = m_entries.begin(); it != m_entries.end();) {
+            if (it->first.starts_with(prefix)) {
+                this->erase(it++);
+                ++m_stats.invalidations;
+            } else {
+                ++it;
+            }
+        }
+    }
+
+    void clearLocked()
+    {
+        ++m_epoch;
+        m_stats.invalidations += m_entries.size();
+        m_stats.bytes = 0;
+        m_stats.files = 0;
+        m_entries.clear();
+        m_lru.clear();
+    }
+
+    bool watchDir(const fs::path& dir)
+    {
+#if defined(__linux__)
+        if (m_inotifyFd < 0) {
+            return true;
+        }
+
+        const auto dirStr = dir.string();
+        if (m_dirWatches.contains(dirStr)) {
+            return true;
+        }
+
+        constexpr std::uint32_t mask = IN_MODIFY | IN_ATTRIB | IN_CLOSE_WRITE | IN_CREATE | IN_DELETE | IN_MOVED_FROM |
+                                       IN_MOVED_TO | IN_DELETE_SELF | IN_MOVE_SELF;
+        const int wd = ::inotify_add_watch(m_inotifyFd, dirStr.c_str(), mask);
+        if (wd < 0) {
+            // E.g. the watch limit is reached, files of the directory are not cached
+            return false;
+        }
+        m_dirWatches.emplace(dirStr, wd);
+        m_watchedDirs.emplace(wd, dirStr);
+#endif
+        return true;
+    }
+
+    void processEvents()
+    {
+#if defined(__linux__)
+        if (m_inotifyFd < 0) {
+            return;
+        }
+
+        alignas(struct inotify_event) std::array<char, 16 * 1024> buf;   // NOLINT(readability-magic-numbers)
+        for (;;) {
+            const auto n = ::read(m_inotifyFd, buf.data(), buf.size());
+            if (n <= 0) {
+                return;
+            }
+
+            std::size_t offset = 0;
+            while (offset < static_cast<std::size_t>(n)) {
+                // NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast)
+                const auto* event = reinterpret_cast<const struct inotify_event*>(buf.data() + offset);
+                offset += sizeof(struct inotify_event) + event->len;
+                this->processEvent(*event);
+            }
+        }
+#endif
+    }
+
+#if defined(__linux__)
+    void processEvent(const struct inotify_event& event)
+    {
+        if ((event.mask & IN_Q_OVERFLOW) != 0) {
+            this->clearLocked();
+            return;
+        }
+
+        const auto it = m_watchedDirs.find(event.wd);
+        if (it == m_watchedDirs.end()) {
+            return;
+        }
+
+        if (event.len > 0) {
+            // Entries of a renamed or removed subdirectory are dropped as well
+            const bool isDir = (event.mask & IN_ISDIR) != 0;
+            // NOLINTNEXTLINE(cppcoreguidelines-pro-bounds-array-to-pointer-decay)
+            this->invalidateLocked((fs::path(it->second) / event.name).string(), isDir);
+            return;
+        }
+
+        if ((event.mask & (IN_DELETE_SELF | IN_MOVE_SELF | IN_IGNORED)) != 0) {
+            const auto dir = it->second;
+            this->invalidateLocked(dir, true);
+            if ((event.mask & IN_IGNORED) == 0) {
+                ::inotify_rm_watch(m_inotifyFd, event.wd);
+            }
+            m_dirWatches.erase(dir);
+            m_watchedDirs.erase(it);
+        }
+    }
+#endif
+
+    const FileCacheOptions m_options;
+
+    mutable std::mutex m_mutex;
+    Entries m_entries;
+    Lru m_lru;   // The most recently used first
+    std::unordered_set<std::string> m_seen;
+    FileCacheStats m_stats;
+
+    // Incremented by every invalidation
+    std::uint64_t m_epoch = 0;
+
+    int m_inotifyFd = -1;
+    std::unordered_map<std::string, int> m_dirWatches;
+    std::unordered_map<int, std::string> m_watchedDirs;
+};
+
+}   // namespace detail
+
+FileCache::FileCache(FileCacheOptions options)
+  : m_impl(std::make_unique<detail::FileCacheImpl>(options))
+{}
+
+FileCache::~FileCache() = default;
+
+FileContent FileCache::get(const std::filesystem::path& path)
+{
+    return m_impl->get(path);
+}
+
+void FileCache::invalidate(const std::filesystem::path& path)
+{
+    m_impl->invalidate(path);
+}
+
+void FileCache::clear()
+{
+    m_impl->clear();
+}
+
+FileCacheStats FileCache::stats() const
+{
+    return m_impl->stats();
+}
+
+}   // namespace royalbed::server
@@ -1,16 +1,39 @@
 #include <string>
+#include <utility>
 
 #include "royalbed/server/detail/handler.h"
 #include "nhope/io/string-reader.h"
 
 namespace royalbed::server::detail {
 
-void addContent(RequestContext& ctx, std::string content)
+void addContent(RequestContext& ctx, common::BodyType type, std::string content)
 {
-    //TODO make other mime-types
-    ctx.response.headers.emplace("Content-Type", "application/json");
+    ctx.response.headers.emplace("Content-Type", common::mimeType(type));
+    ctx.response.headers.emplace("Vary", "Accept");
     ctx.response.headers.emplace("Content-Length", std::to_string(content.size()));
     ctx.response.body = nhope::StringReader::create(ctx.aoCtx, std::move(content));
 }
 
+void addContent(RequestContext& ctx, JsonArrayStream stream)
+{
+    ctx.response.headers.emplace("Content-Type", "application/json");
+    ctx.response.headers.emplace("Transfer-Encoding", "chunked");
+    ctx.response.body = std::move(stream).makeReader(ctx.aoCtx);
+}
+
+void addContent(RequestContext& ctx, EventStream stream)
+{
+    ctx.response.headers.emplace("Content-Type", "text/event-stream");
+    ctx.response.headers.emplace("Cache-Control", "no-cache");
+    ctx.response.headers.emplace("Transfer-Encoding", "chunked");
+    // Every event must reach the client immediately
+    ctx.response.chunked.minChunkSize = 0;
+    ctx.response.body = std::move(stream).makeReader(ctx.aoCtx);
+}
+
+void addContent(RequestContext& ctx, WebSocketUpgrade upgrade)
+{
+    std::move(upgrade).accept(ctx);
+}
+
 }   // namespace royalbed::server::detail
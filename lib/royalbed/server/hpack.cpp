@@ -0,0 +1,597 @@
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include <gsl/span>
+
+#include "royalbed/server/detail/hpack.h"
+
+namespace royalbed::server::detail {
+namespace {
+using namespace std::literals;
+
+// NOLINTBEGIN(readability-magic-numbers)
+
+// RFC 7541, Appendix A
+constexpr std::array<std::pair<std::string_view, std::string_view>, 61> staticTable{{
+  {":authority"sv, ""sv},
+  {":method"sv, "GET"sv},
+  {":method"sv, "POST"sv},
+  {":path"sv, "/"sv},
+  {":path"sv, "/index.html"sv},
+  {":scheme"sv, "http"sv},
+  {":scheme"sv, "https"sv},
+  {":status"sv, "200"sv},
+  {":status"sv, "204"sv},
+  {":status"sv, "206"sv},
+  {":status"sv, "304"sv},
+  {":status"sv, "400"sv},
+  {":status"sv, "404"sv},
+  {":status"sv, "500"sv},
+  {"accept-charset"sv, ""sv},
+  {"accept-encoding"sv, "gzip, deflate"sv},
+  {"accept-language"sv, ""sv},
+  {"accept-ranges"sv, ""sv},
+  {"accept"sv, ""sv},
+  {"access-control-allow-origin"sv, ""sv},
+  {"age"sv, ""sv},
+  {"allow"sv, ""sv},
+  {"authorization"sv, ""sv},
+  {"cache-control"sv, ""sv},
+  {"content-disposition"sv, ""sv},
+  {"content-encoding"sv, ""sv},
+  {"content-language"sv, ""sv},
+  {"content-length"sv, ""sv},
+  {"content-location"sv, ""sv},
+  {"content-range"sv, ""sv},
+  {"content-type"sv, ""sv},
+  {"cookie"sv, ""sv},
+  {"date"sv, ""sv},
+  {"etag"sv, ""sv},
+  {"expect"sv, ""sv},
+  {"expires"sv, ""sv},
+  {"from"sv, ""sv},
+  {"host"sv, ""sv},
+  {"if-match"sv, ""sv},
+  {"if-modified-since"sv, ""sv},
+  {"if-none-match"sv, ""sv},
+  {"if-range"sv, ""sv},
+  {"if-unmodified-since"sv, ""sv},
+  {"last-modified"sv, ""sv},
+  {"link"sv, ""sv},
+  {"location"sv, ""sv},
+  {"max-forwards"sv, ""sv},
+  {"proxy-authenticate"sv, ""sv},
+  {"proxy-authorization"sv, ""sv},
+  {"range"sv, ""sv},
+  {"referer"sv, ""sv},
+  {"refresh"sv, ""sv},
+  {"retry-after"sv, ""sv},
+  {"server"sv, ""sv},
+  {"set-cookie"sv, ""sv},
+  {"strict-transport-security"sv, ""sv},
+  {"transfer-encoding"sv, ""sv},
+  {"user-agent"sv, ""sv},
+  {"vary"sv, ""sv},
+  {"via"sv, ""sv},
+  {"www-authenticate"sv, ""sv},
+}};
+
+// RFC 7541, Appendix B
+constexpr std::array<std::uint32_t, 256> huffmanCodes{
+  0x1ff8, 0x7fffd8, 0xfffffe2, 0xfffffe3, 0xfffffe4, 0xfffffe5, 0xfffffe6, 0xfffffe7,
+  0xfffffe8, 0xffffea, 0x3ffffffc, 0xfffffe9, 0xfffffea, 0x3ffffffd, 0xfffffeb, 0xfffffec,
+  0xfffffed, 0xfffffee, 0xfffffef, 0xffffff0, 0xffffff1, 0xffffff2, 0x3ffffffe, 0xffffff3,
+  0xffffff4, 0xffffff5, 0xffffff6, 0xffffff7, 0xffffff8, 0xffffff9, 0xffffffa, 0xffffffb,
+  0x14, 0x3f8, 0x3f9, 0xffa, 0x1ff9, 0x15, 0xf8, 0x7fa,
+  0x3fa, 0x3fb, 0xf9, 0x7fb, 0xfa, 0x16, 0x17, 0x18,
+  0x0, 0x1, 0x2, 0x19, 0x1a, 0x1b, 0x1c, 0x1d,
+  0x1e, 0x1f, 0x5c, 0xfb, 0x7ffc, 0x20, 0xffb, 0x3fc,
+  0x1ffa, 0x21, 0x5d, 0x5e, 0x5f, 0x60, 0x61, 0x62,
+  0x63, 0x64, 0x65, 0x66, 0x67, 0x68, 0x69, 0x6a,
+  0x6b, 0x6c, 0x6d, 0x6e, 0x6f, 0x70, 0x71, 0x72,
+  0xfc, 0x73, 0xfd, 0x1ffb, 0x7fff0, 0x1ffc, 0x3ffc, 0x22,
+  0x7ffd, 0x3, 0x23, 0x4, 0x24, 0x5, 0x25, 0x26,
+  0x27, 0x6, 0x74, 0x75, 0x28, 0x29, 0x2a, 0x7,
+  0x2b, 0x76, 0x2c, 0x8, 0x9, 0x2d, 0x77, 0x78,
+  0x79, 0x7a, 0x7b, 0x7ffe, 0x7fc, 0x3ffd, 0x1ffd, 0xffffffc,
+  0xfffe6, 0x3fffd2, 0xfffe7, 0xfffe8, 0x3fffd3, 0x3fffd4, 0x3fffd5, 0x7fffd9,
+  0x3fffd6, 0x7fffda, 0x7fffdb, 0x7fffdc, 0x7fffdd, 0x7fffde, 0xffffeb, 0x7fffdf,
+  0xffffec, 0xffffed, 0x3fffd7, 0x7fffe0, 0xffffee, 0x7fffe1, 0x7fffe2, 0x7fffe3,
+  0x7fffe4, 0x1fffdc, 0x3fffd8, 0x7fffe5, 0x3fffd9, 0x7fffe6, 0x7fffe7, 0xffffef,
+  0x3fffda, 0x1fffdd, 0xfffe9, 0x3fffdb, 0x3fffdc, 0x7fffe8, 0x7fffe9, 0x1fffde,
+  0x7fffea, 0x3fffdd, 0x3fffde, 0xfffff0, 0x1fffdf, 0x3fffdf, 0x7fffeb, 0x7fffec,
+  0x1fffe0, 0x1fffe1, 0x3fffe0, 0x1fffe2, 0x7fffed, 0x3fffe1, 0x7fffee, 0x7fffef,
+  0xfffea, 0x3fffe2, 0x3fffe3, 0x3fffe4, 0x7ffff0, 0x3fffe5, 0x3fffe6, 0x7ffff1,
+  0x3ffffe0, 0x3ffffe1, 0xfffeb, 0x7fff1, 0x3fffe7, 0x7ffff2, 0x3fffe8, 0x1ffffec,
+  0x3ffffe2, 0x3ffffe3, 0x3ffffe4, 0x7ffffde, 0x7ffffdf, 0x3ffffe5, 0xfffff1, 0x1ffffed,
+  0x7fff2, 0x1fffe3, 0x3ffffe6, 0x7ffffe0, 0x7ffffe1, 0x3ffffe7, 0x7ffffe2, 0xfffff2,
+  0x1fffe4, 0x1fffe5, 0x3ffffe8, 0x3ffffe9, 0xffffffd, 0x7ffffe3, 0x7ffffe4, 0x7ffffe5,
+  0xfffec, 0xfffff3, 0xfffed, 0x1fffe6, 0x3fffe9, 0x1fffe7, 0x1fffe8, 0x7ffff3,
+  0x3fffea, 0x3fffeb, 0x1ffffee, 0x1ffffef, 0xfffff4, 0xfffff5, 0x3ffffea, 0x7ffff4,
+  0x3ffffeb, 0x7ffffe6, 0x3ffffec, 0x3ffffed, 0x7ffffe7, 0x7ffffe8, 0x7ffffe9, 0x7ffffea,
+  0x7ffffeb, 0xffffffe, 0x7ffffec, 0x7ffffed, 0x7ffffee, 0x7ffffef, 0x7fffff0, 0x3ffffee,
+};
+
+constexpr std::array<std::uint8_t, 256> huffmanCodeLengths{
+  13, 23, 28, 28, 28, 28, 28, 28, 28, 24, 30, 28, 28, 30, 28, 28,
+  28, 28, 28, 28, 28, 28, 30, 28, 28, 28, 28, 28, 28, 28, 28, 28,
+  6, 10, 10, 12, 13, 6, 8, 11, 10, 10, 8, 11, 8, 6, 6, 6,
+  5, 5, 5, 6, 6, 6, 6, 6, 6, 6, 7, 8, 15, 6, 12, 10,
+  13, 6, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7,
+  7, 7, 7, 7, 7, 7, 7, 7, 8, 7, 8, 13, 19, 13, 14, 6,
+  15, 5, 6, 5, 6, 5, 6, 6, 6, 5, 7, 7, 6, 6, 6, 5,
+  6, 7, 6, 5, 5, 6, 7, 7, 7, 7, 7, 15, 11, 14, 13, 28,
+  20, 22, 20, 20, 22, 22, 22, 23, 22, 23, 23, 23, 23, 23, 24, 23,
+  24, 24, 22, 23, 24, 23, 23, 23, 23, 21, 22, 23, 22, 23, 23, 24,
+  22, 21, 20, 22, 22, 23, 23, 21, 23, 22, 22, 24, 21, 22, 23, 23,
+  21, 21, 22, 21, 23, 22, 23, 23, 20, 22, 22, 22, 23, 22, 22, 23,
+  26, 26, 20, 19, 22, 23, 22, 25, 26, 26, 26, 27, 27, 26, 24, 25,
+  19, 21, 26, 27, 27, 26, 27, 24, 21, 21, 26, 26, 28, 27, 27, 27,
+  20, 24, 20, 21, 22, 21, 21, 23, 22, 22, 25, 25, 24, 24, 26, 23,
+  26, 27, 26, 26, 27, 27, 27, 27, 27, 28, 27, 27, 27, 27, 27, 26,
+};
+
+constexpr std::uint32_t eosCode = 0x3fffffff;
+constexpr std::uint8_t eosCodeLength = 30;
+constexpr int eosSymbol = 256;
+
+constexpr std::size_t entryOverhead = 32;
+
+// Values that differ in almost every response only pollute the dynamic table
+constexpr std::array notIndexedHeaders{
+  "content-length"sv, "content-range"sv, "date"sv, "etag"sv, "last-modified"sv, "location"sv,
+};
+// Never indexed, so that intermediaries do not compress them either (RFC 7541, 7.1.3)
+constexpr std::array sensitiveHeaders{"authorization"sv, "cookie"sv, "proxy-authorization"sv, "set-cookie"sv};
+
+template<std::size_t N>
+bool contains(const std::array<std::string_view, N>& names, std::string_view name)
+{
+    return std::find(names.begin(), names.end(), name) != names.end();
+}
+
+// A binary tree of the Huffman code, it is walked bit by bit while decoding
+class HuffmanTree final
+{
+public:
+    HuffmanTree()
+    {
+        m_nodes.emplace_back();
+        for (int symbol = 0; symbol < eosSymbol; ++symbol) {
+            this->add(symbol, huffmanCodes[symbol], huffmanCodeLengths[symbol]);
+        }
+        this->add(eosSymbol, eosCode, eosCodeLength);
+    }
+
+    struct Node
+    {
+        std::array<std::int16_t, 2> children{-1, -1};
+        std::int16_t symbol = -1;
+    };
+
+    [[nodiscard]] const Node& node(std::size_t index) const noexcept
+    {
+        return m_nodes[index];
+    }
+
+private:
+    void add(int symbol, std::uint32_t code, std::uint8_t length)
+    {
+        std::size_t current = 0;
+        for (int bit = length - 1; bit >= 0; --bit) {
+            const auto branch = (code >> bit) & 1U;
+            if (m_nodes[current].children[branch] < 0) {
+                m_nodes[current].children[branch] = static_cast<std::int16_t>(m_nodes.size());
+                m_nodes.emplace_back();
+            }
+            current = static_cast<std::size_t>(m_nodes[current].children[branch]);
+        }
+        m_nodes[current].symbol = static_cast<std::int16_t>(symbol);
+    }
+
+    std::vector<Node> m_nodes;
+};
+
+const HuffmanTree& huffmanTree()
+{
+    static const HuffmanTree tree;
+    return tree;
+}
+
+class BlockReader final
+{
+public:
+    explicit BlockReader(gsl::span<const std::uint8_t> data)
+      : m_data(data)
+    {}
+
+    [[nodiscard]] bool atEnd() const noexcept
+    {
+        return m_pos == m_data.size();
+    }
+
+    [[nodiscard]] std::uint8_t peek() const
+    {
+        if (this->atEnd()) {
+            throw HpackError("Truncated header block");
+        }
+        return m_data[m_pos];
+    }
+
+    std::uint64_t integer(int prefixBits)
+    {
+        const auto prefixMax = static_cast<std::uint8_t>((1U << prefixBits) - 1);
+        std::uint64_t value = this->peek() & prefixMax;
+        ++m_pos;
+        if (value < prefixMax) {
+            return value;
+        }
+
+        for (int shift = 0;; shift += 7) {
+            if (shift > 28) {
+                throw HpackError("Integer overflow");
+            }
+            const auto byte = this->peek();
+            ++m_pos;
+            value += static_cast<std::uint64_t>(byte & 0x7F) << shift;
+            if ((byte & 0x80) == 0) {
+                return value;
+            }
+        }
+    }
+
+    std::string string()
+    {
+        const bool huffman = (this->peek() & 0x80) != 0;
+        const auto size = this->integer(7);
+        if (size > m_data.size() - m_pos) {
+            throw HpackError("Truncated string literal");
+        }
+
+        const auto data = m_data.subspan(m_pos, size);
+        m_pos += size;
+        if (huffman) {
+            return huffmanDecode(data);
+        }
+        return {reinterpret_cast<const char*>(data.data()), data.size()};
+    }
+
+private:
+    gsl::span<const std::uint8_t> m_data;
+    std::size_t m_pos = 0;
+};
+
+}   // namespace
+
+HpackTable::HpackTable(std::size_t maxSize)
+  : m_maxSize(maxSize)
+{}
+
+std::size_t HpackTable::maxSize() const noexcept
+{
+    return m_maxSize;
+}
+
+std::size_t HpackTable::size() const noexcept
+{
+    return m_size;
+}
+
+void HpackTable::setMaxSize(std::size_t maxSize)
+{
+    m_maxSize = maxSize;
+    this->evict(0);
+}
+
+void HpackTable::add(std::string name, std::string value)
+{
+    const auto entrySize = name.size() + value.size() + entryOverhead;
+    if (entrySize > m_maxSize) {
+        // Not an error, the table just becomes empty (RFC 7541, 4.4)
+        m_entries.clear();
+        m_size = 0;
+        return;
+    }
+
+    this->evict(entrySize);
+    m_entries.push_front({std::move(name), std::move(value)});
+    m_size += entrySize;
+}
+
+const HpackHeader* HpackTable::get(std::size_t index) const
+{
+    static const auto staticEntries = [] {
+        std::vector<HpackHeader> entries;
+        for (const auto& [name, value] : staticTable) {
+            entries.push_back({std::string(name), std::string(value)});
+        }
+        return entries;
+    }();
+
+    if (index == 0) {
+        return nullptr;
+    }
+    if (index <= staticEntries.size()) {
+        return &staticEntries[index - 1];
+    }
+    index -= staticEntries.size() + 1;
+    return index < m_entries.size() ? &m_entries[index] : nullptr;
+}
+
+HpackTable::Match HpackTable::find(std::string_view name, std::string_view value) const
+{
+    Match match;
+    for (std::size_t i = 0; i < staticTable.size(); ++i) {
+        if (staticTable[i].first != name) {
+            continue;
+        }
+        if (staticTable[i].second == value) {
+            return {i + 1, true};
+        }
+        if (match.index == 0) {
+            match.index = i + 1;
+        }
+    }
+
+    for (std::size_t i = 0; i < m_entries.size(); ++i) {
+        if (m_entries[i].name != name) {
+            continue;
+        }
+        if (m_entries[i].value == value) {
+            return {staticTable.size() + i + 1, true};
+        }
+        if (match.index == 0) {
+            match.index = staticTable.size() + i + 1;
+        }
+    }
+    return match;
+}
+
+void HpackTable::evict(std::size_t needSize)
+{
+    while (!m_entries.empty() && m_size + needSize > m_maxSize) {
+        const auto& oldest = m_entries.back();
+        m_size -= oldest.name.size() + oldest.value.size() + entryOverhead;
+        m_entries.pop_back();
+    }
+}
+
+HpackDecoder::HpackDecoder(std::size_t maxTableSize, std::size_t maxHeaderListSize)
+  : m_table(maxTableSize)
+  , m_maxTableSize(maxTableSize)
+  , m_maxHeaderListSize(maxHeaderListSize)
+{}
+
+std::optional<std::vector<HpackHeader>> HpackDecoder::decode(gsl::span<const std::uint8_t> block)
+{
+    std::vector<HpackHeader> headers;
+    BlockReader in(block);
+    bool headerSeen = false;
+
+    // Counted before a field is copied: a few bytes of indexed references can expand to a huge list
+    std::size_t listSize = 0;
+    bool tooLarge = false;
+    const auto fits = [&](const std::string& name, const std::string& value) {
+        listSize += name.size() + value.size() + entryOverhead;
+        if (!tooLarge && listSize > m_maxHeaderListSize) {
+            tooLarge = true;
+            headers = {};
+        }
+        return !tooLarge;
+    };
+
+    while (!in.atEnd()) {
+        const auto first = in.peek();
+
+        if ((first & 0x80) != 0) {
+            // Indexed header field
+            const auto* entry = m_table.get(in.integer(7));
+            if (entry == nullptr) {
+                throw HpackError("Invalid header index");
+            }
+            if (fits(entry->name, entry->value)) {
+                headers.push_back(*entry);
+            }
+            headerSeen = true;
+            continue;
+        }
+
+        if ((first & 0xE0) == 0x20) {
+            // Dynamic table size update, allowed only at the beginning of the block
+            const auto size = in.integer(5);
+            if (headerSeen || size > m_maxTableSize) {
+                throw HpackError("Invalid dynamic table size update");
+            }
+            m_table.setMaxSize(size);
+            continue;
+        }
+
+        // Literal header field: with incremental indexing (01), without indexing (0000) or never indexed (0001)
+        const bool indexing = (first & 0xC0) == 0x40;
+        const auto nameIndex = in.integer(indexing ? 6 : 4);
+        HpackHeader header;
+        if (nameIndex == 0) {
+            header.name = in.string();
+        } else {
+            const auto* entry = m_table.get(nameIndex);
+            if (entry == nullptr) {
+                throw HpackError("Invalid header name index");
+            }
+            header.name = entry->name;
+        }
+        header.value = in.string();
+
+        if (indexing) {
+            m_table.add(header.name, header.value);
+        }
+        if (fits(header.name, header.value)) {
+            headers.emplace_back(std::move(header));
+        }
+        headerSeen = true;
+    }
+
+    if (tooLarge) {
+        return std::nullopt;
+    }
+    return headers;
+}
+
+void HpackEncoder::setMaxTableSize(std::size_t size)
+{
+    // The table is never larger than the default, even if the peer allows it
+    const auto newSize = std::min(size, hpackDefaultTableSize);
+    if (newSize != m_table.maxSize()) {
+        m_table.setMaxSize(newSize);
+        m_pendingSizeUpdate = newSize;
+    }
+}
+
+void HpackEncoder::encode(std::string& out, const std::vector<HpackHeaderRef>& headers)
+{
+    if (m_pendingSizeUpdate.has_value()) {
+        hpackEncodeInteger(out, *m_pendingSizeUpdate, 5, 0x20);
+        m_pendingSizeUpdate.reset();
+    }
+
+    for (const auto& [name, value] : headers) {
+        this->encodeHeader(out, name, value);
+    }
+}
+
+void HpackEncoder::encodeHeader(std::string& out, std::string_view name, std::string_view value)
+{
+    const auto match = m_table.find(name, value);
+    if (match.valueMatches) {
+        hpackEncodeInteger(out, match.index, 7, 0x80);
+        return;
+    }
+
+    const bool sensitive = contains(sensitiveHeaders, name);
+    const bool indexing = !sensitive && !contains(notIndexedHeaders, name) &&
+                          name.size() + value.size() + entryOverhead <= m_table.maxSize() / 2;
+
+    if (indexing) {
+        hpackEncodeInteger(out, match.index, 6, 0x40);
+    } else {
+        hpackEncodeInteger(out, match.index, 4, sensitive ? 0x10 : 0x00);
+    }
+    if (match.index == 0) {
+        hpackEncodeString(out, name);
+    }
+    hpackEncodeString(out, value);
+
+    if (indexing) {
+        m_table.add(std::string(name), std::string(value));
+    }
+}
+
+void hpackEncodeInteger(std::string& out, std::uint64_t value, int prefixBits, std::uint8_t flags)
+{
+    const auto prefixMax = static_cast<std::uint8_t>((1U << prefixBits) - 1);
+    if (value < prefixMax) {
+        out += static_cast<char>(flags | static_cast<std::uint8_t>(value));
+        return;
+    }
+
+    out += static_cast<char>(flags | prefixMax);
+    value -= prefixMax;
+    while (value >= 0x80) {
+        out += static_cast<char>((value & 0x7F) | 0x80);
+        value >>= 7;
+    }
+    out += static_cast<char>(value);
+}
+
+void hpackEncodeString(std::string& out, std::string_view str)
+{
+    const auto huffmanSize = huffmanEncodedSize(str);
+    if (huffmanSize < str.size()) {
+        hpackEncodeInteger(out, huffmanSize, 7, 0x80);
+        huffmanEncode(out, str);
+    } else {
+        hpackEncodeInteger(out, str.size(), 7);
+        out += str;
+    }
+}
+
+std::size_t huffmanEncodedSize(std::string_view str) noexcept
+{
+    std::size_t bits = 0;
+    for (const auto ch : str) {
+        bits += huffmanCodeLengths[static_cast<std::uint8_t>(ch)];
+    }
+    return (bits + 7) / 8;
+}
+
+void huffmanEncode(std::string& out, std::string_view str)
+{
+    std::uint64_t acc = 0;
+    int accBits = 0;
+    for (const auto ch : str) {
+        const auto symbol = static_cast<std::uint8_t>(ch);
+        acc = acc << huffmanCodeLengths[symbol] | huffmanCodes[symbol];
+        accBits += huffmanCodeLengths[symbol];
+        while (accBits >= 8) {
+            accBits -= 8;
+            out += static_cast<char>(acc >> accBits);
+        }
+    }
+
+    if (accBits > 0) {
+        // Padded with the most significant bits of EOS, that is with ones
+        out += static_cast<char>(acc << (8 - accBits) | (0xFFU >> accBits));
+    }
+}
+
+std::string huffmanDecode(gsl::span<const std::uint8_t> data)
+{
+    const auto& tree = huffmanTree();
+
+    std::string result;
+    result.reserve(data.size() * 8 / 5);
+
+    std::size_t current = 0;
+    int depth = 0;
+    bool allOnes = true;
+    for (const auto byte : data) {
+        for (int bit = 7; bit >= 0; --bit) {
+            const auto branch = (byte >> bit) & 1U;
+            const auto next = tree.node(current).children[branch];
+            if (next < 0) {
+                throw HpackError("Invalid Huffman code");
+            }
+
+            current = static_cast<std::size_t>(next);
+            ++depth;
+            allOnes = allOnes && branch == 1;
+
+            const auto symbol = tree.node(current).symbol;
+            if (symbol == eosSymbol) {
+                throw HpackError("EOS in Huffman string");
+            }
+            if (symbol >= 0) {
+                result += static_cast<char>(symbol);
+                current = 0;
+                depth = 0;
+                allOnes = true;
+            }
+        }
+    }
+
+    // The padding is shorter than 8 bits and consists of the EOS prefix
+    if (depth > 7 || !allOnes) {
+        throw HpackError("Invalid Huffman padding");
+    }
+    return result;
+}
+
+// NOLINTEND(readability-magic-numbers)
+
+}   // namespace royalbed::server::detail
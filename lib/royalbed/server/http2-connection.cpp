@@ -0,0 +1,1630 @@
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <charconv>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+#include <gsl/span>
+
+#include "spdlog/logger.h"
+
+#include "nhope/async/ao-context-close-handler.h"
+#include "nhope/async/ao-context.h"
+#include "nhope/async/future.h"
+#include "nhope/async/timer.h"
+#include "nhope/io/io-device.h"
+
+#include "royalbed/common/detail/string-utils.h"
+#include "royalbed/server/detail/connection.h"
+#include "royalbed/server/detail/hpack.h"
+#include "royalbed/server/detail/http2-connection.h"
+#include "royalbed/server/detail/http2-frame.h"
+#include "royalbed/server/detail/process-request.h"
+#include "royalbed/server/detail/timer-wheel.h"
+#include "royalbed/server/error.h"
+#include "royalbed/server/http-status.h"
+#include "royalbed/server/request-context.h"
+#include "royalbed/server/request.h"
+#include "royalbed/server/response.h"
+#include "royalbed/server/uri.h"
+
+namespace royalbed::server::detail {
+namespace {
+using namespace std::literals;
+using common::detail::toLower;
+using common::detail::trim;
+
+constexpr std::size_t readChunkSize = 64 * 1024;
+
+// DATA frames are prepared while less than this is waiting to be written
+constexpr std::size_t maxQueuedOutput = 64 * 1024;
+// Queued frames are written together up to this size
+constexpr std::size_t writeBatchSize = 64 * 1024;
+constexpr std::size_t responseChunkSize = 16 * 1024;
+
+constexpr std::size_t priorityFieldsSize = 5;
+constexpr std::size_t pingSize = 8;
+constexpr std::size_t goAwayMinSize = 8;
+
+// RFC 9218: urgency 0 (the highest) .. 7, 3 by default
+constexpr int defaultUrgency = 3;
+constexpr int lowestUrgency = 7;
+
+// Connection-specific fields are not allowed in HTTP/2 (RFC 9113, 8.2.2)
+constexpr std::array connectionHeaders{
+  "connection"sv, "keep-alive"sv, "proxy-connection"sv, "transfer-encoding"sv, "upgrade"sv,
+};
+
+bool isConnectionHeader(std::string_view lowercaseName)
+{
+    return std::find(connectionHeaders.begin(), connectionHeaders.end(), lowercaseName) != connectionHeaders.end();
+}
+
+std::optional<std::string> fromBase64Url(std::string_view str)
+{
+    // NOLINTBEGIN(readability-magic-numbers)
+    std::string result;
+    std::uint32_t acc = 0;
+    int bits = 0;
+    for (const auto ch : str) {
+        std::uint32_t value = 0;
+        if (ch >= 'A' && ch <= 'Z') {
+            value = static_cast<std::uint32_t>(ch - 'A');
+        } else if (ch >= 'a' && ch <= 'z') {
+            value = static_cast<std::uint32_t>(ch - 'a' + 26);
+        } else if (ch >= '0' && ch <= '9') {
+            value = static_cast<std::uint32_t>(ch - '0' + 52);
+        } else if (ch == '-' || ch == '+') {
+            value = 62;
+        } else if (ch == '_' || ch == '/') {
+            value = 63;
+        } else if (ch == '=') {
+            break;
+        } else {
+            return std::nullopt;
+        }
+
+        acc = acc << 6 | value;
+        bits += 6;
+        if (bits >= 8) {
+            bits -= 8;
+            result += static_cast<char>(acc >> bits);
+        }
+    }
+    return result;
+    // NOLINTEND(readability-magic-numbers)
+}
+
+gsl::span<const std::uint8_t> asBytes(std::string_view str)
+{
+    return {reinterpret_cast<const std::uint8_t*>(str.data()), str.size()};
+}
+
+// Splits a structured field dictionary into members, commas inside strings are skipped (RFC 8941, 3.2)
+std::vector<std::string_view> splitSfDictionary(std::string_view value)
+{
+    std::vector<std::string_view> members;
+    std::size_t begin = 0;
+    bool quoted = false;
+    for (std::size_t i = 0; i < value.size(); ++i) {
+        if (quoted && value[i] == '\\') {
+            ++i;
+        } else if (value[i] == '"') {
+            quoted = !quoted;
+        } else if (!quoted && value[i] == ',') {
+            members.push_back(value.substr(begin, i - begin));
+            begin = i + 1;
+        }
+    }
+    members.push_back(value.substr(begin));
+    return members;
+}
+
+bool isSfKey(std::string_view key)
+{
+    const auto isLcAlpha = [](char ch) {
+        return ch >= 'a' && ch <= 'z';
+    };
+    if (key.empty() || (!isLcAlpha(key.front()) && key.front() != '*')) {
+        return false;
+    }
+    return std::all_of(key.begin(), key.end(), [&isLcAlpha](char ch) {
+        return isLcAlpha(ch) || (ch >= '0' && ch <= '9') || ch == '_' || ch == '-' || ch == '.' || ch == '*';
+    });
+}
+
+// The urgency from the Priority header field (RFC 9218, 4), e.g. "u=1, i".
+// The field is a structured field dictionary: the last "u" member wins, a malformed field is ignored.
+int requestUrgency(const Headers& headers)
+{
+    const auto it = headers.find("priority");
+    if (it == headers.end()) {
+        return defaultUrgency;
+    }
+
+    int urgency = defaultUrgency;
+    for (auto member : splitSfDictionary(it->second)) {
+        member = trim(member);
+        if (member.empty()) {
+            return defaultUrgency;
+        }
+
+        // The parameters of the member are not used
+        member = member.substr(0, member.find(';'));
+        const auto eq = member.find('=');
+        if (!isSfKey(member.substr(0, eq))) {
+            return defaultUrgency;
+        }
+        if (member.substr(0, eq) != "u") {
+            continue;
+        }
+
+        // Only an integer in the range sets the urgency, "u" without a value is the boolean true
+        urgency = defaultUrgency;
+        if (eq == std::string_view::npos) {
+            continue;
+        }
+        const auto number = member.substr(eq + 1);
+        int value = 0;
+        const auto [end, ec] = std::from_chars(number.data(), number.data() + number.size(), value);
+        if (ec == std::errc() && end == number.data() + number.size() && value >= 0 && value <= lowestUrgency) {
+            urgency = value;
+        }
+    }
+    return urgency;
+}
+
+// The request body of a stream. The connection pushes DATA frames into it,
+// the handler reads it through StreamBodyReader.
+class StreamInput final
+{
+public:
+    using Waiter = std::function<void()>;
+    using ConsumedHandler = std::function<void(std::size_t n)>;
+
+    explicit StreamInput(ConsumedHandler consumed)
+      : m_consumed(std::move(consumed))
+    {}
+
+    void push(gsl::span<const std::uint8_t> data)
+    {
+        this->update([&] {
+            m_chunks.emplace_back(data.begin(), data.end());
+            m_size += data.size();
+        });
+    }
+
+    void finish()
+    {
+        this->update([&] {
+            m_eof = true;
+        });
+    }
+
+    void reset()
+    {
+        this->update([&] {
+            m_reset = true;
+        });
+    }
+
+    [[nodiscard]] std::size_t buffered() const
+    {
+        std::scoped_lock lock(m_mutex);
+        return m_size;
+    }
+
+    // Returns nullopt if there is no data yet, the waiter is called when something arrives
+    std::optional<std::size_t> takeOrWait(gsl::span<std::uint8_t> buf, Waiter waiter)
+    {
+        std::size_t n = 0;
+        {
+            std::scoped_lock lock(m_mutex);
+            if (m_reset) {
+                throw std::runtime_error("The request stream was reset");
+            }
+
+            while (!m_chunks.empty() && n < buf.size()) {
+                const auto& chunk = m_chunks.front();
+                const auto size = std::min(buf.size() - n, chunk.size() - m_frontOffset);
+                std::memcpy(buf.data() + n, chunk.data() + m_frontOffset, size);
+                n += size;
+                m_frontOffset += size;
+                if (m_frontOffset == chunk.size()) {
+                    m_frontOffset = 0;
+                    m_chunks.pop_front();
+                }
+            }
+            m_size -= n;
+
+            if (n == 0 && !m_eof && !buf.empty()) {
+                m_waiter = std::move(waiter);
+                return std::nullopt;
+            }
+        }
+
+        if (n > 0) {
+            m_consumed(n);
+        }
+        return n;
+    }
+
+private:
+    template<typename Fn>
+    void update(Fn&& fn)
+    {
+        Waiter waiter;
+        {
+            std::scoped_lock lock(m_mutex);
+            fn();
+            waiter = std::exchange(m_waiter, nullptr);
+        }
+        if (waiter) {
+            waiter();
+        }
+    }
+
+    mutable std::mutex m_mutex;
+    std::deque<std::vector<std::uint8_t>> m_chunks;
+    std::size_t m_frontOffset = 0;
+    std::size_t m_size = 0;
+    bool m_eof = false;
+    bool m_reset = false;
+    Waiter m_waiter;
+    ConsumedHandler m_consumed;
+};
+
+class StreamBodyReader final : public nhope::Reader
+{
+public:
+    StreamBodyReader(nhope::AOContext& parent, std::shared_ptr<StreamInput> input)
+      : m_input(std::move(input))
+      , m_aoCtx(parent)
+    {}
+
+    ~StreamBodyReader() override
+    {
+        m_aoCtx.close();
+    }
+
+    void read(gsl::span<std::uint8_t> buf, nhope::IOHandler handler) override
+    {
+        auto waiter = [this, aoCtx = nhope::AOContextRef(m_aoCtx), buf, handler]() mutable {
+            aoCtx.exec([this, buf, handler = std::move(handler)] {
+                this->read(buf, handler);
+            });
+        };
+
+        std::optional<std::size_t> n;
+        try {
+            n = m_input->takeOrWait(buf, std::move(waiter));
+        } catch (...) {
+            m_aoCtx.exec([handler = std::move(handler), ex = std::current_exception()] {
+                handler(ex, 0);
+            });
+            return;
+        }
+
+        if (n.has_value()) {
+            m_aoCtx.exec([handler = std::move(handler), n = *n] {
+                handler(nullptr, n);
+            });
+        }
+    }
+
+private:
+    std::shared_ptr<StreamInput> m_input;
+    nhope::AOContext m_aoCtx;
+};
+
+struct Stream
+{
+    std::uint32_t id = 0;
+    std::uint32_t sessionNum = 0;
+    int urgency = defaultUrgency;
+
+    std::unique_ptr<RequestContext> ctx;
+
+    // Receiving the request body
+    std::shared_ptr<StreamInput> input;
+    bool remoteClosed = false;
+    std::int64_t recvWindow = 0;
+    std::size_t unackedBytes = 0;
+    std::optional<std::uint64_t> expectedLength;
+    std::uint64_t receivedLength = 0;
+
+    // Sending the response
+    std::int64_t sendWindow = 0;
+    bool responding = false;
+    nhope::ReaderPtr body;
+    TrailersProvider trailers;
+    std::vector<std::uint8_t> outBuf;
+    std::size_t outPos = 0;
+    std::size_t outSize = 0;
+    bool reading = false;
+    bool bodyEof = false;
+};
+
+class Http2Connection final : public nhope::AOContextCloseHandler
+{
+public:
+    Http2Connection(nhope::AOContext& parent, Http2ConnectionParams&& params, nhope::Promise<void>&& promise)
+      : m_num(params.num)
+      , m_ctx(params.ctx)
+      , m_log(std::move(params.log))
+      , m_params(params.http2)
+      , m_in(params.in)
+      , m_out(params.out)
+      , m_upgradeRequest(std::move(params.upgradeRequest))
+      , m_upgradeSettings(std::move(params.upgradeSettings))
+      , m_maxBodySize(params.limits.maxBodySize)
+      , m_maxDecodedBodySize(params.limits.maxDecodedBodySize)
+      , m_timeouts(params.timeouts)
+      , m_lifetime(params.keepAlive.timeout)
+      , m_leftStreams(params.keepAlive.requestsCount > 0 ? params.keepAlive.requestsCount : 1)
+      , m_promise(std::move(promise))
+      , m_inBuf(readChunkSize)
+      , m_decoder(hpackDefaultTableSize, m_params.maxHeaderListSize)
+      , m_aoCtx(parent)
+      , m_aoCtxRef(m_aoCtx)
+      , m_idleDeadline(params.timers, m_aoCtx)
+      , m_settingsDeadline(params.timers, m_aoCtx)
+      , m_headerDeadline(params.timers, m_aoCtx)
+      , m_pingDeadline(params.timers, m_aoCtx)
+    {
+        m_params.initialWindowSize = std::clamp(m_params.initialWindowSize, http2DefaultWindowSize, http2MaxWindowSize);
+        m_params.maxFrameSize = std::clamp(m_params.maxFrameSize, http2MinMaxFrameSize, http2MaxMaxFrameSize);
+        m_connRecvWindow = m_params.initialWindowSize;
+
+        m_aoCtx.startCancellableTask(
+          [this] {
+              this->start();
+          },
+          *this);
+    }
+
+private:
+    ~Http2Connection() override
+    {
+        assert(m_finished);   // NOLINT
+        m_aoCtx.removeCloseHandler(*this);
+    }
+
+    void aoContextClose() noexcept override
+    {
+        if (!m_finished) {
+            this->finish();
+        }
+        delete this;
+    }
+
+    void start()
+    {
+        nhope::setTimeout(m_aoCtx, m_lifetime, [this](auto) {
+            this->goAway("keep-alive timeout");
+            this->writeNext();
+        });
+        this->armIdle();
+        m_settingsDeadline.arm(m_timeouts.header, [this] {
+            this->connectionError(Http2ErrorCode::SettingsTimeout, "SETTINGS timeout");
+        });
+
+        // The server connection preface
+        this->enqueue(encodeHttp2Settings({
+          {Http2Setting::EnablePush, 0},
+          {Http2Setting::MaxConcurrentStreams, m_params.maxConcurrentStreams},
+          {Http2Setting::InitialWindowSize, m_params.initialWindowSize},
+          {Http2Setting::MaxFrameSize, m_params.maxFrameSize},
+          {Http2Setting::MaxHeaderListSize, m_params.maxHeaderListSize},
+        }));
+        if (m_params.initialWindowSize > http2DefaultWindowSize) {
+            this->enqueue(encodeHttp2WindowUpdate(0, m_params.initialWindowSize - http2DefaultWindowSize));
+        }
+
+        if (m_upgradeRequest.has_value()) {
+            try {
+                this->applyPeerSettings(parseHttp2Settings(asBytes(m_upgradeSettings)));
+            } catch (const Http2Error& e) {
+                this->connectionError(e.code(), e.what());
+                return;
+            }
+
+            // The upgrade request is stream 1, half-closed by the client (RFC 7540, 3.2)
+            m_lastStreamId = 1;
+            auto request = std::move(*m_upgradeRequest);
+            m_upgradeRequest.reset();
+            this->openStream(1, std::move(request), true, false);
+        }
+
+        this->writeNext();
+        this->readNext();
+    }
+
+    // Input
+
+    void readNext()
+    {
+        if (m_inBegin > 0) {
+            std::memmove(m_inBuf.data(), m_inBuf.data() + m_inBegin, m_inEnd - m_inBegin);
+            m_inEnd -= m_inBegin;
+            m_inBegin = 0;
+        }
+        const auto needSize = std::max(m_inEnd + readChunkSize / 4, m_needSize);
+        if (m_inBuf.size() < needSize) {
+            m_inBuf.resize(std::max(needSize, m_inBuf.size() * 2));
+        }
+
+        m_in.read(gsl::span(m_inBuf).subspan(m_inEnd), [this, aoCtx = m_aoCtxRef](auto err, auto n) mutable {
+            aoCtx.exec([this, err = std::move(err), n] {
+                if (m_closing) {
+                    return;
+                }
+                if (err) {
+                    this->finish();
+                    return;
+                }
+                if (n == 0) {
+                    this->inputClosed();
+                    return;
+                }
+
+                m_inEnd += n;
+                try {
+                    this->processInput();
+                } catch (const Http2Error& e) {
+                    this->connectionError(e.code(), e.what());
+                }
+                if (!m_closing) {
+                    this->armPing();
+                    this->readNext();
+                }
+
+                // May finish the connection, so it goes last
+                this->writeNext();
+            });
+        });
+    }
+
+    // The requests already received are still answered
+    void inputClosed()
+    {
+        m_log->trace("HTTP/2 connection closed by the client");
+        m_peerGoAway = true;
+
+        std::vector<std::uint32_t> incomplete;
+        for (const auto& [id, stream] : m_streams) {
+            if (!stream->remoteClosed) {
+                incomplete.push_back(id);
+            }
+        }
+        for (const auto id : incomplete) {
+            this->removeStream(id);
+        }
+
+        if (m_streams.empty()) {
+            m_finishAfterWrite = true;
+        }
+        this->writeNext();
+    }
+
+    void processInput()
+    {
+        m_needSize = 0;
+        while (!m_closing) {
+            const auto data = gsl::span<const std::uint8_t>(m_inBuf).subspan(m_inBegin, m_inEnd - m_inBegin);
+
+            if (!m_prefaceReceived) {
+                if (data.size() < http2Preface.size()) {
+                    return;
+                }
+                if (!std::equal(http2Preface.begin(), http2Preface.end(), data.begin())) {
+                    throw Http2Error(Http2ErrorCode::ProtocolError, "Invalid connection preface");
+                }
+                m_inBegin += http2Preface.size();
+                m_prefaceReceived = true;
+                continue;
+            }
+
+            if (data.size() < http2FrameHeaderSize) {
+                return;
+            }
+            const auto header = parseHttp2FrameHeader(data);
+            if (header.length > m_params.maxFrameSize) {
+                throw Http2Error(Http2ErrorCode::FrameSizeError, "Frame is too large");
+            }
+            const auto frameSize = http2FrameHeaderSize + header.length;
+            if (data.size() < frameSize) {
+                m_needSize = frameSize;
+                return;
+            }
+            m_inBegin += frameSize;
+
+            try {
+                this->processFrame(header, data.subspan(http2FrameHeaderSize, header.length));
+            } catch (const Http2Error& e) {
+                if (e.streamId() == 0) {
+                    throw;
+                }
+                m_log->debug("HTTP/2 stream {} error: {}", e.streamId(), e.what());
+                this->resetStream(e.streamId(), e.code());
+                this->countReset();
+            }
+        }
+    }
+
+    void processFrame(const Http2FrameHeader& header, gsl::span<const std::uint8_t> payload)
+    {
+        if (!m_settingsReceived && header.type != Http2FrameType::Settings) {
+            throw Http2Error(Http2ErrorCode::ProtocolError, "SETTINGS expected");
+        }
+        if (m_continuationStreamId != 0 &&
+            (header.type != Http2FrameType::Continuation || header.streamId != m_continuationStreamId)) {
+            throw Http2Error(Http2ErrorCode::ProtocolError, "CONTINUATION expected");
+        }
+
+        switch (header.type) {
+        case Http2FrameType::Data:
+            this->onData(header, payload);
+            break;
+        case Http2FrameType::Headers:
+            this->onHeaders(header, payload);
+            break;
+        case Http2FrameType::Priority:
+            this->onPriority(header, payload);
+            break;
+        case Http2FrameType::RstStream:
+            this->onRstStream(header, payload);
+            break;
+        case Http2FrameType::Settings:
+            this->onSettings(header, payload);
+            break;
+        case Http2FrameType::PushPromise:
+            throw Http2Error(Http2ErrorCode::ProtocolError, "PUSH_PROMISE from the client");
+        case Http2FrameType::Ping:
+            this->onPing(header, payload);
+            break;
+        case Http2FrameType::GoAway:
+            this->onGoAway(header, payload);
+            break;
+        case Http2FrameType::WindowUpdate:
+            this->onWindowUpdate(header, payload);
+            break;
+        case Http2FrameType::Continuation:
+            this->onContinuation(header, payload);
+            break;
+        default:
+            // Unknown frame types are ignored (RFC 9113, 4.1)
+            break;
+        }
+    }
+
+    static gsl::span<const std::uint8_t> removePadding(const Http2FrameHeader& header,
+                                                       gsl::span<const std::uint8_t> payload)
+    {
+        if ((header.flags & http2Flags::padded) == 0) {
+            return payload;
+        }
+        if (payload.empty() || payload[0] >= payload.size()) {
+            throw Http2Error(Http2ErrorCode::ProtocolError, "Invalid padding");
+        }
+        return payload.subspan(1, payload.size() - 1 - payload[0]);
+    }
+
+    void onData(const Http2FrameHeader& header, gsl::span<const std::uint8_t> payload)
+    {
+        if (header.streamId == 0) {
+            throw Http2Error(Http2ErrorCode::ProtocolError, "DATA on stream 0");
+        }
+
+        m_connRecvWindow -= header.length;
+        if (m_connRecvWindow < 0) {
+            throw Http2Error(Http2ErrorCode::FlowControlError, "Connection flow-control window exceeded");
+        }
+
+        const auto data = removePadding(header, payload);
+        auto* stream = this->findStream(header.streamId);
+        if (stream == nullptr || stream->remoteClosed) {
+            if (header.streamId > m_lastStreamId) {
+                throw Http2Error(Http2ErrorCode::ProtocolError, "DATA on an idle stream");
+            }
+            // The frames sent before the client learned that the stream is closed only take the window back
+            this->creditConnection(header.length);
+            if (stream != nullptr) {
+                throw Http2Error(Http2ErrorCode::StreamClosed, "DATA after END_STREAM", header.streamId);
+            }
+            return;
+        }
+
+        stream->recvWindow -= header.length;
+        if (stream->recvWindow < 0) {
+            this->creditConnection(header.length);
+            throw Http2Error(Http2ErrorCode::FlowControlError, "Stream flow-control window exceeded", header.streamId);
+        }
+
+        stream->receivedLength += data.size();
+        if (stream->expectedLength.has_value() && stream->receivedLength > *stream->expectedLength) {
+            this->creditConnection(header.length);
+            throw Http2Error(Http2ErrorCode::ProtocolError, "Body is longer than Content-Length", header.streamId);
+        }
+
+        // The padding is consumed right away
+        const auto padding = header.length - data.size();
+        stream->unackedBytes += padding;
+        m_connUnackedBytes += padding;
+
+        if (!data.empty()) {
+            stream->input->push(data);
+        }
+        if ((header.flags & http2Flags::endStream) != 0) {
+            this->closeRemote(*stream);
+        }
+        this->updateWindows(stream);
+    }
+
+    void onHeaders(const Http2FrameHeader& header, gsl::span<const std::uint8_t> payload)
+    {
+        if (header.streamId == 0) {
+            throw Http2Error(Http2ErrorCode::ProtocolError, "HEADERS on stream 0");
+        }
+
+        auto block = removePadding(header, payload);
+        if ((header.flags & http2Flags::priority) != 0) {
+            // The priority fields are deprecated (RFC 9113, 5.3.2), only skipped
+            if (block.size() < priorityFieldsSize) {
+                throw Http2Error(Http2ErrorCode::FrameSizeError, "Invalid HEADERS size");
+            }
+            block = block.subspan(priorityFieldsSize);
+        }
+
+        m_headerBlock.assign(block.begin(), block.end());
+        m_headerStreamId = header.streamId;
+        m_headerEndStream = (header.flags & http2Flags::endStream) != 0;
+
+        if ((header.flags & http2Flags::endHeaders) != 0) {
+            this->headersComplete();
+        } else {
+            m_continuationStreamId = header.streamId;
+            m_headerDeadline.arm(m_timeouts.header, [this] {
+                this->connectionError(Http2ErrorCode::EnhanceYourCalm, "Header block timeout");
+            });
+        }
+    }
+
+    void onContinuation(const Http2FrameHeader& header, gsl::span<const std::uint8_t> payload)
+    {
+        if (m_continuationStreamId == 0) {
+            throw Http2Error(Http2ErrorCode::ProtocolError, "Unexpected CONTINUATION");
+        }
+
+        m_headerBlock.insert(m_headerBlock.end(), payload.begin(), payload.end());
+        if (m_headerBlock.size() > 2 * static_cast<std::size_t>(m_params.maxHeaderListSize)) {
+            throw Http2Error(Http2ErrorCode::EnhanceYourCalm, "Header block is too large");
+        }
+
+        if ((header.flags & http2Flags::endHeaders) != 0) {
+            m_continuationStreamId = 0;
+            m_headerDeadline.cancel();
+            this->headersComplete();
+        }
+    }
+
+    void headersComplete()
+    {
+        std::optional<std::vector<HpackHeader>> headers;
+        try {
+            headers = m_decoder.decode(m_headerBlock);
+        } catch (const HpackError& e) {
+            throw Http2Error(Http2ErrorCode::CompressionError, e.what());
+        }
+
+        const auto id = m_headerStreamId;
+        if (auto* stream = this->findStream(id); stream != nullptr) {
+            // The trailer fields of the request are not passed to the handler
+            if (stream->remoteClosed) {
+                throw Http2Error(Http2ErrorCode::StreamClosed, "HEADERS after END_STREAM", id);
+            }
+            if (!m_headerEndStream) {
+                throw Http2Error(Http2ErrorCode::ProtocolError, "Trailers without END_STREAM", id);
+            }
+            this->closeRemote(*stream);
+            return;
+        }
+
+        if (id % 2 == 0) {
+            throw Http2Error(Http2ErrorCode::ProtocolError, "Invalid stream identifier");
+        }
+        if (id <= m_lastStreamId) {
+            // A closed stream, e.g. the trailers of a request that was answered and reset with NO_ERROR.
+            // The block is already decoded, so the compression state stays in sync (RFC 9113, 5.1)
+            return;
+        }
+        m_lastStreamId = id;
+
+        if (m_peerGoAway || m_goAwaySent || m_streams.size() >= m_params.maxConcurrentStreams) {
+            this->enqueue(encodeHttp2RstStream(id, Http2ErrorCode::RefusedStream));
+            return;
+        }
+
+        // The fields of a too large list are dropped by the decoder, the stream is answered with 431
+        const bool headersTooLarge = !headers.has_value();
+        auto request = headersTooLarge ? Request{} : makeRequest(id, std::move(*headers));
+        this->openStream(id, std::move(request), m_headerEndStream, headersTooLarge);
+
+        if (--m_leftStreams == 0) {
+            this->goAway("requests limit");
+        }
+    }
+
+    static Request makeRequest(std::uint32_t id, std::vector<HpackHeader>&& headers)
+    {
+        const auto malformed = [id](const char* message) {
+            return Http2Error(Http2ErrorCode::ProtocolError, message, id);
+        };
+
+        Request request;
+        std::string path;
+        std::string scheme;
+        std::string authority;
+        bool regularSeen = false;
+
+        for (auto& field : headers) {
+            if (field.name.empty()) {
+                throw malformed("Empty field name");
+            }
+
+            if (field.name.front() == ':') {
+                std::string* target = nullptr;
+                if (field.name == ":method") {
+                    target = &request.method;
+                } else if (field.name == ":path") {
+                    target = &path;
+                } else if (field.name == ":scheme") {
+                    target = &scheme;
+                } else if (field.name == ":authority") {
+                    target = &authority;
+                }
+
+                if (target == nullptr || regularSeen || !target->empty() || field.value.empty()) {
+                    throw malformed("Invalid pseudo-header field");
+                }
+                *target = std::move(field.value);
+                continue;
+            }
+
+            regularSeen = true;
+            if (std::any_of(field.name.begin(), field.name.end(), [](char ch) {
+                    return ch >= 'A' && ch <= 'Z';
+                })) {
+                throw malformed("Uppercase field name");
+            }
+            if (isConnectionHeader(field.name) || (field.name == "te" && field.value != "trailers")) {
+                throw malformed("Connection-specific field");
+            }
+
+            const auto separator = field.name == "cookie" ? "; "sv : ", "sv;
+            auto [it, inserted] = request.headers.emplace(std::move(field.name), field.value);
+            if (!inserted) {
+                it->second += separator;
+                it->second += field.value;
+            }
+        }
+
+        // CONNECT is not supported, so :scheme and :path are always required
+        if (request.method.empty() || path.empty() || scheme.empty()) {
+            throw malformed("Missing pseudo-header field");
+        }
+
+        try {
+            request.uri = Uri::parseRelative(path);
+        } catch (const UriParseError&) {
+            throw malformed("Invalid :path");
+        }
+
+        if (!authority.empty()) {
+            request.headers.emplace("host", std::move(authority));
+        }
+        return request;
+    }
+
+    void onPriority(const Http2FrameHeader& header, gsl::span<const std::uint8_t> /*payload*/) const
+    {
+        if (header.streamId == 0) {
+            throw Http2Error(Http2ErrorCode::ProtocolError, "PRIORITY on stream 0");
+        }
+        if (header.length != priorityFieldsSize) {
+            throw Http2Error(Http2ErrorCode::FrameSizeError, "Invalid PRIORITY size", header.streamId);
+        }
+        // The dependency tree is not used, streams are scheduled by the Priority header field
+    }
+
+    void onRstStream(const Http2FrameHeader& header, gsl::span<const std::uint8_t> payload)
+    {
+        if (header.streamId == 0 || header.streamId > m_lastStreamId) {
+            throw Http2Error(Http2ErrorCode::ProtocolError, "RST_STREAM on an idle stream");
+        }
+        if (payload.size() != 4) {
+            throw Http2Error(Http2ErrorCode::FrameSizeError, "Invalid RST_STREAM size");
+        }
+
+        if (auto* stream = this->findStream(header.streamId); stream != nullptr) {
+            stream->ctx->log->debug("the stream was reset by the client: {}", readHttp2Uint32(payload));
+            this->removeStream(header.streamId);
+            this->countReset();
+        }
+    }
+
+    // Each reset stream has already started a session, so a client that opens and resets streams
+    // at once is stopped (rapid reset, CVE-2023-44487)
+    void countReset()
+    {
+        const auto now = std::chrono::steady_clock::now();
+        if (now - m_resetPeriodStart >= std::chrono::seconds(1)) {
+            m_resetPeriodStart = now;
+            m_resetCount = 0;
+        }
+        if (++m_resetCount > m_params.maxStreamResets) {
+            throw Http2Error(Http2ErrorCode::EnhanceYourCalm, "Too many reset streams");
+        }
+    }
+
+    void onSettings(const Http2FrameHeader& header, gsl::span<const std::uint8_t> payload)
+    {
+        if (header.streamId != 0) {
+            throw Http2Error(Http2ErrorCode::ProtocolError, "SETTINGS on a stream");
+        }
+        if ((header.flags & http2Flags::ack) != 0) {
+            if (!payload.empty()) {
+                throw Http2Error(Http2ErrorCode::FrameSizeError, "SETTINGS ACK with payload");
+            }
+            m_settingsAcked = true;
+        } else {
+            this->applyPeerSettings(parseHttp2Settings(payload));
+            m_settingsReceived = true;
+            this->enqueue(encodeHttp2SettingsAck());
+        }
+
+        if (m_settingsReceived && m_settingsAcked) {
+            m_settingsDeadline.cancel();
+        }
+    }
+
+    void applyPeerSettings(const Http2Settings& settings)
+    {
+        for (const auto& [id, value] : settings) {
+            switch (id) {
+            case Http2Setting::HeaderTableSize:
+                m_encoder.setMaxTableSize(value);
+                break;
+
+            case Http2Setting::InitialWindowSize: {
+                const auto delta = static_cast<std::int64_t>(value) - m_peerInitialWindow;
+                for (auto& [streamId, stream] : m_streams) {
+                    stream->sendWindow += delta;
+                    if (stream->sendWindow > http2MaxWindowSize) {
+                        throw Http2Error(Http2ErrorCode::FlowControlError, "Stream window overflow");
+                    }
+                }
+                m_peerInitialWindow = value;
+                break;
+            }
+
+            case Http2Setting::MaxFrameSize:
+                m_peerMaxFrameSize = value;
+                break;
+
+            default:
+                break;
+            }
+        }
+    }
+
+    void onPing(const Http2FrameHeader& header, gsl::span<const std::uint8_t> payload)
+    {
+        if (header.streamId != 0) {
+            throw Http2Error(Http2ErrorCode::ProtocolError, "PING on a stream");
+        }
+        if (payload.size() != pingSize) {
+            throw Http2Error(Http2ErrorCode::FrameSizeError, "Invalid PING size");
+        }
+        if ((header.flags & http2Flags::ack) == 0) {
+            this->enqueue(encodeHttp2Ping(payload, true));
+        }
+    }
+
+    void onGoAway(const Http2FrameHeader& header, gsl::span<const std::uint8_t> payload)
+    {
+        if (header.streamId != 0) {
+            throw Http2Error(Http2ErrorCode::ProtocolError, "GOAWAY on a stream");
+        }
+        if (payload.size() < goAwayMinSize) {
+            throw Http2Error(Http2ErrorCode::FrameSizeError, "Invalid GOAWAY size");
+        }
+
+        m_log->trace("GOAWAY from the client: {}", readHttp2Uint32(payload.subspan(4, 4)));
+        m_peerGoAway = true;
+        if (m_streams.empty()) {
+            m_finishAfterWrite = true;
+        }
+    }
+
+    void onWindowUpdate(const Http2FrameHeader& header, gsl::span<const std::uint8_t> payload)
+    {
+        if (payload.size() != 4) {
+            throw Http2Error(Http2ErrorCode::FrameSizeError, "Invalid WINDOW_UPDATE size");
+        }
+
+        const auto increment = readHttp2Uint32(payload) & http2MaxWindowSize;
+        if (header.streamId == 0) {
+            if (increment == 0) {
+                throw Http2Error(Http2ErrorCode::ProtocolError, "Zero WINDOW_UPDATE");
+            }
+            m_connSendWindow += increment;
+            if (m_connSendWindow > http2MaxWindowSize) {
+                throw Http2Error(Http2ErrorCode::FlowControlError, "Connection window overflow");
+            }
+            return;
+        }
+
+        if (header.streamId > m_lastStreamId) {
+            throw Http2Error(Http2ErrorCode::ProtocolError, "WINDOW_UPDATE on an idle stream");
+        }
+        auto* stream = this->findStream(header.streamId);
+        if (stream == nullptr) {
+            return;
+        }
+        if (increment == 0) {
+            throw Http2Error(Http2ErrorCode::ProtocolError, "Zero WINDOW_UPDATE", header.streamId);
+        }
+        stream->sendWindow += increment;
+        if (stream->sendWindow > http2MaxWindowSize) {
+            throw Http2Error(Http2ErrorCode::FlowControlError, "Stream window overflow", header.streamId);
+        }
+    }
+
+    // Streams
+
+    Stream* findStream(std::uint32_t id)
+    {
+        const auto it = m_streams.find(id);
+        return it != m_streams.end() ? it->second.get() : nullptr;
+    }
+
+    void openStream(std::uint32_t id, Request&& request, bool endStream, bool headersTooLarge)
+    {
+        auto [sessionNum, log] = m_ctx.startSession(m_num);
+        log->trace("HTTP/2 stream {}", id);
+
+        auto stream = std::make_unique<Stream>();
+        stream->id = id;
+        stream->sessionNum = sessionNum;
+        stream->urgency = requestUrgency(request.headers);
+        stream->recvWindow = m_params.initialWindowSize;
+        stream->sendWindow = m_peerInitialWindow;
+        stream->input = std::make_shared<StreamInput>([this, aoCtx = m_aoCtxRef, id](std::size_t n) mutable {
+            aoCtx.exec([this, id, n] {
+                this->bodyConsumed(id, n);
+            });
+        });
+
+        if (auto it = request.headers.find("content-length"); it != request.headers.end()) {
+            std::uint64_t length = 0;
+            const auto& value = it->second;
+            const auto [end, ec] = std::from_chars(value.data(), value.data() + value.size(), length);
+            if (ec != std::errc() || end != value.data() + value.size()) {
+                m_ctx.sessionFinished(sessionNum);
+                throw Http2Error(Http2ErrorCode::ProtocolError, "Invalid Content-Length", id);
+            }
+            stream->expectedLength = length;
+        }
+
+        // NOLINTNEXTLINE(cppcoreguidelines-owning-memory)
+        stream->ctx.reset(new RequestContext{
+          .num = sessionNum,
+          .log = std::move(log),
+          .router = m_ctx.router(),
+          .request = std::move(request),
+          .rawPathParams{},
+          .response{},
+          .aoCtx = nhope::AOContext(m_aoCtx),
+          .upgrade{},
+          .maxBodySize = m_maxBodySize,
+          .maxDecodedBodySize = m_maxDecodedBodySize,
+        });
+
+        auto& ctx = *stream->ctx;
+        ctx.request.body = std::make_unique<StreamBodyReader>(ctx.aoCtx, stream->input);
+
+        auto& inserted = *m_streams.emplace(id, std::move(stream)).first->second;
+        m_idleDeadline.cancel();
+        if (endStream) {
+            this->closeRemote(inserted);
+        }
+
+        this->startProcessing(ctx, headersTooLarge).fail(ctx.aoCtx, [&ctx](auto ex) {
+            makeResponseFromError(ctx, std::move(ex));
+        }).then(m_aoCtx, [this, id] {
+            this->sendResponse(id);
+        });
+    }
+
+    static nhope::Future<void> startProcessing(RequestContext& ctx, bool headersTooLarge)
+    {
+        try {
+            if (headersTooLarge) {
+                throw HttpError(HttpStatus::RequestHeaderFieldsTooLarge);
+            }
+            return processRequest(ctx);
+        } catch (...) {
+            return nhope::makeExceptionalFuture<void>(std::current_exception());
+        }
+    }
+
+    void closeRemote(Stream& stream)
+    {
+        stream.remoteClosed = true;
+        if (stream.expectedLength.has_value() && stream.receivedLength != *stream.expectedLength) {
+            throw Http2Error(Http2ErrorCode::ProtocolError, "Body length does not match Content-Length", stream.id);
+        }
+        stream.input->finish();
+    }
+
+    void bodyConsumed(std::uint32_t id, std::size_t n)
+    {
+        m_connUnackedBytes += n;
+        auto* stream = this->findStream(id);
+        if (stream != nullptr) {
+            stream->unackedBytes += n;
+        }
+        this->updateWindows(stream);
+        this->writeNext();
+    }
+
+    void creditConnection(std::size_t n)
+    {
+        m_connUnackedBytes += n;
+        this->updateWindows(nullptr);
+    }
+
+    // The windows are returned to the client in large portions, when half of them has been consumed
+    void updateWindows(Stream* stream)
+    {
+        const auto threshold = m_params.initialWindowSize / 2;
+        if (m_connUnackedBytes >= threshold) {
+            this->enqueue(encodeHttp2WindowUpdate(0, static_cast<std::uint32_t>(m_connUnackedBytes)));
+            m_connRecvWindow += static_cast<std::int64_t>(m_connUnackedBytes);
+            m_connUnackedBytes = 0;
+        }
+
+        if (stream != nullptr && !stream->remoteClosed && stream->unackedBytes >= threshold) {
+            this->enqueue(encodeHttp2WindowUpdate(stream->id, static_cast<std::uint32_t>(stream->unackedBytes)));
+            stream->recvWindow += static_cast<std::int64_t>(stream->unackedBytes);
+            stream->unackedBytes = 0;
+        }
+    }
+
+    void sendResponse(std::uint32_t id)
+    {
+        auto* stream = this->findStream(id);
+        if (stream == nullptr || stream->responding || m_closing) {
+            return;
+        }
+
+        auto& ctx = *stream->ctx;
+        if (ctx.response.status < HttpStatus::Ok) {
+            // Neither protocol switching nor interim responses are possible here
+            makeResponseFromError(ctx, std::make_exception_ptr(HttpError(HttpStatus::InternalServerError,
+                                                                         "Protocol switching over HTTP/2")));
+        }
+
+        auto& response = ctx.response;
+        ctx.log->trace("response: {}", response.status);
+        response.headers["Date"] = gmtDateTime();
+
+        const bool noBody = response.body == nullptr || ctx.request.method == "HEAD" ||
+                            response.status == HttpStatus::NoContent || response.status == HttpStatus::NotModified;
+
+        const auto status = std::to_string(response.status);
+        this->sendHeaders(id, ":status"sv, status, response.headers, noBody);
+        stream->responding = true;
+
+        if (noBody) {
+            this->streamCompleted(id);
+            this->writeNext();
+            return;
+        }
+
+        stream->body = std::move(response.body);
+        stream->trailers = std::move(response.trailers);
+        stream->outBuf.resize(responseChunkSize);
+        this->writeNext();
+    }
+
+    void sendHeaders(std::uint32_t id, std::string_view statusName, std::string_view status, const Headers& headers,
+                     bool endStream)
+    {
+        std::vector<std::pair<std::string, const std::string*>> lowercase;
+        lowercase.reserve(headers.size());
+        for (const auto& [name, value] : headers) {
+            auto lowercaseName = toLower(name);
+            if (!isConnectionHeader(lowercaseName)) {
+                lowercase.emplace_back(std::move(lowercaseName), &value);
+            }
+        }
+
+        std::vector<HpackHeaderRef> fields;
+        fields.reserve(lowercase.size() + 1);
+        if (!statusName.empty()) {
+            fields.emplace_back(statusName, status);
+        }
+        for (const auto& [name, value] : lowercase) {
+            fields.emplace_back(name, *value);
+        }
+
+        std::string block;
+        m_encoder.encode(block, fields);
+
+        // HEADERS and its CONTINUATION frames go one after another
+        std::size_t pos = 0;
+        do {
+            const auto size = std::min<std::size_t>(block.size() - pos, m_peerMaxFrameSize);
+            const bool first = pos == 0;
+            const bool last = pos + size == block.size();
+
+            std::uint8_t flags = last ? http2Flags::endHeaders : 0;
+            if (first && endStream) {
+                flags |= http2Flags::endStream;
+            }
+
+            std::string frame;
+            frame.reserve(http2FrameHeaderSize + size);
+            appendHttp2FrameHeader(frame, {
+                                            .length = static_cast<std::uint32_t>(size),
+                                            .type = first ? Http2FrameType::Headers : Http2FrameType::Continuation,
+                                            .flags = flags,
+                                            .streamId = id,
+                                          });
+            frame.append(block, pos, size);
+            this->enqueue(std::move(frame));
+            pos += size;
+        } while (pos < block.size());
+    }
+
+    // Both the request and the response are complete for the server
+    void streamCompleted(std::uint32_t id)
+    {
+        auto* stream = this->findStream(id);
+        if (stream == nullptr) {
+            return;
+        }
+        if (!stream->remoteClosed) {
+            // The rest of the request body is not needed (RFC 9113, 8.1)
+            this->enqueue(encodeHttp2RstStream(id, Http2ErrorCode::NoError));
+        }
+        this->removeStream(id);
+    }
+
+    void resetStream(std::uint32_t id, Http2ErrorCode code)
+    {
+        this->enqueue(encodeHttp2RstStream(id, code));
+        this->removeStream(id);
+    }
+
+    void removeStream(std::uint32_t id)
+    {
+        const auto it = m_streams.find(id);
+        if (it == m_streams.end()) {
+            return;
+        }
+
+        auto stream = std::move(it->second);
+        m_streams.erase(it);
+
+        // The body bytes the handler has not read no longer occupy the connection window
+        this->creditConnection(stream->input->buffered());
+        stream->input->reset();
+
+        stream->ctx->aoCtx.close();
+        m_ctx.sessionFinished(stream->sessionNum);
+
+        if (!m_streams.empty()) {
+            return;
+        }
+        if (m_peerGoAway || m_goAwaySent) {
+            m_finishAfterWrite = true;
+        }
+        m_pingDeadline.cancel();
+        this->armIdle();
+    }
+
+    // Timeouts
+
+    void armIdle()
+    {
+        m_idleDeadline.arm(m_timeouts.idle, [this] {
+            this->goAway("idle timeout");
+            this->writeNext();
+        });
+    }
+
+    // A client that stays silent while its streams are open is checked with PING
+    void armPing()
+    {
+        if (m_streams.empty()) {
+            m_pingDeadline.cancel();
+            return;
+        }
+
+        m_pingDeadline.arm(m_timeouts.idle, [this] {
+            this->enqueue(encodeHttp2Ping(std::array<std::uint8_t, pingSize>{}, false));
+            this->writeNext();
+            m_pingDeadline.arm(m_timeouts.header, [this] {
+                m_log->debug("HTTP/2 PING timeout");
+                this->finish();
+            });
+        });
+    }
+
+    // The streams already received are answered, new ones are refused (RFC 9113, 6.8)
+    void goAway(std::string_view reason)
+    {
+        if (m_goAwaySent || m_closing) {
+            return;
+        }
+
+        m_log->debug("HTTP/2 connection shutdown: {}", reason);
+        m_goAwaySent = true;
+        this->enqueue(encodeHttp2GoAway(m_lastStreamId, Http2ErrorCode::NoError));
+        if (m_streams.empty()) {
+            m_finishAfterWrite = true;
+        }
+    }
+
+    // Output
+
+    void enqueue(std::string frame)
+    {
+        m_queuedBytes += frame.size();
+        m_outQueue.emplace_back(std::move(frame));
+    }
+
+    // Picks the stream with the highest priority that can send now, streams of the same urgency take turns
+    Stream* nextSendingStream()
+    {
+        Stream* best = nullptr;
+        auto bestKey = std::make_tuple(lowestUrgency + 1, true, std::uint32_t{0});
+
+        for (auto& [id, stream] : m_streams) {
+            if (!stream->responding || stream->body == nullptr) {
+                continue;
+            }
+
+            const bool drained = stream->outPos == stream->outSize;
+            if (drained && !stream->bodyEof) {
+                if (!stream->reading) {
+                    this->readBody(*stream);
+                }
+                continue;
+            }
+            if (!drained && (stream->sendWindow <= 0 || m_connSendWindow <= 0)) {
+                continue;
+            }
+
+            const auto key = std::make_tuple(stream->urgency, id <= m_lastSentStreamId, id);
+            if (best == nullptr || key < bestKey) {
+                best = stream.get();
+                bestKey = key;
+            }
+        }
+        return best;
+    }
+
+    void pumpData()
+    {
+        while (m_queuedBytes < maxQueuedOutput && !m_closing) {
+            auto* stream = this->nextSendingStream();
+            if (stream == nullptr) {
+                return;
+            }
+            m_lastSentStreamId = stream->id;
+
+            if (stream->outPos == stream->outSize) {
+                this->finishBody(*stream);
+                continue;
+            }
+
+            const auto size = std::min({
+              stream->outSize - stream->outPos,
+              static_cast<std::size_t>(m_peerMaxFrameSize),
+              static_cast<std::size_t>(stream->sendWindow),
+              static_cast<std::size_t>(m_connSendWindow),
+            });
+
+            std::string frame;
+            frame.reserve(http2FrameHeaderSize + size);
+            appendHttp2FrameHeader(frame, {
+                                            .length = static_cast<std::uint32_t>(size),
+                                            .type = Http2FrameType::Data,
+                                            .flags = 0,
+                                            .streamId = stream->id,
+                                          });
+            frame.append(reinterpret_cast<const char*>(stream->outBuf.data() + stream->outPos), size);
+            this->enqueue(std::move(frame));
+
+            stream->outPos += size;
+            stream->sendWindow -= static_cast<std::int64_t>(size);
+            m_connSendWindow -= static_cast<std::int64_t>(size);
+        }
+    }
+
+    void finishBody(Stream& stream)
+    {
+        if (stream.trailers) {
+            const auto trailers = stream.trailers();
+            this->sendHeaders(stream.id, {}, {}, trailers, true);
+        } else {
+            std::string frame;
+            appendHttp2FrameHeader(frame, {
+                                            .length = 0,
+                                            .type = Http2FrameType::Data,
+                                            .flags = http2Flags::endStream,
+                                            .streamId = stream.id,
+                                          });
+            this->enqueue(std::move(frame));
+        }
+        this->streamCompleted(stream.id);
+    }
+
+    void readBody(Stream& stream)
+    {
+        stream.reading = true;
+        stream.body->read(stream.outBuf, [this, aoCtx = m_aoCtxRef, id = stream.id](auto err, auto n) mutable {
+            aoCtx.exec([this, id, err = std::move(err), n] {
+                this->bodyRead(id, err, n);
+            });
+        });
+    }
+
+    void bodyRead(std::uint32_t id, const std::exception_ptr& err, std::size_t n)
+    {
+        auto* stream = this->findStream(id);
+        if (stream == nullptr) {
+            return;
+        }
+
+        stream->reading = false;
+        if (err) {
+            try {
+                std::rethrow_exception(err);
+            } catch (const std::exception& e) {
+                stream->ctx->log->error("response body failed: {}", e.what());
+            }
+            this->resetStream(id, Http2ErrorCode::InternalError);
+            this->writeNext();
+            return;
+        }
+
+        stream->outPos = 0;
+        stream->outSize = n;
+        stream->bodyEof = n == 0;
+        this->writeNext();
+    }
+
+    void writeNext()
+    {
+        if (m_finished) {
+            return;
+        }
+
+        this->pumpData();
+        if (m_writing) {
+            return;
+        }
+
+        if (m_outQueue.empty()) {
+            if (m_finishAfterWrite) {
+                this->finish();
+            }
+            return;
+        }
+
+        m_writeBuf.clear();
+        while (!m_outQueue.empty() && m_writeBuf.size() < writeBatchSize) {
+            m_writeBuf += m_outQueue.front();
+            m_queuedBytes -= m_outQueue.front().size();
+            m_outQueue.pop_front();
+        }
+        m_writePos = 0;
+        this->writeBuffered();
+
+        // The queue has room for more DATA frames
+        this->pumpData();
+    }
+
+    void writeBuffered()
+    {
+        m_writing = true;
+        const auto data = asBytes(m_writeBuf).subspan(m_writePos);
+        m_out.write(data, [this, aoCtx = m_aoCtxRef](auto err, auto n) mutable {
+            aoCtx.exec([this, err = std::move(err), n] {
+                m_writing = false;
+                if (err) {
+                    this->finish();
+                    return;
+                }
+
+                m_writePos += n;
+                if (m_writePos < m_writeBuf.size()) {
+                    this->writeBuffered();
+                    return;
+                }
+                this->writeNext();
+            });
+        });
+    }
+
+    void connectionError(Http2ErrorCode code, std::string_view message)
+    {
+        if (m_closing) {
+            return;
+        }
+
+        m_log->debug("HTTP/2 connection error: {}", message);
+        m_closing = true;
+        m_finishAfterWrite = true;
+        this->enqueue(encodeHttp2GoAway(m_lastStreamId, code));
+        this->writeNext();
+    }
+
+    void finish()
+    {
+        if (m_finished) {
+            return;
+        }
+        m_finished = true;
+        m_closing = true;
+
+        for (auto& [id, stream] : m_streams) {
+            stream->input->reset();
+            stream->ctx->aoCtx.close();
+            m_ctx.sessionFinished(stream->sessionNum);
+        }
+        m_streams.clear();
+
+        auto promise = std::move(m_promise);
+        m_aoCtx.close();
+        promise.setValue();
+    }
+
+    const std::uint32_t m_num;
+    ConnectionCtx& m_ctx;
+    std::shared_ptr<spdlog::logger> m_log;
+    Http2Params m_params;
+
+    nhope::Reader& m_in;
+    nhope::Writter& m_out;
+
+    std::optional<Request> m_upgradeRequest;
+    std::string m_upgradeSettings;
+    const std::uint64_t m_maxBodySize;
+    const std::uint64_t m_maxDecodedBodySize;
+    const Timeouts m_timeouts;
+    const std::chrono::seconds m_lifetime;
+    std::uint32_t m_leftStreams;
+    nhope::Promise<void> m_promise;
+
+    std::vector<std::uint8_t> m_inBuf;
+    std::size_t m_inBegin = 0;
+    std::size_t m_inEnd = 0;
+    std::size_t m_needSize = 0;
+    bool m_prefaceReceived = false;
+    bool m_settingsReceived = false;
+    bool m_settingsAcked = false;
+
+    std::vector<std::uint8_t> m_headerBlock;
+    std::uint32_t m_headerStreamId = 0;
+    bool m_headerEndStream = false;
+    std::uint32_t m_continuationStreamId = 0;
+
+    HpackDecoder m_decoder;
+    HpackEncoder m_encoder;
+
+    std::map<std::uint32_t, std::unique_ptr<Stream>> m_streams;
+    std::uint32_t m_lastStreamId = 0;
+    std::uint32_t m_lastSentStreamId = 0;
+    std::chrono::steady_clock::time_point m_resetPeriodStart;
+    std::uint32_t m_resetCount = 0;
+
+    std::int64_t m_connRecvWindow = 0;
+    std::size_t m_connUnackedBytes = 0;
+    std::int64_t m_connSendWindow = http2DefaultWindowSize;
+    std::int64_t m_peerInitialWindow = http2DefaultWindowSize;
+    std::uint32_t m_peerMaxFrameSize = http2MinMaxFrameSize;
+
+    std::deque<std::string> m_outQueue;
+    std::size_t m_queuedBytes = 0;
+    std::string m_writeBuf;
+    std::size_t m_writePos = 0;
+    bool m_writing = false;
+
+    bool m_peerGoAway = false;
+    bool m_goAwaySent = false;
+    bool m_closing = false;
+    bool m_finishAfterWrite = false;
+    bool m_finished = false;
+
+    nhope::AOContext m_aoCtx;
+    nhope::AOContextRef m_aoCtxRef;
+
+    // Declared after m_aoCtx they are bound to
+    Deadline m_idleDeadline;
+    Deadline m_settingsDeadline;
+    Deadline m_headerDeadline;
+    Deadline m_pingDeadline;
+};
+
+}   // namespace
+
+nhope::Future<void> serveHttp2(nhope::AOContext& aoCtx, Http2ConnectionParams&& params)
+{
+    nhope::Promise<void> promise;
+    auto future = promise.future();
+    new Http2Connection(aoCtx, std::move(params), std::move(promise));
+    return future;
+}
+
+bool startsWithHttp2Preface(gsl::span<const std::uint8_t> data) noexcept
+{
+    // "PRI " cannot start an HTTP/1.1 request the server is able to handle
+    constexpr std::size_t minSize = 4;
+    const auto size = std::min(data.size(), http2Preface.size());
+    return size >= minSize && std::equal(data.begin(), data.begin() + static_cast<std::ptrdiff_t>(size),
+                                         http2Preface.begin());
+}
+
+std::optional<std::string> h2cUpgradeSettings(const Request& request)
+{
+    const auto& headers = request.headers;
+    const auto upgrade = headers.find("Upgrade");
+    const auto settings = headers.find("HTTP2-Settings");
+    if (upgrade == headers.end() || settings == headers.end() ||
+        !common::detail::containsToken(upgrade->second, "h2c")) {
+        return std::nullopt;
+    }
+
+    // The request body would have to be read before switching, such requests stay on HTTP/1.1
+    if (headers.contains("Transfer-Encoding")) {
+        return std::nullopt;
+    }
+    if (const auto length = headers.find("Content-Length"); length != headers.end() && length->second != "0") {
+        return std::nullopt;
+    }
+
+    auto payload = fromBase64Url(settings->second);
+    if (!payload.has_value()) {
+        return std::nullopt;
+    }
+    try {
+        parseHttp2Settings(asBytes(*payload));
+    } catch (const Http2Error&) {
+        return std::nullopt;
+    }
+    return payload;
+}
+
+}   // namespace royalbed::server::detail
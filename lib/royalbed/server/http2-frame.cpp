@@ -0,0 +1,162 @@
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+#include <gsl/span>
+
+#include "royalbed/server/detail/http2-frame.h"
+
+namespace royalbed::server::detail {
+namespace {
+
+// NOLINTBEGIN(readability-magic-numbers)
+
+constexpr std::size_t settingSize = 6;
+constexpr std::size_t pingSize = 8;
+constexpr std::uint32_t streamIdMask = 0x7fffffff;
+
+void writeBigEndian(std::string& out, std::uint32_t value, std::size_t size)
+{
+    for (std::size_t i = size; i > 0; --i) {
+        out += static_cast<char>(value >> ((i - 1) * 8));
+    }
+}
+
+std::string frame(Http2FrameType type, std::uint8_t flags, std::uint32_t streamId, std::size_t payloadSize)
+{
+    std::string out;
+    out.reserve(http2FrameHeaderSize + payloadSize);
+    appendHttp2FrameHeader(out, {
+                                  .length = static_cast<std::uint32_t>(payloadSize),
+                                  .type = type,
+                                  .flags = flags,
+                                  .streamId = streamId,
+                                });
+    return out;
+}
+
+}   // namespace
+
+Http2Error::Http2Error(Http2ErrorCode code, const std::string& message, std::uint32_t streamId)
+  : std::runtime_error(message)
+  , m_code(code)
+  , m_streamId(streamId)
+{}
+
+Http2ErrorCode Http2Error::code() const noexcept
+{
+    return m_code;
+}
+
+std::uint32_t Http2Error::streamId() const noexcept
+{
+    return m_streamId;
+}
+
+std::uint32_t readHttp2Uint32(gsl::span<const std::uint8_t> data)
+{
+    return static_cast<std::uint32_t>(data[0]) << 24 | static_cast<std::uint32_t>(data[1]) << 16 |
+           static_cast<std::uint32_t>(data[2]) << 8 | static_cast<std::uint32_t>(data[3]);
+}
+
+Http2FrameHeader parseHttp2FrameHeader(gsl::span<const std::uint8_t> data)
+{
+    return {
+      .length = static_cast<std::uint32_t>(data[0]) << 16 | static_cast<std::uint32_t>(data[1]) << 8 | data[2],
+      .type = static_cast<Http2FrameType>(data[3]),
+      .flags = data[4],
+      .streamId = readHttp2Uint32(data.subspan(5, 4)) & streamIdMask,
+    };
+}
+
+void appendHttp2FrameHeader(std::string& out, const Http2FrameHeader& header)
+{
+    writeBigEndian(out, header.length, 3);
+    out += static_cast<char>(header.type);
+    out += static_cast<char>(header.flags);
+    writeBigEndian(out, header.streamId & streamIdMask, 4);
+}
+
+Http2Settings parseHttp2Settings(gsl::span<const std::uint8_t> payload)
+{
+    if (payload.size() % settingSize != 0) {
+        throw Http2Error(Http2ErrorCode::FrameSizeError, "Invalid SETTINGS size");
+    }
+
+    Http2Settings settings;
+    for (std::size_t pos = 0; pos < payload.size(); pos += settingSize) {
+        const auto id = static_cast<Http2Setting>(payload[pos] << 8 | payload[pos + 1]);
+        const auto value = readHttp2Uint32(payload.subspan(pos + 2, 4));
+
+        switch (id) {
+        case Http2Setting::EnablePush:
+            if (value > 1) {
+                throw Http2Error(Http2ErrorCode::ProtocolError, "Invalid SETTINGS_ENABLE_PUSH");
+            }
+            break;
+        case Http2Setting::InitialWindowSize:
+            if (value > http2MaxWindowSize) {
+                throw Http2Error(Http2ErrorCode::FlowControlError, "Invalid SETTINGS_INITIAL_WINDOW_SIZE");
+            }
+            break;
+        case Http2Setting::MaxFrameSize:
+            if (value < http2MinMaxFrameSize || value > http2MaxMaxFrameSize) {
+                throw Http2Error(Http2ErrorCode::ProtocolError, "Invalid SETTINGS_MAX_FRAME_SIZE");
+            }
+            break;
+        default:
+            // Unknown settings are ignored
+            break;
+        }
+        settings.emplace_back(id, value);
+    }
+    return settings;
+}
+
+std::string encodeHttp2Settings(const Http2Settings& settings)
+{
+    auto out = frame(Http2FrameType::Settings, 0, 0, settings.size() * settingSize);
+    for (const auto& [id, value] : settings) {
+        writeBigEndian(out, static_cast<std::uint16_t>(id), 2);
+        writeBigEndian(out, value, 4);
+    }
+    return out;
+}
+
+std::string encodeHttp2SettingsAck()
+{
+    return frame(Http2FrameType::Settings, http2Flags::ack, 0, 0);
+}
+
+std::string encodeHttp2WindowUpdate(std::uint32_t streamId, std::uint32_t increment)
+{
+    auto out = frame(Http2FrameType::WindowUpdate, 0, streamId, 4);
+    writeBigEndian(out, increment & streamIdMask, 4);
+    return out;
+}
+
+std::string encodeHttp2RstStream(std::uint32_t streamId, Http2ErrorCode code)
+{
+    auto out = frame(Http2FrameType::RstStream, 0, streamId, 4);
+    writeBigEndian(out, static_cast<std::uint32_t>(code), 4);
+    return out;
+}
+
+std::string encodeHttp2GoAway(std::uint32_t lastStreamId, Http2ErrorCode code)
+{
+    auto out = frame(Http2FrameType::GoAway, 0, 0, 8);
+    writeBigEndian(out, lastStreamId & streamIdMask, 4);
+    writeBigEndian(out, static_cast<std::uint32_t>(code), 4);
+    return out;
+}
+
+std::string encodeHttp2Ping(gsl::span<const std::uint8_t> payload, bool ack)
+{
+    auto out = frame(Http2FrameType::Ping, ack ? http2Flags::ack : 0, 0, pingSize);
+    out.append(reinterpret_cast<const char*>(payload.data()), pingSize);
+    return out;
+}
+
+// NOLINTEND(readability-magic-numbers)
+
+}   // namespace royalbed::server::detail
@@ -0,0 +1,98 @@
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <exception>
+#include <memory>
+#include <string>
+#include <utility>
+
+#include <gsl/span>
+
+#include "nhope/async/ao-context.h"
+#include "nhope/async/future.h"
+#include "nhope/io/io-device.h"
+
+#include "royalbed/common/json-writer.h"
+#include "royalbed/server/json-stream.h"
+
+namespace royalbed::server {
+namespace {
+
+// Serializes the array produced by JsonArrayStream::Producer portion by portion,
+// the next portion is requested only when the previous one has been read out.
+class JsonArrayReader final : public nhope::Reader
+{
+public:
+    JsonArrayReader(nhope::AOContext& parent, JsonArrayStream::Producer producer)
+      : m_producer(std::move(producer))
+      , m_aoCtx(parent)
+    {}
+
+    void read(gsl::span<std::uint8_t> buf, nhope::IOHandler handler) override
+    {
+        if (m_pos < m_out.buffer().size() || m_finished) {
+            m_aoCtx.exec([this, buf, handler = std::move(handler)] {
+                handler(nullptr, this->readBuffered(buf));
+            });
+            return;
+        }
+
+        m_out.buffer().clear();
+        m_pos = 0;
+        if (!m_started) {
+            m_started = true;
+            m_out.beginArray();
+        }
+
+        this->produce().then(m_aoCtx, [this, buf, handler](bool hasMore) {
+            if (!hasMore) {
+                m_finished = true;
+                m_out.endArray();
+            }
+            handler(nullptr, this->readBuffered(buf));
+        }).fail(m_aoCtx, [handler](auto ex) {
+            handler(std::move(ex), 0);
+        });
+    }
+
+private:
+    nhope::Future<bool> produce()
+    {
+        try {
+            return m_producer(m_aoCtx, m_out);
+        } catch (...) {
+            return nhope::makeExceptionalFuture<bool>(std::current_exception());
+        }
+    }
+
+    std::size_t readBuffered(gsl::span<std::uint8_t> buf)
+    {
+        const auto& data = m_out.buffer();
+        const auto n = std::min(buf.size(), data.size() - m_pos);
+        std::memcpy(buf.data(), data.data() + m_pos, n);
+        m_pos += n;
+        return n;
+    }
+
+    JsonArrayStream::Producer m_producer;
+    common::JsonWriter m_out;
+    std::size_t m_pos = 0;
+    bool m_started = false;
+    bool m_finished = false;
+
+    nhope::AOContext m_aoCtx;
+};
+
+}   // namespace
+
+JsonArrayStream::JsonArrayStream(Producer producer)
+  : m_producer(std::move(producer))
+{}
+
+nhope::ReaderPtr JsonArrayStream::makeReader(nhope::AOContext& aoCtx) &&
+{
+    return std::make_unique<JsonArrayReader>(aoCtx, std::move(m_producer));
+}
+
+}   // namespace royalbed::server
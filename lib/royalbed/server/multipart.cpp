@@ -0,0 +1,673 @@
+#include <algorithm>
+#include <array>
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <exception>
+#include <filesystem>
+#include <functional>
+#include <limits>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <utility>
+#include <vector>
+
+#include <unistd.h>
+
+#include <gsl/span>
+
+#include "nhope/async/ao-context.h"
+#include "nhope/async/future.h"
+#include "nhope/async/thread-pool-executor.h"
+#include "nhope/io/io-device.h"
+#include "nhope/io/string-reader.h"
+
+#include "royalbed/common/detail/string-utils.h"
+#include "royalbed/server/error.h"
+#include "royalbed/server/http-status.h"
+#include "royalbed/server/multipart.h"
+#include "royalbed/server/request-context.h"
+
+namespace royalbed::server {
+
+namespace {
+
+using namespace std::literals;
+using common::detail::trim;
+
+constexpr std::size_t readBufSize = 16 * 1024;
+
+// RFC 2046, 5.1.1
+constexpr std::size_t maxBoundarySize = 70;
+
+// Whitespace allowed between the boundary and the end of its line
+constexpr std::size_t maxPaddingSize = 256;
+
+// Finds a parameter of a header value like `form-data; name="file"; filename="a.txt"`.
+// The parameter name is case-insensitive, a quoted value is unescaped.
+std::optional<std::string> headerParam(std::string_view value, std::string_view param)
+{
+    std::size_t pos = value.find(';');
+    while (pos < value.size()) {
+        ++pos;
+        const auto eq = value.find('=', pos);
+        if (eq == std::string_view::npos) {
+            return std::nullopt;
+        }
+
+        const auto name = trim(value.substr(pos, eq - pos));
+        std::string paramValue;
+        pos = eq + 1;
+        while (pos < value.size() && (value[pos] == ' ' || value[pos] == '\t')) {
+            ++pos;
+        }
+
+        if (pos < value.size() && value[pos] == '"') {
+            for (++pos; pos < value.size() && value[pos] != '"'; ++pos) {
+                if (value[pos] == '\\' && pos + 1 < value.size()) {
+                    ++pos;
+                }
+                paramValue.push_back(value[pos]);
+            }
+            pos = value.find(';', pos);
+        } else {
+            const auto end = std::min(value.find(';', pos), value.size());
+            paramValue = trim(value.substr(pos, end - pos));
+            pos = end;
+        }
+
+        if (common::detail::toLower(name) == common::detail::toLower(param)) {
+            return paramValue;
+        }
+    }
+    return std::nullopt;
+}
+
+std::string extractBoundary(const Headers& headers)
+{
+    const auto it = headers.find("Content-Type");
+    if (it == headers.end()) {
+        throw HttpError(HttpStatus::UnsupportedMediaType, "multipart/form-data body expected");
+    }
+
+    const auto& contentType = it->second;
+    const auto mediaType = trim(std::string_view(contentType).substr(0, contentType.find(';')));
+    if (common::detail::toLower(mediaType) != "multipart/form-data"sv) {
+        throw HttpError(HttpStatus::UnsupportedMediaType, "multipart/form-data body expected");
+    }
+
+    auto boundary = headerParam(contentType, "boundary");
+    if (!boundary.has_value() || boundary->empty() || boundary->size() > maxBoundarySize) {
+        throw HttpError(HttpStatus::BadRequest, "Invalid multipart boundary");
+    }
+    return std::move(*boundary);
+}
+
+[[noreturn]] void invalidMultipart(std::string_view what)
+{
+    throw HttpError(HttpStatus::BadRequest, "Invalid multipart body: " + std::string(what));
+}
+
+Headers parsePartHeaders(std::string_view block)
+{
+    Headers headers;
+    while (!block.empty()) {
+        const auto end = std::min(block.find("\r\n"sv), block.size());
+        const auto line = block.substr(0, end);
+        block.remove_prefix(std::min(end + 2, block.size()));
+
+        const auto colon = line.find(':');
+        if (colon == 0 || colon == std::string_view::npos) {
+            invalidMultipart("malformed part header");
+        }
+        headers[std::string(trim(line.substr(0, colon)))] = std::string(trim(line.substr(colon + 1)));
+    }
+    return headers;
+}
+
+struct FileCloser final
+{
+    void operator()(std::FILE* file) const noexcept
+    {
+        std::fclose(file);   // NOLINT(cppcoreguidelines-owning-memory)
+    }
+};
+using FilePtr = std::unique_ptr<std::FILE, FileCloser>;
+
+std::shared_ptr<const std::filesystem::path> makeSpoolFile(const std::filesystem::path& dir, FilePtr& file)
+{
+    const auto& spoolDir = dir.empty() ? std::filesystem::temp_directory_path() : dir;
+    auto name = (spoolDir / "royalbed-upload-XXXXXX").string();
+
+    const int fd = ::mkstemp(name.data());
+    if (fd < 0) {
+        throw std::system_error(errno, std::generic_category(), "create spool file in " + spoolDir.string());
+    }
+
+    file.reset(::fdopen(fd, "wb"));   // NOLINT(cppcoreguidelines-owning-memory)
+    if (file == nullptr) {
+        const auto err = errno;
+        ::close(fd);
+        std::filesystem::remove(name);
+        throw std::system_error(err, std::generic_category(), "open " + name);
+    }
+
+    return {new std::filesystem::path(name), [](const std::filesystem::path* path) {
+                std::error_code ec;
+                std::filesystem::remove(*path, ec);
+                delete path;   // NOLINT(cppcoreguidelines-owning-memory)
+            }};
+}
+
+}   // namespace
+
+namespace detail {
+
+// Splits the body into parts by the delimiter CRLF "--" boundary (RFC 2046, 5.1.1).
+// The delimiter is searched with Boyer-Moore-Horspool over a fixed read buffer, the bytes that
+// may start a delimiter split between two reads stay in the buffer until the next read.
+// The body is seen as starting with CRLF, so the first boundary is found as any other delimiter.
+class MultipartParser final : public std::enable_shared_from_this<MultipartParser>
+{
+public:
+    MultipartParser(nhope::AOContext& parent, nhope::Reader& body, std::string_view boundary,
+                    MultipartOptions options)
+      : m_body(body)
+      , m_delimiter("\r\n--" + std::string(boundary))
+      , m_options(std::move(options))
+      , m_buf(std::max(readBufSize, m_options.maxPartHeadersSize + m_delimiter.size() + maxPaddingSize))
+      , m_aoCtx(parent)
+    {
+        m_shift.fill(m_delimiter.size());
+        for (std::size_t i = 0; i + 1 < m_delimiter.size(); ++i) {
+            m_shift[static_cast<std::uint8_t>(m_delimiter[i])] = m_delimiter.size() - 1 - i;
+        }
+
+        m_buf[0] = '\r';
+        m_buf[1] = '\n';
+        m_end = 2;
+    }
+
+    ~MultipartParser()
+    {
+        m_aoCtx.close();
+    }
+
+    [[nodiscard]] const MultipartOptions& options() const noexcept
+    {
+        return m_options;
+    }
+
+    nhope::AOContext& aoCtx() noexcept
+    {
+        return m_aoCtx;
+    }
+
+    nhope::Future<std::optional<MultipartPart>> next()
+    {
+        ++m_partNum;
+        auto promise = std::make_shared<nhope::Promise<std::optional<MultipartPart>>>();
+        auto future = promise->future();
+        this->advance(std::move(promise));
+        return future;
+    }
+
+    void readPart(std::uint64_t partNum, gsl::span<std::uint8_t> buf, nhope::IOHandler handler)
+    {
+        if (partNum != m_partNum || m_state != State::Body || buf.empty()) {
+            this->complete(std::move(handler), nullptr, 0);
+            return;
+        }
+
+        const auto data = this->data();
+        const auto pos = this->findDelimiter(data);
+        if (pos == 0) {
+            // The part is over, the delimiter is consumed by the next call of next()
+            this->complete(std::move(handler), nullptr, 0);
+            return;
+        }
+
+        const auto available = pos != std::string_view::npos ? pos : this->safeSize(data);
+        if (available > 0) {
+            const auto n = std::min(available, buf.size());
+            std::memcpy(buf.data(), data.data(), n);
+            m_begin += n;
+            this->complete(std::move(handler), nullptr, n);
+            return;
+        }
+
+        this->fill([this, partNum, buf, handler = std::move(handler)](std::exception_ptr err) mutable {
+            if (err) {
+                handler(std::move(err), 0);
+                return;
+            }
+            this->readPart(partNum, buf, std::move(handler));
+        });
+    }
+
+private:
+    enum class State
+    {
+        Body,
+        Delimiter,
+        Headers,
+        Epilogue,
+        End,
+    };
+
+    using PartPromise = std::shared_ptr<nhope::Promise<std::optional<MultipartPart>>>;
+
+    [[nodiscard]] std::string_view data() const noexcept
+    {
+        // NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast)
+        return {reinterpret_cast<const char*>(m_buf.data()) + m_begin, m_end - m_begin};
+    }
+
+    // Bytes that cannot belong to a delimiter beginning in the buffered tail
+    [[nodiscard]] std::size_t safeSize(std::string_view data) const noexcept
+    {
+        return data.size() >= m_delimiter.size() ? data.size() - m_delimiter.size() + 1 : 0;
+    }
+
+    [[nodiscard]] std::size_t findDelimiter(std::string_view data) const noexcept
+    {
+        const auto n = m_delimiter.size();
+        std::size_t i = 0;
+        while (i + n <= data.size()) {
+            std::size_t j = n - 1;
+            while (data[i + j] == m_delimiter[j]) {
+                if (j == 0) {
+                    return i;
+                }
+                --j;
+            }
+            i += m_shift[static_cast<std::uint8_t>(data[i + n - 1])];
+        }
+        return std::string_view::npos;
+    }
+
+    // Steps over the rest of the current part and reads the headers of the next one
+    void advance(PartPromise promise)
+    {
+        try {
+            while (this->step(promise)) {
+            }
+        } catch (...) {
+            m_state = State::End;
+            promise->setException(std::current_exception());
+        }
+    }
+
+    // Returns false when the promise is resolved or more data is being read
+    bool step(const PartPromise& promise)
+    {
+        const auto data = this->data();
+        switch (m_state) {
+        case State::Body:
+            if (const auto pos = this->findDelimiter(data); pos != std::string_view::npos) {
+                m_begin += pos + m_delimiter.size();
+                m_state = State::Delimiter;
+                return true;
+            }
+            m_begin += this->safeSize(data);
+            break;
+
+        case State::Delimiter:
+            if (data.starts_with("--"sv)) {
+                m_state = State::Epilogue;
+                return true;
+            }
+            if (const auto eol = data.find("\r\n"sv); eol != std::string_view::npos) {
+                if (!trim(data.substr(0, eol)).empty()) {
+                    invalidMultipart("garbage after boundary");
+                }
+                m_begin += eol + 2;
+                m_state = State::Headers;
+                return true;
+            }
+            if (data.size() > maxPaddingSize) {
+                invalidMultipart("garbage after boundary");
+            }
+            break;
+
+        case State::Headers:
+            if (data.starts_with("\r\n"sv)) {
+                m_begin += 2;
+                return this->startPart(promise, {});
+            }
+            if (const auto end = data.find("\r\n\r\n"sv); end != std::string_view::npos) {
+                if (end > m_options.maxPartHeadersSize) {
+                    invalidMultipart("part headers are too large");
+                }
+                auto headers = parsePartHeaders(data.substr(0, end));
+                m_begin += end + 4;
+                return this->startPart(promise, std::move(headers));
+            }
+            if (data.size() > m_options.maxPartHeadersSize) {
+                invalidMultipart("part headers are too large");
+            }
+            break;
+
+        case State::Epilogue:
+            this->skipEpilogue(promise);
+            return false;
+
+        case State::End:
+            promise->setValue(std::nullopt);
+            return false;
+        }
+
+        this->fill([this, promise](std::exception_ptr err) {
+            if (err) {
+                m_state = State::End;
+                promise->setException(std::move(err));
+                return;
+            }
+            this->advance(promise);
+        });
+        return false;
+    }
+
+    // The rest of the body after the close delimiter is read up to the end, otherwise it would be left
+    // in the connection and taken for the next request
+    void skipEpilogue(const PartPromise& promise)
+    {
+        m_begin = 0;
+        m_end = 0;
+        m_body.read(m_buf, [this, aoCtx = nhope::AOContextRef(m_aoCtx), promise](std::exception_ptr err,
+                                                                                  std::size_t n) mutable {
+            aoCtx.exec([this, err = std::move(err), n, promise] {
+                if (err) {
+                    m_state = State::End;
+                    promise->setException(err);
+                    return;
+                }
+                if (n == 0) {
+                    m_state = State::End;
+                }
+                this->advance(promise);
+            });
+        });
+    }
+
+    bool startPart(const PartPromise& promise, Headers headers)
+    {
+        if (++m_partCount > m_options.maxParts) {
+            throw HttpError(HttpStatus::RequestEntityTooLarge, "Too many multipart parts");
+        }
+
+        m_state = State::Body;
+        auto reader = std::make_shared<MultipartPartReader>(this->shared_from_this(), m_partNum);
+        promise->setValue(MultipartPart(std::move(reader), std::move(headers)));
+        return false;
+    }
+
+    // Reads the next portion of the body after the buffered bytes, the end of the body fails the read
+    void fill(std::function<void(std::exception_ptr)> handler)
+    {
+        if (m_begin > 0) {
+            std::memmove(m_buf.data(), m_buf.data() + m_begin, m_end - m_begin);
+            m_end -= m_begin;
+            m_begin = 0;
+        }
+
+        const auto freeSpace = gsl::span<std::uint8_t>(m_buf).subspan(m_end);
+        m_body.read(freeSpace, [this, aoCtx = nhope::AOContextRef(m_aoCtx), handler = std::move(handler)](
+                                 std::exception_ptr err, std::size_t n) mutable {
+            aoCtx.exec([this, err = std::move(err), n, handler = std::move(handler)]() mutable {
+                if (!err && n == 0) {
+                    err = std::make_exception_ptr(
+                      HttpError(HttpStatus::BadRequest, "Invalid multipart body: unexpected end of the body"));
+                }
+                m_end += n;
+                handler(std::move(err));
+            });
+        });
+    }
+
+    void complete(nhope::IOHandler handler, std::exception_ptr err, std::size_t n)
+    {
+        m_aoCtx.exec([handler = std::move(handler), err = std::move(err), n] {
+            handler(err, n);
+        });
+    }
+
+    nhope::Reader& m_body;
+    const std::string m_delimiter;
+    const MultipartOptions m_options;
+    std::array<std::size_t, std::numeric_limits<std::uint8_t>::max() + 1> m_shift{};
+
+    std::vector<std::uint8_t> m_buf;
+    std::size_t m_begin = 0;
+    std::size_t m_end = 0;
+
+    State m_state = State::Body;
+    std::uint64_t m_partNum = 0;
+    std::size_t m_partCount = 0;
+
+    nhope::AOContext m_aoCtx;
+};
+
+class MultipartPartReader final : public nhope::Reader
+{
+public:
+    MultipartPartReader(std::shared_ptr<MultipartParser> parser, std::uint64_t partNum)
+      : m_parser(std::move(parser))
+      , m_partNum(partNum)
+    {}
+
+    void read(gsl::span<std::uint8_t> buf, nhope::IOHandler handler) override
+    {
+        m_parser->readPart(m_partNum, buf, std::move(handler));
+    }
+
+private:
+    std::shared_ptr<MultipartParser> m_parser;
+    const std::uint64_t m_partNum;
+};
+
+}   // namespace detail
+
+namespace {
+
+// Reads the parts one by one, keeps the small ones in memory and writes the large ones to spool files.
+// The spool files are created and written on the worker pool, the next portion is read after the write.
+class FormReader final : public std::enable_shared_from_this<FormReader>
+{
+public:
+    explicit FormReader(std::shared_ptr<detail::MultipartParser> parser)
+      : m_parser(std::move(parser))
+      , m_aoCtx(m_parser->aoCtx())
+    {}
+
+    nhope::Future<std::vector<FormField>> start()
+    {
+        this->nextPart();
+        return m_promise.future();
+    }
+
+private:
+    void nextPart()
+    {
+        m_parser->next()
+          .then([self = this->shared_from_this()](std::optional<MultipartPart> part) {
+              if (!part.has_value()) {
+                  self->m_promise.setValue(std::move(self->m_fields));
+                  return;
+              }
+
+              self->m_part = std::move(part);
+              self->m_fields.push_back(FormField{
+                .headers = self->m_part->headers(),
+                .name = self->m_part->name(),
+                .fileName = self->m_part->fileName(),
+              });
+              self->readPart();
+          })
+          .fail([self = this->shared_from_this()](std::exception_ptr err) {
+              self->m_promise.setException(std::move(err));
+          });
+    }
+
+    void readPart()
+    {
+        m_part->body().read(m_buf, [self = this->shared_from_this()](std::exception_ptr err, std::size_t n) {
+            if (err) {
+                self->m_promise.setException(std::move(err));
+                return;
+            }
+
+            if (n == 0) {
+                if (self->m_file != nullptr) {
+                    self->spool({}, true);
+                } else {
+                    self->nextPart();
+                }
+                return;
+            }
+            self->store(gsl::span<const std::uint8_t>(self->m_buf).first(n));
+        });
+    }
+
+    void store(gsl::span<const std::uint8_t> portion)
+    {
+        auto& field = m_fields.back();
+        const auto& options = m_parser->options();
+        if (m_file == nullptr && field.value.size() + portion.size() <= options.spoolThreshold &&
+            m_memorySize + portion.size() <= options.maxFormMemorySize) {
+            field.value.append(portion.begin(), portion.end());
+            m_memorySize += portion.size();
+            this->readPart();
+            return;
+        }
+
+        // The part goes to a file with the bytes kept in memory so far
+        std::vector<std::uint8_t> data(field.value.begin(), field.value.end());
+        data.insert(data.end(), portion.begin(), portion.end());
+        m_memorySize -= field.value.size();
+        field.value = std::string();
+        this->spool(std::move(data), false);
+    }
+
+    // The part is not touched by the AO thread until the write is done
+    void spool(std::vector<std::uint8_t> data, bool partEnd)
+    {
+        nhope::ThreadPoolExecutor::defaultExecutor().exec(
+          [self = this->shared_from_this(), data = std::move(data), partEnd, aoCtx = m_aoCtx]() mutable {
+              std::exception_ptr err;
+              try {
+                  self->write(data);
+                  if (partEnd) {
+                      self->close();
+                  }
+              } catch (...) {
+                  err = std::current_exception();
+              }
+
+              aoCtx.exec([self, err = std::move(err), partEnd] {
+                  if (err) {
+                      self->m_promise.setException(err);
+                  } else if (partEnd) {
+                      self->nextPart();
+                  } else {
+                      self->readPart();
+                  }
+              });
+          });
+    }
+
+    void write(const std::vector<std::uint8_t>& data)
+    {
+        auto& field = m_fields.back();
+        if (m_file == nullptr) {
+            field.file = makeSpoolFile(m_parser->options().spoolDir, m_file);
+        }
+        if (std::fwrite(data.data(), 1, data.size(), m_file.get()) != data.size()) {
+            throw std::system_error(errno, std::generic_category(), "write to " + field.file->string());
+        }
+    }
+
+    // A failed flush of the buffered tail must not leave a truncated file reported as received
+    void close()
+    {
+        if (std::fclose(m_file.release()) != 0) {   // NOLINT(cppcoreguidelines-owning-memory)
+            throw std::system_error(errno, std::generic_category(), "write to " + m_fields.back().file->string());
+        }
+    }
+
+    std::shared_ptr<detail::MultipartParser> m_parser;
+    nhope::AOContextRef m_aoCtx;
+    nhope::Promise<std::vector<FormField>> m_promise;
+
+    std::vector<FormField> m_fields;
+    std::optional<MultipartPart> m_part;
+    FilePtr m_file;
+    std::size_t m_memorySize = 0;
+    std::array<std::uint8_t, readBufSize> m_buf{};
+};
+
+}   // namespace
+
+MultipartPart::MultipartPart(std::shared_ptr<detail::MultipartPartReader> reader, Headers headers)
+  : m_reader(std::move(reader))
+  , m_headers(std::move(headers))
+{}
+
+const Headers& MultipartPart::headers() const noexcept
+{
+    return m_headers;
+}
+
+std::string MultipartPart::name() const
+{
+    const auto it = m_headers.find("Content-Disposition");
+    if (it == m_headers.end()) {
+        return {};
+    }
+    return headerParam(it->second, "name").value_or(std::string());
+}
+
+std::optional<std::string> MultipartPart::fileName() const
+{
+    const auto it = m_headers.find("Content-Disposition");
+    if (it == m_headers.end()) {
+        return std::nullopt;
+    }
+    return headerParam(it->second, "filename");
+}
+
+nhope::Reader& MultipartPart::body() const noexcept
+{
+    return *m_reader;
+}
+
+MultipartBody::MultipartBody(RequestContext& ctx)
+  : MultipartBody(ctx, MultipartOptions{})
+{}
+
+MultipartBody::MultipartBody(RequestContext& ctx, MultipartOptions options)
+{
+    auto boundary = extractBoundary(ctx.request.headers);
+    if (ctx.request.body == nullptr) {
+        ctx.request.body = nhope::StringReader::create(ctx.aoCtx, {});
+    }
+    m_parser = std::make_shared<detail::MultipartParser>(ctx.aoCtx, *ctx.request.body, boundary, std::move(options));
+}
+
+nhope::Future<std::optional<MultipartPart>> MultipartBody::next() const
+{
+    return m_parser->next();
+}
+
+nhope::Future<std::vector<FormField>> MultipartBody::readForm() const
+{
+    return std::make_shared<FormReader>(m_parser)->start();
+}
+
+}   // namespace royalbed::server
@@ -0,0 +1,210 @@
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <charconv>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <ctime>
+#include <exception>
+#include <limits>
+#include <list>
+#include <memory>
+#include <string>
+#include <system_error>
+#include <type_traits>
+#include <utility>
+
+#include "nhope/async/future.h"
+#include "nhope/io/io-device.h"
+
+#include "royalbed/common/response.h"
+#include "royalbed/server/detail/content-decoder.h"
+#include "royalbed/server/detail/process-request.h"
+#include "royalbed/server/error.h"
+#include "royalbed/server/http-status.h"
+#include "royalbed/server/low-level-handler.h"
+#include "royalbed/server/middleware.h"
+#include "royalbed/server/request-context.h"
+#include "royalbed/server/router.h"
+
+namespace royalbed::server::detail {
+
+namespace {
+
+template<typename AsyncFunc>
+auto safeCall(RequestContext& ctx, AsyncFunc&& func)
+{
+    using Future = std::invoke_result_t<AsyncFunc, RequestContext&>;
+    using Promise = nhope::Promise<typename Future::Type>;
+
+    try {
+        return func(ctx);
+    } catch (...) {
+        Promise p;
+        p.setException(std::current_exception());
+        return p.future();
+    }
+}
+
+// The route must live until the handler finishes
+struct Route
+{
+    LowLevelHandler handler;
+    std::list<Middleware> middlewares;
+};
+
+nhope::Future<bool> doMiddlewares(RequestContext& ctx, const std::shared_ptr<Route>& route)
+{
+    if (route->middlewares.empty()) {
+        return nhope::makeReadyFuture<bool>(true);
+    }
+
+    const auto& middleware = route->middlewares.front();
+    return safeCall(ctx, middleware).then(ctx.aoCtx, [&ctx, route](bool doNext) {
+        assert(!route->middlewares.empty());   // NOLINT
+
+        route->middlewares.pop_front();
+        if (!doNext) {
+            return nhope::makeReadyFuture<bool>(false);
+        }
+        return doMiddlewares(ctx, route);
+    });
+}
+
+// Fails with 413 as soon as the body turns out to be longer than allowed
+class LimitedBodyReader final : public nhope::Reader
+{
+public:
+    LimitedBodyReader(nhope::ReaderPtr body, std::uint64_t maxSize)
+      : m_body(std::move(body))
+      , m_left(maxSize)
+    {}
+
+    void read(gsl::span<std::uint8_t> buf, nhope::IOHandler handler) override
+    {
+        // One byte over the limit is enough to know that the body is too large
+        const auto size = m_left < buf.size() ? static_cast<std::size_t>(m_left) + 1 : buf.size();
+        m_body->read(buf.first(size), [this, handler = std::move(handler)](std::exception_ptr err, std::size_t n) {
+            if (err == nullptr && n > m_left) {
+                handler(std::make_exception_ptr(HttpError(HttpStatus::RequestEntityTooLarge)), 0);
+                return;
+            }
+            m_left -= n;
+            handler(std::move(err), n);
+        });
+    }
+
+private:
+    nhope::ReaderPtr m_body;
+    std::uint64_t m_left;
+};
+
+// The declared length is checked before the handler starts, so an oversized body is not read at all
+void limitBody(RequestContext& ctx)
+{
+    if (ctx.maxBodySize == std::numeric_limits<std::uint64_t>::max()) {
+        return;
+    }
+
+    if (auto it = ctx.request.headers.find("Content-Length"); it != ctx.request.headers.end()) {
+        std::uint64_t length = 0;
+        const auto& value = it->second;
+        const auto [end, ec] = std::from_chars(value.data(), value.data() + value.size(), length);
+        if (ec == std::errc::result_out_of_range || (ec == std::errc() && length > ctx.maxBodySize)) {
+            throw HttpError(HttpStatus::RequestEntityTooLarge);
+        }
+    }
+
+    ctx.request.body = std::make_unique<LimitedBodyReader>(std::move(ctx.request.body), ctx.maxBodySize);
+}
+
+// The handler gets the decoded body. The size limit applies to the body as sent, the decoded body is limited
+// by the smaller of the limits, so a decompression bomb is cut off even if the body size is not limited.
+void prepareBody(RequestContext& ctx)
+{
+    if (ctx.request.body == nullptr) {
+        return;
+    }
+
+    limitBody(ctx);
+
+    auto& headers = ctx.request.headers;
+    if (auto it = headers.find("Content-Encoding"); it != headers.end()) {
+        ctx.request.body = makeContentDecoder(ctx.aoCtx, std::move(ctx.request.body), it->second);
+        headers.erase(it);
+        headers.erase("Content-Length");
+
+        const auto maxDecodedSize = std::min(ctx.maxBodySize, ctx.maxDecodedBodySize);
+        if (maxDecodedSize != std::numeric_limits<std::uint64_t>::max()) {
+            ctx.request.body = std::make_unique<LimitedBodyReader>(std::move(ctx.request.body), maxDecodedSize);
+        }
+    }
+}
+
+nhope::Future<void> doResponseFilters(RequestContext& ctx)
+{
+    if (ctx.responseFilters.empty()) {
+        return nhope::makeReadyFuture();
+    }
+
+    auto filter = std::move(ctx.responseFilters.back());
+    ctx.responseFilters.pop_back();
+    return safeCall(ctx, filter).then(ctx.aoCtx, [&ctx] {
+        return doResponseFilters(ctx);
+    });
+}
+
+}   // namespace
+
+nhope::Future<void> processRequest(RequestContext& ctx)
+{
+    ctx.log->trace("request: \"{} {}\"", ctx.request.method, ctx.request.uri.path);
+
+    // The context is reused by the requests of a connection
+    ctx.responseFilters.clear();
+
+    auto routeResult = ctx.router.route(ctx.request.method, ctx.request.uri.path);
+    auto route = std::make_shared<Route>(Route{
+      .handler = std::move(routeResult.handler),
+      .middlewares = std::move(routeResult.middlewares),
+    });
+    ctx.rawPathParams = std::move(routeResult.rawPathParams);
+
+    return doMiddlewares(ctx, route).then(ctx.aoCtx, [&ctx, route](bool doHandler) {
+        if (!doHandler) {
+            return nhope::makeReadyFuture();
+        }
+
+        return safeCall(ctx, [&route](RequestContext& reqCtx) {
+            prepareBody(reqCtx);
+            return route->handler(reqCtx);
+        }).then(ctx.aoCtx, [&ctx] {
+            return doResponseFilters(ctx);
+        });
+    });
+}
+
+void makeResponseFromError(RequestContext& ctx, std::exception_ptr ex)
+{
+    try {
+        std::rethrow_exception(std::move(ex));
+    } catch (const HttpError& e) {
+        ctx.response = common::makePlainTextResponse(ctx.aoCtx, e.httpStatus(), e.what());
+
+    } catch (const std::exception& e) {
+        ctx.response = common::makePlainTextResponse(ctx.aoCtx, HttpStatus::InternalServerError, e.what());
+    }
+}
+
+std::string gmtDateTime()
+{
+    constexpr auto bufSize{100};
+    std::array<char, bufSize> dateBuffer{};
+    const auto curTime = std::chrono::system_clock::to_time_t(std::chrono::system_clock::now());
+    const char* fmt = "%a, %d %Y %b %H:%M:%S GMT";
+    const auto count = std::strftime(dateBuffer.data(), bufSize, fmt, std::gmtime(&curTime));
+    return {dateBuffer.data(), count};
+}
+
+}   // namespace royalbed::server::detail
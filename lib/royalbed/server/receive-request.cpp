@@ -1,10 +1,8 @@
-#include <array>
 #include <cassert>
 #include <cstddef>
 #include <cstdint>
 #include <exception>
 #include <memory>
-#include <span>
 #include <string>
 #include <utility>
 
@@ -12,13 +10,14 @@
 #include "nhope/async/ao-context.h"
 #include "nhope/async/future.h"
 #include "nhope/async/safe-callback.h"
-#include "nhope/io/pushback-reader.h"
 
 #include "3rdparty/llhttp/llhttp.h"
 
 #include "royalbed/common/detail/body-reader.h"
+#include "royalbed/common/detail/connection-buffer.h"
 #include "royalbed/server/error.h"
 #include "royalbed/server/http-status.h"
+#include "royalbed/server/request-limits.h"
 #include "royalbed/server/request.h"
 #include "royalbed/server/uri.h"
 
@@ -28,14 +27,13 @@ namespace royalbed::server::detail {
 namespace {
 using namespace royalbed::common::detail;
 
-constexpr std::size_t receiveBufSize = 4096;
-
 class RequestReceiver final : public std::enable_shared_from_this<RequestReceiver>
 {
 public:
-    RequestReceiver(nhope::AOContext& aoCtx, nhope::PushbackReader& device)
+    RequestReceiver(nhope::AOContext& aoCtx, ConnectionBuffer& device, const RequestLimits& limits)
       : m_aoCtx(aoCtx)
       , m_device(device)
+      , m_limits(limits)
       , m_httpParser(std::make_unique<llhttp_t>())
     {
         llhttp_init(m_httpParser.get(), HTTP_REQUEST, &llhttpSettings);
@@ -51,26 +49,40 @@ public:
 
     nhope::Future<Request> start()
     {
-        this->readNextPortion();
-        return m_promise.future();
+        auto future = m_promise.future();
+
+        // A pipelined message may be buffered already
+        if (m_device.data().empty() || this->processData(m_device.data())) {
+            this->readNextPortion();
+        }
+        return future;
     }
 
 private:
-    bool processData(std::span<std::uint8_t> data)
+    // The parsed bytes are consumed from the device, the head is copied out by the llhttp callbacks
+    bool processData(gsl::span<const std::uint8_t> data)
     {
         assert(!m_headersComplete);   // NOLINT
 
+        // NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast)
+        const auto* begin = reinterpret_cast<const char*>(data.data());
         if (!data.empty()) {
-            // NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast)
-            llhttp_execute(m_httpParser.get(), reinterpret_cast<char*>(data.data()), data.size());
+            llhttp_execute(m_httpParser.get(), begin, data.size());
         } else {
             llhttp_finish(m_httpParser.get());
         }
 
         if (m_httpParser->error == HPE_OK) {
+            m_device.consume(data.size());
             return true;
         }
 
+        if (m_httpParser->error == HPE_USER && m_limitStatus != 0) {
+            auto ex = std::make_exception_ptr(HttpError(m_limitStatus));
+            m_promise.setException(std::move(ex));
+            return false;
+        }
+
         if (m_httpParser->error != HPE_PAUSED) {
             const auto* reason = llhttp_get_error_reason(m_httpParser.get());
             auto ex = std::make_exception_ptr(HttpError(HttpStatus::BadRequest, reason));
@@ -85,9 +97,7 @@ private:
         m_httpParser->data = nullptr;
         llhttp_resume(m_httpParser.get());
 
-        // NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast)
-        const auto* beginBody = reinterpret_cast<const std::uint8_t*>(llhttp_get_error_pos(m_httpParser.get()));
-        m_device.unread({std::to_address(beginBody), std::to_address(data.end())});
+        m_device.consume(static_cast<std::size_t>(llhttp_get_error_pos(m_httpParser.get()) - begin));
         m_request.method = llhttp_method_name(static_cast<llhttp_method_t>(m_httpParser->method));
         m_request.body = BodyReader::create(m_aoCtx, m_device, std::move(m_httpParser));
 
@@ -98,9 +108,10 @@ private:
 
     void readNextPortion()
     {
-        m_device.read(m_receiveBuf, [self = shared_from_this()](std::exception_ptr err, std::size_t n) {
+        m_device.fill([self = shared_from_this()](std::exception_ptr err, std::size_t n) {
             self->m_aoCtx.exec([self, err = std::move(err), n] {
-                if (!self->processData(std::span(self->m_receiveBuf.begin(), n))) {
+                const auto data = n == 0 ? gsl::span<const std::uint8_t>() : self->m_device.data();
+                if (!self->processData(data)) {
                     return;
                 }
 
@@ -123,6 +134,9 @@ private:
     static int onUrl(llhttp_t* httpParser, const char* at, std::size_t size)
     {
         auto* self = static_cast<RequestReceiver*>(httpParser->data);
+        if (self->m_url.size() + size > self->m_limits.maxUriSize) {
+            return self->exceedLimit(HttpStatus::RequestUriTooLong);
+        }
         self->m_url.append(at, size);
         return HPE_OK;
     }
@@ -141,6 +155,9 @@ private:
     static int onHeaderName(llhttp_t* httpParser, const char* at, std::size_t size)
     {
         auto* self = static_cast<RequestReceiver*>(httpParser->data);
+        if (!self->addHeadersSize(size)) {
+            return self->exceedLimit(HttpStatus::RequestHeaderFieldsTooLarge);
+        }
         self->m_curHeaderName.append(at, size);
         return HPE_OK;
     }
@@ -148,6 +165,9 @@ private:
     static int onHeaderValue(llhttp_t* httpParser, const char* at, std::size_t size)
     {
         auto* self = static_cast<RequestReceiver*>(httpParser->data);
+        if (!self->addHeadersSize(size)) {
+            return self->exceedLimit(HttpStatus::RequestHeaderFieldsTooLarge);
+        }
         self->m_curHeaderValue.append(at, size);
         return HPE_OK;
     }
@@ -158,6 +178,10 @@ private:
 
         assert(self->m_curHeaderName.size() > 0);   // NOLINT
 
+        if (++self->m_headerCount > self->m_limits.maxHeaderCount) {
+            return self->exceedLimit(HttpStatus::RequestHeaderFieldsTooLarge);
+        }
+
         self->m_request.headers[self->m_curHeaderName] = self->m_curHeaderValue;
         self->m_curHeaderName.clear();
         self->m_curHeaderValue.clear();
@@ -172,6 +196,19 @@ private:
         return HPE_PAUSED;
     }
 
+    bool addHeadersSize(std::size_t size)
+    {
+        m_headersSize += size;
+        return m_headersSize <= m_limits.maxHeadersSize;
+    }
+
+    // The parser stops with HPE_USER, processData turns it into the response with the given status
+    int exceedLimit(int status)
+    {
+        m_limitStatus = status;
+        return HPE_USER;
+    }
+
     static constexpr llhttp_settings_s llhttpSettings = {
       .on_url = onUrl,
       .on_header_field = onHeaderName,
@@ -183,7 +220,8 @@ private:
     };
 
     nhope::AOContextRef m_aoCtx;
-    nhope::PushbackReader& m_device;
+    ConnectionBuffer& m_device;
+    const RequestLimits m_limits;
 
     nhope::Promise<Request> m_promise;
 
@@ -193,16 +231,20 @@ private:
     std::string m_curHeaderValue;
     bool m_headersComplete = false;
 
-    std::array<std::uint8_t, receiveBufSize> m_receiveBuf{};
+    std::size_t m_headerCount = 0;
+    std::size_t m_headersSize = 0;
+    int m_limitStatus = 0;
+
 
     Request m_request;
 };
 
 }   // namespace
 
-nhope::Future<Request> receiveRequest(nhope::AOContext& aoCtx, nhope::PushbackReader& device)
+nhope::Future<Request> receiveRequest(nhope::AOContext& aoCtx, ConnectionBuffer& device,
+                                      const RequestLimits& limits)
 {
-    auto receiver = std::make_shared<RequestReceiver>(aoCtx, device);
+    auto receiver = std::make_shared<RequestReceiver>(aoCtx, device, limits);
     return receiver->start();
 }
 
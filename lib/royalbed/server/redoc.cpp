@@ -1,17 +1,23 @@
 
 
+#include <stdexcept>
 #include <string>
 #include <string_view>
+#include <utility>
 
 #include "cmrc/cmrc.hpp"
 
+#include "fmt/format.h"
+
 #include "nhope/async/future.h"
 #include "nhope/io/string-reader.h"
 
 #include "royalbed/common/mime-type.h"
+#include "royalbed/server/asset-bundle.h"
 #include "royalbed/server/redoc.h"
 #include "royalbed/server/request-context.h"
 #include "royalbed/server/router.h"
+#include "royalbed/server/send-content.h"
 #include "royalbed/server/static-files.h"
 
 CMRC_DECLARE(royalbed::redoc);
@@ -24,6 +30,28 @@ using namespace std::literals;
 
 namespace royalbed::server {
 
+namespace {
+
+void addDocApi(Router& router, const AssetBundle& bundle, std::string_view openApiFilePath)
+{
+    const auto* asset = bundle.find(openApiFilePath);
+    if (asset == nullptr) {
+        throw std::runtime_error(fmt::format("{} is not found in the asset bundle", openApiFilePath));
+    }
+
+    auto info = ContentInfo{
+      .contentType = std::string(asset->contentType),
+      .contentEncoding = std::string(asset->content.contentEncoding),
+      .etag = std::string(asset->content.etag),
+    };
+    router.get("/redoc/doc-api"sv, [content = asset->content.data, info = std::move(info),
+                                    owner = bundle.owner()](RequestContext& ctx) {
+        sendContent(ctx, content, info, owner);
+    });
+}
+
+}   // namespace
+
 void redoc(Router& router, const cmrc::embedded_filesystem& fs, std::string_view openApiFilePath)
 {
     router.get("/redoc/doc-api"sv, [mimeType = common::mimeTypeForFileName(openApiFilePath),
@@ -37,4 +65,16 @@ void redoc(Router& router, const cmrc::embedded_filesystem& fs, std::string_view
     router.use("/"sv, staticFiles(cmrc::royalbed::redoc::get_filesystem()));
 }
 
+void redoc(Router& router, const AssetBundle& bundle, std::string_view openApiFilePath)
+{
+    addDocApi(router, bundle, openApiFilePath);
+    router.use("/"sv, staticFiles(cmrc::royalbed::redoc::get_filesystem()));
+}
+
+void redoc(Router& router, const AssetBundle& bundle, std::string_view openApiFilePath, const AssetBundle& ui)
+{
+    addDocApi(router, bundle, openApiFilePath);
+    router.use("/"sv, staticFiles(ui));
+}
+
 }   // namespace royalbed::server
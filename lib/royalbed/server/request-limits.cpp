@@ -0,0 +1,20 @@
+#include <cstdint>
+
+#include "nhope/async/future.h"
+
+#include "royalbed/server/middleware.h"
+#include "royalbed/server/request-context.h"
+#include "royalbed/server/request-limits.h"
+
+namespace royalbed::server {
+
+Middleware limitBodySize(std::uint64_t maxSize)
+{
+    return [maxSize](RequestContext& ctx) {
+        ctx.maxBodySize = maxSize;
+        ctx.maxDecodedBodySize = maxSize;
+        return nhope::makeReadyFuture<bool>(true);
+    };
+}
+
+}   // namespace royalbed::server
@@ -0,0 +1,481 @@
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <exception>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include <gsl/span>
+
+#include "nhope/async/ao-context.h"
+#include "nhope/async/future.h"
+#include "nhope/io/io-device.h"
+#include "nhope/io/string-reader.h"
+
+#include "royalbed/common/detail/string-utils.h"
+#include "royalbed/server/detail/normalize-path.h"
+#include "royalbed/server/http-status.h"
+#include "royalbed/server/middleware.h"
+#include "royalbed/server/request-context.h"
+#include "royalbed/server/response-cache.h"
+
+namespace royalbed::server {
+
+namespace {
+
+using namespace std::literals;
+using Clock = std::chrono::steady_clock;
+
+constexpr std::size_t readBufSize = 16 * 1024;
+
+struct CachedResponse final
+{
+    int status = HttpStatus::Ok;
+    std::string statusMessage;
+    Headers headers;
+    std::vector<std::uint8_t> body;
+
+    // Cache-Control: public, the response may be served to requests with credentials
+    bool isPublic = false;
+
+    Clock::time_point storedAt;
+};
+
+// Reads the body of a cached response, the body is shared by all the hits
+class CachedBodyReader final : public nhope::Reader
+{
+public:
+    CachedBodyReader(nhope::AOContext& parent, std::shared_ptr<const CachedResponse> response)
+      : m_response(std::move(response))
+      , m_aoCtx(parent)
+    {}
+
+    void read(gsl::span<std::uint8_t> buf, nhope::IOHandler handler) override
+    {
+        const auto& body = m_response->body;
+        const auto n = std::min(buf.size(), body.size() - m_offset);
+        std::memcpy(buf.data(), body.data() + m_offset, n);
+        m_offset += n;
+
+        m_aoCtx.exec([handler = std::move(handler), n] {
+            handler(nullptr, n);
+        });
+    }
+
+private:
+    std::shared_ptr<const CachedResponse> m_response;
+    std::size_t m_offset = 0;
+
+    nhope::AOContext m_aoCtx;
+};
+
+// Reads the response body up to the limit. The rest of a larger body is left in the reader.
+class BodyCollector final : public std::enable_shared_from_this<BodyCollector>
+{
+public:
+    struct Result
+    {
+        std::vector<std::uint8_t> data;
+
+        // The body is larger than the limit
+        nhope::ReaderPtr rest;
+    };
+
+    BodyCollector(nhope::ReaderPtr body, std::size_t limit)
+      : m_body(std::move(body))
+      , m_limit(limit)
+    {}
+
+    nhope::Future<Result> start()
+    {
+        this->readNext();
+        return m_promise.future();
+    }
+
+private:
+    void readNext()
+    {
+        m_body->read(m_buf, [self = this->shared_from_this()](std::exception_ptr err, std::size_t n) {
+            if (err) {
+                self->m_promise.setException(std::move(err));
+                return;
+            }
+
+            if (n == 0) {
+                self->m_promise.setValue(Result{.data = std::move(self->m_data), .rest = nullptr});
+                return;
+            }
+
+            self->m_data.insert(self->m_data.end(), self->m_buf.begin(), self->m_buf.begin() + n);
+            if (self->m_data.size() > self->m_limit) {
+                self->m_promise.setValue(Result{.data = std::move(self->m_data), .rest = std::move(self->m_body)});
+                return;
+            }
+            self->readNext();
+        });
+    }
+
+    nhope::ReaderPtr m_body;
+    const std::size_t m_limit;
+    nhope::Promise<Result> m_promise;
+
+    std::array<std::uint8_t, readBufSize> m_buf{};
+    std::vector<std::uint8_t> m_data;
+};
+
+using detail::normalizePath;
+
+bool hasToken(const Headers& headers, const std::string& name, std::string_view token)
+{
+    const auto it = headers.find(name);
+    return it != headers.end() && common::detail::containsToken(it->second, token);
+}
+
+}   // namespace
+
+namespace detail {
+
+class ResponseCacheImpl final
+{
+public:
+    explicit ResponseCacheImpl(ResponseCacheOptions options)
+      : m_options(std::move(options))
+    {}
+
+    // Only GET responses are stored, HEAD requests are answered with their headers
+    [[nodiscard]] std::string key(const RequestContext& ctx) const
+    {
+        // The path goes first, so the responses for a path can be found by the key prefix
+        auto key = normalizePath(ctx.request.uri.path);
+        key += '\0';
+
+        // Values are prefixed with their size, so different values cannot produce the same key
+        const auto addValue = [&key](std::string_view value) {
+            key += std::to_string(value.size());
+            key += ':';
+            key += value;
+        };
+
+        for (const auto& name : m_options.queryParams) {
+            key += '\0';
+            for (const auto& [param, value] : ctx.request.uri.query) {
+                if (param == name) {
+                    addValue(value);
+                }
+            }
+        }
+
+        for (const auto& name : m_options.varyHeaders) {
+            key += '\0';
+            if (const auto it = ctx.request.headers.find(name); it != ctx.request.headers.end()) {
+                addValue(it->second);
+            }
+        }
+        return key;
+    }
+
+    // The request has credentials (Authorization or Cookie) that are not a part of the key:
+    // a response to it may belong to the user, it is shared only with Cache-Control: public
+    [[nodiscard]] bool hasCredentials(const RequestContext& ctx) const
+    {
+        for (const auto* name : {"Authorization", "Cookie"}) {
+            const bool inKey = std::any_of(m_options.varyHeaders.begin(), m_options.varyHeaders.end(),
+                                           [name](const auto& header) {
+                                               return common::detail::LowercaseEqual()(header, name);
+                                           });
+            if (!inKey && ctx.request.headers.contains(name)) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    std::shared_ptr<const CachedResponse> find(const std::string& key, bool withCredentials)
+    {
+        std::lock_guard lock(m_mutex);
+        const auto it = m_entries.find(key);
+        if (it == m_entries.end() || (withCredentials && !it->second.response->isPublic)) {
+            ++m_stats.misses;
+            return nullptr;
+        }
+
+        if (Clock::now() - it->second.response->storedAt >= m_options.ttl) {
+            this->erase(it);
+            ++m_stats.expirations;
+            ++m_stats.misses;
+            return nullptr;
+        }
+
+        ++m_stats.hits;
+        m_lru.splice(m_lru.begin(), m_lru, it->second.lruPos);
+        return it->second.response;
+    }
+
+    [[nodiscard]] bool cacheable(const RequestContext& ctx, bool withCredentials) const
+    {
+        const auto& response = ctx.response;
+        if (response.status != HttpStatus::Ok || ctx.upgrade != nullptr || response.trailers != nullptr ||
+            response.headers.contains("Set-Cookie")) {
+            return false;
+        }
+
+        if (withCredentials && !hasToken(response.headers, "Cache-Control", "public"sv)) {
+            return false;
+        }
+
+        // Streams sent as they are produced (e.g. EventStream) may never end
+        if (response.chunked.minChunkSize == 0) {
+            return false;
+        }
+
+        for (const auto directive : {"no-store"sv, "no-cache"sv, "private"sv}) {
+            if (hasToken(response.headers, "Cache-Control", directive)) {
+                return false;
+            }
+        }
+
+        if (const auto it = response.headers.find("Vary"); it != response.headers.end()) {
+            std::string_view list = it->second;
+            while (!list.empty()) {
+                const auto comma = std::min(list.find(','), list.size());
+                const auto name = common::detail::trim(list.substr(0, comma));
+                list.remove_prefix(std::min(comma + 1, list.size()));
+
+                const bool known = std::any_of(m_options.varyHeaders.begin(), m_options.varyHeaders.end(),
+                                               [name](const auto& header) {
+                                                   return common::detail::LowercaseEqual()(header, name);
+                                               });
+                if (!name.empty() && !known) {
+                    return false;
+                }
+            }
+        }
+        return true;
+    }
+
+    [[nodiscard]] std::size_t maxEntrySize() const noexcept
+    {
+        return m_options.maxEntrySize;
+    }
+
+    void store(const std::string& key, std::shared_ptr<const CachedResponse> response)
+    {
+        const auto cost = costOf(key, *response);
+        if (cost > m_options.maxBytes) {
+            return;
+        }
+
+        std::lock_guard lock(m_mutex);
+        if (const auto it = m_entries.find(key); it != m_entries.end()) {
+            this->erase(it);
+        }
+
+        m_lru.push_front(key);
+        m_entries.emplace(key, Slot{.response = std::move(response), .cost = cost, .lruPos = m_lru.begin()});
+        m_stats.bytes += cost;
+        ++m_stats.entries;
+
+        while (m_stats.bytes > m_options.maxBytes) {
+            this->erase(m_entries.find(m_lru.back()));
+            ++m_stats.evictions;
+        }
+    }
+
+    void invalidate(std::string_view path, bool subtree)
+    {
+        auto prefix = normalizePath(path);
+        const auto pathSize = prefix.size();
+
+        std::lock_guard lock(m_mutex);
+        for (auto it = m_entries.begin(); it != m_entries.end();) {
+            const std::string_view key = it->first;
+            const bool matches = key.starts_with(prefix) && key.size() > pathSize &&
+                                 (key[pathSize] == '\0' || (subtree && (pathSize == 0 || key[pathSize] == '/')));
+            if (matches) {
+                this->erase(it++);
+                ++m_stats.invalidations;
+            } else {
+                ++it;
+            }
+        }
+    }
+
+    void clear()
+    {
+        std::lock_guard lock(m_mutex);
+        m_stats.invalidations += m_entries.size();
+        m_stats.bytes = 0;
+        m_stats.entries = 0;
+        m_entries.clear();
+        m_lru.clear();
+    }
+
+    ResponseCacheStats stats() const
+    {
+        std::lock_guard lock(m_mutex);
+        return m_stats;
+    }
+
+private:
+    using Lru = std::list<std::string>;
+
+    struct Slot final
+    {
+        std::shared_ptr<const CachedResponse> response;
+        std::size_t cost;
+        Lru::iterator lruPos;
+    };
+
+    using Entries = std::unordered_map<std::string, Slot>;
+
+    static std::size_t costOf(const std::string& key, const CachedResponse& response)
+    {
+        std::size_t cost = key.size() + response.statusMessage.size() + response.body.size();
+        for (const auto& [name, value] : response.headers) {
+            cost += name.size() + value.size();
+        }
+        return cost;
+    }
+
+    void erase(Entries::iterator it)
+    {
+        m_stats.bytes -= it->second.cost;
+        --m_stats.entries;
+        m_lru.erase(it->second.lruPos);
+        m_entries.erase(it);
+    }
+
+    const ResponseCacheOptions m_options;
+
+    mutable std::mutex m_mutex;
+    Entries m_entries;
+    Lru m_lru;   // The most recently used first
+    ResponseCacheStats m_stats;
+};
+
+}   // namespace detail
+
+namespace {
+
+void respondFromCache(RequestContext& ctx, std::shared_ptr<const CachedResponse> cached)
+{
+    const auto age = std::chrono::duration_cast<std::chrono::seconds>(Clock::now() - cached->storedAt);
+
+    ctx.response.status = cached->status;
+    ctx.response.statusMessage = cached->statusMessage;
+    ctx.response.headers = cached->headers;
+    ctx.response.headers["Age"] = std::to_string(age.count());
+    if (ctx.request.method == "HEAD"sv) {
+        // Content-Length of the GET response is kept
+        ctx.response.body = nullptr;
+        return;
+    }
+    ctx.response.body = std::make_unique<CachedBodyReader>(ctx.aoCtx, std::move(cached));
+}
+
+// cache keeps impl alive until the body is collected
+nhope::Future<void> storeResponse(RequestContext& ctx, std::shared_ptr<const void> cache,
+                                  detail::ResponseCacheImpl& impl, std::string key, bool withCredentials)
+{
+    if (!impl.cacheable(ctx, withCredentials)) {
+        return nhope::makeReadyFuture();
+    }
+
+    auto body = std::move(ctx.response.body);
+    if (body == nullptr) {
+        body = nhope::StringReader::create(ctx.aoCtx, {});
+    }
+
+    auto collector = std::make_shared<BodyCollector>(std::move(body), impl.maxEntrySize());
+    return collector->start().then(ctx.aoCtx, [&ctx, cache = std::move(cache), &impl,
+                                               key = std::move(key)](BodyCollector::Result result) {
+        auto& response = ctx.response;
+        if (result.rest != nullptr) {
+            // Too large to be cached, the body is sent as is
+            auto head = nhope::StringReader::create(ctx.aoCtx, {result.data.begin(), result.data.end()});
+            response.body = nhope::concat(ctx.aoCtx, std::move(head), std::move(result.rest));
+            return;
+        }
+
+        // A collected stream is sent with its length, the two headers must not go together (RFC 9112, 6.2)
+        response.headers.erase("Transfer-Encoding");
+        response.headers["Content-Length"] = std::to_string(result.data.size());
+        auto cached = std::make_shared<CachedResponse>(CachedResponse{
+          .status = response.status,
+          .statusMessage = response.statusMessage,
+          .headers = response.headers,
+          .body = std::move(result.data),
+          .isPublic = hasToken(response.headers, "Cache-Control", "public"sv),
+          .storedAt = Clock::now(),
+        });
+        impl.store(key, cached);
+        response.body = std::make_unique<CachedBodyReader>(ctx.aoCtx, std::move(cached));
+    });
+}
+
+}   // namespace
+
+ResponseCache::ResponseCache(ResponseCacheOptions options)
+  : m_impl(std::make_unique<detail::ResponseCacheImpl>(std::move(options)))
+{}
+
+ResponseCache::~ResponseCache() = default;
+
+void ResponseCache::invalidate(std::string_view path)
+{
+    m_impl->invalidate(path, false);
+}
+
+void ResponseCache::invalidateSubtree(std::string_view path)
+{
+    m_impl->invalidate(path, true);
+}
+
+void ResponseCache::clear()
+{
+    m_impl->clear();
+}
+
+ResponseCacheStats ResponseCache::stats() const
+{
+    return m_impl->stats();
+}
+
+Middleware cacheResponses(std::shared_ptr<ResponseCache> cache)
+{
+    return [cache = std::move(cache)](RequestContext& ctx) {
+        const auto& method = ctx.request.method;
+        if (method != "GET"sv && method != "HEAD"sv) {
+            return nhope::makeReadyFuture<bool>(true);
+        }
+
+        auto& impl = *cache->m_impl;
+        const bool withCredentials = impl.hasCredentials(ctx);
+        auto key = impl.key(ctx);
+        if (auto cached = impl.find(key, withCredentials); cached != nullptr) {
+            respondFromCache(ctx, std::move(cached));
+            return nhope::makeReadyFuture<bool>(false);
+        }
+
+        // A HEAD response has no body to store, Content-Length of the handler is sent as is
+        if (method == "HEAD"sv) {
+            return nhope::makeReadyFuture<bool>(true);
+        }
+
+        ctx.responseFilters.emplace_back([cache, key = std::move(key), withCredentials](RequestContext& reqCtx) {
+            return storeResponse(reqCtx, cache, *cache->m_impl, key, withCredentials);
+        });
+        return nhope::makeReadyFuture<bool>(true);
+    };
+}
+
+}   // namespace royalbed::server
@@ -23,6 +23,7 @@
 
 #include "royalbed/common/detail/string-utils.h"
 #include "royalbed/common/response.h"
+#include "royalbed/server/detail/normalize-path.h"
 #include "royalbed/server/http-status.h"
 #include "royalbed/server/low-level-handler.h"
 #include "royalbed/server/middleware.h"
@@ -95,20 +96,7 @@ bool isFixedSegment(std::string_view segment) noexcept
     return !isParamSegment(segment);
 }
 
-std::string normalizePath(std::string_view path)
-{
-    std::string retval = fs::path(path, fs::path::format::generic_format)   //
-                           .lexically_normal()
-                           .generic_string();
-
-    if (retval.starts_with('/')) {
-        retval.erase(0, 1);
-    }
-    if (retval.ends_with('/')) {
-        retval.pop_back();
-    }
-    return retval;
-}
+using detail::normalizePath;
 
 const auto defaultNotFoundHandler = LowLevelHandler{[](RequestContext& ctx) {
     ctx.log->error("Resource route \"{}\" not found", ctx.request.uri.path);
@@ -566,4 +554,23 @@ void Router::processException(RequestContext& ctx, std::exception_ptr e, std::st
     node->exceptionHandler()(ctx, std::move(e));
 }
 
+namespace detail {
+
+std::string normalizePath(std::string_view path)
+{
+    std::string retval = fs::path(path, fs::path::format::generic_format)   //
+                           .lexically_normal()
+                           .generic_string();
+
+    if (retval.starts_with('/')) {
+        retval.erase(0, 1);
+    }
+    if (retval.ends_with('/')) {
+        retval.pop_back();
+    }
+    return retval;
+}
+
+}   // namespace detail
+
 }   // namespace royalbed::server
@@ -0,0 +1,271 @@
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <exception>
+#include <memory>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <utility>
+#include <vector>
+
+#include <unistd.h>
+
+#include <gsl/span>
+
+#include "fmt/format.h"
+
+#include "nhope/async/ao-context.h"
+#include "nhope/async/thread-pool-executor.h"
+#include "nhope/io/io-device.h"
+
+#include "royalbed/server/detail/byte-ranges.h"
+#include "royalbed/server/http-status.h"
+#include "royalbed/server/request-context.h"
+#include "royalbed/server/send-content.h"
+
+namespace royalbed::server {
+
+namespace {
+
+using namespace std::literals;
+using detail::ByteRange;
+
+// Part of the content: the bytes in memory or a range of the file read with pread
+struct Segment final
+{
+    gsl::span<const std::uint8_t> data;
+    int fd = -1;
+    std::uint64_t offset = 0;
+    std::uint64_t size = 0;
+};
+
+// Reads the content slices and the multipart framing between them without copying the content beforehand.
+// The file slices are read on the worker pool, so a truncated file fails the response instead of SIGBUS.
+class SegmentsReader final : public nhope::Reader
+{
+public:
+    SegmentsReader(nhope::AOContext& parent, std::shared_ptr<const void> owner, int fd)
+      : m_owner(std::move(owner))
+      , m_fd(fd)
+      , m_aoCtx(parent)
+    {}
+
+    void add(gsl::span<const std::uint8_t> segment)
+    {
+        if (!segment.empty()) {
+            m_segments.push_back({.data = segment, .size = segment.size()});
+        }
+    }
+
+    void add(std::string text)
+    {
+        const auto& stored = m_texts.emplace_back(std::move(text));
+        // NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast)
+        this->add(gsl::span(reinterpret_cast<const std::uint8_t*>(stored.data()), stored.size()));
+    }
+
+    // A slice of the content: of the file if the reader has one, otherwise of the bytes in memory
+    void add(gsl::span<const std::uint8_t> content, std::uint64_t offset, std::uint64_t length)
+    {
+        if (m_fd < 0) {
+            this->add(content.subspan(offset, length));
+        } else if (length > 0) {
+            m_segments.push_back({.fd = m_fd, .offset = offset, .size = length});
+        }
+    }
+
+    [[nodiscard]] std::uint64_t size() const noexcept
+    {
+        std::uint64_t result = 0;
+        for (const auto& segment : m_segments) {
+            result += segment.size;
+        }
+        return result;
+    }
+
+    void read(gsl::span<std::uint8_t> buf, nhope::IOHandler handler) override
+    {
+        std::size_t n = 0;
+        while (n < buf.size() && m_current < m_segments.size() && m_segments[m_current].fd < 0) {
+            const auto segment = m_segments[m_current].data.subspan(m_offset);
+            const auto portion = std::min(segment.size(), buf.size() - n);
+            std::memcpy(buf.data() + n, segment.data(), portion);
+            n += portion;
+            this->advance(portion);
+        }
+
+        if (n == 0 && !buf.empty() && m_current < m_segments.size()) {
+            this->readFile(buf, std::move(handler));
+            return;
+        }
+
+        m_aoCtx.exec([handler = std::move(handler), n] {
+            handler(nullptr, n);
+        });
+    }
+
+private:
+    void advance(std::uint64_t n)
+    {
+        m_offset += n;
+        if (m_offset == m_segments[m_current].size) {
+            ++m_current;
+            m_offset = 0;
+        }
+    }
+
+    void readFile(gsl::span<std::uint8_t> buf, nhope::IOHandler handler)
+    {
+        const auto& segment = m_segments[m_current];
+        const auto offset = static_cast<off_t>(segment.offset + m_offset);
+        const auto size = static_cast<std::size_t>(std::min<std::uint64_t>(buf.size(), segment.size - m_offset));
+
+        nhope::ThreadPoolExecutor::defaultExecutor().exec(
+          [this, owner = m_owner, fd = segment.fd, buf, offset, size, aoCtx = nhope::AOContextRef(m_aoCtx),
+           handler = std::move(handler)]() mutable {
+              ssize_t n = 0;
+              do {
+                  n = ::pread(fd, buf.data(), size, offset);
+              } while (n < 0 && errno == EINTR);
+
+              std::exception_ptr err;
+              if (n < 0) {
+                  err = std::make_exception_ptr(std::system_error(errno, std::generic_category(), "read file"));
+              } else if (n == 0) {
+                  // The file was truncated after Content-Length was sent
+                  err = std::make_exception_ptr(std::runtime_error("file truncated while sending"));
+              }
+
+              aoCtx.exec([this, handler = std::move(handler), err = std::move(err), n] {
+                  if (err) {
+                      handler(err, 0);
+                      return;
+                  }
+                  this->advance(static_cast<std::uint64_t>(n));
+                  handler(nullptr, static_cast<std::size_t>(n));
+              });
+          });
+    }
+
+    std::shared_ptr<const void> m_owner;
+    const int m_fd;
+    std::deque<std::string> m_texts;
+    std::vector<Segment> m_segments;
+    std::size_t m_current = 0;
+    std::uint64_t m_offset = 0;
+
+    nhope::AOContext m_aoCtx;
+};
+
+std::string contentRange(const ByteRange& range, std::uint64_t size)
+{
+    return fmt::format("bytes {}-{}/{}", range.offset, range.offset + range.length - 1, size);
+}
+
+std::string makeBoundary()
+{
+    static std::atomic<std::uint64_t> counter = 0;
+    return fmt::format("royalbed-byteranges-{:016x}", counter.fetch_add(1, std::memory_order_relaxed));
+}
+
+// The Range header is ignored for a changed representation (RFC 9110, 13.1.5), only a strong ETag matches
+bool rangeApplies(const RequestContext& ctx, const ContentInfo& info)
+{
+    const auto it = ctx.request.headers.find("If-Range");
+    if (it == ctx.request.headers.end()) {
+        return true;
+    }
+    return !info.etag.empty() && !info.etag.starts_with("W/"sv) && it->second == info.etag;
+}
+
+std::optional<std::vector<ByteRange>> requestedRanges(const RequestContext& ctx, const ContentInfo& info,
+                                                      std::uint64_t size)
+{
+    const auto it = ctx.request.headers.find("Range");
+    if (it == ctx.request.headers.end() || !rangeApplies(ctx, info)) {
+        return std::nullopt;
+    }
+    return detail::parseByteRanges(it->second, size);
+}
+
+void send(RequestContext& ctx, gsl::span<const std::uint8_t> content, int fd, std::uint64_t contentSize,
+          const ContentInfo& info, std::shared_ptr<const void> owner)
+{
+    auto& response = ctx.response;
+    response.headers["Accept-Ranges"] = "bytes";
+    if (!info.etag.empty()) {
+        response.headers["ETag"] = info.etag;
+    }
+    if (!info.contentEncoding.empty()) {
+        response.headers["Content-Encoding"] = info.contentEncoding;
+    }
+
+    auto body = std::make_unique<SegmentsReader>(ctx.aoCtx, std::move(owner), fd);
+    const auto ranges = requestedRanges(ctx, info, contentSize);
+
+    if (!ranges.has_value()) {
+        body->add(content, 0, contentSize);
+        response.headers["Content-Type"] = info.contentType;
+    } else if (ranges->empty()) {
+        response.status = HttpStatus::RequestedRangeNotSatisfiable;
+        response.headers["Content-Range"] = fmt::format("bytes */{}", contentSize);
+        response.headers["Content-Length"] = "0";
+        return;
+    } else if (ranges->size() == 1) {
+        const auto& range = ranges->front();
+        response.status = HttpStatus::PartialContent;
+        response.headers["Content-Type"] = info.contentType;
+        response.headers["Content-Range"] = contentRange(range, contentSize);
+        body->add(content, range.offset, range.length);
+    } else {
+        const auto boundary = makeBoundary();
+        response.status = HttpStatus::PartialContent;
+        response.headers["Content-Type"] = "multipart/byteranges; boundary=" + boundary;
+
+        auto delimiter = fmt::format("--{}\r\n", boundary);
+        for (const auto& range : *ranges) {
+            body->add(fmt::format("{}Content-Type: {}\r\nContent-Range: {}\r\n\r\n", delimiter, info.contentType,
+                                  contentRange(range, contentSize)));
+            body->add(content, range.offset, range.length);
+            delimiter = fmt::format("\r\n--{}\r\n", boundary);
+        }
+        body->add(fmt::format("\r\n--{}--\r\n", boundary));
+    }
+
+    response.headers["Content-Length"] = std::to_string(body->size());
+    response.body = std::move(body);
+}
+
+}   // namespace
+
+void sendContent(RequestContext& ctx, gsl::span<const std::uint8_t> content, const ContentInfo& info,
+                 std::shared_ptr<const void> owner)
+{
+    send(ctx, content, -1, content.size(), info, std::move(owner));
+}
+
+void sendFile(RequestContext& ctx, int fd, std::uint64_t size, const ContentInfo& info,
+              std::shared_ptr<const void> owner)
+{
+    send(ctx, {}, fd, size, info, std::move(owner));
+}
+
+std::string contentETag(gsl::span<const std::uint8_t> content)
+{
+    // FNV-1a
+    std::uint64_t hash = 0xcbf29ce484222325;   // NOLINT(readability-magic-numbers)
+    for (const auto byte : content) {
+        hash ^= byte;
+        hash *= 0x100000001b3;   // NOLINT(readability-magic-numbers)
+    }
+    return fmt::format("\"{:016x}-{:x}\"", hash, content.size());
+}
+
+}   // namespace royalbed::server
@@ -1,3 +1,4 @@
+#include <cstddef>
 #include <string>
 #include <string_view>
 #include <utility>
@@ -8,6 +9,7 @@
 #include "royalbed/server/response.h"
 #include "royalbed/server/http-status.h"
 
+#include "royalbed/common/detail/chunked-encoder.h"
 #include "royalbed/common/detail/write-headers.h"
 #include "royalbed/server/detail/send-response.h"
 
@@ -17,6 +19,24 @@ namespace {
 using namespace std::literals;
 using namespace royalbed::common::detail;
 
+const auto contentLengthHeader = "Content-Length"s;
+const auto transferEncodingHeader = "Transfer-Encoding"s;
+
+bool isChunked(const Response& response)
+{
+    const auto it = response.headers.find(transferEncodingHeader);
+    return it != response.headers.end() && it->second == "chunked"sv;
+}
+
+// A body of unknown length is sent in chunks
+void selectTransferEncoding(Response& response)
+{
+    if (response.body == nullptr || isChunked(response) || response.headers.contains(contentLengthHeader)) {
+        return;
+    }
+    response.headers[transferEncodingHeader] = "chunked";
+}
+
 void writeStartLine(const Response& response, std::string& out)
 {
     out += "HTTP/1.1 "sv;
@@ -45,9 +65,16 @@ nhope::ReaderPtr makeResponseStream(nhope::AOContext& aoCtx, Response&& response
         return makeResponseHeaderStream(aoCtx, response);
     }
 
+    selectTransferEncoding(response);
+
+    auto body = std::move(response.body);
+    if (isChunked(response)) {
+        body = makeChunkedEncoder(aoCtx, std::move(body), response.chunked, std::move(response.trailers));
+    }
+
     return nhope::concat(aoCtx,                                       //
                          makeResponseHeaderStream(aoCtx, response),   //
-                         std::move(response.body));
+                         std::move(body));
 }
 
 }   // namespace
@@ -1,26 +1,145 @@
 #include <cassert>
+#include <chrono>
+#include <exception>
 #include <memory>
+#include <optional>
+#include <stdexcept>
 #include <string>
 #include <string_view>
+#include <type_traits>
+#include <utility>
+#include <variant>
+#include <vector>
 
 #include "fmt/core.h"
 #include "nhope/async/ao-context.h"
+#include "nhope/async/future.h"
+#include "nhope/async/timer.h"
+#include "nhope/io/io-device.h"
 #include "nhope/io/tcp.h"
 
 #include "royalbed/common/detail/uptime.h"
+#include "royalbed/common/tcp.h"
+#include "royalbed/common/unix-socket.h"
 #include "royalbed/server/detail/connection.h"
+#include "royalbed/server/detail/timer-wheel.h"
+#include "royalbed/server/detail/tls-stream.h"
 #include "royalbed/server/server.h"
 
 namespace royalbed::server {
 namespace {
 using namespace detail;
 
-nhope::TcpServerPtr startTcpServer(nhope::AOContext& aoCtx, const ServerParams& params)
+constexpr auto timerWheelTick = std::chrono::milliseconds(100);
+
+// A failed accept (e.g. EMFILE) is retried after this delay, the listener stays open
+constexpr auto acceptRetryDelay = std::chrono::seconds(1);
+
+struct AcceptedConnection
+{
+    nhope::IODevicePtr sock;
+    std::string peer;
+};
+
+// Accepts connections on one of the server listeners
+class Acceptor
+{
+public:
+    virtual ~Acceptor() = default;
+
+    virtual nhope::Future<AcceptedConnection> accept(nhope::AOContext& aoCtx) = 0;
+
+    [[nodiscard]] virtual std::string url(bool tls) const = 0;
+    [[nodiscard]] virtual std::optional<nhope::SockAddr> tcpAddress() const = 0;
+};
+
+class TcpAcceptor final : public Acceptor
+{
+public:
+    TcpAcceptor(nhope::AOContext& aoCtx, const TcpListener& params, const ServerParams& serverParams)
+      : m_server(common::startTcpServer(aoCtx,
+                                        {
+                                          .address = params.bindAddress,
+                                          .port = params.port,
+                                        },
+                                        serverParams.socketOptions, serverParams.ioBackend))
+    {}
+
+    nhope::Future<AcceptedConnection> accept(nhope::AOContext& aoCtx) override
+    {
+        return m_server->accept().then(aoCtx, [](nhope::TcpSocketPtr sock) {
+            auto peer = sock->peerAddress().toString();
+            return AcceptedConnection{std::move(sock), std::move(peer)};
+        });
+    }
+
+    [[nodiscard]] std::string url(bool tls) const override
+    {
+        return fmt::format("{}://{}", tls ? "https" : "http", m_server->bindAddress().toString());
+    }
+
+    [[nodiscard]] std::optional<nhope::SockAddr> tcpAddress() const override
+    {
+        return m_server->bindAddress();
+    }
+
+private:
+    nhope::TcpServerPtr m_server;
+};
+
+class UnixAcceptor final : public Acceptor
 {
-    return nhope::TcpServer::start(aoCtx, {
-                                            .address = params.bindAddress,
-                                            .port = params.port,
-                                          });
+public:
+    UnixAcceptor(nhope::AOContext& aoCtx, const UnixListener& params)
+      : m_server(common::UnixServer::start(aoCtx, params.path))
+    {}
+
+    nhope::Future<AcceptedConnection> accept(nhope::AOContext& aoCtx) override
+    {
+        return m_server->accept().then(aoCtx, [](common::UnixSocketPtr sock) {
+            auto peer = sock->path();
+            return AcceptedConnection{std::move(sock), std::move(peer)};
+        });
+    }
+
+    [[nodiscard]] std::string url(bool tls) const override
+    {
+        return fmt::format("{}+unix://{}", tls ? "https" : "http", m_server->path());
+    }
+
+    [[nodiscard]] std::optional<nhope::SockAddr> tcpAddress() const override
+    {
+        return std::nullopt;
+    }
+
+private:
+    common::UnixServerPtr m_server;
+};
+
+std::vector<std::unique_ptr<Acceptor>> startAcceptors(nhope::AOContext& aoCtx, const ServerParams& params)
+{
+    std::vector<std::unique_ptr<Acceptor>> acceptors;
+    if (!params.bindAddress.empty()) {
+        acceptors.push_back(std::make_unique<TcpAcceptor>(aoCtx, TcpListener{params.bindAddress, params.port}, params));
+    }
+
+    for (const auto& listener : params.listeners) {
+        std::visit(
+          [&](const auto& l) {
+              using T = std::decay_t<decltype(l)>;
+              if constexpr (std::is_same_v<T, TcpListener>) {
+                  acceptors.push_back(std::make_unique<TcpAcceptor>(aoCtx, l, params));
+              } else {
+                  acceptors.push_back(std::make_unique<UnixAcceptor>(aoCtx, l));
+              }
+          },
+          listener);
+    }
+
+    if (acceptors.empty()) {
+        throw std::invalid_argument("The server has no listeners");
+    }
+    return acceptors;
 }
 
 class ServerImpl final
@@ -30,20 +149,28 @@ class ServerImpl final
 public:
     ServerImpl(nhope::AOContext& aoCtx, ServerParams&& params)
       : m_log(params.log)
-      , m_tcpServer(startTcpServer(aoCtx, params))
+      , m_tlsCtx(params.tls.has_value() ? makeTlsContext(*params.tls, params.http2.enabled) : nullptr)
+      , m_acceptors(startAcceptors(aoCtx, params))
       , m_router(std::move(params.router))
+      , m_http2(params.http2)
+      , m_timeouts(params.timeouts)
+      , m_limits(params.limits)
       , m_upTime(m_log, "service uptime")
       , m_aoCtx(aoCtx)
+      , m_timers(std::make_shared<TimerWheel>(m_aoCtx, timerWheelTick))
     {
-        const auto bindAddr = m_tcpServer->bindAddress();
-        m_log->info("service accepting HTTP connections at http://{}", bindAddr.toString());
+        for (const auto& acceptor : m_acceptors) {
+            m_log->info("service accepting HTTP connections at {}", acceptor->url(m_tlsCtx != nullptr));
+        }
 
         for (const auto& resource : m_router.resources()) {
             m_log->info("resource published on route {}", resource);
         }
 
         m_aoCtx.exec([this] {
-            this->acceptNextConnection();
+            for (auto& acceptor : m_acceptors) {
+                this->acceptNextConnection(*acceptor);
+            }
         });
     }
 
@@ -54,7 +181,12 @@ public:
 
     [[nodiscard]] nhope::SockAddr bindAddress() const override
     {
-        return m_tcpServer->bindAddress();
+        for (const auto& acceptor : m_acceptors) {
+            if (auto addr = acceptor->tcpAddress(); addr.has_value()) {
+                return *addr;
+            }
+        }
+        throw std::logic_error("The server has no TCP listeners");
     }
 
 private:
@@ -89,33 +221,54 @@ private:
         m_log->trace("The connection with num={} closed", connectionNum);
     }
 
-    void acceptNextConnection()
+    void acceptNextConnection(Acceptor& acceptor)
     {
-        m_tcpServer->accept().then(m_aoCtx, [this](auto connection) {
-            ++m_activeConnectionCount;
-            const auto connectionNum = ++m_connectionCounter;
-
-            m_log->trace("New connection accepted: num={}, peer={}", connectionNum,
-                         connection->peerAddress().toString());
-
-            detail::openConnection(m_aoCtx, {
-                                              .num = connectionNum,
-                                              .keepAlive = m_keepAlive,
-                                              .ctx = *this,
-                                              .log = m_log->clone(fmt::format("{}/C{}", m_log->name(), connectionNum)),
-                                              .sock = std::move(connection),
-                                            });
-
-            this->acceptNextConnection();
-        });
+        acceptor.accept(m_aoCtx)
+          .then(m_aoCtx,
+                [this, &acceptor](AcceptedConnection connection) {
+                    ++m_activeConnectionCount;
+                    const auto connectionNum = ++m_connectionCounter;
+
+                    m_log->trace("New connection accepted: num={}, peer={}", connectionNum, connection.peer);
+
+                    auto log = m_log->clone(fmt::format("{}/C{}", m_log->name(), connectionNum));
+                    detail::openConnection(m_aoCtx, {
+                                                      .num = connectionNum,
+                                                      .keepAlive = m_keepAlive,
+                                                      .ctx = *this,
+                                                      .log = std::move(log),
+                                                      .sock = std::move(connection.sock),
+                                                      .http2 = m_http2,
+                                                      .tls = m_tlsCtx,
+                                                      .timers = m_timers,
+                                                      .timeouts = m_timeouts,
+                                                      .limits = m_limits,
+                                                    });
+
+                    this->acceptNextConnection(acceptor);
+                })
+          .fail(m_aoCtx, [this, &acceptor](auto ex) {
+              try {
+                  std::rethrow_exception(std::move(ex));
+              } catch (const std::exception& e) {
+                  m_log->error("accept failed: {}", e.what());
+              }
+              nhope::setTimeout(m_aoCtx, acceptRetryDelay, [this, &acceptor](auto) {
+                  this->acceptNextConnection(acceptor);
+              });
+          });
     }
 
     std::shared_ptr<spdlog::logger> m_log;
-    nhope::TcpServerPtr m_tcpServer;
+    TlsContextPtr m_tlsCtx;
+    std::vector<std::unique_ptr<Acceptor>> m_acceptors;
     Router m_router;
 
     // TODO add max connections limit
     KeepAliveParams m_keepAlive{};
+    Http2Params m_http2;
+    Timeouts m_timeouts;
+    RequestLimits m_limits;
 
     std::uint32_t m_activeConnectionCount = 0;
     std::uint32_t m_activeSessionCount = 0;
@@ -126,6 +279,9 @@ private:
     royalbed::common::detail::UpTimeLogger m_upTime;
 
     nhope::AOContext m_aoCtx;
+
+    // One wheel serves the deadlines of all connections
+    TimerWheelPtr m_timers;
 };
 
 }   // namespace
@@ -4,9 +4,9 @@
 #include <cstddef>
 #include <cstdint>
 #include <exception>
+#include <memory>
 #include <string>
 #include <string_view>
-#include <type_traits>
 #include <utility>
 
 #include "spdlog/logger.h"
@@ -14,17 +14,18 @@
 #include "nhope/async/ao-context.h"
 #include "nhope/async/future.h"
 #include "nhope/io/io-device.h"
-#include "nhope/io/pushback-reader.h"
 
+#include "royalbed/common/detail/connection-buffer.h"
+#include "royalbed/common/detail/string-utils.h"
 #include "royalbed/common/detail/uptime.h"
+#include "royalbed/server/detail/process-request.h"
 #include "royalbed/server/detail/receive-request.h"
 #include "royalbed/server/detail/send-response.h"
 #include "royalbed/server/detail/session.h"
 #include "royalbed/server/error.h"
 #include "royalbed/server/http-status.h"
-#include "royalbed/server/low-level-handler.h"
-#include "royalbed/server/middleware.h"
 #include "royalbed/server/request-context.h"
+#include "royalbed/server/request-limits.h"
 #include "royalbed/server/request.h"
 #include "royalbed/server/response.h"
 
@@ -32,34 +33,85 @@ namespace royalbed::server::detail {
 
 namespace {
 using namespace std::literals;
+using common::detail::ConnectionBuffer;
 
 const auto ConnectionHeader = "Connection"s;
 const auto ConnectionHeaderCloseValue = "close"s;
+const auto ExpectHeader = "Expect"s;
+const auto ExpectHeaderContinueValue = "100-continue"s;
 
-std::string gmtDateTime()
+// The unread rest of a body up to this size is skipped to keep the connection alive, a longer one closes it
+constexpr std::size_t maxDrainSize = 64 * 1024;
+constexpr std::size_t drainBufSize = 4096;
+
+// Tells the connection when the handler waits for the request body and the session when the body is read up to
+// the end. The body itself is owned by the session, so the rest of it can be skipped after the handler.
+class BodyWaitReader final : public nhope::Reader
 {
-    constexpr auto bufSize{100};
-    std::array<char, bufSize> dateBuffer{};
-    const auto curTime = std::chrono::system_clock::to_time_t(std::chrono::system_clock::now());
-    const char* fmt = "%a, %d %Y %b %H:%M:%S GMT";
-    const auto count = std::strftime(dateBuffer.data(), bufSize, fmt, std::gmtime(&curTime));
-    return {dateBuffer.data(), count};
-}
+public:
+    BodyWaitReader(nhope::Reader& body, SessionCtx& ctx, std::uint32_t sessionNum, bool& eof)
+      : m_body(body)
+      , m_ctx(ctx)
+      , m_sessionNum(sessionNum)
+      , m_eof(eof)
+    {}
+
+    void read(gsl::span<std::uint8_t> buf, nhope::IOHandler handler) override
+    {
+        m_ctx.sessionBodyWait(m_sessionNum, true);
+        m_body.read(buf, [&ctx = m_ctx, sessionNum = m_sessionNum, &eof = m_eof, requested = !buf.empty(),
+                          handler = std::move(handler)](std::exception_ptr err, std::size_t n) {
+            ctx.sessionBodyWait(sessionNum, false);
+            if (err == nullptr && n == 0 && requested) {
+                eof = true;
+            }
+            handler(std::move(err), n);
+        });
+    }
 
-template<typename AsyncFunc>
-auto safeCall(RequestContext& ctx, AsyncFunc&& func)
+private:
+    nhope::Reader& m_body;
+    SessionCtx& m_ctx;
+    const std::uint32_t m_sessionNum;
+    bool& m_eof;
+};
+
+// Sends 100 Continue when the handler starts reading the body. A request rejected by the routing,
+// the middlewares or the body limit is answered before the client uploads the body.
+class ContinueReader final : public nhope::Reader
 {
-    using Future = std::invoke_result_t<AsyncFunc, RequestContext&>;
-    using Promise = nhope::Promise<typename Future::Type>;
+public:
+    ContinueReader(nhope::AOContext& aoCtx, nhope::ReaderPtr body, nhope::Writter& out, bool& continueSent)
+      : m_aoCtx(aoCtx)
+      , m_body(std::move(body))
+      , m_out(out)
+      , m_continueSent(continueSent)
+    {}
+
+    void read(gsl::span<std::uint8_t> buf, nhope::IOHandler handler) override
+    {
+        if (m_continueSent) {
+            m_body->read(buf, std::move(handler));
+            return;
+        }
 
-    try {
-        return func(ctx);
-    } catch (...) {
-        Promise p;
-        p.setException(std::current_exception());
-        return p.future();
+        m_continueSent = true;
+        sendResponse(m_aoCtx, Response{.status = HttpStatus::Continue}, m_out)
+          .then(m_aoCtx,
+                [this, buf, handler](auto /*unused*/) mutable {
+                    m_body->read(buf, std::move(handler));
+                })
+          .fail(m_aoCtx, [handler](auto ex) mutable {
+              handler(std::move(ex), 0);
+          });
     }
-}
+
+private:
+    nhope::AOContext& m_aoCtx;
+    nhope::ReaderPtr m_body;
+    nhope::Writter& m_out;
+    bool& m_continueSent;
+};
 
 class Session final : public nhope::AOContextCloseHandler
 {
@@ -68,7 +120,8 @@ public:
       : m_num(param.num)
       , m_ctx(param.ctx)
       , m_in(param.in)
-      , m_out(param.out)      
+      , m_out(param.out)
+      , m_limits(param.limits)
       , m_requestCtx{
           .num = param.num,
           .log = std::move(param.log),
@@ -77,6 +130,9 @@ public:
           .rawPathParams{},
           .response{},
           .aoCtx = nhope::AOContext(aoCtx),
+          .upgrade{},
+          .maxBodySize = param.limits.maxBodySize,
+          .maxDecodedBodySize = param.limits.maxDecodedBodySize,
         }
         , m_upTime(m_requestCtx.log, "session time:")
     {
@@ -104,18 +160,54 @@ private:
         delete this;
     }
 
+    // The first received bytes separate waiting for a request on a keep-alive connection from receiving it
     void start()
     {
-        receiveRequest(m_requestCtx.aoCtx, m_in)
+        m_ctx.sessionStage(m_num, SessionStage::WaitRequest);
+        if (!m_in.data().empty()) {
+            // The request has been pipelined after the previous one
+            this->receive();
+            return;
+        }
+
+        m_in.fill([this, aoCtx = nhope::AOContextRef(aoCtx())](std::exception_ptr err, std::size_t n) mutable {
+            aoCtx.exec([this, err = std::move(err), n] {
+                if (err || n == 0) {
+                    // The client closed the connection between requests
+                    this->finished(false);
+                    return;
+                }
+                this->receive();
+            });
+        });
+    }
+
+    void receive()
+    {
+        m_ctx.sessionStage(m_num, SessionStage::ReceiveHeaders);
+        receiveRequest(m_requestCtx.aoCtx, m_in, m_limits)
           .then(aoCtx(),
                 [this](auto req) mutable {
+                    m_requestReceived = true;
                     m_ctx.sessionReceivedRequest(m_num);
+                    m_ctx.sessionStage(m_num, SessionStage::ProcessRequest);
+                    if (req.body != nullptr) {
+                        this->checkExpect(req);
+                        if (m_expectContinue) {
+                            req.body = std::make_unique<ContinueReader>(aoCtx(), std::move(req.body), m_out,
+                                                                        m_continueSent);
+                        }
+                    }
                     return this->processingRequest(std::move(req));
                 })
           .fail(aoCtx(),
                 [this](auto ex) {
                     return this->makeResponseFromError(std::move(ex));
                 })
+          .then(aoCtx(),
+                [this] {
+                    return this->drainBody();
+                })
           .then(aoCtx(),
                 [this] {
                     return this->sendResponse();
@@ -134,60 +226,96 @@ private:
           });
     }
 
-    nhope::Future<void> processingRequest(Request&& req)
+    void checkExpect(const Request& req)
     {
-        m_requestCtx.log->trace("request: \"{} {}\"", req.method, req.uri.path);
+        const auto it = req.headers.find(ExpectHeader);
+        if (it == req.headers.end()) {
+            return;
+        }
+        if (common::detail::toLower(it->second) != ExpectHeaderContinueValue) {
+            throw HttpError(HttpStatus::ExpectationFailed);
+        }
+        m_expectContinue = true;
+    }
 
-        auto routeResult = m_requestCtx.router.route(req.method, req.uri.path);
-        m_handler = std::move(routeResult.handler);
-        m_middlewares = std::move(routeResult.middlewares);
-        m_requestCtx.rawPathParams = std::move(routeResult.rawPathParams);
+    nhope::Future<void> processingRequest(Request&& req)
+    {
         m_requestCtx.request = std::move(req);
 
-        return this->doMiddlewares().then(aoCtx(), [this](bool doHandler) {
-            if (!doHandler) {
-                return nhope::makeReadyFuture();
-            }
+        if (auto h2c = m_ctx.sessionH2cUpgrade(m_requestCtx.request); h2c != nullptr) {
+            // The request is answered on HTTP/2 stream 1 after the switch
+            m_requestCtx.response = Response{
+              .status = HttpStatus::SwitchingProtocols,
+              .statusMessage = std::string(HttpStatus::message(HttpStatus::SwitchingProtocols)),
+              .headers = {{"Connection", "Upgrade"}, {"Upgrade", "h2c"}},
+            };
+            m_requestCtx.upgrade = std::move(h2c);
+            return nhope::makeReadyFuture();
+        }
 
-            return safeCall(m_requestCtx, m_handler);
-        });
+        if (auto& body = m_requestCtx.request.body; body != nullptr) {
+            m_body = std::move(body);
+            body = std::make_unique<BodyWaitReader>(*m_body, m_ctx, m_num, m_bodyEof);
+        }
+        return processRequest(m_requestCtx);
+    }
+
+    void makeResponseFromError(std::exception_ptr ex)
+    {
+        detail::makeResponseFromError(m_requestCtx, std::move(ex));
     }
 
-    nhope::Future<bool> doMiddlewares()
+    // A handler may leave the body unread (e.g. after a parse error). The rest of it would be taken for
+    // the next pipelined request, so a short rest is skipped and a longer one closes the connection.
+    nhope::Future<void> drainBody()
     {
-        if (m_middlewares.empty()) {
-            return nhope::makeReadyFuture<bool>(true);
+        if (m_body == nullptr || m_bodyEof || m_ctx.sessionNeedClose() || this->bodyLeftUnread()) {
+            return nhope::makeReadyFuture();
         }
 
-        const auto& middleware = m_middlewares.front();
-        return safeCall(m_requestCtx, middleware).then(aoCtx(), [this](bool doNext) {
-            assert(!m_middlewares.empty());   // NOLINT
+        auto reader = std::make_shared<BodyWaitReader>(*m_body, m_ctx, m_num, m_bodyEof);
+        auto promise = std::make_shared<nhope::Promise<void>>();
+        this->drainNext(std::move(reader), promise);
+        return promise->future();
+    }
 
-            m_middlewares.pop_front();
-            if (!doNext) {
-                return nhope::makeReadyFuture<bool>(false);
+    void drainNext(std::shared_ptr<BodyWaitReader> reader, std::shared_ptr<nhope::Promise<void>> promise)
+    {
+        auto& body = *reader;
+        body.read(m_drainBuf, [this, reader = std::move(reader), promise](std::exception_ptr err, std::size_t n) {
+            m_drained += n;
+            if (err != nullptr || n == 0 || m_drained > maxDrainSize) {
+                // Without the end of the body the connection is closed, see needClose
+                promise->setValue();
+                return;
             }
-            return this->doMiddlewares();
+            this->drainNext(reader, promise);
         });
     }
 
-    void makeResponseFromError(std::exception_ptr ex)
+    // The rest of the request is left unread on purpose, it cannot be told from the next request
+    bool bodyLeftUnread() const noexcept
     {
-        try {
-            std::rethrow_exception(std::move(ex));
-        } catch (const HttpError& e) {
-            m_requestCtx.response = common::makePlainTextResponse(aoCtx(), e.httpStatus(), e.what());
-
-        } catch (const std::exception& e) {
-            m_requestCtx.response = common::makePlainTextResponse(aoCtx(), HttpStatus::InternalServerError, e.what());
+        const auto status = m_requestCtx.response.status;
+        if (!m_requestReceived || status == HttpStatus::RequestEntityTooLarge ||
+            status == HttpStatus::ExpectationFailed) {
+            return true;
         }
+
+        // The client waiting for 100 Continue may still send the body after its timeout
+        return m_expectContinue && !m_continueSent;
     }
 
     bool needClose() const noexcept
     {
-        if (m_ctx.sessionNeedClose()) {
+        if (m_ctx.sessionNeedClose() || this->bodyLeftUnread()) {
             return true;
         }
+
+        if (m_body != nullptr && !m_bodyEof) {
+            return true;
+        }
+
         if (auto it = m_requestCtx.request.headers.find(ConnectionHeader); it != m_requestCtx.request.headers.end()) {
             return it->second == ConnectionHeaderCloseValue;
         }
@@ -196,16 +324,22 @@ private:
 
     nhope::Future<bool> sendResponse()
     {
+        m_ctx.sessionStage(m_num, SessionStage::SendResponse);
         m_requestCtx.log->trace("response: {}", m_requestCtx.response.status);
-        auto needAddClose = needClose();
+        const bool upgrade =
+          m_requestCtx.upgrade != nullptr && m_requestCtx.response.status == HttpStatus::SwitchingProtocols;
+        auto needAddClose = !upgrade && needClose();
         if (needAddClose) {
             m_requestCtx.response.headers[ConnectionHeader] = ConnectionHeaderCloseValue;
         }
         m_requestCtx.response.headers["Date"] = gmtDateTime();
 
         return detail::sendResponse(aoCtx(), std::move(m_requestCtx.response), m_out)
-          .then(aoCtx(), [this, keepAlive = !needAddClose](auto size) {
+          .then(aoCtx(), [this, keepAlive = !needAddClose, upgrade](auto size) {
               m_requestCtx.log->trace("response has been sent: {} bytes", size);
+              if (upgrade) {
+                  m_upgrade = std::move(m_requestCtx.upgrade);
+              }
               return keepAlive;
           });
     }
@@ -218,9 +352,14 @@ private:
 
         const auto num = m_num;
         auto& ctx = m_ctx;
+        auto upgrade = std::move(m_upgrade);
 
         m_requestCtx.aoCtx.close();
 
+        if (upgrade) {
+            ctx.sessionUpgraded(num, std::move(upgrade));
+            return;
+        }
         ctx.sessionFinished(num, keepAlive);
     }
 
@@ -232,13 +371,22 @@ private:
     const std::uint32_t m_num;
     SessionCtx& m_ctx;
 
-    nhope::PushbackReader& m_in;
+    ConnectionBuffer& m_in;
     nhope::Writter& m_out;
+    const RequestLimits m_limits;
 
     bool m_finished = false;
+    bool m_requestReceived = false;
+    bool m_expectContinue = false;
+    bool m_continueSent = false;
+
+    // The body as received, the request gets a BodyWaitReader over it
+    nhope::ReaderPtr m_body;
+    bool m_bodyEof = false;
+    std::size_t m_drained = 0;
+    std::array<std::uint8_t, drainBufSize> m_drainBuf{};
 
-    LowLevelHandler m_handler;
-    std::list<Middleware> m_middlewares;
+    UpgradeHandler m_upgrade;
 
     RequestContext m_requestCtx;
     royalbed::common::detail::UpTimeLogger m_upTime;
@@ -0,0 +1,308 @@
+#include <array>
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <filesystem>
+#include <memory>
+#include <string>
+#include <system_error>
+#include <utility>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include <gsl/span>
+
+#include "nhope/async/ao-context.h"
+#include "nhope/async/future.h"
+#include "nhope/async/thread-pool-executor.h"
+#include "nhope/io/io-device.h"
+
+#include "royalbed/server/middleware.h"
+#include "royalbed/server/request-context.h"
+#include "royalbed/server/spooled-body.h"
+
+namespace royalbed::server {
+
+namespace detail {
+
+// The body in memory or in a read-only mapping of the spool file
+class SpooledStorage final
+{
+public:
+    explicit SpooledStorage(std::vector<std::uint8_t> data)
+      : m_data(std::move(data))
+    {}
+
+    SpooledStorage(void* mapping, std::size_t size)
+      : m_mapping(mapping)
+      , m_mappingSize(size)
+    {}
+
+    SpooledStorage(const SpooledStorage&) = delete;
+    SpooledStorage& operator=(const SpooledStorage&) = delete;
+
+    ~SpooledStorage()
+    {
+        if (m_mapping != nullptr) {
+            ::munmap(m_mapping, m_mappingSize);
+        }
+    }
+
+    [[nodiscard]] gsl::span<const std::uint8_t> data() const noexcept
+    {
+        if (m_mapping != nullptr) {
+            return {static_cast<const std::uint8_t*>(m_mapping), m_mappingSize};
+        }
+        return m_data;
+    }
+
+    [[nodiscard]] bool spooled() const noexcept
+    {
+        return m_mapping != nullptr;
+    }
+
+private:
+    std::vector<std::uint8_t> m_data;
+    void* m_mapping = nullptr;
+    std::size_t m_mappingSize = 0;
+};
+
+}   // namespace detail
+
+namespace {
+
+constexpr std::size_t readBufSize = 64 * 1024;
+
+class FileDescriptor final
+{
+public:
+    FileDescriptor() = default;
+    FileDescriptor(const FileDescriptor&) = delete;
+    FileDescriptor& operator=(const FileDescriptor&) = delete;
+
+    ~FileDescriptor()
+    {
+        if (m_fd >= 0) {
+            ::close(m_fd);
+        }
+    }
+
+    void reset(int fd) noexcept
+    {
+        if (m_fd >= 0) {
+            ::close(m_fd);
+        }
+        m_fd = fd;
+    }
+
+    [[nodiscard]] int get() const noexcept
+    {
+        return m_fd;
+    }
+
+private:
+    int m_fd = -1;
+};
+
+[[noreturn]] void throwSystemError(const std::string& what)
+{
+    throw std::system_error(errno, std::generic_category(), what);
+}
+
+// An unnamed file disappears with its last descriptor even if the process crashes.
+// Without O_TMPFILE support in the file system a named file is unlinked right after creation.
+int openSpoolFile(const std::filesystem::path& dir)
+{
+    // NOLINTNEXTLINE(cppcoreguidelines-pro-type-vararg)
+    const int fd = ::open(dir.c_str(), O_TMPFILE | O_RDWR | O_CLOEXEC, S_IRUSR | S_IWUSR);
+    if (fd >= 0) {
+        return fd;
+    }
+    if (errno != EOPNOTSUPP && errno != EISDIR && errno != EINVAL) {
+        throwSystemError("create spool file in " + dir.string());
+    }
+
+    auto name = (dir / "royalbed-body-XXXXXX").string();
+    const int namedFd = ::mkostemp(name.data(), O_CLOEXEC);
+    if (namedFd < 0) {
+        throwSystemError("create spool file in " + dir.string());
+    }
+    ::unlink(name.c_str());
+    return namedFd;
+}
+
+// The spool file is created and written on the worker pool, the next portion is read after the write
+class SpoolReceiver final : public std::enable_shared_from_this<SpoolReceiver>
+{
+public:
+    SpoolReceiver(nhope::AOContext& aoCtx, nhope::Reader& body, std::size_t threshold, std::filesystem::path dir)
+      : m_aoCtx(aoCtx)
+      , m_body(body)
+      , m_threshold(threshold)
+      , m_dir(std::move(dir))
+    {}
+
+    nhope::Future<std::unique_ptr<detail::SpooledStorage>> start()
+    {
+        this->readNext();
+        return m_promise.future();
+    }
+
+private:
+    void readNext()
+    {
+        m_body.read(m_buf, [self = this->shared_from_this()](std::exception_ptr err, std::size_t n) {
+            if (err) {
+                self->m_promise.setException(std::move(err));
+                return;
+            }
+
+            if (n == 0) {
+                try {
+                    self->m_promise.setValue(self->finish());
+                } catch (...) {
+                    self->m_promise.setException(std::current_exception());
+                }
+                return;
+            }
+            self->store(gsl::span<const std::uint8_t>(self->m_buf).first(n));
+        });
+    }
+
+    void store(gsl::span<const std::uint8_t> portion)
+    {
+        if (m_file.get() < 0 && m_data.size() + portion.size() <= m_threshold) {
+            m_data.insert(m_data.end(), portion.begin(), portion.end());
+            this->readNext();
+            return;
+        }
+
+        // The first write to the file takes the bytes kept in memory so far
+        auto data = std::exchange(m_data, {});
+        data.insert(data.end(), portion.begin(), portion.end());
+        this->spool(std::move(data));
+    }
+
+    // The file is not touched by the AO thread until the write is done
+    void spool(std::vector<std::uint8_t> data)
+    {
+        nhope::ThreadPoolExecutor::defaultExecutor().exec(
+          [self = this->shared_from_this(), data = std::move(data), aoCtx = m_aoCtx]() mutable {
+              std::exception_ptr err;
+              try {
+                  if (self->m_file.get() < 0) {
+                      self->m_file.reset(openSpoolFile(self->m_dir));
+                  }
+                  self->write(data);
+              } catch (...) {
+                  err = std::current_exception();
+              }
+
+              aoCtx.exec([self, err = std::move(err)] {
+                  if (err) {
+                      self->m_promise.setException(err);
+                  } else {
+                      self->readNext();
+                  }
+              });
+          });
+    }
+
+    void write(gsl::span<const std::uint8_t> data)
+    {
+        while (!data.empty()) {
+            const auto n = ::write(m_file.get(), data.data(), data.size());
+            if (n < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                throwSystemError("write to spool file");
+            }
+            data = data.subspan(static_cast<std::size_t>(n));
+            m_fileSize += static_cast<std::size_t>(n);
+        }
+    }
+
+    std::unique_ptr<detail::SpooledStorage> finish()
+    {
+        if (m_file.get() < 0) {
+            return std::make_unique<detail::SpooledStorage>(std::move(m_data));
+        }
+
+        // The mapping keeps the file alive after the descriptor is closed
+        void* mapping = ::mmap(nullptr, m_fileSize, PROT_READ, MAP_SHARED, m_file.get(), 0);
+        if (mapping == MAP_FAILED) {   // NOLINT(cppcoreguidelines-pro-type-cstyle-cast)
+            throwSystemError("map spool file");
+        }
+        m_file.reset(-1);
+        return std::make_unique<detail::SpooledStorage>(mapping, m_fileSize);
+    }
+
+    nhope::AOContextRef m_aoCtx;
+    nhope::Reader& m_body;
+    const std::size_t m_threshold;
+    const std::filesystem::path m_dir;
+    nhope::Promise<std::unique_ptr<detail::SpooledStorage>> m_promise;
+
+    std::array<std::uint8_t, readBufSize> m_buf{};
+    std::vector<std::uint8_t> m_data;
+    FileDescriptor m_file;
+    std::size_t m_fileSize = 0;
+};
+
+}   // namespace
+
+SpooledBody::SpooledBody(std::unique_ptr<detail::SpooledStorage> storage)
+  : m_storage(std::move(storage))
+{}
+
+SpooledBody::SpooledBody(SpooledBody&&) noexcept = default;
+SpooledBody& SpooledBody::operator=(SpooledBody&&) noexcept = default;
+SpooledBody::~SpooledBody() = default;
+
+gsl::span<const std::uint8_t> SpooledBody::data() const noexcept
+{
+    return m_storage->data();
+}
+
+std::size_t SpooledBody::size() const noexcept
+{
+    return m_storage->data().size();
+}
+
+bool SpooledBody::spooled() const noexcept
+{
+    return m_storage->spooled();
+}
+
+nhope::Future<SpooledBody> SpooledBody::receive(nhope::AOContext& aoCtx, nhope::Reader& body, std::size_t threshold,
+                                                const std::filesystem::path& dir)
+{
+    auto receiver = std::make_shared<SpoolReceiver>(aoCtx, body, threshold, dir);
+    return receiver->start().then([](std::unique_ptr<detail::SpooledStorage> storage) {
+        return SpooledBody(std::move(storage));
+    });
+}
+
+nhope::Future<SpooledBody> SpooledBody::receive(RequestContext& ctx)
+{
+    if (ctx.request.body == nullptr) {
+        return nhope::makeReadyFuture<SpooledBody>(
+          SpooledBody(std::make_unique<detail::SpooledStorage>(std::vector<std::uint8_t>())));
+    }
+    return receive(ctx.aoCtx, *ctx.request.body, ctx.spoolThreshold);
+}
+
+Middleware spoolBodyAbove(std::size_t threshold)
+{
+    return [threshold](RequestContext& ctx) {
+        ctx.spoolThreshold = threshold;
+        return nhope::makeReadyFuture<bool>(true);
+    };
+}
+
+}   // namespace royalbed::server
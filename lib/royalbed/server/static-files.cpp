@@ -1,5 +1,7 @@
+#include <algorithm>
 #include <cstddef>
 #include <cstdint>
+#include <exception>
 #include <filesystem>
 #include <list>
 #include <map>
@@ -8,15 +10,22 @@
 #include <stdexcept>
 #include <string_view>
 #include <string>
+#include <utility>
 
 #include "fmt/format.h"
 #include "cmrc/cmrc.hpp"
 
+#include <gsl/span>
+
 #include "nhope/async/future.h"
-#include "nhope/io/string-reader.h"
+#include "nhope/async/thread-pool-executor.h"
 
+#include "royalbed/common/detail/string-utils.h"
 #include "royalbed/common/mime-type.h"
+#include "royalbed/server/asset-bundle.h"
+#include "royalbed/server/file-cache.h"
 #include "royalbed/server/router.h"
+#include "royalbed/server/send-content.h"
 #include "royalbed/server/static-files.h"
 
 namespace royalbed::server {
@@ -24,6 +33,7 @@ namespace royalbed::server {
 namespace {
 namespace fs = std::filesystem;
 using namespace std::literals;
+using common::detail::trim;
 
 constexpr auto indexHtml = "index.html"sv;
 
@@ -51,6 +61,109 @@ std::string removeEncoderExtension(std::string_view filePath)
     return std::string(filePath.substr(0, encoderExtensionPos));
 }
 
+void redirectToIndex(Router& router, std::string_view parentPath)
+{
+    router.get(parentPath, [](RequestContext& ctx) {
+        auto path = ctx.request.uri.path;
+        if (!path.empty() && path.back() == '/') {
+            path.pop_back();
+        }
+        ctx.response.headers["Location"] = fmt::format("{}/{}", path, indexHtml);
+        ctx.response.status = HttpStatus::Found;
+    });
+}
+
+bool acceptsGzip(const RequestContext& ctx)
+{
+    const auto it = ctx.request.headers.find("Accept-Encoding");
+    if (it == ctx.request.headers.end()) {
+        return false;
+    }
+
+    std::string_view list = it->second;
+    while (!list.empty()) {
+        const auto comma = std::min(list.find(','), list.size());
+        const auto item = common::detail::toLower(list.substr(0, comma));
+        list.remove_prefix(std::min(comma + 1, list.size()));
+
+        const auto semicolon = std::min(item.find(';'), item.size());
+        const auto coding = trim(std::string_view(item).substr(0, semicolon));
+        if (coding != "gzip"sv && coding != "*"sv) {
+            continue;
+        }
+
+        // q=0 means "not acceptable"
+        const auto q = item.find("q=", semicolon);
+        return q == std::string::npos ||
+               trim(std::string_view(item).substr(q + 2)).find_first_not_of("0.") != std::string_view::npos;
+    }
+    return false;
+}
+
+// Opening the file and reading it into the cache block, so they are done on the worker pool
+nhope::Future<void> sendDiskFile(RequestContext& ctx, fs::path path, std::shared_ptr<FileCache> cache)
+{
+    auto promise = std::make_shared<nhope::Promise<FileContent>>();
+    nhope::ThreadPoolExecutor::defaultExecutor().exec([promise, path = std::move(path), cache = std::move(cache)] {
+        try {
+            promise->setValue(cache != nullptr ? cache->get(path) : loadFile(path));
+        } catch (...) {
+            promise->setException(std::current_exception());
+        }
+    });
+    return promise->future().then(ctx.aoCtx, [&ctx](const FileContent& content) {
+        sendContent(ctx, content);
+    });
+}
+
+void publicDiskFile(Router& router, const fs::path& file, std::string_view resourcePath,
+                    const std::shared_ptr<FileCache>& cache)
+{
+    auto gzipFile = file;
+    gzipFile += ".gz";
+    if (!fs::is_regular_file(gzipFile)) {
+        router.get(resourcePath, [file, cache](RequestContext& ctx) {
+            return sendDiskFile(ctx, file, cache);
+        });
+        return;
+    }
+
+    router.get(resourcePath, [file, gzipFile, cache](RequestContext& ctx) {
+        ctx.response.headers["Vary"] = "Accept-Encoding";
+        return sendDiskFile(ctx, acceptsGzip(ctx) ? gzipFile : file, cache);
+    });
+}
+
+ContentInfo contentInfo(const Asset& asset, const AssetVariant& variant)
+{
+    return {
+      .contentType = std::string(asset.contentType),
+      .contentEncoding = std::string(variant.contentEncoding),
+      .etag = std::string(variant.etag),
+    };
+}
+
+void publicAsset(Router& router, const Asset& asset, const std::shared_ptr<const void>& owner)
+{
+    auto info = contentInfo(asset, asset.content);
+    if (!asset.gzip.has_value()) {
+        router.get(asset.path, [content = asset.content.data, info = std::move(info), owner](RequestContext& ctx) {
+            sendContent(ctx, content, info, owner);
+        });
+        return;
+    }
+
+    router.get(asset.path, [content = asset.content.data, info = std::move(info), gzip = asset.gzip->data,
+                            gzipInfo = contentInfo(asset, *asset.gzip), owner](RequestContext& ctx) {
+        ctx.response.headers["Vary"] = "Accept-Encoding";
+        if (acceptsGzip(ctx)) {
+            sendContent(ctx, gzip, gzipInfo, owner);
+        } else {
+            sendContent(ctx, content, info, owner);
+        }
+    });
+}
+
 void publicFile(Router& router, const cmrc::embedded_filesystem& fs, const cmrc::directory_entry& entry,
                 std::string_view parentPath)
 
@@ -63,27 +176,18 @@ void publicFile(Router& router, const cmrc::embedded_filesystem& fs, const cmrc:
     if (contentEncoding) {
         resourcePath = removeEncoderExtension(resourcePath);
     }
-    router.get(resourcePath,
-               [file, contentEncoding,
-                contentType = std::string(common::mimeTypeForFileName(resourcePath))](RequestContext& ctx) {
-                   ctx.response.headers["Content-Length"] = std::to_string(file.size());
-                   ctx.response.headers["Content-Type"] = contentType;
-
-                   if (contentEncoding != std::nullopt) {
-                       ctx.response.headers["Content-Encoding"] = contentEncoding.value();
-                   };
-                   ctx.response.body = nhope::StringReader::create(ctx.aoCtx, {file.begin(), file.end()});
-               });
+    // NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast)
+    const auto content = gsl::span(reinterpret_cast<const std::uint8_t*>(file.begin()), file.size());
+    auto info = ContentInfo{
+      .contentType = std::string(common::mimeTypeForFileName(resourcePath)),
+      .contentEncoding = contentEncoding.value_or(std::string()),
+      .etag = contentETag(content),
+    };
+    router.get(resourcePath, [content, info = std::move(info)](RequestContext& ctx) {
+        sendContent(ctx, content, info);
+    });
     if (filename == indexHtml) {
-        // Redirect to index page
-        router.get(parentPath, [](RequestContext& ctx) {
-            auto path = ctx.request.uri.path;
-            if (!path.empty() && path.back() == '/') {
-                path.pop_back();
-            }
-            ctx.response.headers["Location"] = fmt::format("{}/{}", path, indexHtml);
-            ctx.response.status = HttpStatus::Found;
-        });
+        redirectToIndex(router, parentPath);
     }
 }
 
@@ -112,4 +216,47 @@ Router staticFiles(const cmrc::embedded_filesystem& fs)
     return router;
 }
 
+Router staticFiles(const std::filesystem::path& root, std::shared_ptr<FileCache> cache)
+{
+    Router router;
+    for (const auto& entry : fs::recursive_directory_iterator(root)) {
+        if (!entry.is_regular_file()) {
+            continue;
+        }
+
+        const auto relative = entry.path().lexically_relative(root);
+        auto resourcePath = relative.generic_string();
+        if (getContentEncodingByExtension(resourcePath)) {
+            resourcePath = removeEncoderExtension(resourcePath);
+            if (fs::is_regular_file(root / resourcePath)) {
+                // The precompressed variant of the file, it is served by the route of the file
+                continue;
+            }
+        }
+
+        publicDiskFile(router, entry.path(), resourcePath, cache);
+        if (relative.filename() == indexHtml) {
+            redirectToIndex(router, relative.parent_path().generic_string());
+        }
+    }
+    return router;
+}
+
+Router staticFiles(const AssetBundle& bundle)
+{
+    Router router;
+    const auto owner = bundle.owner();
+    for (const auto& asset : bundle.assets()) {
+        publicAsset(router, asset, owner);
+
+        const auto slash = asset.path.rfind('/');
+        const auto parentPath = slash == std::string_view::npos ? ""sv : asset.path.substr(0, slash);
+        const auto filename = slash == std::string_view::npos ? asset.path : asset.path.substr(slash + 1);
+        if (filename == indexHtml) {
+            redirectToIndex(router, parentPath);
+        }
+    }
+    return router;
+}
+
 }   // namespace royalbed::server
@@ -0,0 +1,199 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <system_error>
+#include <utility>
+#include <vector>
+
+#include "nhope/async/ao-context.h"
+#include "nhope/async/timer.h"
+
+#include "royalbed/server/detail/timer-wheel.h"
+
+namespace royalbed::server::detail {
+
+TimerWheel::TimerWheel(nhope::AOContext& parent, std::chrono::milliseconds tick)
+  : m_tick(tick)
+  , m_aoCtx(parent)
+{}
+
+TimerWheel::~TimerWheel()
+{
+    m_aoCtx.close();
+}
+
+TimerWheel::TimerId TimerWheel::schedule(std::chrono::milliseconds delay, Callback callback)
+{
+    const auto ticks = std::max<std::uint64_t>(1, (delay + m_tick - std::chrono::milliseconds(1)) / m_tick);
+
+    std::scoped_lock lock(m_mutex);
+    const auto id = m_nextId++;
+    const auto expire = m_now + ticks;
+    m_timers.emplace(id, Timer{expire, std::move(callback)});
+    this->place(id, expire);
+
+    if (!m_ticking) {
+        m_ticking = true;
+        nhope::AOContextRef(m_aoCtx).exec([this] {
+            this->startTicking();
+        });
+    }
+
+    return id;
+}
+
+void TimerWheel::cancel(TimerId id)
+{
+    std::scoped_lock lock(m_mutex);
+    m_timers.erase(id);
+}
+
+std::size_t TimerWheel::size() const
+{
+    std::scoped_lock lock(m_mutex);
+    return m_timers.size();
+}
+
+void TimerWheel::advance(std::uint64_t ticks)
+{
+    std::vector<Callback> expired;
+
+    {
+        std::scoped_lock lock(m_mutex);
+        for (std::uint64_t i = 0; i < ticks; ++i) {
+            ++m_now;
+
+            // Timers of the upper levels move down when the lower level wraps around
+            for (unsigned level = 1; level <= levelCount; ++level) {
+                if ((m_now & ((std::uint64_t(1) << (slotBits * level)) - 1)) != 0) {
+                    break;
+                }
+                this->cascade(level, expired);
+            }
+            this->cascade(0, expired);
+        }
+    }
+
+    for (auto& callback : expired) {
+        callback();
+    }
+}
+
+// A timer is put on the level of the highest digit in which its expiry differs from the current time,
+// so it is reached exactly when the lower levels wrap around to it
+void TimerWheel::place(TimerId id, std::uint64_t expire)
+{
+    const auto diff = expire ^ m_now;
+
+    // Beyond the current turn of the top level, such timers are placed again when it wraps around
+    if ((diff >> (slotBits * levelCount)) != 0) {
+        m_overflow.push_back(id);
+        return;
+    }
+
+    unsigned level = 0;
+    while (level + 1 < levelCount && (diff >> (slotBits * (level + 1))) != 0) {
+        ++level;
+    }
+
+    const auto slot = (expire >> (slotBits * level)) & (slotCount - 1);
+    m_slots[level][slot].push_back(id);
+}
+
+void TimerWheel::cascade(unsigned level, std::vector<Callback>& expired)
+{
+    auto& source = level < levelCount ? m_slots[level][(m_now >> (slotBits * level)) & (slotCount - 1)] : m_overflow;
+    auto ids = std::move(source);
+    source.clear();
+
+    for (const auto id : ids) {
+        auto it = m_timers.find(id);
+        if (it == m_timers.end()) {
+            continue;
+        }
+
+        if (it->second.expire <= m_now) {
+            expired.push_back(std::move(it->second.callback));
+            m_timers.erase(it);
+        } else {
+            this->place(id, it->second.expire);
+        }
+    }
+}
+
+void TimerWheel::startTicking()
+{
+    {
+        std::scoped_lock lock(m_mutex);
+        m_epoch = std::chrono::steady_clock::now() - m_tick * m_now;
+    }
+
+    nhope::setInterval(m_aoCtx, m_tick, [this](const std::error_code& err) {
+        if (err) {
+            return false;
+        }
+
+        this->onTimer();
+
+        std::scoped_lock lock(m_mutex);
+        if (m_timers.empty()) {
+            m_ticking = false;
+            return false;
+        }
+        return true;
+    });
+}
+
+void TimerWheel::onTimer()
+{
+    // The interval timer may drift or be late, the wheel follows the clock
+    std::uint64_t ticks = 0;
+    {
+        std::scoped_lock lock(m_mutex);
+        const auto elapsed = std::chrono::steady_clock::now() - m_epoch;
+        const auto target = static_cast<std::uint64_t>(elapsed / m_tick);
+        ticks = target > m_now ? target - m_now : 0;
+    }
+    this->advance(ticks);
+}
+
+Deadline::Deadline(TimerWheelPtr wheel, nhope::AOContext& owner)
+  : m_wheel(std::move(wheel))
+  , m_owner(owner)
+{}
+
+Deadline::~Deadline()
+{
+    this->cancel();
+}
+
+void Deadline::arm(std::chrono::milliseconds timeout, std::function<void()> callback)
+{
+    this->cancel();
+    if (m_wheel == nullptr || timeout.count() <= 0) {
+        return;
+    }
+
+    m_id = m_wheel->schedule(timeout, [this, owner = m_owner, generation = m_generation,
+                                       callback = std::move(callback)]() mutable {
+        owner.exec([this, generation, callback = std::move(callback)] {
+            if (generation == m_generation) {
+                m_id = 0;
+                callback();
+            }
+        });
+    });
+}
+
+void Deadline::cancel()
+{
+    ++m_generation;
+    if (m_id != 0 && m_wheel != nullptr) {
+        m_wheel->cancel(m_id);
+        m_id = 0;
+    }
+}
+
+}   // namespace royalbed::server::detail
@@ -0,0 +1,461 @@
+#include <stdexcept>
+
+#include "royalbed/server/detail/tls-stream.h"
+
+#ifdef ROYALBED_TLS_ENABLED
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include <gsl/span>
+
+#include <openssl/bio.h>
+#include <openssl/err.h>
+#include <openssl/ssl.h>
+
+namespace royalbed::server::detail {
+namespace {
+
+using namespace std::literals;
+
+constexpr std::size_t netBufSize = 16 * 1024 + 512;   // a TLS record with its overhead
+constexpr std::string_view sessionIdContext = "royalbed";
+
+std::string sslErrors()
+{
+    std::string result;
+    while (const auto code = ERR_get_error()) {
+        std::array<char, 256> buf{};   // NOLINT(readability-magic-numbers)
+        ERR_error_string_n(code, buf.data(), buf.size());
+        if (!result.empty()) {
+            result += "; ";
+        }
+        result += buf.data();
+    }
+    return result.empty() ? "unknown error"s : result;
+}
+
+std::runtime_error tlsError(std::string_view what)
+{
+    return std::runtime_error(std::string(what) + ": " + sslErrors());
+}
+
+struct SslCtxDeleter
+{
+    void operator()(SSL_CTX* ctx) const noexcept
+    {
+        SSL_CTX_free(ctx);
+    }
+};
+
+struct SslDeleter
+{
+    void operator()(SSL* ssl) const noexcept
+    {
+        SSL_free(ssl);
+    }
+};
+
+class OpenSslContext final : public TlsContext
+{
+public:
+    OpenSslContext(const TlsParams& params, bool http2)
+      : m_ctx(SSL_CTX_new(TLS_server_method()))
+      , m_alpn(http2 ? "\x02h2\x08http/1.1"s : "\x08http/1.1"s)
+      , m_handshakeTimeout(params.handshakeTimeout)
+    {
+        if (m_ctx == nullptr) {
+            throw tlsError("Unable to create the TLS context");
+        }
+        auto* ctx = m_ctx.get();
+
+        SSL_CTX_set_min_proto_version(ctx, TLS1_2_VERSION);
+        SSL_CTX_set_options(ctx, SSL_OP_CIPHER_SERVER_PREFERENCE | SSL_OP_NO_RENEGOTIATION);
+        // Idle keep-alive connections do not hold the record buffers
+        SSL_CTX_set_mode(ctx, SSL_MODE_RELEASE_BUFFERS);
+
+        if (params.sessionResumption) {
+            SSL_CTX_set_session_cache_mode(ctx, SSL_SESS_CACHE_SERVER);
+            SSL_CTX_set_session_id_context(ctx, reinterpret_cast<const unsigned char*>(sessionIdContext.data()),
+                                           sessionIdContext.size());
+            SSL_CTX_set_num_tickets(ctx, 1);
+        } else {
+            SSL_CTX_set_session_cache_mode(ctx, SSL_SESS_CACHE_OFF);
+            SSL_CTX_set_options(ctx, SSL_OP_NO_TICKET);
+            SSL_CTX_set_num_tickets(ctx, 0);
+        }
+
+        if (SSL_CTX_use_certificate_chain_file(ctx, params.certificateFile.c_str()) != 1) {
+            throw tlsError("Unable to load the certificate " + params.certificateFile);
+        }
+        if (SSL_CTX_use_PrivateKey_file(ctx, params.privateKeyFile.c_str(), SSL_FILETYPE_PEM) != 1) {
+            throw tlsError("Unable to load the private key " + params.privateKeyFile);
+        }
+        if (SSL_CTX_check_private_key(ctx) != 1) {
+            throw tlsError("The private key does not match the certificate");
+        }
+
+        SSL_CTX_set_alpn_select_cb(ctx, &OpenSslContext::selectAlpn, this);
+    }
+
+    [[nodiscard]] std::chrono::milliseconds handshakeTimeout() const noexcept override
+    {
+        return m_handshakeTimeout;
+    }
+
+    [[nodiscard]] SSL_CTX* native() const noexcept
+    {
+        return m_ctx.get();
+    }
+
+private:
+    static int selectAlpn(SSL* /*ssl*/, const unsigned char** out, unsigned char* outlen, const unsigned char* in,
+                          unsigned int inlen, void* arg)
+    {
+        const auto* self = static_cast<const OpenSslContext*>(arg);
+        const auto* server = reinterpret_cast<const unsigned char*>(self->m_alpn.data());
+
+        // The server preference wins
+        unsigned char* selected = nullptr;
+        if (SSL_select_next_proto(&selected, outlen, server, static_cast<unsigned int>(self->m_alpn.size()), in,
+                                  inlen) != OPENSSL_NPN_NEGOTIATED) {
+            return SSL_TLSEXT_ERR_NOACK;
+        }
+        *out = selected;
+        return SSL_TLSEXT_ERR_OK;
+    }
+
+    std::unique_ptr<SSL_CTX, SslCtxDeleter> m_ctx;
+    std::string m_alpn;
+    std::chrono::milliseconds m_handshakeTimeout;
+};
+
+class OpenSslStream final : public TlsStream
+{
+public:
+    OpenSslStream(nhope::AOContext& parent, std::shared_ptr<OpenSslContext> ctx, nhope::IODevice& sock)
+      : m_ctx(std::move(ctx))
+      , m_ssl(SSL_new(m_ctx->native()))
+      , m_sock(sock)
+      , m_netBuf(netBufSize)
+      , m_aoCtx(parent)
+      , m_aoCtxRef(m_aoCtx)
+    {
+        if (m_ssl == nullptr) {
+            throw tlsError("Unable to create the TLS connection");
+        }
+
+        // The records go through memory BIOs, the socket is read and written asynchronously
+        m_netIn = BIO_new(BIO_s_mem());
+        m_netOut = BIO_new(BIO_s_mem());
+        if (m_netIn == nullptr || m_netOut == nullptr) {
+            BIO_free(m_netIn);
+            BIO_free(m_netOut);
+            throw tlsError("Unable to create the TLS connection");
+        }
+        BIO_set_mem_eof_return(m_netIn, -1);
+        SSL_set_bio(m_ssl.get(), m_netIn, m_netOut);
+        SSL_set_accept_state(m_ssl.get());
+    }
+
+    ~OpenSslStream() override
+    {
+        m_aoCtx.close();
+    }
+
+    nhope::Future<void> handshake() override
+    {
+        m_aoCtx.exec([this] {
+            this->continueHandshake();
+        });
+        return m_handshake.future();
+    }
+
+    [[nodiscard]] std::string alpnProtocol() const override
+    {
+        const unsigned char* data = nullptr;
+        unsigned int size = 0;
+        SSL_get0_alpn_selected(m_ssl.get(), &data, &size);
+        if (data == nullptr) {
+            return {};
+        }
+        return {reinterpret_cast<const char*>(data), size};
+    }
+
+    void read(gsl::span<std::uint8_t> buf, nhope::IOHandler handler) override
+    {
+        m_aoCtx.exec([this, buf, handler = std::move(handler)]() mutable {
+            m_readOp.emplace(ReadOp{buf, std::move(handler)});
+            this->continueRead();
+        });
+    }
+
+    void write(gsl::span<const std::uint8_t> data, nhope::IOHandler handler) override
+    {
+        m_aoCtx.exec([this, data, handler = std::move(handler)] {
+            if (m_writeError) {
+                handler(m_writeError, 0);
+                return;
+            }
+            if (data.empty()) {
+                handler(nullptr, 0);
+                return;
+            }
+
+            // A memory BIO takes the whole record, the handler is called when it leaves the socket
+            ERR_clear_error();
+            std::size_t n = 0;
+            if (SSL_write_ex(m_ssl.get(), data.data(), data.size(), &n) != 1) {
+                handler(std::make_exception_ptr(tlsError("TLS write failed")), 0);
+                return;
+            }
+
+            this->collectOutput();
+            m_writeOps.push_back({m_outTotal, n, handler});
+            this->flushOutput();
+        });
+    }
+
+private:
+    struct ReadOp
+    {
+        gsl::span<std::uint8_t> buf;
+        nhope::IOHandler handler;
+    };
+
+    struct WriteOp
+    {
+        std::uint64_t end;   // the position in the encrypted output after which the data is sent
+        std::size_t size;
+        nhope::IOHandler handler;
+    };
+
+    void continueHandshake()
+    {
+        ERR_clear_error();
+        const int ret = SSL_do_handshake(m_ssl.get());
+        this->flushOutput();
+        if (ret == 1) {
+            m_handshake.setValue();
+            return;
+        }
+
+        if (SSL_get_error(m_ssl.get(), ret) == SSL_ERROR_WANT_READ && !m_eof) {
+            this->readSocket([this] {
+                this->continueHandshake();
+            });
+            return;
+        }
+        m_handshake.setException(std::make_exception_ptr(tlsError("TLS handshake failed")));
+    }
+
+    void continueRead()
+    {
+        if (m_readOp->buf.empty()) {
+            this->completeRead(nullptr, 0);
+            return;
+        }
+
+        ERR_clear_error();
+        std::size_t n = 0;
+        const int ret = SSL_read_ex(m_ssl.get(), m_readOp->buf.data(), m_readOp->buf.size(), &n);
+        // Reading may produce records too: alerts, key updates
+        this->flushOutput();
+        if (ret == 1) {
+            this->completeRead(nullptr, n);
+            return;
+        }
+
+        switch (SSL_get_error(m_ssl.get(), ret)) {
+        case SSL_ERROR_WANT_READ:
+            if (m_readError) {
+                this->completeRead(m_readError, 0);
+            } else if (m_eof) {
+                // Many clients close the connection without close_notify
+                this->completeRead(nullptr, 0);
+            } else {
+                this->readSocket([this] {
+                    this->continueRead();
+                });
+            }
+            return;
+
+        case SSL_ERROR_ZERO_RETURN:
+            this->completeRead(nullptr, 0);
+            return;
+
+        default:
+            this->completeRead(std::make_exception_ptr(tlsError("TLS read failed")), 0);
+            return;
+        }
+    }
+
+    void completeRead(const std::exception_ptr& err, std::size_t n)
+    {
+        auto handler = std::move(m_readOp->handler);
+        m_readOp.reset();
+        // May destroy the stream
+        handler(err, n);
+    }
+
+    void readSocket(std::function<void()> next)
+    {
+        m_sock.read(m_netBuf, [this, aoCtx = m_aoCtxRef, next = std::move(next)](auto err, auto n) mutable {
+            aoCtx.exec([this, err = std::move(err), n, next = std::move(next)] {
+                if (err) {
+                    m_readError = err;
+                    m_eof = true;
+                } else if (n == 0) {
+                    m_eof = true;
+                } else {
+                    BIO_write(m_netIn, m_netBuf.data(), static_cast<int>(n));
+                }
+                next();
+            });
+        });
+    }
+
+    void collectOutput()
+    {
+        while (const auto pending = BIO_ctrl_pending(m_netOut)) {
+            const auto offset = m_outPending.size();
+            m_outPending.resize(offset + pending);
+            const int n = BIO_read(m_netOut, m_outPending.data() + offset, static_cast<int>(pending));
+            m_outPending.resize(offset + static_cast<std::size_t>(std::max(n, 0)));
+            m_outTotal += static_cast<std::uint64_t>(std::max(n, 0));
+            if (n <= 0) {
+                break;
+            }
+        }
+    }
+
+    void flushOutput()
+    {
+        this->collectOutput();
+        if (m_sockWriting || m_outPending.empty() || m_writeError) {
+            return;
+        }
+
+        m_sockWriting = true;
+        m_outWriting = std::exchange(m_outPending, {});
+        m_outWritePos = 0;
+        this->writeSocket();
+    }
+
+    void writeSocket()
+    {
+        const auto data = gsl::span<const std::uint8_t>(m_outWriting).subspan(m_outWritePos);
+        m_sock.write(data, [this, aoCtx = m_aoCtxRef](auto err, auto n) mutable {
+            aoCtx.exec([this, err = std::move(err), n] {
+                if (err) {
+                    this->failWrites(err);
+                    return;
+                }
+
+                m_outWritePos += n;
+                m_outFlushed += n;
+                if (m_outWritePos < m_outWriting.size()) {
+                    this->writeSocket();
+                    return;
+                }
+
+                m_sockWriting = false;
+                this->flushOutput();
+                this->completeWrites();
+            });
+        });
+    }
+
+    void completeWrites()
+    {
+        std::vector<WriteOp> completed;
+        while (!m_writeOps.empty() && m_writeOps.front().end <= m_outFlushed) {
+            completed.push_back(std::move(m_writeOps.front()));
+            m_writeOps.pop_front();
+        }
+
+        // The handlers may destroy the stream
+        for (auto& op : completed) {
+            op.handler(nullptr, op.size);
+        }
+    }
+
+    void failWrites(const std::exception_ptr& err)
+    {
+        m_writeError = err;
+        m_sockWriting = false;
+        auto ops = std::exchange(m_writeOps, {});
+        for (auto& op : ops) {
+            op.handler(err, 0);
+        }
+    }
+
+    std::shared_ptr<OpenSslContext> m_ctx;
+    std::unique_ptr<SSL, SslDeleter> m_ssl;
+    BIO* m_netIn = nullptr;    // owned by m_ssl
+    BIO* m_netOut = nullptr;   // owned by m_ssl
+    nhope::IODevice& m_sock;
+
+    nhope::Promise<void> m_handshake;
+
+    std::vector<std::uint8_t> m_netBuf;
+    std::optional<ReadOp> m_readOp;
+    bool m_eof = false;
+    std::exception_ptr m_readError;
+
+    std::vector<std::uint8_t> m_outPending;
+    std::vector<std::uint8_t> m_outWriting;
+    std::size_t m_outWritePos = 0;
+    std::uint64_t m_outTotal = 0;
+    std::uint64_t m_outFlushed = 0;
+    bool m_sockWriting = false;
+    std::deque<WriteOp> m_writeOps;
+    std::exception_ptr m_writeError;
+
+    nhope::AOContext m_aoCtx;
+    nhope::AOContextRef m_aoCtxRef;
+};
+
+}   // namespace
+
+TlsContextPtr makeTlsContext(const TlsParams& params, bool http2)
+{
+    return std::make_shared<OpenSslContext>(params, http2);
+}
+
+TlsStreamPtr makeTlsStream(nhope::AOContext& aoCtx, const TlsContextPtr& ctx, nhope::IODevice& sock)
+{
+    return std::make_unique<OpenSslStream>(aoCtx, std::static_pointer_cast<OpenSslContext>(ctx), sock);
+}
+
+}   // namespace royalbed::server::detail
+
+#else
+
+namespace royalbed::server::detail {
+
+TlsContextPtr makeTlsContext(const TlsParams& /*params*/, bool /*http2*/)
+{
+    throw std::runtime_error("royalbed is built without TLS support (ROYALBED_TLS_ENABLED)");
+}
+
+TlsStreamPtr makeTlsStream(nhope::AOContext& /*aoCtx*/, const TlsContextPtr& /*ctx*/, nhope::IODevice& /*sock*/)
+{
+    throw std::runtime_error("royalbed is built without TLS support (ROYALBED_TLS_ENABLED)");
+}
+
+}   // namespace royalbed::server::detail
+
+#endif
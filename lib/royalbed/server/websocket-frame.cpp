@@ -0,0 +1,181 @@
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <optional>
+#include <string>
+#include <string_view>
+
+#include <gsl/span>
+
+#include "royalbed/server/detail/websocket-frame.h"
+#include "royalbed/server/websocket.h"
+
+namespace royalbed::server::detail {
+namespace {
+
+// NOLINTBEGIN(readability-magic-numbers)
+constexpr std::uint8_t finBit = 0x80;
+constexpr std::uint8_t rsvBits = 0x70;
+constexpr std::uint8_t opcodeBits = 0x0F;
+constexpr std::uint8_t maskBit = 0x80;
+constexpr std::uint8_t payloadSizeBits = 0x7F;
+
+constexpr std::uint8_t payloadSize16 = 126;
+constexpr std::uint8_t payloadSize64 = 127;
+// NOLINTEND(readability-magic-numbers)
+
+std::uint64_t readBigEndian(gsl::span<const std::uint8_t> data)
+{
+    std::uint64_t value = 0;
+    for (const auto byte : data) {
+        value = value << 8 | byte;   // NOLINT(readability-magic-numbers)
+    }
+    return value;
+}
+
+void writeBigEndian(std::string& out, std::uint64_t value, std::size_t size)
+{
+    for (std::size_t i = size; i > 0; --i) {
+        out += static_cast<char>(value >> ((i - 1) * 8));   // NOLINT(readability-magic-numbers)
+    }
+}
+
+}   // namespace
+
+std::optional<WsFrameHeader> parseWsFrameHeader(gsl::span<const std::uint8_t> data)
+{
+    if (data.size() < 2) {
+        return std::nullopt;
+    }
+
+    WsFrameHeader header;
+    header.fin = (data[0] & finBit) != 0;
+    header.rsv = static_cast<std::uint8_t>((data[0] & rsvBits) >> 4);   // NOLINT(readability-magic-numbers)
+    header.opcode = static_cast<WsOpcode>(data[0] & opcodeBits);
+    header.masked = (data[1] & maskBit) != 0;
+
+    std::size_t pos = 2;
+    const auto sizeCode = static_cast<std::uint8_t>(data[1] & payloadSizeBits);
+    std::size_t extSizeBytes = 0;
+    if (sizeCode == payloadSize16) {
+        extSizeBytes = 2;
+    } else if (sizeCode == payloadSize64) {
+        extSizeBytes = 8;   // NOLINT(readability-magic-numbers)
+    }
+
+    header.headerSize = pos + extSizeBytes + (header.masked ? header.mask.size() : 0);
+    if (data.size() < header.headerSize) {
+        return std::nullopt;
+    }
+
+    header.payloadSize = extSizeBytes == 0 ? sizeCode : readBigEndian(data.subspan(pos, extSizeBytes));
+    pos += extSizeBytes;
+
+    if (header.masked) {
+        std::memcpy(header.mask.data(), &data[pos], header.mask.size());
+    }
+    return header;
+}
+
+std::string encodeWsFrame(WsOpcode opcode, std::string_view payload, bool fin)
+{
+    std::string frame;
+    frame.reserve(wsMaxHeaderSize + payload.size());
+
+    frame += static_cast<char>((fin ? finBit : 0) | static_cast<std::uint8_t>(opcode));
+    if (payload.size() < payloadSize16) {
+        frame += static_cast<char>(payload.size());
+    } else if (payload.size() <= UINT16_MAX) {
+        frame += static_cast<char>(payloadSize16);
+        writeBigEndian(frame, payload.size(), 2);
+    } else {
+        frame += static_cast<char>(payloadSize64);
+        writeBigEndian(frame, payload.size(), 8);   // NOLINT(readability-magic-numbers)
+    }
+
+    frame += payload;
+    return frame;
+}
+
+std::string encodeWsCloseFrame(WsCloseCode code, std::string_view reason)
+{
+    std::string payload;
+    writeBigEndian(payload, static_cast<std::uint16_t>(code), 2);
+    payload += reason.substr(0, wsMaxControlPayloadSize - payload.size());
+    return encodeWsFrame(WsOpcode::Close, payload);
+}
+
+void unmaskWsPayload(gsl::span<std::uint8_t> data, const std::array<std::uint8_t, 4>& mask, std::size_t offset)
+{
+    constexpr std::size_t wordSize = sizeof(std::uint64_t);
+
+    // The mask repeated twice and rotated so that it starts at the right position
+    std::array<std::uint8_t, wordSize> wordMask{};
+    for (std::size_t i = 0; i < wordSize; ++i) {
+        wordMask[i] = mask[(offset + i) % mask.size()];
+    }
+    std::uint64_t maskWord = 0;
+    std::memcpy(&maskWord, wordMask.data(), wordSize);
+
+    std::size_t i = 0;
+    for (; i + wordSize <= data.size(); i += wordSize) {
+        std::uint64_t word = 0;
+        std::memcpy(&word, &data[i], wordSize);
+        word ^= maskWord;
+        std::memcpy(&data[i], &word, wordSize);
+    }
+    for (; i < data.size(); ++i) {
+        data[i] ^= wordMask[i % wordSize];
+    }
+}
+
+bool isValidUtf8(std::string_view str) noexcept
+{
+    // NOLINTBEGIN(readability-magic-numbers)
+    std::size_t i = 0;
+    while (i < str.size()) {
+        const auto ch = static_cast<std::uint8_t>(str[i]);
+        if (ch < 0x80) {
+            ++i;
+            continue;
+        }
+
+        std::size_t len = 0;
+        std::uint32_t codePoint = 0;
+        if ((ch & 0xE0) == 0xC0) {
+            len = 2;
+            codePoint = ch & 0x1F;
+        } else if ((ch & 0xF0) == 0xE0) {
+            len = 3;
+            codePoint = ch & 0x0F;
+        } else if ((ch & 0xF8) == 0xF0) {
+            len = 4;
+            codePoint = ch & 0x07;
+        } else {
+            return false;
+        }
+
+        if (i + len > str.size()) {
+            return false;
+        }
+        for (std::size_t k = 1; k < len; ++k) {
+            const auto next = static_cast<std::uint8_t>(str[i + k]);
+            if ((next & 0xC0) != 0x80) {
+                return false;
+            }
+            codePoint = codePoint << 6 | (next & 0x3F);
+        }
+
+        // Overlong encodings, surrogates and code points beyond U+10FFFF
+        constexpr std::array<std::uint32_t, 5> minCodePoint{0, 0, 0x80, 0x800, 0x10000};
+        if (codePoint < minCodePoint[len] || codePoint > 0x10FFFF || (codePoint >= 0xD800 && codePoint <= 0xDFFF)) {
+            return false;
+        }
+        i += len;
+    }
+    return true;
+    // NOLINTEND(readability-magic-numbers)
+}
+
+}   // namespace royalbed::server::detail
@@ -0,0 +1,652 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <utility>
+#include <vector>
+
+#include <gsl/span>
+
+#include "nhope/async/ao-context.h"
+#include "nhope/async/future.h"
+#include "nhope/async/timer.h"
+#include "nhope/io/io-device.h"
+
+#include "royalbed/common/detail/sha1.h"
+#include "royalbed/common/detail/string-utils.h"
+#include "royalbed/common/http-status.h"
+#include "royalbed/common/response.h"
+#include "royalbed/server/detail/websocket-frame.h"
+#include "royalbed/server/error.h"
+#include "royalbed/server/headers.h"
+#include "royalbed/server/request-context.h"
+#include "royalbed/server/websocket.h"
+
+namespace royalbed::server {
+namespace {
+using namespace std::literals;
+
+constexpr auto wsGuid = "258EAFA5-E914-47DA-95CA-C5AB0DC85B11"sv;
+constexpr auto wsVersion = "13"sv;
+constexpr auto closeTimeout = std::chrono::seconds(5);
+constexpr std::size_t readChunkSize = 16 * 1024;
+
+bool hasToken(const Headers& headers, const std::string& name, std::string_view token)
+{
+    const auto it = headers.find(name);
+    return it != headers.end() && common::detail::containsToken(it->second, token);
+}
+
+// RFC 6455, 4.1: the key is a base64-encoded 16-byte nonce
+bool isValidWsKey(std::string_view key)
+{
+    constexpr std::size_t encodedNonceSize = 24;
+    if (key.size() != encodedNonceSize || !key.ends_with("=="sv)) {
+        return false;
+    }
+    return std::all_of(key.begin(), key.end() - 2, [](char ch) {
+        return (ch >= 'A' && ch <= 'Z') || (ch >= 'a' && ch <= 'z') || (ch >= '0' && ch <= '9') || ch == '+' ||
+               ch == '/';
+    });
+}
+
+bool isControl(WsOpcode opcode)
+{
+    return (static_cast<std::uint8_t>(opcode) & 0x8) != 0;   // NOLINT(readability-magic-numbers)
+}
+
+bool isKnownOpcode(WsOpcode opcode)
+{
+    switch (opcode) {
+    case WsOpcode::Continuation:
+    case WsOpcode::Text:
+    case WsOpcode::Binary:
+    case WsOpcode::Close:
+    case WsOpcode::Ping:
+    case WsOpcode::Pong:
+        return true;
+    }
+    return false;
+}
+
+// Codes that must not appear in a Close frame (RFC 6455, 7.4)
+bool isValidCloseCode(std::uint16_t code)
+{
+    // NOLINTBEGIN(readability-magic-numbers)
+    if (code >= 3000 && code < 5000) {
+        return true;
+    }
+    return code >= 1000 && code <= 1011 && code != 1004 && code != 1005 && code != 1006;
+    // NOLINTEND(readability-magic-numbers)
+}
+
+struct WsHandlers
+{
+    WebSocketUpgrade::OpenHandler onOpen;
+    WebSocketUpgrade::MessageHandler onMessage;
+    WebSocketUpgrade::CloseHandler onClose;
+};
+
+// Serves one upgraded connection: parses incoming frames, assembles messages
+// and writes queued frames one after another.
+class WebSocketSession final
+  : public WebSocket
+  , public std::enable_shared_from_this<WebSocketSession>
+{
+public:
+    WebSocketSession(nhope::AOContext& parent, nhope::Reader& in, nhope::Writter& out, const WebSocketParams& params,
+                     WsHandlers&& handlers)
+      : m_in(in)
+      , m_out(out)
+      , m_params(params)
+      , m_handlers(std::move(handlers))
+      , m_inBuf(readChunkSize)
+      , m_aoCtx(parent)
+      , m_aoCtxRef(m_aoCtx)
+    {}
+
+    ~WebSocketSession() override
+    {
+        m_aoCtx.close();
+    }
+
+    nhope::Future<void> start()
+    {
+        m_open = true;
+        this->startPing();
+        this->readNext();
+
+        if (m_handlers.onOpen) {
+            this->callHandler([&] {
+                m_handlers.onOpen(this->shared_from_this());
+            });
+        }
+        return m_closed.future();
+    }
+
+    void send(std::string_view text) override
+    {
+        this->sendFrame(makeWsTextFrame(text));
+    }
+
+    void sendBinary(gsl::span<const std::uint8_t> data) override
+    {
+        this->sendFrame(makeWsBinaryFrame(data));
+    }
+
+    void sendFrame(WsFrame frame) override
+    {
+        m_aoCtxRef.exec([self = this->shared_from_this(), frame = std::move(frame)]() mutable {
+            if (self->m_closeSent) {
+                return;
+            }
+            if (self->m_queuedBytes + frame->size() > self->m_params.maxQueuedBytes) {
+                // The client does not keep up with the messages
+                self->startClosing(WsCloseCode::PolicyViolation, "Send queue overflow"sv);
+                return;
+            }
+            self->enqueue(std::move(frame));
+        });
+    }
+
+    void close(WsCloseCode code, std::string_view reason) override
+    {
+        m_aoCtxRef.exec([self = this->shared_from_this(), code, reason = std::string(reason)] {
+            self->startClosing(code, reason);
+        });
+    }
+
+    [[nodiscard]] bool isOpen() const override
+    {
+        return m_open;
+    }
+
+private:
+    template<typename Fn>
+    void callHandler(Fn&& fn)
+    {
+        try {
+            fn();
+        } catch (const std::exception& e) {
+            this->startClosing(WsCloseCode::InternalError, e.what());
+        }
+    }
+
+    void startPing()
+    {
+        if (m_params.pingInterval.count() <= 0) {
+            return;
+        }
+
+        nhope::setInterval(m_aoCtx, m_params.pingInterval, [this](const std::error_code& err) {
+            if (err || m_finished) {
+                return false;
+            }
+            if (!m_receivedSincePing && m_pingSent) {
+                this->finish(WsCloseCode::GoingAway, "Ping timeout");
+                return false;
+            }
+            if (m_closeSent) {
+                return true;
+            }
+            m_pingSent = true;
+            m_receivedSincePing = false;
+            this->enqueue(std::make_shared<const std::string>(detail::encodeWsFrame(WsOpcode::Ping, {})));
+            return true;
+        });
+    }
+
+    void readNext()
+    {
+        // Compact the buffer and make room for the rest of the current frame
+        if (m_inBegin > 0) {
+            std::memmove(m_inBuf.data(), m_inBuf.data() + m_inBegin, m_inEnd - m_inBegin);
+            m_inEnd -= m_inBegin;
+            m_inBegin = 0;
+        }
+        const auto needSize = std::max(m_inEnd + readChunkSize / 4, m_needSize);
+        if (m_inBuf.size() < needSize) {
+            m_inBuf.resize(std::max(needSize, m_inBuf.size() * 2));
+        }
+
+        const auto buf = gsl::span(m_inBuf).subspan(m_inEnd);
+        m_in.read(buf, [self = this->shared_from_this(), aoCtx = m_aoCtxRef](auto err, auto n) mutable {
+            aoCtx.exec([self, err = std::move(err), n] {
+                if (self->m_finished) {
+                    return;
+                }
+                if (err || n == 0) {
+                    self->finish(WsCloseCode::Abnormal, {});
+                    return;
+                }
+                self->m_inEnd += n;
+                self->m_receivedSincePing = true;
+                if (self->processInput()) {
+                    self->readNext();
+                }
+            });
+        });
+    }
+
+    // Returns false if the reading must be stopped
+    bool processInput()
+    {
+        m_needSize = 0;
+        while (!m_finished) {
+            const auto data = gsl::span<std::uint8_t>(m_inBuf).subspan(m_inBegin, m_inEnd - m_inBegin);
+            const auto header = detail::parseWsFrameHeader(data);
+            if (!header.has_value()) {
+                return true;
+            }
+
+            if (const auto error = this->checkHeader(*header); error.has_value()) {
+                this->startClosing(*error, {});
+                return false;
+            }
+
+            const auto frameSize = header->headerSize + header->payloadSize;
+            if (data.size() < frameSize) {
+                m_needSize = frameSize;
+                return true;
+            }
+
+            const auto payload = data.subspan(header->headerSize, header->payloadSize);
+            detail::unmaskWsPayload(payload, header->mask);
+            m_inBegin += frameSize;
+
+            if (!this->processFrame(*header, payload)) {
+                return false;
+            }
+        }
+        return false;
+    }
+
+    std::optional<WsCloseCode> checkHeader(const detail::WsFrameHeader& header) const
+    {
+        if (!header.masked || header.rsv != 0 || !isKnownOpcode(header.opcode)) {
+            return WsCloseCode::ProtocolError;
+        }
+        if (isControl(header.opcode)) {
+            if (!header.fin || header.payloadSize > detail::wsMaxControlPayloadSize) {
+                return WsCloseCode::ProtocolError;
+            }
+            return std::nullopt;
+        }
+
+        const bool continuation = header.opcode == WsOpcode::Continuation;
+        if (continuation != m_inMessage) {
+            return WsCloseCode::ProtocolError;
+        }
+        const auto assembled = continuation ? m_message.data.size() : 0;
+        if (header.payloadSize > m_params.maxMessageSize - assembled) {
+            return WsCloseCode::MessageTooBig;
+        }
+        return std::nullopt;
+    }
+
+    bool processFrame(const detail::WsFrameHeader& header, gsl::span<std::uint8_t> payload)
+    {
+        const std::string_view data(reinterpret_cast<const char*>(payload.data()), payload.size());
+
+        switch (header.opcode) {
+        case WsOpcode::Ping:
+            if (!m_closeSent) {
+                this->enqueuePong(data);
+            }
+            return true;
+
+        case WsOpcode::Pong:
+            m_pingSent = false;
+            return true;
+
+        case WsOpcode::Close:
+            // Messages sent by the handlers before the Close has arrived go first
+            m_aoCtxRef.exec([self = this->shared_from_this(), payload = std::string(data)] {
+                if (!self->m_finished) {
+                    self->processClose(payload);
+                }
+            });
+            return false;
+
+        case WsOpcode::Text:
+        case WsOpcode::Binary:
+            m_message.binary = header.opcode == WsOpcode::Binary;
+            m_message.data.assign(data);
+            break;
+
+        case WsOpcode::Continuation:
+            m_message.data.append(data);
+            break;
+        }
+
+        m_inMessage = !header.fin;
+        if (m_inMessage) {
+            return true;
+        }
+
+        if (!m_message.binary && !detail::isValidUtf8(m_message.data)) {
+            this->startClosing(WsCloseCode::InvalidPayload, {});
+            return false;
+        }
+
+        if (m_handlers.onMessage && !m_closeSent) {
+            this->callHandler([&] {
+                m_handlers.onMessage(this->shared_from_this(), std::exchange(m_message, {}));
+            });
+        }
+        return !m_finished;
+    }
+
+    void processClose(std::string_view payload)
+    {
+        auto code = WsCloseCode::NoStatus;
+        std::string reason;
+        if (payload.size() == 1) {
+            code = WsCloseCode::ProtocolError;
+        } else if (payload.size() >= 2) {
+            const auto rawCode = static_cast<std::uint16_t>(static_cast<std::uint8_t>(payload[0]) << 8 |   // NOLINT
+                                                            static_cast<std::uint8_t>(payload[1]));
+            reason = payload.substr(2);
+            code = isValidCloseCode(rawCode) && detail::isValidUtf8(reason) ? static_cast<WsCloseCode>(rawCode)
+                                                                              : WsCloseCode::ProtocolError;
+        }
+
+        m_peerCode = code;
+        m_peerReason = std::move(reason);
+        if (m_closeSent) {
+            // The client has answered our Close
+            this->finish(m_peerCode, m_peerReason);
+            return;
+        }
+
+        // Echo the code, the connection is closed once the answer is written
+        const auto answerCode = code == WsCloseCode::NoStatus ? WsCloseCode::Normal : code;
+        this->sendClose(answerCode, {});
+        m_finishAfterWrite = true;
+        this->writeNext();
+    }
+
+    void startClosing(WsCloseCode code, std::string_view reason)
+    {
+        if (m_closeSent || m_finished) {
+            return;
+        }
+
+        this->sendClose(code, reason);
+        m_peerCode = code;
+        m_peerReason = std::string(reason);
+        if (code != WsCloseCode::Normal && code != WsCloseCode::GoingAway) {
+            // Protocol violation: do not wait for the client
+            m_finishAfterWrite = true;
+            this->writeNext();
+            return;
+        }
+
+        nhope::setTimeout(m_aoCtx, closeTimeout, [this](const std::error_code& err) {
+            if (!err && !m_finished) {
+                this->finish(WsCloseCode::Abnormal, {});
+            }
+        });
+    }
+
+    void sendClose(WsCloseCode code, std::string_view reason)
+    {
+        m_closeSent = true;
+        m_open = false;
+        this->enqueue(std::make_shared<const std::string>(detail::encodeWsCloseFrame(code, reason)));
+    }
+
+    // Only the latest Ping is answered (RFC 6455, 5.5.3): a Pong waiting in the queue is replaced,
+    // so a Ping flood does not grow the queue past maxQueuedBytes
+    void enqueuePong(std::string_view data)
+    {
+        auto frame = std::make_shared<const std::string>(detail::encodeWsFrame(WsOpcode::Pong, data));
+        if (m_pongFrame.has_value() && *m_pongFrame >= m_sentFrames) {
+            const auto index = *m_pongFrame - m_sentFrames;
+            const bool isWritten = index == 0 && (m_writing || m_writeOffset > 0);
+            if (!isWritten) {
+                auto& queued = m_outQueue[index];
+                m_queuedBytes = m_queuedBytes - queued->size() + frame->size();
+                queued = std::move(frame);
+                return;
+            }
+        }
+
+        m_pongFrame = m_sentFrames + m_outQueue.size();
+        this->enqueue(std::move(frame));
+    }
+
+    void enqueue(WsFrame frame)
+    {
+        m_queuedBytes += frame->size();
+        m_outQueue.emplace_back(std::move(frame));
+        this->writeNext();
+    }
+
+    void writeNext()
+    {
+        if (m_writing || m_finished) {
+            return;
+        }
+        if (m_outQueue.empty()) {
+            if (m_finishAfterWrite) {
+                this->finish(m_peerCode, m_peerReason);
+            }
+            return;
+        }
+
+        m_writing = true;
+        const auto& frame = *m_outQueue.front();
+        const auto data = gsl::span(reinterpret_cast<const std::uint8_t*>(frame.data()), frame.size());
+        m_out.write(data.subspan(m_writeOffset),
+                    [self = this->shared_from_this(), aoCtx = m_aoCtxRef](auto err, auto n) mutable {
+                        aoCtx.exec([self, err = std::move(err), n] {
+                            self->m_writing = false;
+                            if (self->m_finished) {
+                                return;
+                            }
+                            if (err) {
+                                self->finish(WsCloseCode::Abnormal, {});
+                                return;
+                            }
+                            self->frameWritten(n);
+                        });
+                    });
+    }
+
+    void frameWritten(std::size_t n)
+    {
+        m_writeOffset += n;
+        const auto frameSize = m_outQueue.front()->size();
+        if (m_writeOffset == frameSize) {
+            m_writeOffset = 0;
+            m_queuedBytes -= frameSize;
+            m_outQueue.pop_front();
+            ++m_sentFrames;
+        }
+        this->writeNext();
+    }
+
+    void finish(WsCloseCode code, const std::string& reason)
+    {
+        if (m_finished) {
+            return;
+        }
+
+        m_finished = true;
+        m_open = false;
+        m_outQueue.clear();
+        m_pongFrame.reset();
+
+        if (m_handlers.onClose) {
+            try {
+                m_handlers.onClose(code, reason);
+            } catch (...) {
+                // The connection is closed anyway
+            }
+        }
+        m_closed.setValue();
+    }
+
+    nhope::Reader& m_in;
+    nhope::Writter& m_out;
+    const WebSocketParams m_params;
+    WsHandlers m_handlers;
+
+    std::vector<std::uint8_t> m_inBuf;
+    std::size_t m_inBegin = 0;
+    std::size_t m_inEnd = 0;
+    std::size_t m_needSize = 0;
+
+    WsMessage m_message;
+    bool m_inMessage = false;
+
+    std::deque<WsFrame> m_outQueue;
+    std::size_t m_queuedBytes = 0;
+    std::size_t m_writeOffset = 0;
+    bool m_writing = false;
+
+    // Frames are numbered in the order of the queue: the number of the queued Pong and of the next frame to send
+    std::optional<std::size_t> m_pongFrame;
+    std::size_t m_sentFrames = 0;
+
+    bool m_pingSent = false;
+    bool m_receivedSincePing = false;
+
+    std::atomic<bool> m_open = false;
+    bool m_closeSent = false;
+    bool m_finishAfterWrite = false;
+    bool m_finished = false;
+    WsCloseCode m_peerCode = WsCloseCode::Abnormal;
+    std::string m_peerReason;
+    nhope::Promise<void> m_closed;
+
+    nhope::AOContext m_aoCtx;
+    nhope::AOContextRef m_aoCtxRef;
+};
+
+}   // namespace
+
+WsFrame makeWsTextFrame(std::string_view text)
+{
+    return std::make_shared<const std::string>(detail::encodeWsFrame(WsOpcode::Text, text));
+}
+
+WsFrame makeWsBinaryFrame(gsl::span<const std::uint8_t> data)
+{
+    const std::string_view payload(reinterpret_cast<const char*>(data.data()), data.size());
+    return std::make_shared<const std::string>(detail::encodeWsFrame(WsOpcode::Binary, payload));
+}
+
+std::string wsAcceptKey(std::string_view key)
+{
+    std::string data(key);
+    data += wsGuid;
+    return common::detail::toBase64(common::detail::sha1(data));
+}
+
+WebSocketUpgrade::WebSocketUpgrade(RequestContext& ctx, WebSocketParams params)
+  : m_params(params)
+{
+    const auto& headers = ctx.request.headers;
+    if (!hasToken(headers, "Upgrade", "websocket"sv) || !hasToken(headers, "Connection", "upgrade"sv)) {
+        throw HttpError(HttpStatus::UpgradeRequired, "WebSocket upgrade is expected");
+    }
+
+    const auto version = headers.find("Sec-WebSocket-Version");
+    if (version == headers.end() || version->second != wsVersion) {
+        // RFC 6455, 4.4: the 426 response lists the supported versions, accept leaves it as is
+        ctx.response = common::makePlainTextResponse(ctx.aoCtx, HttpStatus::UpgradeRequired,
+                                                     "Unsupported WebSocket version");
+        ctx.response.headers["Sec-WebSocket-Version"] = std::string(wsVersion);
+        m_rejected = true;
+        return;
+    }
+
+    const auto key = headers.find("Sec-WebSocket-Key");
+    if (key == headers.end() || !isValidWsKey(key->second)) {
+        throw HttpError(HttpStatus::BadRequest, "Sec-WebSocket-Key is missing or invalid");
+    }
+    m_acceptKey = wsAcceptKey(key->second);
+}
+
+WebSocketUpgrade& WebSocketUpgrade::onOpen(OpenHandler handler)
+{
+    m_onOpen = std::move(handler);
+    return *this;
+}
+
+WebSocketUpgrade& WebSocketUpgrade::onMessage(MessageHandler handler)
+{
+    m_onMessage = std::move(handler);
+    return *this;
+}
+
+WebSocketUpgrade& WebSocketUpgrade::onClose(CloseHandler handler)
+{
+    m_onClose = std::move(handler);
+    return *this;
+}
+
+void WebSocketUpgrade::accept(RequestContext& ctx) &&
+{
+    if (m_rejected) {
+        return;
+    }
+
+    ctx.response.status = HttpStatus::SwitchingProtocols;
+    ctx.response.statusMessage = std::string(HttpStatus::message(HttpStatus::SwitchingProtocols));
+    ctx.response.headers["Upgrade"] = "websocket";
+    ctx.response.headers["Connection"] = "Upgrade";
+    ctx.response.headers["Sec-WebSocket-Accept"] = std::move(m_acceptKey);
+    ctx.response.body = nullptr;
+
+    ctx.upgrade = [params = m_params,
+                   handlers = WsHandlers{std::move(m_onOpen), std::move(m_onMessage), std::move(m_onClose)}](
+                    nhope::AOContext& aoCtx, nhope::Reader& in, nhope::Writter& out) mutable {
+        auto session = std::make_shared<WebSocketSession>(aoCtx, in, out, params, std::move(handlers));
+        return session->start();
+    };
+}
+
+void WsBroadcaster::subscribe(const WebSocketPtr& ws)
+{
+    std::scoped_lock lock(m_mutex);
+    m_subscribers.emplace_back(ws);
+}
+
+void WsBroadcaster::broadcast(std::string_view text)
+{
+    this->broadcast(makeWsTextFrame(text));
+}
+
+void WsBroadcaster::broadcast(WsFrame frame)
+{
+    std::scoped_lock lock(m_mutex);
+    m_subscribers.remove_if([&frame](const std::weak_ptr<WebSocket>& item) {
+        const auto ws = item.lock();
+        if (ws == nullptr || !ws->isOpen()) {
+            return true;
+        }
+        ws->sendFrame(frame);
+        return false;
+    });
+}
+
+std::size_t WsBroadcaster::subscriberCount() const
+{
+    std::scoped_lock lock(m_mutex);
+    return m_subscribers.size();
+}
+
+}   // namespace royalbed::server
@@ -4,9 +4,9 @@
 #include "nhope/async/async-invoke.h"
 #include "nhope/async/thread-executor.h"
 #include "nhope/io/io-device.h"
-#include "nhope/io/pushback-reader.h"
 #include "nhope/io/string-reader.h"
 
+#include "royalbed/common/detail/connection-buffer.h"
 #include "royalbed/client/detail/receive-response.h"
 #include "royalbed/client/headers.h"
 #include "royalbed/client/http-error.h"
@@ -19,6 +19,7 @@ namespace {
 using namespace std::literals;
 using namespace royalbed::client;
 using namespace royalbed::client::detail;
+using royalbed::common::detail::ConnectionBuffer;
 
 }   // namespace
 
@@ -29,7 +30,7 @@ TEST(ReceiveResponse, OnlyStatusLine)   // NOLINT
     nhope::ThreadExecutor executor;
     nhope::AOContext aoCtx(executor);
 
-    auto conn = nhope::PushbackReader::create(aoCtx, nhope::StringReader::create(aoCtx, rawResponse));
+    auto conn = ConnectionBuffer::create(aoCtx, nhope::StringReader::create(aoCtx, rawResponse));
     receiveResponse(aoCtx, *conn)
       .then([](auto resp) {
           EXPECT_EQ(resp.status, 200);
@@ -53,7 +54,7 @@ TEST(ReceiveResponse, OnlyHeaders)   // NOLINT
 
     nhope::ThreadExecutor executor;
     nhope::AOContext aoCtx(executor);
-    auto conn = nhope::PushbackReader::create(aoCtx, nhope::StringReader::create(aoCtx, rawResponse));
+    auto conn = ConnectionBuffer::create(aoCtx, nhope::StringReader::create(aoCtx, rawResponse));
 
     receiveResponse(aoCtx, *conn)
       .then([](auto resp) {
@@ -78,7 +79,7 @@ TEST(ReceiveResponse, Badresponse)   // NOLINT
 
     nhope::ThreadExecutor executor;
     nhope::AOContext aoCtx(executor);
-    auto conn = nhope::PushbackReader::create(aoCtx, nhope::StringReader::create(aoCtx, rawResponse));
+    auto conn = ConnectionBuffer::create(aoCtx, nhope::StringReader::create(aoCtx, rawResponse));
 
     auto future = receiveResponse(aoCtx, *conn);
 
@@ -92,7 +93,7 @@ TEST(ReceiveResponse, Incompleteresponse)   // NOLINT
 
     nhope::ThreadExecutor executor;
     nhope::AOContext aoCtx(executor);
-    auto conn = nhope::PushbackReader::create(aoCtx, nhope::StringReader::create(aoCtx, rawResponse));
+    auto conn = ConnectionBuffer::create(aoCtx, nhope::StringReader::create(aoCtx, rawResponse));
 
     auto future = receiveResponse(aoCtx, *conn);
 
@@ -105,7 +106,7 @@ TEST(ReceiveResponse, IOError)   // NOLINT
     nhope::ThreadExecutor executor;
     nhope::AOContext aoCtx(executor);
 
-    auto conn = nhope::PushbackReader::create(
+    auto conn = ConnectionBuffer::create(
       aoCtx,                                                                        //
       nhope::concat(aoCtx, nhope::StringReader::create(aoCtx, "HTTP/1.1 200 OK"),   // Begining of the response header
                     BrokenSock::create(aoCtx))                                      // IOError
@@ -121,7 +122,7 @@ TEST(ReceiveResponse, BodyReader_IOError)   // NOLINT
     nhope::ThreadExecutor executor;
     nhope::AOContext aoCtx(executor);
 
-    auto conn = nhope::PushbackReader::create(
+    auto conn = ConnectionBuffer::create(
       aoCtx,                                                                      //
       nhope::concat(aoCtx,                                                        //
                     nhope::StringReader::create(aoCtx, "HTTP/1.1 200 OK\r\n"      // Begining of the response header
@@ -143,7 +144,7 @@ TEST(Receiveresponse, Cancel)   // NOLINT
     nhope::ThreadExecutor executor;
     nhope::AOContext aoCtx(executor);
 
-    auto conn = nhope::PushbackReader::create(
+    auto conn = ConnectionBuffer::create(
       aoCtx,                                                               //
       nhope::concat(aoCtx,                                                 //
                     nhope::StringReader::create(aoCtx, "HTTP/1.1 200 "),   // Begining of the response header
@@ -164,7 +165,7 @@ TEST(ReceiveResponse, BodyReader_Cancel)   // NOLINT
     nhope::ThreadExecutor executor;
     nhope::AOContext aoCtx(executor);
 
-    auto conn = nhope::PushbackReader::create(
+    auto conn = ConnectionBuffer::create(
       aoCtx,                                                                      //
       nhope::concat(aoCtx,                                                        //
                     nhope::StringReader::create(aoCtx, "HTTP/1.1 200 OK\r\n"      // Begining of the response header
@@ -188,7 +189,7 @@ TEST(ReceiveResponse, TwoResponse)   // NOLINT
     nhope::ThreadExecutor executor;
     nhope::AOContext aoCtx(executor);
 
-    auto conn = nhope::PushbackReader::create(   //
+    auto conn = ConnectionBuffer::create(   //
       aoCtx,                                     //
       nhope::StringReader::create(aoCtx, "HTTP/1.1 200 OK\r\n"
                                          "Content-Length: 10\r\n"
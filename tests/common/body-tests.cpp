@@ -1,7 +1,13 @@
+#include <cerrno>
+#include <cstdint>
+#include <exception>
 #include <string>
+#include <system_error>
+#include <vector>
 
 #include "nhope/async/ao-context.h"
 #include "nhope/async/thread-executor.h"
+#include "nhope/io/io-device.h"
 #include "nhope/io/string-reader.h"
 
 #include "spdlog/spdlog.h"
@@ -42,6 +48,24 @@ void to_json(nlohmann::json& json, const TestStruct& value)
     json = {{"val1", value.val1}, {"val2", value.val2}};
 }
 
+// A sequence container with its own JSON representation
+struct Polyline : std::vector<int>
+{};
+
+void from_json(const nlohmann::json& json, Polyline& value)
+{
+    json.at("points").get_to(static_cast<std::vector<int>&>(value));
+}
+
+class FailingReader final : public nhope::Reader
+{
+public:
+    void read(gsl::span<std::uint8_t> /*buf*/, nhope::IOHandler handler) override
+    {
+        handler(std::make_exception_ptr(std::system_error(ECONNRESET, std::generic_category())), 0);
+    }
+};
+
 }   // namespace
 
 TEST(Body, ValidBody)   // NOLINT
@@ -69,5 +93,154 @@ TEST(Body, InvalidContentType)   // NOLINT
 
     Request req;
     req.headers.emplace("Content-Type", "application/jpeg");
-    EXPECT_THROW(royalbed::common::extractBodyType(req.headers), HttpError);   // NOLINT
+    try {
+        royalbed::common::extractBodyType(req.headers);
+        FAIL() << "HttpError expected";
+    } catch (const HttpError& e) {
+        EXPECT_EQ(e.httpStatus(), HttpStatus::UnsupportedMediaType);
+    }
+
+    // parseBody reads JSON whatever the Content-Type
+    for (const auto* type : {"application/jpeg", "text/plain", "application/x-www-form-urlencoded"}) {
+        req.headers["Content-Type"] = type;
+        const auto rawBody = json(etalon).dump();
+        const auto body = royalbed::common::parseBody<TestStruct>(req.headers, {rawBody.begin(), rawBody.end()});
+        EXPECT_EQ(body.get(), etalon) << type;
+    }
+}
+
+TEST(Body, ParseStreamedArray)   // NOLINT
+{
+    nhope::ThreadExecutor th;
+    nhope::AOContext ao(th);
+
+    const auto etalon = std::vector<TestStruct>{{1, "one"}, {2, "two, [three]"}};
+    auto reader = nhope::StringReader::create(ao, json(etalon).dump());
+
+    Headers headers{{"Content-Type", "application/json"}};
+    const auto body = royalbed::common::parseBody<std::vector<TestStruct>>(headers, *reader).get();
+    EXPECT_EQ(body.get(), etalon);
+}
+
+TEST(Body, ParseStreamedObject)   // NOLINT
+{
+    nhope::ThreadExecutor th;
+    nhope::AOContext ao(th);
+
+    const TestStruct etalon = {100, "text text"};
+    auto reader = nhope::StringReader::create(ao, json(etalon).dump());
+
+    Headers headers{{"Content-Type", "application/json"}};
+    const auto body = royalbed::common::parseBody<TestStruct>(headers, *reader).get();
+    EXPECT_EQ(body.get(), etalon);
+}
+
+TEST(Body, ParseStreamedInvalidArray)   // NOLINT
+{
+    nhope::ThreadExecutor th;
+    nhope::AOContext ao(th);
+
+    Headers headers{{"Content-Type", "application/json"}};
+    for (const auto* invalid : {"[{\"val1\": 1, \"val2\": \"x\"},]", "{}", "[1, 2]", "[{\"val1\": 1"}) {
+        auto reader = nhope::StringReader::create(ao, invalid);
+        auto future = royalbed::common::parseBody<std::vector<TestStruct>>(headers, *reader);
+        EXPECT_THROW(future.get(), HttpError);   // NOLINT
+    }
+}
+
+TEST(Body, ParseStreamedOwnFromJson)   // NOLINT
+{
+    nhope::ThreadExecutor th;
+    nhope::AOContext ao(th);
+
+    auto reader = nhope::StringReader::create(ao, R"({"points": [1, 2, 3]})");
+    Headers headers{{"Content-Type", "application/json"}};
+    const auto body = royalbed::common::parseBody<Polyline>(headers, *reader).get();
+    EXPECT_EQ(body.get(), (std::vector<int>{1, 2, 3}));
+}
+
+TEST(Body, ReaderErrorIsNotParseError)   // NOLINT
+{
+    Headers headers{{"Content-Type", "application/json"}};
+    for (const auto* type : {"application/json", "application/cbor"}) {
+        headers["Content-Type"] = type;
+        FailingReader reader;
+        auto future = royalbed::common::parseBody<std::vector<TestStruct>>(headers, reader);
+        EXPECT_THROW(future.get(), std::system_error);   // NOLINT
+    }
+}
+
+TEST(Body, ContentTypeWithParameters)   // NOLINT
+{
+    EXPECT_EQ(extractBodyType(Headers{{"Content-Type", "application/json; charset=utf-8"}}), BodyType::Json);
+    EXPECT_EQ(extractBodyType(Headers{{"Content-Type", "Application/CBOR"}}), BodyType::Cbor);
+    EXPECT_EQ(extractBodyType(Headers{{"Content-Type", "application/x-msgpack"}}), BodyType::MsgPack);
+    EXPECT_EQ(extractBodyType(Headers{{"Content-Type", "text/plain;charset=utf-8"}}), BodyType::Plain);
+}
+
+TEST(Body, NegotiateBodyType)   // NOLINT
+{
+    const auto negotiate = [](const char* acceptValue) {
+        return negotiateBodyType(Headers{{"Accept", acceptValue}});
+    };
+
+    EXPECT_EQ(negotiateBodyType(Headers{}), BodyType::Json);
+    EXPECT_EQ(negotiate("*/*"), BodyType::Json);
+    EXPECT_EQ(negotiate("application/cbor"), BodyType::Cbor);
+    EXPECT_EQ(negotiate("application/msgpack"), BodyType::MsgPack);
+    EXPECT_EQ(negotiate("application/vnd.msgpack"), BodyType::MsgPack);
+    EXPECT_EQ(negotiate("application/json;q=0.5, application/cbor"), BodyType::Cbor);
+    EXPECT_EQ(negotiate("application/json;q=0.5, application/msgpack;q=0.9, */*;q=0.1"), BodyType::MsgPack);
+    EXPECT_EQ(negotiate("application/*;q=0.8, application/json;q=0.1"), BodyType::Cbor);
+    EXPECT_EQ(negotiate("application/cbor;q=0"), BodyType::Json);
+    EXPECT_EQ(negotiate("text/html"), BodyType::Json);
+}
+
+TEST(Body, ParseBinaryBody)   // NOLINT
+{
+    nhope::ThreadExecutor th;
+    nhope::AOContext ao(th);
+
+    const TestStruct etalon = {100, "text text"};
+    const auto cbor = json::to_cbor(json(etalon));
+    const auto msgPack = json::to_msgpack(json(etalon));
+
+    Headers cborHeaders{{"Content-Type", "application/cbor"}};
+    auto cborReader = nhope::StringReader::create(ao, std::string(cbor.begin(), cbor.end()));
+    EXPECT_EQ(parseBody<TestStruct>(cborHeaders, *cborReader).get().get(), etalon);
+
+    Headers msgPackHeaders{{"Content-Type", "application/msgpack"}};
+    EXPECT_EQ(parseBody<TestStruct>(msgPackHeaders, msgPack).get(), etalon);
+
+    auto invalidReader = nhope::StringReader::create(ao, "\xff\xff");
+    EXPECT_THROW(parseBody<TestStruct>(cborHeaders, *invalidReader).get(), HttpError);   // NOLINT
+}
+
+TEST(Body, BinaryResult)   // NOLINT
+{
+    nhope::ThreadExecutor th;
+    const TestStruct etalon = {100, "text text"};
+
+    royalbed::server::Router router;
+    router.post("/echo", [](Body<TestStruct> body) {
+        return *body;
+    });
+
+    const auto cbor = json::to_cbor(json(etalon));
+    nhope::AOContext ao(th);
+    royalbed::server::Request req;
+    req.headers = {{"Content-Type", "application/cbor"}, {"Accept", "application/msgpack, application/json;q=0.5"}};
+    req.body = nhope::StringReader::create(ao, std::string(cbor.begin(), cbor.end()));
+
+    royalbed::server::RequestContext ctx{
+      .num = 1,
+      .router = router,
+      .request = std::move(req),
+      .aoCtx = nhope::AOContext(th),
+    };
+    router.route("POST", "/echo").handler(ctx).get();
+
+    EXPECT_EQ(ctx.response.headers["Content-Type"], "application/msgpack");
+    const auto respBody = nhope::readAll(*ctx.response.body).get();
+    EXPECT_EQ(json::from_msgpack(respBody).get<TestStruct>(), etalon);
 }
@@ -0,0 +1,73 @@
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "royalbed/common/detail/chunked-decoder.h"
+#include "royalbed/common/http-error.h"
+
+#include "helpers/bytes.h"
+
+namespace {
+
+using namespace royalbed::common;
+using namespace royalbed::common::detail;
+using namespace std::literals;
+
+// Feeds the encoded body by portions of the given size, returns the body and the bytes behind it
+std::pair<std::string, std::string> decode(std::string_view encoded, std::size_t portionSize)
+{
+    ChunkedDecoder decoder;
+    std::string body;
+    std::string rest;
+
+    auto data = asBytes(encoded);
+    for (std::size_t pos = 0; pos < data.size(); pos += portionSize) {
+        auto portion = gsl::span<std::uint8_t>(data).subspan(pos, std::min(portionSize, data.size() - pos));
+        if (decoder.done()) {
+            rest += asString(portion);
+            continue;
+        }
+
+        const auto result = decoder.decode(portion);
+        body += asString(portion.first(result.bodySize));
+        rest += asString(portion.subspan(result.consumed));
+    }
+
+    EXPECT_TRUE(decoder.done());
+    return {body, rest};
+}
+
+}   // namespace
+
+TEST(ChunkedDecoder, Decode)   // NOLINT
+{
+    constexpr auto encoded = "5\r\nHello\r\n"
+                             "1;name=value\r\n,\r\n"
+                             "B\r\n 0123456789\r\n"
+                             "0\r\n"
+                             "Trailer: value\r\n"
+                             "\r\n"
+                             "GET / HTTP/1.1\r\n"sv;
+
+    for (const std::size_t portionSize : {1, 2, 3, 7, 16, 1024}) {
+        const auto [body, rest] = decode(encoded, portionSize);
+        EXPECT_EQ(body, "Hello, 0123456789") << portionSize;
+        EXPECT_EQ(rest, "GET / HTTP/1.1\r\n") << portionSize;
+    }
+}
+
+TEST(ChunkedDecoder, InvalidFraming)   // NOLINT
+{
+    for (const auto encoded : {"\r\n"sv, "x\r\n"sv, "5\r\nHello0\r\n\r\n"sv, "5\nHello\r\n0\r\n\r\n"sv,
+                               "FFFFFFFFFFFFFFFFF\r\n"sv}) {
+        ChunkedDecoder decoder;
+        auto data = asBytes(encoded);
+        EXPECT_THROW(decoder.decode(data), HttpError) << encoded;   // NOLINT
+    }
+}
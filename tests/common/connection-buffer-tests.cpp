@@ -0,0 +1,67 @@
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <string>
+
+#include <gtest/gtest.h>
+
+#include "nhope/async/ao-context.h"
+#include "nhope/async/future.h"
+#include "nhope/async/thread-executor.h"
+#include "nhope/io/io-device.h"
+#include "nhope/io/string-reader.h"
+
+#include "royalbed/common/detail/connection-buffer.h"
+
+#include "helpers/bytes.h"
+
+namespace {
+
+using namespace royalbed::common::detail;
+
+std::size_t fill(ConnectionBuffer& buffer)
+{
+    nhope::Promise<std::size_t> promise;
+    auto future = promise.future();
+    buffer.fill([&promise](std::exception_ptr err, std::size_t n) {
+        if (err) {
+            promise.setException(err);
+            return;
+        }
+        promise.setValue(n);
+    });
+    return future.get();
+}
+
+}   // namespace
+
+TEST(ConnectionBuffer, FillAndConsume)   // NOLINT
+{
+    nhope::ThreadExecutor executor;
+    nhope::AOContext aoCtx(executor);
+
+    constexpr std::size_t capacity = 4;
+    ConnectionBuffer buffer(aoCtx, nhope::StringReader::create(aoCtx, "0123456789"), capacity);
+
+    EXPECT_TRUE(buffer.data().empty());
+    EXPECT_EQ(fill(buffer), 4);
+    EXPECT_EQ(asString(buffer.data()), "0123");
+
+    // The consumed bytes make room for the next portion
+    buffer.consume(3);
+    EXPECT_EQ(fill(buffer), 3);
+    EXPECT_EQ(asString(buffer.data()), "3456");
+
+    // The storage grows when nothing is consumed
+    EXPECT_EQ(fill(buffer), 3);
+    EXPECT_EQ(asString(buffer.data()), "3456789");
+
+    std::array<std::uint8_t, 5> buf{};
+    EXPECT_EQ(nhope::read(buffer, buf).get(), 5);
+    EXPECT_EQ(asString(buf), "34567");
+    EXPECT_EQ(asString(buffer.data()), "89");
+
+    buffer.consume(2);
+    EXPECT_EQ(fill(buffer), 0);
+}
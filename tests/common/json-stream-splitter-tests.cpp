@@ -0,0 +1,62 @@
+#include <cstdint>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "royalbed/common/detail/json-stream-splitter.h"
+
+#include "helpers/bytes.h"
+
+namespace {
+
+using namespace std::literals;
+using royalbed::common::detail::JsonStreamSplitter;
+
+std::vector<std::string> split(std::string_view json, std::size_t chunkSize)
+{
+    std::vector<std::string> elements;
+    JsonStreamSplitter splitter([&elements](std::string_view element) {
+        elements.emplace_back(element);
+    });
+
+    const auto bytes = asBytes(json);
+    for (std::size_t pos = 0; pos < bytes.size(); pos += chunkSize) {
+        splitter.feed(std::span(bytes).subspan(pos, std::min(chunkSize, bytes.size() - pos)));
+    }
+    splitter.finish();
+
+    return elements;
+}
+
+}   // namespace
+
+TEST(JsonStreamSplitter, Elements)   // NOLINT
+{
+    constexpr auto json = R"( [ {"a": "x,]\"}"}, [1, [2]] ,3 ,"s" ] )"sv;
+    const auto etalon = std::vector<std::string>{
+      R"({"a": "x,]\"}"})",
+      "[1, [2]] ",
+      "3 ",
+      R"("s" )",
+    };
+
+    for (const std::size_t chunkSize : {1, 2, 3, 7, 1024}) {
+        EXPECT_EQ(split(json, chunkSize), etalon);
+    }
+}
+
+TEST(JsonStreamSplitter, EmptyArray)   // NOLINT
+{
+    EXPECT_TRUE(split("[]", 1).empty());
+    EXPECT_TRUE(split(" [ ] ", 1).empty());
+}
+
+TEST(JsonStreamSplitter, InvalidArray)   // NOLINT
+{
+    for (const auto json : {"[1,]"sv, "[,1]"sv, "{}"sv, "[1"sv, "[1]x"sv, "[1}]"sv, ""sv}) {
+        EXPECT_ANY_THROW(split(json, 1)) << json;   // NOLINT
+    }
+}
@@ -0,0 +1,134 @@
+#include <cstdint>
+#include <limits>
+#include <map>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "nlohmann/json.hpp"
+
+#include "royalbed/common/json-writer.h"
+
+namespace {
+
+using namespace std::literals;
+using royalbed::common::JsonWriter;
+using royalbed::common::serializeJson;
+
+struct Point
+{
+    int x;
+    int y;
+};
+
+void writeJson(JsonWriter& out, const Point& point)
+{
+    out.beginObject().field("x", point.x).field("y", point.y).endObject();
+}
+
+struct Legacy
+{
+    std::string name;
+};
+
+void to_json(nlohmann::json& json, const Legacy& legacy)
+{
+    json = nlohmann::json{{"name", legacy.name}};
+}
+
+// An iterable type with its own JSON representation
+struct Route
+{
+    std::vector<int> stops;
+
+    [[nodiscard]] auto begin() const
+    {
+        return stops.begin();
+    }
+
+    [[nodiscard]] auto end() const
+    {
+        return stops.end();
+    }
+};
+
+void to_json(nlohmann::json& json, const Route& route)
+{
+    json = nlohmann::json{{"stops", route.stops.size()}};
+}
+
+}   // namespace
+
+TEST(JsonWriter, Primitives)   // NOLINT
+{
+    EXPECT_EQ(serializeJson(true), "true");
+    EXPECT_EQ(serializeJson(false), "false");
+    EXPECT_EQ(serializeJson(-42), "-42");
+    EXPECT_EQ(serializeJson(std::numeric_limits<std::uint64_t>::max()), "18446744073709551615");
+    EXPECT_EQ(serializeJson(1.5), "1.5");
+    EXPECT_EQ(serializeJson(std::numeric_limits<double>::quiet_NaN()), "null");
+    EXPECT_EQ(serializeJson(nullptr), "null");
+    EXPECT_EQ(serializeJson("text"), "\"text\"");
+    EXPECT_EQ(serializeJson("text"s), "\"text\"");
+}
+
+TEST(JsonWriter, Escaping)   // NOLINT
+{
+    const auto str = "quote\" backslash\\ \b\f\n\r\t \x01 юникод"s;
+    const auto json = serializeJson(str);
+    EXPECT_EQ(json, R"("quote\" backslash\\ \b\f\n\r\t \u0001 юникод")");
+    EXPECT_EQ(nlohmann::json::parse(json).get<std::string>(), str);
+}
+
+TEST(JsonWriter, Nested)   // NOLINT
+{
+    JsonWriter out;
+    out.beginObject()
+      .field("a", 1)
+      .key("b")
+      .beginArray()
+      .value(1)
+      .beginObject()
+      .endObject()
+      .beginArray()
+      .endArray()
+      .endArray()
+      .field("c", "x")
+      .endObject();
+
+    EXPECT_EQ(out.buffer(), R"({"a":1,"b":[1,{},[]],"c":"x"})");
+}
+
+TEST(JsonWriter, ExternalBuffer)   // NOLINT
+{
+    std::string buf = "prefix:";
+    JsonWriter out(buf);
+    out.value(std::vector<int>{1, 2, 3});
+    EXPECT_EQ(buf, "prefix:[1,2,3]");
+}
+
+TEST(JsonWriter, StandardTypes)   // NOLINT
+{
+    EXPECT_EQ(serializeJson(std::optional<int>()), "null");
+    EXPECT_EQ(serializeJson(std::optional<int>(5)), "5");
+    EXPECT_EQ(serializeJson(std::vector<std::string>{"a", "b"}), R"(["a","b"])");
+    EXPECT_EQ(serializeJson(std::map<std::string, int>{{"a", 1}, {"b", 2}}), R"({"a":1,"b":2})");
+    EXPECT_EQ(serializeJson(nlohmann::json{{"k", {1, 2}}}), R"({"k":[1,2]})");
+}
+
+TEST(JsonWriter, UserTypes)   // NOLINT
+{
+    EXPECT_EQ(serializeJson(Point{1, 2}), R"({"x":1,"y":2})");
+    EXPECT_EQ(serializeJson(std::vector<Point>{{1, 2}, {3, 4}}), R"([{"x":1,"y":2},{"x":3,"y":4}])");
+    EXPECT_EQ(serializeJson(Legacy{"old"}), R"({"name":"old"})");
+    EXPECT_EQ(serializeJson(Route{{1, 2, 3}}), R"({"stops":3})");
+    EXPECT_EQ(serializeJson(std::vector<Route>{{{1}}}), R"([{"stops":1}])");
+}
+
+TEST(JsonWriter, SameAsNlohmann)   // NOLINT
+{
+    const std::map<std::string, std::vector<double>> value{{"a", {0.1, 1e100, -3.0}}, {"b", {}}};
+    EXPECT_EQ(serializeJson(value), nlohmann::json(value).dump());
+}
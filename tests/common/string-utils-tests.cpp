@@ -85,3 +85,11 @@ TEST(StringUtils, LowercaseLess)   // NOLINT
 {
     EXPECT_TRUE(LowercaseLess{}("a", "B"));
 }
+
+TEST(StringUtils, trim)   // NOLINT
+{
+    EXPECT_EQ(trim(" \tgzip \t"sv), "gzip"sv);
+    EXPECT_EQ(trim("a b"sv), "a b"sv);
+    EXPECT_EQ(trim(" \t "sv), ""sv);
+    EXPECT_EQ(trim(""sv), ""sv);
+}
@@ -9,9 +9,10 @@
 #include "nhope/io/io-device.h"
 #include "nhope/io/sock-addr.h"
 #include "nhope/io/tcp.h"
-#include "nhope/io/pushback-reader.h"
 #include "nhope/io/string-reader.h"
 
+#include "royalbed/common/detail/connection-buffer.h"
+
 class SlowSock final : public nhope::TcpSocket
 {
 public:
@@ -147,10 +148,11 @@ private:
     nhope::AOContext m_aoCtx;
 };
 
-inline nhope::PushbackReaderPtr inputStream(nhope::AOContext& aoCtx, std::string request)
+inline royalbed::common::detail::ConnectionBufferPtr inputStream(nhope::AOContext& aoCtx, std::string request)
 {
     using namespace nhope;
-    return PushbackReader::create(aoCtx, StringReader::create(aoCtx, std::move(request)));
+    using royalbed::common::detail::ConnectionBuffer;
+    return ConnectionBuffer::create(aoCtx, StringReader::create(aoCtx, std::move(request)));
 }
 
 class EchoSock final : public nhope::TcpSocket
@@ -0,0 +1,41 @@
+#pragma once
+
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <string_view>
+
+// A temporary directory removed with its content
+class TempDir final
+{
+public:
+    TempDir()
+    {
+        auto name = (std::filesystem::temp_directory_path() / "royalbed-tests-XXXXXX").string();
+        m_path = ::mkdtemp(name.data());
+    }
+
+    TempDir(const TempDir&) = delete;
+    TempDir& operator=(const TempDir&) = delete;
+
+    ~TempDir()
+    {
+        std::filesystem::remove_all(m_path);
+    }
+
+    [[nodiscard]] std::filesystem::path write(const std::filesystem::path& name, std::string_view content) const
+    {
+        const auto path = m_path / name;
+        std::filesystem::create_directories(path.parent_path());
+        std::ofstream(path, std::ios::binary | std::ios::trunc) << content;
+        return path;
+    }
+
+    [[nodiscard]] const std::filesystem::path& path() const
+    {
+        return m_path;
+    }
+
+private:
+    std::filesystem::path m_path;
+};
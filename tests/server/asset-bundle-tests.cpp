@@ -0,0 +1,162 @@
+#include <cstdint>
+#include <filesystem>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include <gsl/span>
+
+#include "nhope/async/ao-context.h"
+#include "nhope/async/future.h"
+#include "nhope/async/thread-executor.h"
+#include "nhope/io/io-device.h"
+
+#include "royalbed/server/asset-bundle.h"
+#include "royalbed/server/http-status.h"
+#include "royalbed/server/request-context.h"
+#include "royalbed/server/router.h"
+#include "royalbed/server/send-content.h"
+#include "royalbed/server/static-files.h"
+#include "royalbed/server/swagger.h"
+
+#include "helpers/logger.h"
+#include "helpers/temp-dir.h"
+
+namespace {
+
+namespace fs = std::filesystem;
+using namespace std::literals;
+using namespace royalbed::server;
+
+std::string text(gsl::span<const std::uint8_t> data)
+{
+    return {data.begin(), data.end()};
+}
+
+AssetBundle makeBundle(const TempDir& dir)
+{
+    const auto files = std::vector<fs::path>{
+      dir.write("site/index.html", "<html></html>"),
+      dir.write("site/js/app.js", "plain"),
+      dir.write("site/js/app.js.gz", "compressed"),
+      dir.write("site/js/lib.js.gz", "only compressed"),
+      dir.write("site/api/openapi.yml", "openapi: 3.0.0"),
+    };
+    const auto bundlePath = dir.path() / "site.bundle";
+    AssetBundle::build(bundlePath, dir.path() / "site", files);
+    return AssetBundle::open(bundlePath);
+}
+
+struct Response
+{
+    int status;
+    Headers headers;
+    std::string body;
+};
+
+Response get(const Router& router, std::string_view path, const Headers& headers = {})
+{
+    nhope::ThreadExecutor th;
+    RequestContext ctx{
+      .num = 1,
+      .log = nullLogger(),
+      .router = router,
+      .aoCtx = nhope::AOContext(th),
+    };
+    ctx.request.headers = headers;
+    router.route("GET", path).handler(ctx).get();
+
+    std::string body;
+    if (ctx.response.body != nullptr) {
+        const auto data = nhope::readAll(*ctx.response.body).get();
+        body.assign(data.begin(), data.end());
+    }
+    return {ctx.response.status, ctx.response.headers, body};
+}
+
+}   // namespace
+
+TEST(AssetBundle, BuildAndOpen)   // NOLINT
+{
+    const TempDir dir;
+    const auto bundle = makeBundle(dir);
+
+    ASSERT_EQ(bundle.assets().size(), 4);
+    EXPECT_EQ(bundle.assets()[0].path, "api/openapi.yml");
+    EXPECT_EQ(bundle.find("missing.html"), nullptr);
+
+    const auto* index = bundle.find("index.html");
+    ASSERT_NE(index, nullptr);
+    EXPECT_EQ(index->contentType, "text/html; charset=utf-8");
+    EXPECT_EQ(text(index->content.data), "<html></html>");
+    EXPECT_EQ(index->content.etag, contentETag(index->content.data));
+    EXPECT_FALSE(index->gzip.has_value());
+    EXPECT_EQ(reinterpret_cast<std::uintptr_t>(index->content.data.data()) % 64, 0);   // NOLINT
+
+    const auto* app = bundle.find("js/app.js");
+    ASSERT_NE(app, nullptr);
+    EXPECT_EQ(text(app->content.data), "plain");
+    EXPECT_TRUE(app->content.contentEncoding.empty());
+    ASSERT_TRUE(app->gzip.has_value());
+    EXPECT_EQ(text(app->gzip->data), "compressed");
+    EXPECT_EQ(app->gzip->contentEncoding, "gzip");
+    EXPECT_NE(app->gzip->etag, app->content.etag);
+
+    const auto* lib = bundle.find("js/lib.js");
+    ASSERT_NE(lib, nullptr);
+    EXPECT_EQ(text(lib->content.data), "only compressed");
+    EXPECT_EQ(lib->content.contentEncoding, "gzip");
+    EXPECT_EQ(lib->contentType, "application/javascript; charset=utf-8");
+}
+
+TEST(AssetBundle, Invalid)   // NOLINT
+{
+    const TempDir dir;
+    EXPECT_THROW(AssetBundle::open(dir.write("empty.bundle", "")), std::runtime_error);            // NOLINT
+    EXPECT_THROW(AssetBundle::open(dir.write("text.bundle", "not a bundle")), std::runtime_error);   // NOLINT
+
+    // Truncated data
+    (void)makeBundle(dir);
+    const auto path = dir.path() / "site.bundle";
+    fs::resize_file(path, fs::file_size(path) - 1);
+    EXPECT_THROW(AssetBundle::open(path), std::runtime_error);   // NOLINT
+}
+
+TEST(StaticFiles, AssetBundle)   // NOLINT
+{
+    const TempDir dir;
+    const auto router = staticFiles(makeBundle(dir));
+
+    const auto index = get(router, "/index.html");
+    EXPECT_EQ(index.body, "<html></html>");
+    EXPECT_EQ(index.headers.at("Content-Type"), "text/html; charset=utf-8");
+
+    const auto redirect = get(router, "/");
+    EXPECT_EQ(redirect.status, HttpStatus::Found);
+
+    const auto plain = get(router, "/js/app.js");
+    EXPECT_EQ(plain.body, "plain");
+    EXPECT_EQ(plain.headers.at("Vary"), "Accept-Encoding");
+
+    const auto gzip = get(router, "/js/app.js", {{"Accept-Encoding", "gzip, deflate"}});
+    EXPECT_EQ(gzip.body, "compressed");
+    EXPECT_EQ(gzip.headers.at("Content-Encoding"), "gzip");
+
+    const auto range = get(router, "/js/lib.js", {{"Range", "bytes=0-3"}});
+    EXPECT_EQ(range.status, HttpStatus::PartialContent);
+    EXPECT_EQ(range.body, "only");
+}
+
+TEST(Swagger, AssetBundle)   // NOLINT
+{
+    const TempDir dir;
+    Router router;
+    swagger(router, makeBundle(dir), "api/openapi.yml");
+
+    const auto doc = get(router, "/swagger/doc-api");
+    EXPECT_EQ(doc.body, "openapi: 3.0.0");
+    EXPECT_EQ(doc.headers.at("Content-Type"), "application/yaml");
+}
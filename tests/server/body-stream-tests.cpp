@@ -0,0 +1,133 @@
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <system_error>
+
+#include <gtest/gtest.h>
+
+#include "nhope/async/ao-context.h"
+#include "nhope/async/future.h"
+#include "nhope/async/thread-executor.h"
+#include "nhope/io/io-device.h"
+#include "nhope/io/string-reader.h"
+#include "nhope/io/string-writter.h"
+
+#include "nlohmann/json.hpp"
+
+#include "royalbed/server/body-stream.h"
+#include "royalbed/server/request-context.h"
+#include "royalbed/server/router.h"
+
+namespace {
+
+using namespace std::literals;
+using namespace royalbed::server;
+
+}   // namespace
+
+TEST(BodyStream, PipeTo)   // NOLINT
+{
+    constexpr auto content = "1234567890"sv;
+
+    nhope::ThreadExecutor th;
+    nhope::AOContext aoCtx(th);
+    auto dest = nhope::StringWritter::create(aoCtx);
+
+    Router router;
+    router.put("/upload", [&dest](BodyStream body) {
+        return body.pipeTo(*dest);
+    });
+
+    Request req;
+    req.body = nhope::StringReader::create(aoCtx, std::string(content));
+
+    RequestContext ctx{
+      .num = 1,
+      .router = router,
+      .request = std::move(req),
+      .aoCtx = nhope::AOContext(th),
+    };
+    router.route("PUT", "/upload").handler(ctx).get();
+
+    const auto respBody = nhope::readAll(*ctx.response.body).get();
+    const auto json = nlohmann::json::parse(respBody.begin(), respBody.end());
+    EXPECT_EQ(json.get<std::size_t>(), content.size());
+    EXPECT_EQ(dest->takeContent(), content);
+}
+
+TEST(BodyStream, SaveToFile)   // NOLINT
+{
+    constexpr auto content = "royalbed body stream"sv;
+    const auto filePath = std::filesystem::temp_directory_path() / "royalbed-body-stream-test.bin";
+
+    nhope::ThreadExecutor th;
+
+    Router router;
+    router.put("/upload", [&filePath](BodyStream body) {
+        return body.saveToFile(filePath);
+    });
+
+    nhope::AOContext aoCtx(th);
+    Request req;
+    req.body = nhope::StringReader::create(aoCtx, std::string(content));
+
+    RequestContext ctx{
+      .num = 1,
+      .router = router,
+      .request = std::move(req),
+      .aoCtx = nhope::AOContext(th),
+    };
+    router.route("PUT", "/upload").handler(ctx).get();
+
+    std::ifstream file(filePath, std::ios::binary);
+    const auto saved = std::string(std::istreambuf_iterator<char>(file), {});
+    EXPECT_EQ(saved, content);
+
+    std::filesystem::remove(filePath);
+}
+
+TEST(BodyStream, SaveToFileError)   // NOLINT
+{
+    const auto filePath = std::filesystem::temp_directory_path() / "royalbed-no-such-dir" / "body.bin";
+
+    nhope::ThreadExecutor th;
+
+    Router router;
+    router.put("/upload", [&filePath](BodyStream body) {
+        return body.saveToFile(filePath);
+    });
+
+    nhope::AOContext aoCtx(th);
+    Request req;
+    req.body = nhope::StringReader::create(aoCtx, "royalbed");
+
+    RequestContext ctx{
+      .num = 1,
+      .router = router,
+      .request = std::move(req),
+      .aoCtx = nhope::AOContext(th),
+    };
+    EXPECT_THROW(router.route("PUT", "/upload").handler(ctx).get(), std::system_error);   // NOLINT
+}
+
+TEST(BodyStream, WithoutBody)   // NOLINT
+{
+    nhope::ThreadExecutor th;
+
+    Router router;
+    router.post("/upload", [](BodyStream body) {
+        return nhope::readAll(body.reader());
+    });
+
+    RequestContext ctx{
+      .num = 1,
+      .router = router,
+      .aoCtx = nhope::AOContext(th),
+    };
+    router.route("POST", "/upload").handler(ctx).get();
+
+    const auto respBody = nhope::readAll(*ctx.response.body).get();
+    const auto json = nlohmann::json::parse(respBody.begin(), respBody.end());
+    EXPECT_TRUE(json.empty());
+}
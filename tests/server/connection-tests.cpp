@@ -1,4 +1,5 @@
 #include <chrono>
+#include <memory>
 
 #include "gtest/gtest.h"
 #include <string>
@@ -10,6 +11,7 @@
 #include "nhope/io/null-device.h"
 
 #include "royalbed/server/detail/connection.h"
+#include "royalbed/server/detail/timer-wheel.h"
 #include "royalbed/server/router.h"
 
 #include "helpers/logger.h"
@@ -120,6 +122,26 @@ TEST(Connection, Cancel)   // NOLINT
     EXPECT_TRUE(ctx.wait(1s));
 }
 
+TEST(Connection, IdleTimeout)   // NOLINT
+{
+    TestConnectionCtx ctx{Router()};
+
+    auto executor = nhope::ThreadExecutor();
+    auto aoCtx = nhope::AOContext(executor);
+    openConnection(aoCtx, ConnectionParams{
+                            .num = etalonConnectionNum,
+                            .keepAlive = {},
+                            .ctx = ctx,
+                            .log = nullLogger(),
+                            .sock = SlowSock::create(aoCtx),
+                            .timers = std::make_shared<TimerWheel>(aoCtx, 10ms),
+                            .timeouts = {.idle = 100ms},
+                          });
+
+    EXPECT_FALSE(ctx.wait(50ms));
+    EXPECT_TRUE(ctx.wait(1s));
+}
+
 TEST(Connection, KeepAlive)   // NOLINT
 {
     TestConnectionCtx ctx{Router()};
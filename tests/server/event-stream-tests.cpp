@@ -0,0 +1,155 @@
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "nhope/async/ao-context.h"
+#include "nhope/async/future.h"
+#include "nhope/async/thread-executor.h"
+#include "nhope/io/io-device.h"
+
+#include "royalbed/server/event-stream.h"
+#include "royalbed/server/request-context.h"
+#include "royalbed/server/router.h"
+
+namespace {
+
+using namespace std::literals;
+using namespace royalbed::server;
+
+std::string readAllEvents(RequestContext& ctx)
+{
+    const auto body = nhope::readAll(*ctx.response.body).get();
+    return {body.begin(), body.end()};
+}
+
+}   // namespace
+
+TEST(EventStream, Frame)   // NOLINT
+{
+    EXPECT_EQ(*makeEventFrame({.data = "text"}), "data: text\n\n");
+    EXPECT_EQ(*makeEventFrame({.id = "1", .event = "status", .data = "line1\nline2\r\nline3"}),
+              "id: 1\nevent: status\ndata: line1\ndata: line2\ndata: line3\n\n");
+    EXPECT_EQ(*makeEventFrame({.id = "bad\nid", .data = "", .retry = 3s}), "id: badid\nretry: 3000\ndata: \n\n");
+}
+
+TEST(EventStream, Sink)   // NOLINT
+{
+    nhope::ThreadExecutor th;
+
+    Router router;
+    router.sse("/events", [](RequestContext& ctx) {
+        EventStream stream(ctx);
+        const auto sink = stream.sink();
+        EXPECT_TRUE(sink.send(Event{.id = "1", .data = "first"}));
+        EXPECT_TRUE(sink.send(Event{.id = "2", .data = "second"}));
+        sink.close();
+        EXPECT_FALSE(sink.send(Event{.data = "after close"}));
+        return stream;
+    });
+
+    RequestContext ctx{
+      .num = 1,
+      .router = router,
+      .aoCtx = nhope::AOContext(th),
+    };
+    router.route("GET", "/events").handler(ctx).get();
+
+    EXPECT_EQ(ctx.response.headers["Content-Type"], "text/event-stream");
+    EXPECT_EQ(ctx.response.chunked.minChunkSize, 0U);
+    EXPECT_EQ(readAllEvents(ctx), "id: 1\ndata: first\n\nid: 2\ndata: second\n\n");
+}
+
+TEST(EventStream, Source)   // NOLINT
+{
+    constexpr int eventCount = 3;
+    nhope::ThreadExecutor th;
+
+    Router router;
+    router.sse("/events", [](RequestContext& ctx) {
+        EventStream stream(ctx);
+        stream.setSource([i = 0]() mutable {
+            if (i == eventCount) {
+                return nhope::makeReadyFuture<std::optional<Event>>(std::nullopt);
+            }
+            ++i;
+            return nhope::makeReadyFuture<std::optional<Event>>(Event{.data = std::to_string(i)});
+        });
+        return stream;
+    });
+
+    RequestContext ctx{
+      .num = 1,
+      .router = router,
+      .aoCtx = nhope::AOContext(th),
+    };
+    router.route("GET", "/events").handler(ctx).get();
+
+    EXPECT_EQ(readAllEvents(ctx), "data: 1\n\ndata: 2\n\ndata: 3\n\n");
+}
+
+TEST(EventStream, BroadcasterResume)   // NOLINT
+{
+    nhope::ThreadExecutor th;
+    EventBroadcaster broadcaster;
+
+    Router router;
+    router.sse("/events", [&broadcaster](RequestContext& ctx) {
+        EventStream stream(ctx);
+        broadcaster.subscribe(stream.sink(), stream.lastEventId());
+        return stream;
+    });
+
+    broadcaster.publish({.id = "1", .data = "one"});
+    broadcaster.publish({.id = "2", .data = "two"});
+
+    Request req;
+    req.headers = {{"Last-Event-ID", "1"}};
+    RequestContext ctx{
+      .num = 1,
+      .router = router,
+      .request = std::move(req),
+      .aoCtx = nhope::AOContext(th),
+    };
+    router.route("GET", "/events").handler(ctx).get();
+    EXPECT_EQ(broadcaster.subscriberCount(), 1U);
+
+    broadcaster.publish({.id = "3", .data = "three"});
+
+    // Closing the response body means that the client has gone
+    auto body = std::move(ctx.response.body);
+    std::array<std::uint8_t, 1024> buf{};
+    const auto n = nhope::read(*body, buf).get();
+    EXPECT_EQ(std::string(buf.begin(), buf.begin() + static_cast<long>(n)),
+              "id: 2\ndata: two\n\nid: 3\ndata: three\n\n");
+
+    body.reset();
+    broadcaster.publish({.id = "4", .data = "four"});
+    EXPECT_EQ(broadcaster.subscriberCount(), 0U);
+}
+
+TEST(EventStream, SlowSubscriber)   // NOLINT
+{
+    nhope::ThreadExecutor th;
+    Router router;
+    RequestContext ctx{
+      .num = 1,
+      .router = router,
+      .aoCtx = nhope::AOContext(th),
+    };
+
+    EventStream stream(ctx, {.maxQueuedBytes = 64});
+    const auto sink = stream.sink();
+    EXPECT_TRUE(sink.send(Event{.data = "0123456789"}));
+    EXPECT_FALSE(sink.send(Event{.data = std::string(64, 'x')}));
+    EXPECT_FALSE(sink.isOpen());
+
+    // Queued events are still delivered before the end of the stream
+    auto body = std::move(stream).makeReader(ctx.aoCtx);
+    const auto events = nhope::readAll(*body).get();
+    EXPECT_EQ(std::string(events.begin(), events.end()), "data: 0123456789\n\n");
+}
@@ -0,0 +1,218 @@
+#include <exception>
+#include <filesystem>
+#include <memory>
+#include <string>
+#include <string_view>
+
+#include <unistd.h>
+
+#include <gtest/gtest.h>
+
+#include "nhope/async/ao-context.h"
+#include "nhope/async/future.h"
+#include "nhope/async/thread-executor.h"
+#include "nhope/io/io-device.h"
+
+#include "royalbed/server/error.h"
+#include "royalbed/server/file-cache.h"
+#include "royalbed/server/request-context.h"
+#include "royalbed/server/router.h"
+#include "royalbed/server/static-files.h"
+
+#include "helpers/logger.h"
+#include "helpers/temp-dir.h"
+
+namespace {
+
+namespace fs = std::filesystem;
+using namespace std::literals;
+using namespace royalbed::server;
+
+std::string text(const FileContent& content)
+{
+    if (content.fd < 0) {
+        return {content.data.begin(), content.data.end()};
+    }
+
+    std::string result(content.size, '\0');
+    EXPECT_EQ(::pread(content.fd, result.data(), result.size(), 0), static_cast<ssize_t>(result.size()));
+    return result;
+}
+
+struct Response
+{
+    Headers headers;
+    std::string body;
+};
+
+Response get(const Router& router, std::string_view path, const Headers& headers = {})
+{
+    nhope::ThreadExecutor th;
+    RequestContext ctx{
+      .num = 1,
+      .log = nullLogger(),
+      .router = router,
+      .aoCtx = nhope::AOContext(th),
+    };
+    ctx.request.headers = headers;
+    router.route("GET", path).handler(ctx).get();
+
+    const auto body = nhope::readAll(*ctx.response.body).get();
+    return {ctx.response.headers, std::string(body.begin(), body.end())};
+}
+
+}   // namespace
+
+TEST(FileCache, HitMiss)   // NOLINT
+{
+    const TempDir dir;
+    const auto path = dir.write("index.html", "<html></html>");
+
+    FileCache cache;
+    const auto first = cache.get(path);
+    const auto second = cache.get(path);
+    EXPECT_EQ(text(second), "<html></html>");
+    EXPECT_EQ(second.info->contentType, "text/html; charset=utf-8");
+    EXPECT_EQ(second.info->etag, first.info->etag);
+    EXPECT_EQ(second.data.data(), first.data.data());
+
+    const auto stats = cache.stats();
+    EXPECT_EQ(stats.hits, 1);
+    EXPECT_EQ(stats.misses, 1);
+    EXPECT_EQ(stats.files, 1);
+    EXPECT_EQ(stats.bytes, "<html></html>"sv.size());
+
+    EXPECT_THROW(cache.get(dir.path() / "missing.html"), HttpError);   // NOLINT
+}
+
+TEST(FileCache, Invalidation)   // NOLINT
+{
+    const TempDir dir;
+    const auto path = dir.write("app.js", "v1");
+
+    FileCache cache;
+    EXPECT_EQ(text(cache.get(path)), "v1");
+
+    // The old content stays valid while it is being sent
+    const auto old = cache.get(path);
+    (void)dir.write("app.js", "version 2");
+    EXPECT_EQ(text(cache.get(path)), "version 2");
+    EXPECT_EQ(text(old), "v1");
+    EXPECT_GE(cache.stats().invalidations, 1);
+
+    fs::remove(path);
+    EXPECT_THROW(cache.get(path), HttpError);   // NOLINT
+}
+
+TEST(FileCache, Admission)   // NOLINT
+{
+    const TempDir dir;
+    const auto medium = dir.write("medium.bin", std::string(100, 'm'));
+    const auto large = dir.write("large.bin", std::string(1000, 'l'));
+
+    FileCache cache({.maxBytes = 10000, .smallFileSize = 10, .maxFileSize = 500});
+
+    // A medium file is cached on the second request
+    EXPECT_EQ(text(cache.get(medium)), std::string(100, 'm'));
+    EXPECT_EQ(cache.stats().files, 0);
+    (void)cache.get(medium);
+    EXPECT_EQ(cache.stats().files, 1);
+
+    // A large file is never cached, it is read while the response is sent
+    for (int i = 0; i < 3; ++i) {
+        const auto content = cache.get(large);
+        EXPECT_TRUE(content.data.empty());
+        EXPECT_EQ(text(content), std::string(1000, 'l'));
+    }
+    EXPECT_EQ(cache.stats().files, 1);
+    EXPECT_EQ(cache.stats().bytes, 100);
+}
+
+TEST(FileCache, Eviction)   // NOLINT
+{
+    const TempDir dir;
+    const auto a = dir.write("a.txt", std::string(40, 'a'));
+    const auto b = dir.write("b.txt", std::string(40, 'b'));
+    const auto c = dir.write("c.txt", std::string(40, 'c'));
+
+    FileCache cache({.maxBytes = 100, .smallFileSize = 100, .maxFileSize = 100});
+    (void)cache.get(a);
+    (void)cache.get(b);
+    (void)cache.get(a);
+    (void)cache.get(c);   // evicts b, the least recently used
+
+    auto stats = cache.stats();
+    EXPECT_EQ(stats.evictions, 1);
+    EXPECT_EQ(stats.bytes, 80);
+
+    (void)cache.get(a);
+    stats = cache.stats();
+    EXPECT_EQ(stats.hits, 2);
+
+    cache.clear();
+    EXPECT_EQ(cache.stats().files, 0);
+    EXPECT_EQ(cache.stats().bytes, 0);
+}
+
+TEST(StaticFiles, Directory)   // NOLINT
+{
+    const TempDir dir;
+    (void)dir.write("index.html", "<html></html>");
+    (void)dir.write("js/app.js", "plain");
+    (void)dir.write("js/app.js.gz", "compressed");
+    (void)dir.write("js/lib.js.gz", "only compressed");
+
+    const auto cache = std::make_shared<FileCache>();
+    const auto router = staticFiles(dir.path(), cache);
+
+    const auto index = get(router, "/index.html");
+    EXPECT_EQ(index.body, "<html></html>");
+    EXPECT_EQ(index.headers.at("Content-Type"), "text/html; charset=utf-8");
+    EXPECT_TRUE(index.headers.contains("ETag"));
+
+    const auto plain = get(router, "/js/app.js");
+    EXPECT_EQ(plain.body, "plain");
+    EXPECT_EQ(plain.headers.at("Vary"), "Accept-Encoding");
+    EXPECT_FALSE(plain.headers.contains("Content-Encoding"));
+
+    const auto gzip = get(router, "/js/app.js", {{"Accept-Encoding", "br, gzip;q=0.8"}});
+    EXPECT_EQ(gzip.body, "compressed");
+    EXPECT_EQ(gzip.headers.at("Content-Encoding"), "gzip");
+    EXPECT_EQ(gzip.headers.at("Content-Type"), "application/javascript; charset=utf-8");
+
+    const auto refused = get(router, "/js/app.js", {{"Accept-Encoding", "gzip;q=0"}});
+    EXPECT_EQ(refused.body, "plain");
+
+    const auto onlyGzip = get(router, "/js/lib.js");
+    EXPECT_EQ(onlyGzip.body, "only compressed");
+    EXPECT_EQ(onlyGzip.headers.at("Content-Encoding"), "gzip");
+
+    EXPECT_EQ(cache->stats().files, 4);
+}
+
+TEST(StaticFiles, Uncached)   // NOLINT
+{
+    const TempDir dir;
+    const auto content = std::string(100 * 1024, 'v');
+    const auto path = dir.write("video.bin", content);
+
+    const auto router = staticFiles(dir.path());
+    EXPECT_EQ(get(router, "/video.bin").body, content);
+
+    const auto range = get(router, "/video.bin", {{"Range", "bytes=10-19"}});
+    EXPECT_EQ(range.body, std::string(10, 'v'));
+    EXPECT_EQ(range.headers.at("Content-Range"), "bytes 10-19/102400");
+
+    // A file truncated after the headers fails the response instead of crashing the server
+    nhope::ThreadExecutor th;
+    RequestContext ctx{
+      .num = 1,
+      .log = nullLogger(),
+      .router = router,
+      .aoCtx = nhope::AOContext(th),
+    };
+    sendContent(ctx, loadFile(path));
+    EXPECT_EQ(ctx.response.headers.at("Content-Length"), "102400");
+    fs::resize_file(path, 10);
+    EXPECT_THROW(nhope::readAll(*ctx.response.body).get(), std::exception);   // NOLINT
+}
@@ -0,0 +1,158 @@
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <gsl/span>
+#include <gtest/gtest.h>
+
+#include "royalbed/server/detail/hpack.h"
+
+namespace {
+
+using namespace std::literals;
+using namespace royalbed::server::detail;
+
+std::vector<std::uint8_t> fromHex(std::string_view hex)
+{
+    std::vector<std::uint8_t> result;
+    std::string digits;
+    for (const auto ch : hex) {
+        if (ch != ' ') {
+            digits += ch;
+        }
+    }
+    for (std::size_t i = 0; i + 1 < digits.size(); i += 2) {
+        result.push_back(static_cast<std::uint8_t>(std::stoul(digits.substr(i, 2), nullptr, 16)));
+    }
+    return result;
+}
+
+gsl::span<const std::uint8_t> asBytes(const std::string& str)
+{
+    return {reinterpret_cast<const std::uint8_t*>(str.data()), str.size()};
+}
+
+void expectHeaders(const std::vector<HpackHeader>& actual, const std::vector<HpackHeaderRef>& expected)
+{
+    ASSERT_EQ(actual.size(), expected.size());
+    for (std::size_t i = 0; i < expected.size(); ++i) {
+        EXPECT_EQ(actual[i].name, expected[i].first);
+        EXPECT_EQ(actual[i].value, expected[i].second);
+    }
+}
+
+}   // namespace
+
+TEST(Hpack, Integer)   // NOLINT
+{
+    // RFC 7541, C.1
+    std::string out;
+    hpackEncodeInteger(out, 10, 5);
+    EXPECT_EQ(out, "\x0a"s);
+
+    out.clear();
+    hpackEncodeInteger(out, 1337, 5);
+    EXPECT_EQ(out, "\x1f\x9a\x0a"s);
+}
+
+TEST(Hpack, Huffman)   // NOLINT
+{
+    // RFC 7541, C.4.1
+    const auto encoded = fromHex("f1e3 c2e5 f23a 6ba0 ab90 f4ff");
+    EXPECT_EQ(huffmanDecode(encoded), "www.example.com");
+
+    std::string out;
+    huffmanEncode(out, "www.example.com");
+    EXPECT_EQ(std::vector<std::uint8_t>(out.begin(), out.end()), encoded);
+    EXPECT_EQ(huffmanEncodedSize("www.example.com"), encoded.size());
+
+    std::string all;
+    for (int ch = 0; ch < 256; ++ch) {
+        all += static_cast<char>(ch);
+    }
+    out.clear();
+    huffmanEncode(out, all);
+    EXPECT_EQ(huffmanDecode(asBytes(out)), all);
+
+    // The padding longer than 7 bits
+    EXPECT_THROW(huffmanDecode(fromHex("f1e3 c2e5 f23a 6ba0 ab90 f4ff ff")), HpackError);   // NOLINT
+}
+
+TEST(Hpack, DecodeRequests)   // NOLINT
+{
+    // RFC 7541, C.4
+    HpackDecoder decoder;
+    expectHeaders(decoder.decode(fromHex("8286 8441 8cf1 e3c2 e5f2 3a6b a0ab 90f4 ff")).value(),
+                  {{":method", "GET"}, {":scheme", "http"}, {":path", "/"}, {":authority", "www.example.com"}});
+    expectHeaders(decoder.decode(fromHex("8286 84be 5886 a8eb 1064 9cbf")).value(),
+                  {{":method", "GET"},
+                   {":scheme", "http"},
+                   {":path", "/"},
+                   {":authority", "www.example.com"},
+                   {"cache-control", "no-cache"}});
+    expectHeaders(decoder.decode(fromHex("8287 85bf 4088 25a8 49e9 5ba9 7d7f 8925 a849 e95b b8e8 b4bf")).value(),
+                  {{":method", "GET"},
+                   {":scheme", "https"},
+                   {":path", "/index.html"},
+                   {":authority", "www.example.com"},
+                   {"custom-key", "custom-value"}});
+}
+
+TEST(Hpack, DecodeErrors)   // NOLINT
+{
+    HpackDecoder decoder;
+    EXPECT_THROW(decoder.decode(fromHex("be")), HpackError);          // NOLINT: no dynamic entry
+    EXPECT_THROW(decoder.decode(fromHex("4005 6162")), HpackError);   // NOLINT: truncated
+    EXPECT_THROW(decoder.decode(fromHex("3fe2 1f")), HpackError);     // NOLINT: size update above the limit
+}
+
+TEST(Hpack, HeaderListSize)   // NOLINT
+{
+    constexpr std::size_t maxListSize = 16 * 1024;
+    HpackDecoder decoder(hpackDefaultTableSize, maxListSize);
+
+    // A 4 KiB dynamic table entry referenced 1000 times: a 4 MiB list from a 5 KiB block
+    std::string block;
+    hpackEncodeInteger(block, 0, 6, 0x40);
+    hpackEncodeString(block, "x-bomb");
+    hpackEncodeString(block, std::string(4000, 'a'));
+    block.append(1000, static_cast<char>(0xbe));
+    EXPECT_FALSE(decoder.decode(asBytes(block)).has_value());
+
+    // The dynamic table is still in sync
+    const auto headers = decoder.decode(fromHex("be"));
+    ASSERT_TRUE(headers.has_value());
+    ASSERT_EQ(headers->size(), 1);
+    EXPECT_EQ(headers->front().name, "x-bomb");
+}
+
+TEST(Hpack, EncodeDecode)   // NOLINT
+{
+    HpackEncoder encoder;
+    HpackDecoder decoder;
+
+    const std::vector<HpackHeaderRef> headers{
+      {":status", "200"},
+      {"content-type", "application/json"},
+      {"content-length", "42"},
+      {"set-cookie", "id=1"},
+      {"x-custom", "value"},
+    };
+
+    std::string first;
+    encoder.encode(first, headers);
+    expectHeaders(decoder.decode(asBytes(first)).value(), headers);
+
+    // Repeated headers are taken from the dynamic table
+    std::string second;
+    encoder.encode(second, headers);
+    EXPECT_LT(second.size(), first.size());
+    expectHeaders(decoder.decode(asBytes(second)).value(), headers);
+
+    encoder.setMaxTableSize(0);
+    std::string third;
+    encoder.encode(third, headers);
+    EXPECT_EQ(static_cast<std::uint8_t>(third[0]), 0x20);
+    expectHeaders(decoder.decode(asBytes(third)).value(), headers);
+}
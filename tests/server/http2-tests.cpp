@@ -0,0 +1,355 @@
+#include <cstdint>
+#include <map>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <gsl/span>
+#include <gtest/gtest.h>
+
+#include "nhope/async/ao-context.h"
+#include "nhope/async/future.h"
+#include "nhope/async/thread-executor.h"
+#include "nhope/io/io-device.h"
+#include "nhope/io/string-reader.h"
+#include "nhope/io/string-writter.h"
+
+#include "royalbed/server/detail/connection.h"
+#include "royalbed/server/detail/hpack.h"
+#include "royalbed/server/detail/http2-connection.h"
+#include "royalbed/server/detail/http2-frame.h"
+#include "royalbed/server/http-status.h"
+#include "royalbed/server/request-context.h"
+#include "royalbed/server/router.h"
+
+#include "helpers/logger.h"
+
+namespace {
+
+using namespace std::literals;
+using namespace royalbed::server;
+using namespace royalbed::server::detail;
+
+class TestConnectionCtx final : public ConnectionCtx
+{
+public:
+    explicit TestConnectionCtx(Router&& router)
+      : m_router(std::move(router))
+    {}
+
+    [[nodiscard]] const Router& router() const noexcept override
+    {
+        return m_router;
+    }
+
+    SessionAttr startSession(std::uint32_t /*connectionNum*/) override
+    {
+        ++m_startedSessions;
+        return {
+          .num = m_startedSessions,
+          .log = nullLogger(),
+        };
+    }
+
+    void sessionFinished(std::uint32_t /*sessionNum*/) override
+    {
+        ++m_finishedSessions;
+    }
+
+    void connectionClosed(std::uint32_t /*connectionNum*/) override
+    {}
+
+    std::uint32_t m_startedSessions = 0;
+    std::uint32_t m_finishedSessions = 0;
+
+private:
+    Router m_router;
+};
+
+gsl::span<const std::uint8_t> asBytes(std::string_view str)
+{
+    return {reinterpret_cast<const std::uint8_t*>(str.data()), str.size()};
+}
+
+std::string frame(Http2FrameType type, std::uint8_t flags, std::uint32_t streamId, std::string_view payload = {})
+{
+    std::string result;
+    appendHttp2FrameHeader(result, {
+                                     .length = static_cast<std::uint32_t>(payload.size()),
+                                     .type = type,
+                                     .flags = flags,
+                                     .streamId = streamId,
+                                   });
+    result += payload;
+    return result;
+}
+
+struct Frame
+{
+    Http2FrameHeader header;
+    std::string payload;
+};
+
+std::vector<Frame> parseFrames(std::string_view data)
+{
+    std::vector<Frame> frames;
+    while (data.size() >= http2FrameHeaderSize) {
+        const auto header = parseHttp2FrameHeader(asBytes(data));
+        frames.push_back({header, std::string(data.substr(http2FrameHeaderSize, header.length))});
+        data.remove_prefix(http2FrameHeaderSize + header.length);
+    }
+    EXPECT_TRUE(data.empty());
+    return frames;
+}
+
+struct StreamResult
+{
+    std::map<std::string, std::string> headers;
+    std::string data;
+    bool ended = false;
+};
+
+std::map<std::uint32_t, StreamResult> parseResponses(const std::vector<Frame>& frames)
+{
+    HpackDecoder decoder;
+    std::map<std::uint32_t, StreamResult> streams;
+    for (const auto& [header, payload] : frames) {
+        auto& stream = streams[header.streamId];
+        if (header.type == Http2FrameType::Headers) {
+            const auto fields = decoder.decode(asBytes(payload)).value();
+            for (const auto& field : fields) {
+                stream.headers[field.name] = field.value;
+            }
+        } else if (header.type == Http2FrameType::Data) {
+            stream.data += payload;
+        } else {
+            continue;
+        }
+        stream.ended = stream.ended || (header.flags & http2Flags::endStream) != 0;
+    }
+    return streams;
+}
+
+std::string serve(TestConnectionCtx& connCtx, const std::string& input, KeepAliveParams keepAlive = {},
+                  Http2Params http2 = {})
+{
+    nhope::ThreadExecutor th;
+    nhope::AOContext aoCtx(th);
+
+    auto in = nhope::StringReader::create(aoCtx, input);
+    auto out = nhope::StringWritter::create(aoCtx);
+    nhope::makeReadyFuture()
+      .then(aoCtx,
+            [&] {
+                return serveHttp2(aoCtx, {
+                                           .num = 1,
+                                           .ctx = connCtx,
+                                           .log = nullLogger(),
+                                           .http2 = http2,
+                                           .in = *in,
+                                           .out = *out,
+                                           .upgradeRequest{},
+                                           .upgradeSettings{},
+                                           .keepAlive = keepAlive,
+                                         });
+            })
+      .get();
+
+    return out->takeContent();
+}
+
+}   // namespace
+
+TEST(Http2, Preface)   // NOLINT
+{
+    EXPECT_TRUE(startsWithHttp2Preface(asBytes(http2Preface)));
+    EXPECT_TRUE(startsWithHttp2Preface(asBytes("PRI * HTTP")));
+    EXPECT_FALSE(startsWithHttp2Preface(asBytes("PR")));
+    EXPECT_FALSE(startsWithHttp2Preface(asBytes("GET / HTTP/1.1\r\n")));
+}
+
+TEST(Http2, UpgradeSettings)   // NOLINT
+{
+    Request request;
+    request.method = "GET";
+    request.headers = {
+      {"Connection", "Upgrade, HTTP2-Settings"},
+      {"Upgrade", "h2c"},
+      {"HTTP2-Settings", "AAMAAABk"},   // SETTINGS_MAX_CONCURRENT_STREAMS = 100
+    };
+    EXPECT_EQ(h2cUpgradeSettings(request), "\x00\x03\x00\x00\x00\x64"s);
+
+    request.headers["Content-Length"] = "10";
+    EXPECT_FALSE(h2cUpgradeSettings(request).has_value());
+
+    request.headers.erase("Content-Length");
+    request.headers["HTTP2-Settings"] = "AAMAAA";   // incomplete
+    EXPECT_FALSE(h2cUpgradeSettings(request).has_value());
+
+    request.headers["Upgrade"] = "websocket";
+    EXPECT_FALSE(h2cUpgradeSettings(request).has_value());
+}
+
+TEST(Http2, Requests)   // NOLINT
+{
+    Router router;
+    router.get("/hello", [](RequestContext& ctx) {
+        EXPECT_EQ(ctx.request.headers["Host"], "example.com");
+        ctx.response.status = HttpStatus::Ok;
+        ctx.response.headers["Content-Type"] = "text/plain";
+        ctx.response.body = nhope::StringReader::create(ctx.aoCtx, "Hello");
+    });
+    router.post("/echo", [](RequestContext& ctx) {
+        return nhope::readAll(*ctx.request.body).then(ctx.aoCtx, [&ctx](auto body) {
+            ctx.response.status = HttpStatus::Ok;
+            ctx.response.body = nhope::StringReader::create(ctx.aoCtx, std::string(body.begin(), body.end()));
+        });
+    });
+    TestConnectionCtx connCtx(std::move(router));
+
+    HpackEncoder encoder;
+    std::string getHeaders;
+    encoder.encode(getHeaders,
+                   {{":method", "GET"}, {":scheme", "http"}, {":path", "/hello"}, {":authority", "example.com"}});
+    std::string postHeaders;
+    encoder.encode(postHeaders,
+                   {{":method", "POST"}, {":scheme", "http"}, {":path", "/echo"}, {"content-length", "5"}});
+    std::string missingHeaders;
+    encoder.encode(missingHeaders, {{":method", "GET"}, {":scheme", "http"}, {":path", "/missing"}});
+
+    const auto endHeaders = http2Flags::endHeaders;
+    const auto endStream = http2Flags::endStream;
+    const auto input = std::string(http2Preface) + encodeHttp2Settings({}) +
+                       frame(Http2FrameType::Headers, endHeaders | endStream, 1, getHeaders) +
+                       frame(Http2FrameType::Headers, endHeaders, 3, postHeaders) +
+                       frame(Http2FrameType::Data, 0, 3, "hel") +
+                       frame(Http2FrameType::Headers, endHeaders | endStream, 5, missingHeaders) +
+                       frame(Http2FrameType::Data, endStream, 3, "lo");
+
+    const auto frames = parseFrames(serve(connCtx, input));
+    ASSERT_FALSE(frames.empty());
+    EXPECT_EQ(frames[0].header.type, Http2FrameType::Settings);
+
+    auto responses = parseResponses(frames);
+    EXPECT_EQ(responses[1].headers[":status"], "200");
+    EXPECT_EQ(responses[1].headers["content-type"], "text/plain");
+    EXPECT_TRUE(responses[1].headers.contains("date"));
+    EXPECT_EQ(responses[1].data, "Hello");
+    EXPECT_TRUE(responses[1].ended);
+
+    EXPECT_EQ(responses[3].headers[":status"], "200");
+    EXPECT_EQ(responses[3].data, "hello");
+    EXPECT_TRUE(responses[3].ended);
+
+    EXPECT_EQ(responses[5].headers[":status"], "404");
+    EXPECT_TRUE(responses[5].ended);
+
+    EXPECT_EQ(connCtx.m_startedSessions, 3U);
+    EXPECT_EQ(connCtx.m_finishedSessions, 3U);
+}
+
+TEST(Http2, ProtocolError)   // NOLINT
+{
+    TestConnectionCtx connCtx(Router{});
+
+    HpackEncoder encoder;
+    std::string headers;
+    encoder.encode(headers, {{":method", "GET"}, {":scheme", "http"}, {":path", "/"}});
+
+    // The first frame of the client must be SETTINGS
+    const auto input = std::string(http2Preface) + frame(Http2FrameType::Headers, http2Flags::endHeaders, 1, headers);
+
+    const auto frames = parseFrames(serve(connCtx, input));
+    ASSERT_FALSE(frames.empty());
+    const auto& goAway = frames.back();
+    EXPECT_EQ(goAway.header.type, Http2FrameType::GoAway);
+    EXPECT_EQ(readHttp2Uint32(asBytes(goAway.payload).subspan(4)),
+              static_cast<std::uint32_t>(Http2ErrorCode::ProtocolError));
+    EXPECT_EQ(connCtx.m_startedSessions, 0U);
+}
+
+TEST(Http2, HeaderListBomb)   // NOLINT
+{
+    TestConnectionCtx connCtx(Router{});
+
+    HpackEncoder encoder;
+    std::string bomb;
+    encoder.encode(bomb, {{":method", "GET"}, {":scheme", "http"}, {":path", "/"}});
+
+    // A 4 KiB dynamic table entry and a few hundred indexed references to it
+    hpackEncodeInteger(bomb, 0, 6, 0x40);
+    hpackEncodeString(bomb, "x-bomb");
+    hpackEncodeString(bomb, std::string(4000, 'a'));
+    bomb.append(500, static_cast<char>(0xbe));
+
+    std::string headers;
+    encoder.encode(headers, {{":method", "GET"}, {":scheme", "http"}, {":path", "/missing"}});
+
+    const auto flags = http2Flags::endHeaders | http2Flags::endStream;
+    const auto input = std::string(http2Preface) + encodeHttp2Settings({}) +
+                       frame(Http2FrameType::Headers, flags, 1, bomb) +
+                       frame(Http2FrameType::Headers, flags, 3, headers);
+
+    auto responses = parseResponses(parseFrames(serve(connCtx, input)));
+    EXPECT_EQ(responses[1].headers[":status"], "431");
+    EXPECT_EQ(responses[3].headers[":status"], "404");
+}
+
+TEST(Http2, StreamsLimit)   // NOLINT
+{
+    TestConnectionCtx connCtx(Router{});
+
+    HpackEncoder encoder;
+    std::string headers;
+    encoder.encode(headers, {{":method", "GET"}, {":scheme", "http"}, {":path", "/missing"}});
+
+    const auto flags = http2Flags::endHeaders | http2Flags::endStream;
+    const auto input = std::string(http2Preface) + encodeHttp2Settings({}) +
+                       frame(Http2FrameType::Headers, flags, 1, headers) +
+                       frame(Http2FrameType::Headers, flags, 3, headers);
+
+    const auto frames = parseFrames(serve(connCtx, input, {.requestsCount = 1}));
+
+    // The stream after the limit is refused, the connection is closed gracefully
+    const auto code = [](const std::string& payload, std::size_t offset) {
+        return static_cast<Http2ErrorCode>(readHttp2Uint32(asBytes(payload).subspan(offset)));
+    };
+    bool refused = false;
+    bool goAway = false;
+    for (const auto& [header, payload] : frames) {
+        if (header.type == Http2FrameType::RstStream && header.streamId == 3) {
+            refused = code(payload, 0) == Http2ErrorCode::RefusedStream;
+        }
+        if (header.type == Http2FrameType::GoAway) {
+            goAway = readHttp2Uint32(asBytes(payload)) == 1 && code(payload, 4) == Http2ErrorCode::NoError;
+        }
+    }
+    EXPECT_TRUE(refused);
+    EXPECT_TRUE(goAway);
+    EXPECT_EQ(parseResponses(frames)[1].headers[":status"], "404");
+    EXPECT_EQ(connCtx.m_startedSessions, 1U);
+}
+
+TEST(Http2, RapidReset)   // NOLINT
+{
+    TestConnectionCtx connCtx(Router{});
+
+    HpackEncoder encoder;
+    std::string headers;
+    encoder.encode(headers, {{":method", "POST"}, {":scheme", "http"}, {":path", "/missing"}});
+
+    // The streams are opened and cancelled at once
+    auto input = std::string(http2Preface) + encodeHttp2Settings({});
+    for (std::uint32_t id = 1; id < 10; id += 2) {
+        input += frame(Http2FrameType::Headers, http2Flags::endHeaders, id, headers);
+        input += encodeHttp2RstStream(id, Http2ErrorCode::Cancel);
+    }
+
+    const auto frames = parseFrames(serve(connCtx, input, {}, {.maxStreamResets = 2}));
+    ASSERT_FALSE(frames.empty());
+    const auto& goAway = frames.back();
+    EXPECT_EQ(goAway.header.type, Http2FrameType::GoAway);
+    EXPECT_EQ(readHttp2Uint32(asBytes(goAway.payload).subspan(4)),
+              static_cast<std::uint32_t>(Http2ErrorCode::EnhanceYourCalm));
+    EXPECT_EQ(connCtx.m_startedSessions, 3U);
+}
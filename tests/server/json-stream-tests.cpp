@@ -0,0 +1,137 @@
+#include <optional>
+#include <string>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "nhope/async/ao-context.h"
+#include "nhope/async/future.h"
+#include "nhope/async/thread-executor.h"
+#include "nhope/io/io-device.h"
+
+#include "nlohmann/json.hpp"
+
+#include "royalbed/server/json-stream.h"
+#include "royalbed/server/request-context.h"
+#include "royalbed/server/router.h"
+
+namespace {
+
+using namespace std::literals;
+using namespace royalbed::server;
+
+nlohmann::json callStreamHandler(Router& router)
+{
+    nhope::ThreadExecutor th;
+    RequestContext ctx{
+      .num = 1,
+      .router = router,
+      .aoCtx = nhope::AOContext(th),
+    };
+    router.route("GET", "/items").handler(ctx).get();
+
+    EXPECT_EQ(ctx.response.headers["Content-Type"], "application/json");
+    EXPECT_EQ(ctx.response.headers["Transfer-Encoding"], "chunked");
+    EXPECT_FALSE(ctx.response.headers.contains("Content-Length"));
+
+    const auto body = nhope::readAll(*ctx.response.body).get();
+    return nlohmann::json::parse(body.begin(), body.end());
+}
+
+}   // namespace
+
+TEST(JsonStream, Range)   // NOLINT
+{
+    constexpr int itemCount = 10000;
+
+    std::vector<int> items;
+    for (int i = 0; i < itemCount; ++i) {
+        items.push_back(i);
+    }
+
+    Router router;
+    router.get("/items", [items] {
+        return streamJsonArray(items);
+    });
+
+    EXPECT_EQ(callStreamHandler(router), nlohmann::json(items));
+}
+
+TEST(JsonStream, OwnedRange)   // NOLINT
+{
+    Router router;
+    router.get("/items", [] {
+        return streamJsonArray(std::vector<std::string>{"a", "b", "c"});
+    });
+
+    EXPECT_EQ(callStreamHandler(router), nlohmann::json({"a", "b", "c"}));
+}
+
+TEST(JsonStream, EmptyRange)   // NOLINT
+{
+    Router router;
+    router.get("/items", [] {
+        return streamJsonArray(std::vector<int>{});
+    });
+
+    EXPECT_EQ(callStreamHandler(router), nlohmann::json::array());
+}
+
+TEST(JsonStream, Generator)   // NOLINT
+{
+    constexpr int itemCount = 5000;
+
+    Router router;
+    router.get("/items", [] {
+        return streamJsonArray([i = 0]() mutable -> std::optional<int> {
+            if (i == itemCount) {
+                return std::nullopt;
+            }
+            return i++;
+        });
+    });
+
+    const auto json = callStreamHandler(router);
+    ASSERT_EQ(json.size(), itemCount);
+    for (int i = 0; i < itemCount; ++i) {
+        EXPECT_EQ(json[i], i);
+    }
+}
+
+TEST(JsonStream, AsyncProducer)   // NOLINT
+{
+    constexpr int batchCount = 3;
+
+    Router router;
+    router.get("/items", [] {
+        return nhope::makeReadyFuture<JsonArrayStream>(streamJsonArray([batch = 0]() mutable {
+            if (batch == batchCount) {
+                return nhope::makeReadyFuture<std::vector<int>>();
+            }
+            ++batch;
+            return nhope::makeReadyFuture<std::vector<int>>(std::vector<int>{batch, batch});
+        }));
+    });
+
+    EXPECT_EQ(callStreamHandler(router), nlohmann::json({1, 1, 2, 2, 3, 3}));
+}
+
+TEST(JsonStream, ProducerError)   // NOLINT
+{
+    Router router;
+    router.get("/items", [] {
+        return streamJsonArray([]() -> std::optional<int> {
+            throw std::runtime_error("producer failed");
+        });
+    });
+
+    nhope::ThreadExecutor th;
+    RequestContext ctx{
+      .num = 1,
+      .router = router,
+      .aoCtx = nhope::AOContext(th),
+    };
+    router.route("GET", "/items").handler(ctx).get();
+
+    EXPECT_THROW(nhope::readAll(*ctx.response.body).get(), std::runtime_error);   // NOLINT
+}
@@ -0,0 +1,217 @@
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <memory>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "nhope/async/ao-context.h"
+#include "nhope/async/future.h"
+#include "nhope/async/thread-executor.h"
+#include "nhope/io/io-device.h"
+#include "nhope/io/string-reader.h"
+
+#include "nlohmann/json.hpp"
+
+#include "royalbed/server/error.h"
+#include "royalbed/server/multipart.h"
+#include "royalbed/server/request-context.h"
+#include "royalbed/server/router.h"
+
+namespace {
+
+using namespace std::literals;
+using namespace royalbed::server;
+
+constexpr auto contentType = "multipart/form-data; boundary=\"----boundary\""sv;
+
+std::string makeBody(const std::string& fileContent)
+{
+    return "preamble\r\n"
+           "------boundary\r\n"
+           "Content-Disposition: form-data; name=\"title\"\r\n"
+           "\r\n"
+           "report\r\n"
+           "------boundary\r\n"
+           "Content-Disposition: form-data; name=\"file\"; filename=\"report.txt\"\r\n"
+           "Content-Type: text/plain\r\n"
+           "\r\n" +
+           fileContent +
+           "\r\n"
+           "------boundary--\r\n";
+}
+
+Request makeRequest(nhope::AOContext& aoCtx, std::string body)
+{
+    Request req;
+    req.headers["Content-Type"] = std::string(contentType);
+    req.body = nhope::StringReader::create(aoCtx, std::move(body));
+    return req;
+}
+
+}   // namespace
+
+TEST(Multipart, Next)   // NOLINT
+{
+    // The file content contains a prefix of the delimiter
+    const auto fileContent = "line 1\r\n------bound\r\nline 2"s;
+
+    nhope::ThreadExecutor th;
+
+    Router router;
+    std::vector<std::string> names;
+    std::optional<std::string> fileName;
+    std::string content;
+    router.post("/upload", [&](MultipartBody body) {
+        return body.next()
+          .then([&names, body](std::optional<MultipartPart> part) {
+              names.push_back(part->name());
+              // The rest of the part is skipped
+              return body.next();
+          })
+          .then([&](std::optional<MultipartPart> part) {
+              names.push_back(part->name());
+              fileName = part->fileName();
+              return nhope::readAll(part->body()).then([&content, part](const std::vector<std::uint8_t>& data) {
+                  content.assign(data.begin(), data.end());
+              });
+          })
+          .then([body] {
+              return body.next();
+          })
+          .then([](std::optional<MultipartPart> part) {
+              return part.has_value();
+          });
+    });
+
+    nhope::AOContext aoCtx(th);
+    RequestContext ctx{
+      .num = 1,
+      .router = router,
+      .request = makeRequest(aoCtx, makeBody(fileContent)),
+      .aoCtx = nhope::AOContext(th),
+    };
+    router.route("POST", "/upload").handler(ctx).get();
+
+    const auto respBody = nhope::readAll(*ctx.response.body).get();
+    EXPECT_FALSE(nlohmann::json::parse(respBody.begin(), respBody.end()).get<bool>());
+    EXPECT_EQ(names, (std::vector<std::string>{"title", "file"}));
+    EXPECT_EQ(fileName, "report.txt");
+    EXPECT_EQ(content, fileContent);
+}
+
+TEST(Multipart, ReadForm)   // NOLINT
+{
+    const auto fileContent = std::string(100 * 1024, 'x');
+
+    nhope::ThreadExecutor th;
+
+    Router router;
+    std::vector<FormField> fields;
+    router.post("/upload", [&fields](RequestContext& ctx) {
+        const auto body = MultipartBody(ctx, MultipartOptions{.spoolThreshold = 1024});
+        return body.readForm().then([&fields](std::vector<FormField> form) {
+            fields = std::move(form);
+        });
+    });
+
+    nhope::AOContext aoCtx(th);
+    RequestContext ctx{
+      .num = 1,
+      .router = router,
+      .request = makeRequest(aoCtx, makeBody(fileContent)),
+      .aoCtx = nhope::AOContext(th),
+    };
+    router.route("POST", "/upload").handler(ctx).get();
+
+    // The epilogue after the close delimiter is read as well
+    EXPECT_TRUE(nhope::readAll(*ctx.request.body).get().empty());
+
+    ASSERT_EQ(fields.size(), 2);
+    EXPECT_EQ(fields[0].name, "title");
+    EXPECT_EQ(fields[0].value, "report");
+    EXPECT_EQ(fields[0].file, nullptr);
+
+    EXPECT_EQ(fields[1].fileName, "report.txt");
+    EXPECT_EQ(fields[1].headers.at("Content-Type"), "text/plain");
+    EXPECT_TRUE(fields[1].value.empty());
+    ASSERT_NE(fields[1].file, nullptr);
+
+    const auto filePath = *fields[1].file;
+    {
+        std::ifstream file(filePath, std::ios::binary);
+        EXPECT_EQ(std::string(std::istreambuf_iterator<char>(file), {}), fileContent);
+    }
+
+    // The spool file is removed together with the field
+    fields.clear();
+    EXPECT_FALSE(std::filesystem::exists(filePath));
+}
+
+TEST(Multipart, ReadForm_MemoryLimit)   // NOLINT
+{
+    nhope::ThreadExecutor th;
+
+    Router router;
+    std::vector<FormField> fields;
+    router.post("/upload", [&fields](RequestContext& ctx) {
+        const auto body = MultipartBody(ctx, MultipartOptions{.spoolThreshold = 1024, .maxFormMemorySize = 8});
+        return body.readForm().then([&fields](std::vector<FormField> form) {
+            fields = std::move(form);
+        });
+    });
+
+    nhope::AOContext aoCtx(th);
+    RequestContext ctx{
+      .num = 1,
+      .router = router,
+      .request = makeRequest(aoCtx, makeBody("small file")),
+      .aoCtx = nhope::AOContext(th),
+    };
+    router.route("POST", "/upload").handler(ctx).get();
+
+    // Both parts are under the threshold, the second one does not fit in the memory left after the first
+    ASSERT_EQ(fields.size(), 2);
+    EXPECT_EQ(fields[0].value, "report");
+    EXPECT_EQ(fields[0].file, nullptr);
+
+    EXPECT_TRUE(fields[1].value.empty());
+    ASSERT_NE(fields[1].file, nullptr);
+    std::ifstream file(*fields[1].file, std::ios::binary);
+    EXPECT_EQ(std::string(std::istreambuf_iterator<char>(file), {}), "small file");
+}
+
+TEST(Multipart, Invalid)   // NOLINT
+{
+    nhope::ThreadExecutor th;
+
+    Router router;
+    router.post("/upload", [](MultipartBody body) {
+        return body.readForm().then([](const std::vector<FormField>& form) {
+            return form.size();
+        });
+    });
+
+    nhope::AOContext aoCtx(th);
+    RequestContext truncated{
+      .num = 1,
+      .router = router,
+      .request = makeRequest(aoCtx, "------boundary\r\n\r\nunterminated"),
+      .aoCtx = nhope::AOContext(th),
+    };
+    EXPECT_THROW(router.route("POST", "/upload").handler(truncated).get(), HttpError);   // NOLINT
+
+    RequestContext notMultipart{
+      .num = 2,
+      .router = router,
+      .request = makeRequest(aoCtx, "{}"),
+      .aoCtx = nhope::AOContext(th),
+    };
+    notMultipart.request.headers["Content-Type"] = "application/json";
+    EXPECT_THROW(router.route("POST", "/upload").handler(notMultipart).get(), HttpError);   // NOLINT
+}
@@ -1,3 +1,6 @@
+#include <string>
+#include <utility>
+
 #include <gtest/gtest.h>
 
 #include "nhope/async/ao-context-error.h"
@@ -7,10 +10,12 @@
 #include "nhope/async/thread-executor.h"
 #include "nhope/async/thread-pool-executor.h"
 #include "nhope/io/io-device.h"
-#include "nhope/io/pushback-reader.h"
 #include "nhope/io/string-reader.h"
 
+#include "royalbed/common/detail/connection-buffer.h"
 #include "royalbed/server/error.h"
+#include "royalbed/server/http-status.h"
+#include "royalbed/server/request-limits.h"
 #include "royalbed/server/detail/receive-request.h"
 
 #include "helpers/bytes.h"
@@ -21,6 +26,7 @@ namespace {
 using namespace std::literals;
 using namespace royalbed::server;
 using namespace royalbed::server::detail;
+using royalbed::common::detail::ConnectionBuffer;
 
 }   // namespace
 
@@ -31,7 +37,7 @@ TEST(ReceiveRequest, OnlyMethodLine)   // NOLINT
     nhope::ThreadExecutor executor;
     nhope::AOContext aoCtx(executor);
 
-    auto conn = nhope::PushbackReader::create(aoCtx, nhope::StringReader::create(aoCtx, rawRequest));
+    auto conn = ConnectionBuffer::create(aoCtx, nhope::StringReader::create(aoCtx, rawRequest));
     receiveRequest(aoCtx, *conn)
       .then(aoCtx,
             [](auto req) {
@@ -57,7 +63,7 @@ TEST(ReceiveRequest, OnlyHeaders)   // NOLINT
     nhope::ThreadExecutor executor;
     nhope::AOContext aoCtx(executor);
 
-    auto conn = nhope::PushbackReader::create(aoCtx, nhope::StringReader::create(aoCtx, rawRequest));
+    auto conn = ConnectionBuffer::create(aoCtx, nhope::StringReader::create(aoCtx, rawRequest));
     receiveRequest(aoCtx, *conn)
       .then([](auto req) {
           EXPECT_EQ(req.method, "GET");
@@ -85,7 +91,7 @@ TEST(ReceiveRequest, BodyReader)   // NOLINT
     nhope::ThreadExecutor executor;
     nhope::AOContext aoCtx(executor);
 
-    auto conn = nhope::PushbackReader::create(aoCtx, nhope::StringReader::create(aoCtx, rawRequest));
+    auto conn = ConnectionBuffer::create(aoCtx, nhope::StringReader::create(aoCtx, rawRequest));
     receiveRequest(aoCtx, *conn)
       .then([](auto req) {
           EXPECT_EQ(req.method, "GET");
@@ -102,26 +108,103 @@ TEST(ReceiveRequest, BodyReader)   // NOLINT
       .get();
 }
 
+TEST(ReceiveRequest, BodyReader_EmptyBuffer)   // NOLINT
+{
+    constexpr auto rawRequest = "POST /path HTTP/1.1\r\n"
+                                "Content-Length: 4\r\n"
+                                "\r\n"
+                                "body";
+
+    nhope::ThreadExecutor executor;
+    nhope::AOContext aoCtx(executor);
+
+    auto conn = ConnectionBuffer::create(aoCtx, nhope::StringReader::create(aoCtx, rawRequest));
+    auto req = receiveRequest(aoCtx, *conn).get();
+
+    // Nothing is read into an empty buffer, the body is still there
+    EXPECT_EQ(nhope::read(*req.body, gsl::span<std::uint8_t>()).get(), 0);
+    EXPECT_EQ(asString(nhope::readAll(*req.body).get()), "body");
+}
+
+TEST(ReceiveRequest, ChunkedBody)   // NOLINT
+{
+    nhope::ThreadExecutor executor;
+    nhope::AOContext aoCtx(executor);
+
+    auto conn = ConnectionBuffer::create(   //
+      aoCtx,                                     //
+      nhope::StringReader::create(aoCtx, "POST /first HTTP/1.1\r\n"
+                                         "Transfer-Encoding: chunked\r\n"
+                                         "\r\n"
+                                         "6\r\nfirst-\r\n4\r\nbody\r\n0\r\n\r\n"
+                                         "GET /second HTTP/1.1\r\n"
+                                         "\r\n"));
+
+    receiveRequest(aoCtx, *conn)
+      .then([](auto req) {
+          return nhope::readAll(std::move(req.body));
+      })
+      .then([&](auto content) {
+          EXPECT_EQ(asString(content), "first-body");
+
+          return receiveRequest(aoCtx, *conn).then([](auto req) {
+              EXPECT_EQ(req.uri.toString(), "/second");
+              return nhope::readAll(std::move(req.body));
+          });
+      })
+      .then([](auto content) {
+          // A request without Content-Length has no body, nothing is read from the connection
+          EXPECT_TRUE(content.empty());
+      })
+      .get();
+}
+
 TEST(ReceiveRequest, BadRequest)   // NOLINT
 {
     constexpr auto badRequest = "GET /path Invalid HTTP/1.1\r\n";
 
     nhope::ThreadExecutor executor;
     nhope::AOContext aoCtx(executor);
-    auto conn = nhope::PushbackReader::create(aoCtx, nhope::StringReader::create(aoCtx, badRequest));
+    auto conn = ConnectionBuffer::create(aoCtx, nhope::StringReader::create(aoCtx, badRequest));
 
     auto future = receiveRequest(aoCtx, *conn);
 
     EXPECT_THROW(future.get(), HttpError);   // NOLINT
 }
 
+TEST(ReceiveRequest, Limits)   // NOLINT
+{
+    const auto requestStatus = [](std::string request, const RequestLimits& limits) {
+        nhope::ThreadExecutor executor;
+        nhope::AOContext aoCtx(executor);
+        auto conn = ConnectionBuffer::create(aoCtx, nhope::StringReader::create(aoCtx, std::move(request)));
+        try {
+            receiveRequest(aoCtx, *conn, limits).get();
+            return 0;
+        } catch (const HttpError& e) {
+            return e.httpStatus();
+        }
+    };
+
+    const auto request = "GET /0123456789 HTTP/1.1\r\nHost: localhost\r\nAccept: */*\r\n\r\n"s;
+
+    EXPECT_EQ(requestStatus(request, {}), 0);
+    EXPECT_EQ(requestStatus(request, {.maxUriSize = 10}), HttpStatus::RequestUriTooLong);
+    EXPECT_EQ(requestStatus(request, {.maxHeaderCount = 1}), HttpStatus::RequestHeaderFieldsTooLarge);
+    EXPECT_EQ(requestStatus(request, {.maxHeadersSize = 16}), HttpStatus::RequestHeaderFieldsTooLarge);
+
+    // The limits are checked before the request is complete
+    const auto endless = "GET / HTTP/1.1\r\nX-Long: "s + std::string(100, 'a');
+    EXPECT_EQ(requestStatus(endless, {.maxHeadersSize = 64}), HttpStatus::RequestHeaderFieldsTooLarge);
+}
+
 TEST(ReceiveRequest, IncompleteRequest)   // NOLINT
 {
     constexpr auto incompleteRequest = "GET /path HTTP/1.1\r";
 
     nhope::ThreadExecutor executor;
     nhope::AOContext aoCtx(executor);
-    auto conn = nhope::PushbackReader::create(aoCtx, nhope::StringReader::create(aoCtx, incompleteRequest));
+    auto conn = ConnectionBuffer::create(aoCtx, nhope::StringReader::create(aoCtx, incompleteRequest));
 
     auto future = receiveRequest(aoCtx, *conn);
 
@@ -133,7 +216,7 @@ TEST(ReceiveRequest, IOError)   // NOLINT
     nhope::ThreadExecutor executor;
     nhope::AOContext aoCtx(executor);
 
-    auto conn = nhope::PushbackReader::create(
+    auto conn = ConnectionBuffer::create(
       aoCtx,                                                                           //
       nhope::concat(aoCtx, nhope::StringReader::create(aoCtx, "GET /path HTTP/1.1"),   // Begining of the request header
                     BrokenSock::create(aoCtx))                                         // IOError
@@ -149,7 +232,7 @@ TEST(ReceiveRequest, BodyReader_IOError)   // NOLINT
     nhope::ThreadExecutor executor;
     nhope::AOContext aoCtx(executor);
 
-    auto conn = nhope::PushbackReader::create(
+    auto conn = ConnectionBuffer::create(
       aoCtx,                                                                      //
       nhope::concat(aoCtx,                                                        //
                     nhope::StringReader::create(aoCtx, "GET /path HTTP/1.1\r\n"   // Begining of the request header
@@ -171,7 +254,7 @@ TEST(ReceiveRequest, Cancel)   // NOLINT
     nhope::ThreadExecutor executor;
     nhope::AOContext aoCtx(executor);
 
-    auto conn = nhope::PushbackReader::create(
+    auto conn = ConnectionBuffer::create(
       aoCtx,                                                                    //
       nhope::concat(aoCtx,                                                      //
                     nhope::StringReader::create(aoCtx, "GET /path HTTP/1.1"),   // Begining of the request header
@@ -192,7 +275,7 @@ TEST(ReceiveRequest, BodyReader_Cancel)   // NOLINT
     nhope::ThreadExecutor executor;
     nhope::AOContext aoCtx(executor);
 
-    auto conn = nhope::PushbackReader::create(
+    auto conn = ConnectionBuffer::create(
       aoCtx,                                                                      //
       nhope::concat(aoCtx,                                                        //
                     nhope::StringReader::create(aoCtx, "GET /path HTTP/1.1\r\n"   // Begining of the request header
@@ -216,7 +299,7 @@ TEST(ReceiveRequest, TwoRequest)   // NOLINT
     nhope::ThreadExecutor executor;
     nhope::AOContext aoCtx(executor);
 
-    auto conn = nhope::PushbackReader::create(   //
+    auto conn = ConnectionBuffer::create(   //
       aoCtx,                                     //
       nhope::StringReader::create(aoCtx, "GET /first HTTP/1.1\r\n"
                                          "Content-Length: 10\r\n"
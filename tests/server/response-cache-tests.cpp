@@ -0,0 +1,297 @@
+#include <chrono>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "nhope/async/ao-context.h"
+#include "nhope/async/future.h"
+#include "nhope/async/thread-executor.h"
+#include "nhope/io/io-device.h"
+#include "nhope/io/string-reader.h"
+
+#include "nlohmann/json.hpp"
+
+#include "royalbed/server/json-stream.h"
+#include "royalbed/server/request-context.h"
+#include "royalbed/server/response-cache.h"
+#include "royalbed/server/router.h"
+
+#include "helpers/logger.h"
+
+namespace {
+
+using namespace std::literals;
+using namespace royalbed::server;
+
+struct Response
+{
+    bool handled;
+    Headers headers;
+    std::string body;
+};
+
+// Handler response for the next request
+struct Content
+{
+    std::string body;
+    Headers headers;
+};
+
+class CacheFixture
+{
+public:
+    explicit CacheFixture(ResponseCacheOptions options = {})
+      : cache(std::make_shared<ResponseCache>(std::move(options)))
+    {
+        router.addMiddleware(cacheResponses(cache));
+        router.get("/api/items", handler());
+        router.get("/api/items/:id", handler());
+        router.head("/api/items", handler());
+        router.post("/api/items", handler());
+    }
+
+    Response request(std::string_view method, std::string_view path, const Headers& headers = {},
+                     Uri::Query query = {})
+    {
+        nhope::ThreadExecutor th;
+        RequestContext ctx{
+          .num = 1,
+          .log = nullLogger(),
+          .router = router,
+          .aoCtx = nhope::AOContext(th),
+        };
+        ctx.request.method = method;
+        ctx.request.uri.path = path;
+        ctx.request.uri.query = std::move(query);
+        ctx.request.headers = headers;
+
+        handled = false;
+        auto route = router.route(method, path);
+        bool next = true;
+        for (const auto& middleware : route.middlewares) {
+            if (next = middleware(ctx).get(); !next) {
+                break;
+            }
+        }
+        if (next) {
+            route.handler(ctx).get();
+            while (!ctx.responseFilters.empty()) {
+                auto filter = std::move(ctx.responseFilters.back());
+                ctx.responseFilters.pop_back();
+                filter(ctx).get();
+            }
+        }
+
+        std::string body;
+        if (ctx.response.body != nullptr) {
+            const auto data = nhope::readAll(*ctx.response.body).get();
+            body.assign(data.begin(), data.end());
+        }
+        return {handled, ctx.response.headers, body};
+    }
+
+    std::shared_ptr<ResponseCache> cache;
+    Router router;
+    Content content;
+    bool handled = false;
+
+private:
+    LowLevelHandler handler()
+    {
+        return [this](RequestContext& ctx) {
+            handled = true;
+            ctx.response.headers = content.headers;
+            ctx.response.body = nhope::StringReader::create(ctx.aoCtx, content.body);
+            return nhope::makeReadyFuture();
+        };
+    }
+};
+
+}   // namespace
+
+TEST(ResponseCache, HitMiss)   // NOLINT
+{
+    CacheFixture f;
+
+    f.content = {"items"};
+    const auto miss = f.request("GET", "/api/items");
+    EXPECT_TRUE(miss.handled);
+    EXPECT_EQ(miss.body, "items");
+    EXPECT_EQ(miss.headers.at("Content-Length"), "5");
+
+    f.content = {"changed"};
+    const auto hit = f.request("GET", "/api/items/");
+    EXPECT_FALSE(hit.handled);
+    EXPECT_EQ(hit.body, "items");
+    EXPECT_EQ(hit.headers.at("Age"), "0");
+
+    const auto post = f.request("POST", "/api/items");
+    EXPECT_TRUE(post.handled);
+    EXPECT_EQ(post.body, "changed");
+
+    const auto stats = f.cache->stats();
+    EXPECT_EQ(stats.hits, 1);
+    EXPECT_EQ(stats.misses, 1);
+    EXPECT_EQ(stats.entries, 1);
+    EXPECT_GT(stats.bytes, 5);
+}
+
+TEST(ResponseCache, Key)   // NOLINT
+{
+    CacheFixture f({.queryParams = {"page"}, .varyHeaders = {"Accept-Encoding"}});
+
+    f.content = {"page 1"};
+    f.request("GET", "/api/items", {}, {{"page", "1"}});
+    f.content = {"page 2"};
+    EXPECT_EQ(f.request("GET", "/api/items", {}, {{"page", "1"}, {"sort", "asc"}}).body, "page 1");
+    EXPECT_EQ(f.request("GET", "/api/items", {}, {{"page", "2"}}).body, "page 2");
+
+    f.content = {"gzip", {{"Vary", "Accept-Encoding"}}};
+    EXPECT_TRUE(f.request("GET", "/api/items/1", {{"Accept-Encoding", "gzip"}}).handled);
+    f.content = {"identity", {{"Vary", "Accept-Encoding"}}};
+    EXPECT_TRUE(f.request("GET", "/api/items/1").handled);
+    EXPECT_EQ(f.request("GET", "/api/items/1", {{"accept-encoding", "gzip"}}).body, "gzip");
+    EXPECT_EQ(f.request("GET", "/api/items/1").body, "identity");
+}
+
+TEST(ResponseCache, NotCacheable)   // NOLINT
+{
+    CacheFixture f({.maxEntrySize = 16});
+
+    const auto notCached = [&f](Content content) {
+        f.cache->clear();
+        f.content = content;
+        f.request("GET", "/api/items");
+        const auto resp = f.request("GET", "/api/items");
+        return resp.handled && resp.body == content.body;
+    };
+
+    EXPECT_TRUE(notCached({"no-store", {{"Cache-Control", "no-store"}}}));
+    EXPECT_TRUE(notCached({"private", {{"Cache-Control", "max-age=10, private"}}}));
+    EXPECT_TRUE(notCached({"cookie", {{"Set-Cookie", "id=1"}}}));
+    EXPECT_TRUE(notCached({"vary", {{"Vary", "Cookie"}}}));
+    EXPECT_TRUE(notCached({std::string(1000, 'x')}));
+    EXPECT_FALSE(notCached({"public", {{"Cache-Control", "public"}}}));
+}
+
+TEST(ResponseCache, Credentials)   // NOLINT
+{
+    CacheFixture f;
+
+    // A response to a request with credentials is neither taken from the cache nor stored
+    f.content = {"anonymous"};
+    f.request("GET", "/api/items");
+    f.content = {"alice"};
+    EXPECT_EQ(f.request("GET", "/api/items", {{"Authorization", "Bearer alice"}}).body, "alice");
+    f.content = {"bob"};
+    EXPECT_EQ(f.request("GET", "/api/items/1", {{"Cookie", "id=bob"}}).body, "bob");
+    EXPECT_TRUE(f.request("GET", "/api/items/1").handled);
+    EXPECT_EQ(f.request("GET", "/api/items").body, "anonymous");
+
+    // Unless the response is public
+    f.content = {"public", {{"Cache-Control", "public"}}};
+    f.request("GET", "/api/items/2", {{"Cookie", "id=bob"}});
+    f.content = {"changed"};
+    EXPECT_EQ(f.request("GET", "/api/items/2").body, "public");
+    EXPECT_EQ(f.request("GET", "/api/items/2", {{"Authorization", "Bearer alice"}}).body, "public");
+
+    // Or the credentials are a part of the key
+    CacheFixture vary({.varyHeaders = {"Authorization"}});
+    vary.content = {"alice"};
+    vary.request("GET", "/api/items", {{"Authorization", "Bearer alice"}});
+    vary.content = {"bob"};
+    EXPECT_EQ(vary.request("GET", "/api/items", {{"Authorization", "Bearer bob"}}).body, "bob");
+    EXPECT_FALSE(vary.request("GET", "/api/items", {{"Authorization", "Bearer alice"}}).handled);
+}
+
+TEST(ResponseCache, Head)   // NOLINT
+{
+    CacheFixture f;
+
+    f.content = {"items"};
+    f.request("GET", "/api/items");
+
+    const auto head = f.request("HEAD", "/api/items");
+    EXPECT_FALSE(head.handled);
+    EXPECT_EQ(head.headers.at("Content-Length"), "5");
+    EXPECT_TRUE(head.body.empty());
+
+    // HEAD responses of the handler are not stored
+    f.cache->clear();
+    f.content = {"", {{"Content-Length", "7"}}};
+    EXPECT_EQ(f.request("HEAD", "/api/items").headers.at("Content-Length"), "7");
+    EXPECT_TRUE(f.request("HEAD", "/api/items").handled);
+    EXPECT_EQ(f.cache->stats().entries, 0);
+}
+
+TEST(ResponseCache, Stream)   // NOLINT
+{
+    CacheFixture f;
+    f.router.get("/api/stream", [] {
+        return streamJsonArray(std::vector<int>{1, 2, 3});
+    });
+
+    // The stored response and the hit carry Content-Length only
+    for (int i = 0; i < 2; ++i) {
+        const auto resp = f.request("GET", "/api/stream");
+        EXPECT_EQ(nlohmann::json::parse(resp.body), nlohmann::json({1, 2, 3}));
+        EXPECT_EQ(resp.headers.at("Content-Length"), std::to_string(resp.body.size()));
+        EXPECT_FALSE(resp.headers.contains("Transfer-Encoding"));
+    }
+    EXPECT_EQ(f.cache->stats().hits, 1);
+}
+
+TEST(ResponseCache, Invalidation)   // NOLINT
+{
+    CacheFixture f;
+
+    f.content = {"old"};
+    f.request("GET", "/api/items");
+    f.request("GET", "/api/items/1");
+    f.request("GET", "/api/items/2");
+
+    f.content = {"new"};
+    f.cache->invalidate("/api/items/1");
+    EXPECT_EQ(f.request("GET", "/api/items/1").body, "new");
+    EXPECT_EQ(f.request("GET", "/api/items/2").body, "old");
+
+    f.cache->invalidateSubtree("api/items");
+    EXPECT_EQ(f.request("GET", "/api/items").body, "new");
+    EXPECT_EQ(f.request("GET", "/api/items/2").body, "new");
+    EXPECT_EQ(f.cache->stats().invalidations, 4);
+}
+
+TEST(ResponseCache, Expiration)   // NOLINT
+{
+    CacheFixture f({.ttl = 50ms});
+
+    f.content = {"old"};
+    f.request("GET", "/api/items");
+    f.content = {"new"};
+    EXPECT_EQ(f.request("GET", "/api/items").body, "old");
+
+    std::this_thread::sleep_for(100ms);
+    EXPECT_EQ(f.request("GET", "/api/items").body, "new");
+    EXPECT_EQ(f.cache->stats().expirations, 1);
+}
+
+TEST(ResponseCache, Eviction)   // NOLINT
+{
+    CacheFixture f({.maxBytes = 1024});
+
+    f.content = {std::string(400, 'x')};
+    for (int i = 0; i < 4; ++i) {
+        f.request("GET", "/api/items/" + std::to_string(i));
+    }
+
+    const auto stats = f.cache->stats();
+    EXPECT_LE(stats.bytes, 1024);
+    EXPECT_GT(stats.evictions, 0);
+    EXPECT_FALSE(f.request("GET", "/api/items/3").handled);
+    EXPECT_TRUE(f.request("GET", "/api/items/0").handled);
+}
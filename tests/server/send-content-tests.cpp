@@ -0,0 +1,163 @@
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include <gsl/span>
+
+#include "fmt/format.h"
+
+#include "nhope/async/ao-context.h"
+#include "nhope/async/future.h"
+#include "nhope/async/thread-executor.h"
+#include "nhope/io/io-device.h"
+
+#include "royalbed/server/detail/byte-ranges.h"
+#include "royalbed/server/http-status.h"
+#include "royalbed/server/request-context.h"
+#include "royalbed/server/router.h"
+#include "royalbed/server/send-content.h"
+
+#include "helpers/logger.h"
+
+namespace {
+
+using namespace std::literals;
+using namespace royalbed::server;
+using namespace royalbed::server::detail;
+
+constexpr auto text = "0123456789abcdefghij"sv;
+
+const auto info = ContentInfo{   // NOLINT(cert-err58-cpp)
+  .contentType = "text/plain",
+  .etag = "\"v1\"",
+};
+
+struct Result
+{
+    int status;
+    Headers headers;
+    std::string body;
+};
+
+Result send(const Headers& requestHeaders)
+{
+    nhope::ThreadExecutor th;
+    Router router;
+    RequestContext ctx{
+      .num = 1,
+      .log = nullLogger(),
+      .router = router,
+      .aoCtx = nhope::AOContext(th),
+    };
+    ctx.request.headers = requestHeaders;
+
+    // NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast)
+    sendContent(ctx, gsl::span(reinterpret_cast<const std::uint8_t*>(text.data()), text.size()), info);
+
+    std::string body;
+    if (ctx.response.body != nullptr) {
+        const auto data = nhope::readAll(*ctx.response.body).get();
+        body.assign(data.begin(), data.end());
+    }
+    return {ctx.response.status, ctx.response.headers, body};
+}
+
+}   // namespace
+
+TEST(ByteRanges, Parse)   // NOLINT
+{
+    using Ranges = std::vector<ByteRange>;
+
+    EXPECT_EQ(parseByteRanges("bytes=0-499", 1000), (Ranges{{0, 500}}));
+    EXPECT_EQ(parseByteRanges("bytes=500-", 1000), (Ranges{{500, 500}}));
+    EXPECT_EQ(parseByteRanges("bytes=-200", 1000), (Ranges{{800, 200}}));
+    EXPECT_EQ(parseByteRanges("bytes=-2000", 1000), (Ranges{{0, 1000}}));
+    EXPECT_EQ(parseByteRanges("bytes=900-5000", 1000), (Ranges{{900, 100}}));
+    EXPECT_EQ(parseByteRanges("Bytes = 10-20 ,, -1", 1000), (Ranges{{10, 11}, {999, 1}}));
+
+    // Not satisfiable
+    EXPECT_EQ(parseByteRanges("bytes=1000-", 1000), Ranges{});
+    EXPECT_EQ(parseByteRanges("bytes=-0", 1000), Ranges{});
+    EXPECT_EQ(parseByteRanges("bytes=0-", 0), Ranges{});
+
+    // Ignored
+    EXPECT_EQ(parseByteRanges("bytes=5-1", 1000), std::nullopt);
+    EXPECT_EQ(parseByteRanges("bytes=a-1", 1000), std::nullopt);
+    EXPECT_EQ(parseByteRanges("items=0-1", 1000), std::nullopt);
+    EXPECT_EQ(parseByteRanges("bytes=", 1000), std::nullopt);
+
+    std::string tooMany = "bytes=0-0";
+    for (std::size_t i = 1; i <= maxByteRanges; ++i) {
+        tooMany += fmt::format(",{}-{}", i, i);
+    }
+    EXPECT_EQ(parseByteRanges(tooMany, 1000), std::nullopt);
+}
+
+TEST(SendContent, Full)   // NOLINT
+{
+    const auto result = send({});
+    EXPECT_EQ(result.status, HttpStatus::Ok);
+    EXPECT_EQ(result.headers.at("Accept-Ranges"), "bytes");
+    EXPECT_EQ(result.headers.at("ETag"), info.etag);
+    EXPECT_EQ(result.headers.at("Content-Length"), std::to_string(text.size()));
+    EXPECT_EQ(result.body, text);
+}
+
+TEST(SendContent, SingleRange)   // NOLINT
+{
+    const auto result = send({{"Range", "bytes=10-"}});
+    EXPECT_EQ(result.status, HttpStatus::PartialContent);
+    EXPECT_EQ(result.headers.at("Content-Range"), "bytes 10-19/20");
+    EXPECT_EQ(result.headers.at("Content-Length"), "10");
+    EXPECT_EQ(result.body, "abcdefghij");
+}
+
+TEST(SendContent, MultipleRanges)   // NOLINT
+{
+    const auto result = send({{"Range", "bytes=0-1,-2"}});
+    EXPECT_EQ(result.status, HttpStatus::PartialContent);
+
+    const auto& contentType = result.headers.at("Content-Type");
+    ASSERT_TRUE(contentType.starts_with("multipart/byteranges; boundary="));
+    const auto boundary = contentType.substr(contentType.find('=') + 1);
+
+    const auto expected = fmt::format("--{0}\r\n"
+                                      "Content-Type: text/plain\r\n"
+                                      "Content-Range: bytes 0-1/20\r\n"
+                                      "\r\n"
+                                      "01\r\n"
+                                      "--{0}\r\n"
+                                      "Content-Type: text/plain\r\n"
+                                      "Content-Range: bytes 18-19/20\r\n"
+                                      "\r\n"
+                                      "ij\r\n"
+                                      "--{0}--\r\n",
+                                      boundary);
+    EXPECT_EQ(result.body, expected);
+    EXPECT_EQ(result.headers.at("Content-Length"), std::to_string(expected.size()));
+}
+
+TEST(SendContent, NotSatisfiable)   // NOLINT
+{
+    const auto result = send({{"Range", "bytes=100-"}});
+    EXPECT_EQ(result.status, HttpStatus::RequestedRangeNotSatisfiable);
+    EXPECT_EQ(result.headers.at("Content-Range"), "bytes */20");
+    EXPECT_TRUE(result.body.empty());
+}
+
+TEST(SendContent, IfRange)   // NOLINT
+{
+    const auto same = send({{"Range", "bytes=0-4"}, {"If-Range", info.etag}});
+    EXPECT_EQ(same.status, HttpStatus::PartialContent);
+    EXPECT_EQ(same.body, "01234");
+
+    // The representation has changed, it is sent whole
+    const auto changed = send({{"Range", "bytes=0-4"}, {"If-Range", "\"v0\""}});
+    EXPECT_EQ(changed.status, HttpStatus::Ok);
+    EXPECT_EQ(changed.body, text);
+}
@@ -90,6 +90,83 @@ TEST(SendResponse, SendResponseWithBody)   // NOLINT
     EXPECT_EQ(dev->takeContent(), etalone);
 }
 
+TEST(SendResponse, SendResponseWithChunkedBody)   // NOLINT
+{
+    constexpr auto etalone = "HTTP/1.1 200 OK\r\nTransfer-Encoding: chunked\r\n\r\nA\r\n1234567890\r\n0\r\n\r\n"sv;
+
+    nhope::ThreadExecutor executor;
+    nhope::AOContext aoCtx(executor);
+
+    auto resp = Response{
+      .headers =
+        {
+          {"Transfer-Encoding", "chunked"},
+        },
+      .body = nhope::StringReader::create(aoCtx, "1234567890"),
+    };
+
+    auto dev = nhope::StringWritter::create(aoCtx);
+
+    const auto n = sendResponse(aoCtx, std::move(resp), *dev).get();
+
+    EXPECT_EQ(n, etalone.size());
+    EXPECT_EQ(dev->takeContent(), etalone);
+}
+
+TEST(SendResponse, SendResponseWithUnknownLength)   // NOLINT
+{
+    constexpr auto etalone = "HTTP/1.1 200 OK\r\nTransfer-Encoding: chunked\r\n\r\n"
+                             "A\r\n1234567890\r\n0\r\nChecksum: 42\r\n\r\n"sv;
+
+    nhope::ThreadExecutor executor;
+    nhope::AOContext aoCtx(executor);
+
+    auto resp = Response{
+      .body = nhope::StringReader::create(aoCtx, "1234567890"),
+      .trailers =
+        [] {
+            return Headers{{"Checksum", "42"}};
+        },
+    };
+
+    auto dev = nhope::StringWritter::create(aoCtx);
+
+    const auto n = sendResponse(aoCtx, std::move(resp), *dev).get();
+
+    EXPECT_EQ(n, etalone.size());
+    EXPECT_EQ(dev->takeContent(), etalone);
+}
+
+TEST(SendResponse, ChunkCoalescing)   // NOLINT
+{
+    constexpr auto coalesced = "HTTP/1.1 200 OK\r\nTransfer-Encoding: chunked\r\n\r\n"
+                               "9\r\n123456789\r\n0\r\n\r\n"sv;
+    constexpr auto notCoalesced = "HTTP/1.1 200 OK\r\nTransfer-Encoding: chunked\r\n\r\n"
+                                  "3\r\n123\r\n3\r\n456\r\n3\r\n789\r\n0\r\n\r\n"sv;
+    constexpr auto limited = "HTTP/1.1 200 OK\r\nTransfer-Encoding: chunked\r\n\r\n"
+                             "4\r\n1234\r\n4\r\n5678\r\n1\r\n9\r\n0\r\n\r\n"sv;
+
+    nhope::ThreadExecutor executor;
+    nhope::AOContext aoCtx(executor);
+
+    const auto send = [&aoCtx](ChunkedParams params) {
+        auto resp = Response{
+          .body = nhope::concat(aoCtx,                                       //
+                                nhope::StringReader::create(aoCtx, "123"),   //
+                                nhope::StringReader::create(aoCtx, "456"),   //
+                                nhope::StringReader::create(aoCtx, "789")),
+          .chunked = params,
+        };
+        auto dev = nhope::StringWritter::create(aoCtx);
+        sendResponse(aoCtx, std::move(resp), *dev).get();
+        return dev->takeContent();
+    };
+
+    EXPECT_EQ(send({}), coalesced);
+    EXPECT_EQ(send({.minChunkSize = 0}), notCoalesced);
+    EXPECT_EQ(send({.minChunkSize = 4, .maxChunkSize = 4}), limited);
+}
+
 TEST(SendResponse, IOError)   // NOLINT
 {
     nhope::ThreadExecutor executor;
@@ -1,7 +1,15 @@
+#include <chrono>
 #include <memory>
+#include <stdexcept>
 #include <string>
 #include <utility>
 
+#if defined(__linux__)
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#endif
+
 #include "gtest/gtest.h"
 #include "spdlog/spdlog.h"
 #include "spdlog/sinks/null_sink.h"
@@ -11,14 +19,17 @@
 #include "nhope/async/future.h"
 #include "nhope/async/thread-executor.h"
 #include "nhope/io/io-device.h"
-#include "nhope/io/pushback-reader.h"
 #include "nhope/io/string-reader.h"
 #include "nhope/io/tcp.h"
 
 #include "royalbed/client/detail/receive-response.h"
 #include "royalbed/client/request.h"
 #include "royalbed/client/detail/send-request.h"
+#include "royalbed/client/tcp.h"
+#include "royalbed/client/unix-socket.h"
 
+#include "royalbed/common/detail/connection-buffer.h"
+#include "royalbed/common/tcp.h"
 #include "royalbed/server/http-status.h"
 #include "royalbed/server/server.h"
 #include "royalbed/server/router.h"
@@ -29,6 +40,7 @@
 namespace {
 using namespace royalbed;
 using namespace royalbed::server;
+using royalbed::common::detail::ConnectionBuffer;
 constexpr auto port = 7890;
 
 }   // namespace
@@ -41,7 +53,6 @@ TEST(Server, Echo)   // NOLINT
     nhope::AOContext aoCtx(executor);
 
     const auto send = [&aoCtx](const std::string& content) {
-        using nhope::PushbackReader;
         using nhope::StringReader;
         using nhope::TcpSocket;
 
@@ -60,7 +71,7 @@ TEST(Server, Echo)   // NOLINT
                                     *sock)
           .get();
 
-        auto pushbackReader = PushbackReader::create(aoCtx, *sock);
+        auto pushbackReader = ConnectionBuffer::create(aoCtx, *sock);
         auto resp = client::detail::receiveResponse(aoCtx, *pushbackReader).get();
 
         return asString(nhope::readAll(*resp.body).get());
@@ -86,3 +97,172 @@ TEST(Server, Echo)   // NOLINT
         EXPECT_EQ(send(data), data);
     }
 }
+
+TEST(Server, UnixSocket)   // NOLINT
+{
+    nhope::ThreadExecutor executor;
+    nhope::AOContext aoCtx(executor);
+
+    auto router = Router();
+    router.get("/hello", [](RequestContext& ctx) {
+        ctx.response.status = HttpStatus::Ok;
+        ctx.response.headers["Content-Length"] = "5";
+        ctx.response.body = nhope::StringReader::create(ctx.aoCtx, "Hello");
+        return nhope::makeReadyFuture();
+    });
+
+    auto srv = Server::start(aoCtx, {
+                                      .bindAddress = "",
+                                      .port = 0,
+                                      .router = std::move(router),
+                                      .log = spdlog::default_logger(),
+                                      .listeners = {UnixListener{"@royalbed-server-test"}},
+                                    });
+    EXPECT_THROW(srv->bindAddress(), std::logic_error);   // NOLINT
+
+    auto sock = client::UnixSocket::connect(aoCtx, "@royalbed-server-test").get();
+    client::detail::sendRequest(aoCtx,
+                                {
+                                  .method = "GET",
+                                  .uri = {.path = "/hello"},
+                                  .headers = {{"Connection", "close"}},
+                                },
+                                *sock)
+      .get();
+
+    auto pushbackReader = ConnectionBuffer::create(aoCtx, *sock);
+    auto resp = client::detail::receiveResponse(aoCtx, *pushbackReader).get();
+    EXPECT_EQ(resp.status, HttpStatus::Ok);
+    EXPECT_EQ(asString(nhope::readAll(*resp.body).get()), "Hello");
+}
+
+TEST(Server, SocketOptions)   // NOLINT
+{
+    nhope::ThreadExecutor executor;
+    nhope::AOContext aoCtx(executor);
+
+    auto router = Router();
+    router.get("/hello", [](RequestContext& ctx) {
+        ctx.response.status = HttpStatus::Ok;
+        ctx.response.headers["Content-Length"] = "5";
+        ctx.response.body = nhope::StringReader::create(ctx.aoCtx, "Hello");
+        return nhope::makeReadyFuture();
+    });
+
+    const SocketOptions options{
+      .noDelay = true,
+      .deferAccept = std::chrono::seconds(1),
+      .backlog = 16,
+      .sendBufferSize = 64 * 1024,      // NOLINT
+      .receiveBufferSize = 64 * 1024,   // NOLINT
+    };
+
+    auto srv = Server::start(aoCtx, {
+                                      .bindAddress = "127.0.0.1",
+                                      .port = port,
+                                      .router = std::move(router),
+                                      .log = spdlog::default_logger(),
+                                      .socketOptions = options,
+                                    });
+
+    for (int i = 0; i < 3; ++i) {
+        auto sock = client::connectTcp(aoCtx, "127.0.0.1", port, options).get();
+        client::detail::sendRequest(aoCtx,
+                                    {
+                                      .method = "GET",
+                                      .uri = {.path = "/hello"},
+                                      .headers = {{"Connection", "close"}},
+                                    },
+                                    *sock)
+          .get();
+
+        auto pushbackReader = ConnectionBuffer::create(aoCtx, *sock);
+        auto resp = client::detail::receiveResponse(aoCtx, *pushbackReader).get();
+        EXPECT_EQ(resp.status, HttpStatus::Ok);
+        EXPECT_EQ(asString(nhope::readAll(*resp.body).get()), "Hello");
+    }
+
+#if defined(__linux__)
+    // The options really reach the listening, accepted and connected sockets
+    const auto intOption = [](int fd, int level, int option) {
+        int value = 0;
+        socklen_t size = sizeof(value);
+        EXPECT_EQ(::getsockopt(fd, level, option, &value, &size), 0);
+        return value;
+    };
+
+    auto listener = common::startTcpServer(aoCtx, {.address = "127.0.0.1", .port = port + 1}, options);
+    auto accepted = listener->accept();
+    auto client = client::connectTcp(aoCtx, "127.0.0.1", port + 1, options).get();
+
+    // TCP_DEFER_ACCEPT holds the connection until data arrive
+    const auto request = asBytes("x");
+    client->write(request, [](auto, auto) {});
+    auto server = accepted.get();
+
+    const auto listenerFd = common::nativeSocketHandle(*listener);
+    ASSERT_GE(listenerFd, 0);
+    EXPECT_GT(intOption(listenerFd, IPPROTO_TCP, TCP_DEFER_ACCEPT), 0);
+
+    // The kernel doubles the requested buffer sizes for its bookkeeping
+    for (auto* sock : {server.get(), client.get()}) {
+        const auto fd = common::nativeSocketHandle(*sock);
+        ASSERT_GE(fd, 0);
+        EXPECT_NE(intOption(fd, IPPROTO_TCP, TCP_NODELAY), 0);
+        EXPECT_GE(intOption(fd, SOL_SOCKET, SO_RCVBUF), options.receiveBufferSize);
+        EXPECT_GE(intOption(fd, SOL_SOCKET, SO_SNDBUF), options.sendBufferSize);
+    }
+#endif
+}
+
+#ifdef ROYALBED_IO_URING_ENABLED
+
+TEST(Server, IoUring)   // NOLINT
+{
+    constexpr auto iterCount = 50;
+
+    nhope::ThreadExecutor executor;
+    nhope::AOContext aoCtx(executor);
+
+    auto router = Router();
+    router.get("/echo", [](RequestContext& ctx) {
+        ctx.response.status = HttpStatus::Ok;
+        ctx.response.body = std::move(ctx.request.body);
+        ctx.response.headers = ctx.request.headers;
+        return nhope::makeReadyFuture();
+    });
+
+    auto srv = Server::start(aoCtx, {
+                                      .bindAddress = "127.0.0.1",
+                                      .port = port,
+                                      .router = std::move(router),
+                                      .log = spdlog::default_logger(),
+                                      .ioBackend = IoBackend::IoUring,
+                                    });
+
+    for (int i = 0; i < iterCount; ++i) {
+        // Bigger than one provided buffer
+        const auto content = std::string(40 * 1024, static_cast<char>('a' + i % 26));   // NOLINT
+
+        auto sock = nhope::TcpSocket::connect(aoCtx, "127.0.0.1", port).get();
+        client::detail::sendRequest(aoCtx,
+                                    {
+                                      .method = "GET",
+                                      .uri = {.path = "/echo"},
+                                      .headers =
+                                        {
+                                          {"Connection", "close"},
+                                          {"Content-Length", std::to_string(content.size())},
+                                        },
+                                      .body = nhope::StringReader::create(aoCtx, content),
+                                    },
+                                    *sock)
+          .get();
+
+        auto pushbackReader = ConnectionBuffer::create(aoCtx, *sock);
+        auto resp = client::detail::receiveResponse(aoCtx, *pushbackReader).get();
+        EXPECT_EQ(asString(nhope::readAll(*resp.body).get()), content);
+    }
+}
+
+#endif
@@ -3,9 +3,16 @@
 #include <stdexcept>
 #include <string>
 #include <string_view>
+#include <utility>
+#include <vector>
 
+#include "fmt/format.h"
 #include "gtest/gtest.h"
 
+#ifdef ROYALBED_ZLIB_ENABLED
+#include <zlib.h>
+#endif
+
 #include "nhope/async/event.h"
 #include "royalbed/common/http-status.h"
 #include "spdlog/spdlog.h"
@@ -19,10 +26,13 @@
 
 #include "nhope/io/string-writter.h"
 
+#include "royalbed/common/body.h"
+#include "royalbed/common/detail/connection-buffer.h"
 #include "royalbed/server/detail/session.h"
 #include "royalbed/server/error.h"
 #include "royalbed/server/http-status.h"
 #include "royalbed/server/request-context.h"
+#include "royalbed/server/request-limits.h"
 #include "royalbed/server/router.h"
 
 #include "helpers/iodevs.h"
@@ -32,6 +42,7 @@ namespace {
 using namespace std::literals;
 using namespace royalbed::server;
 using namespace royalbed::server::detail;
+using royalbed::common::detail::ConnectionBuffer;
 
 class TestSessionCtx final : public SessionCtx
 {
@@ -48,8 +59,21 @@ public:
     void sessionReceivedRequest(std::uint32_t /*sessionNum*/) noexcept override
     {}
 
-    void sessionFinished(std::uint32_t /*sessionNum*/, bool /*success*/) noexcept override
+    void sessionStage(std::uint32_t /*sessionNum*/, SessionStage /*stage*/) noexcept override
+    {}
+
+    void sessionBodyWait(std::uint32_t /*sessionNum*/, bool /*waiting*/) noexcept override
+    {}
+
+    void sessionFinished(std::uint32_t /*sessionNum*/, bool keepAlive) noexcept override
+    {
+        m_keepAlive = keepAlive;
+        m_event.set();
+    }
+
+    void sessionUpgraded(std::uint32_t /*sessionNum*/, UpgradeHandler upgrade) noexcept override
     {
+        m_upgrade = std::move(upgrade);
         m_event.set();
     }
 
@@ -58,14 +82,31 @@ public:
         return false;
     }
 
+    UpgradeHandler sessionH2cUpgrade(Request& /*request*/) override
+    {
+        return nullptr;
+    }
+
+    UpgradeHandler takeUpgrade()
+    {
+        return std::move(m_upgrade);
+    }
+
     bool wait(std::chrono::nanoseconds timeout)
     {
         return m_event.waitFor(timeout);
     }
 
+    [[nodiscard]] bool keepAlive() const noexcept
+    {
+        return m_keepAlive;
+    }
+
 private:
     Router m_router;
     nhope::Event m_event;
+    UpgradeHandler m_upgrade;
+    bool m_keepAlive = false;
 };
 
 }   // namespace
@@ -254,7 +295,7 @@ TEST(Session, Close)   // NOLINT
     auto aoCtx = nhope::AOContext(executor);
     TestSessionCtx testSessionCtx(std::move(router));
 
-    auto in = nhope::PushbackReader::create(aoCtx, SlowSock::create(aoCtx));
+    auto in = ConnectionBuffer::create(aoCtx, SlowSock::create(aoCtx));
     auto out = nhope::StringWritter::create(aoCtx);
 
     startSession(aoCtx, SessionParams{
@@ -296,3 +337,275 @@ TEST(Session, NoContent)   // NOLINT
     const auto response = out->takeContent();
     EXPECT_TRUE(response.find("HTTP/1.1 204 No Content\r\n") != std::string::npos);
 }
+
+TEST(Session, BodyTooLarge)   // NOLINT
+{
+    bool handlerCalled = false;
+    auto router = Router();
+    router.post("/upload", [&handlerCalled](RequestContext& /*ctx*/) {
+        handlerCalled = true;
+    });
+
+    auto executor = nhope::ThreadExecutor();
+    auto aoCtx = nhope::AOContext(executor);
+    TestSessionCtx testSessionCtx(std::move(router));
+
+    auto in = inputStream(aoCtx, "POST /upload HTTP/1.1\r\nContent-Length: 11\r\n\r\n12345678901");
+    auto out = nhope::StringWritter::create(aoCtx);
+    startSession(aoCtx, SessionParams{
+                          .ctx = testSessionCtx,
+                          .in = *in,
+                          .out = *out,
+                          .log = nullLogger(),
+                          .limits = {.maxBodySize = 10},
+                        });
+
+    EXPECT_TRUE(testSessionCtx.wait(1s));
+    EXPECT_FALSE(handlerCalled);
+
+    const auto response = out->takeContent();
+    EXPECT_TRUE(response.find("HTTP/1.1 413 ") != std::string::npos);
+    EXPECT_TRUE(response.find("Connection: close\r\n") != std::string::npos);
+}
+
+TEST(Session, RouteBodyLimit)   // NOLINT
+{
+    const auto makeRouter = [] {
+        auto readBody = [](RequestContext& ctx) {
+            return nhope::readAll(*ctx.request.body).then([&ctx](const std::vector<std::uint8_t>& body) {
+                ctx.response.status = HttpStatus::Ok;
+                ctx.response.headers["Body-Size"] = std::to_string(body.size());
+            });
+        };
+
+        auto uploadRouter = Router();
+        uploadRouter.addMiddleware(limitBodySize(100));
+        uploadRouter.post("/file", readBody);
+
+        auto router = Router();
+        router.post("/small", readBody);
+        router.use("/upload", std::move(uploadRouter));
+        return router;
+    };
+
+    constexpr auto chunkedBody = "Transfer-Encoding: chunked\r\n\r\n14\r\n12345678901234567890\r\n0\r\n\r\n";
+
+    for (const auto& [path, status] : {std::pair{"/small"sv, "413"sv}, std::pair{"/upload/file"sv, "200"sv}}) {
+        auto executor = nhope::ThreadExecutor();
+        auto aoCtx = nhope::AOContext(executor);
+        TestSessionCtx testSessionCtx(makeRouter());
+
+        auto in = inputStream(aoCtx, fmt::format("POST {} HTTP/1.1\r\n{}", path, chunkedBody));
+        auto out = nhope::StringWritter::create(aoCtx);
+        startSession(aoCtx, SessionParams{
+                              .ctx = testSessionCtx,
+                              .in = *in,
+                              .out = *out,
+                              .log = nullLogger(),
+                              .limits = {.maxBodySize = 10},
+                            });
+
+        EXPECT_TRUE(testSessionCtx.wait(1s));
+
+        const auto response = out->takeContent();
+        EXPECT_TRUE(response.find(fmt::format("HTTP/1.1 {} ", status)) != std::string::npos) << path;
+    }
+}
+
+TEST(Session, ExpectContinue)   // NOLINT
+{
+    const auto makeRouter = [] {
+        auto router = Router();
+        router.post("/upload", [](RequestContext& ctx) {
+            return nhope::readAll(*ctx.request.body).then([&ctx](const std::vector<std::uint8_t>& body) {
+                ctx.response.status = HttpStatus::Ok;
+                ctx.response.headers["Body-Size"] = std::to_string(body.size());
+            });
+        });
+        return router;
+    };
+
+    constexpr auto request = " HTTP/1.1\r\nExpect: 100-continue\r\nContent-Length: 10\r\n\r\n1234567890";
+
+    {
+        auto executor = nhope::ThreadExecutor();
+        auto aoCtx = nhope::AOContext(executor);
+        TestSessionCtx testSessionCtx(makeRouter());
+
+        auto in = inputStream(aoCtx, "POST /upload"s + request);
+        auto out = nhope::StringWritter::create(aoCtx);
+        startSession(aoCtx, SessionParams{
+                              .ctx = testSessionCtx,
+                              .in = *in,
+                              .out = *out,
+                              .log = nullLogger(),
+                            });
+
+        EXPECT_TRUE(testSessionCtx.wait(1s));
+
+        const auto response = out->takeContent();
+        EXPECT_TRUE(response.starts_with("HTTP/1.1 100 Continue\r\n\r\nHTTP/1.1 200 OK\r\n"));
+        EXPECT_TRUE(response.find("Body-Size: 10\r\n") != std::string::npos);
+    }
+
+    // The route does not exist, the body is not requested
+    {
+        auto executor = nhope::ThreadExecutor();
+        auto aoCtx = nhope::AOContext(executor);
+        TestSessionCtx testSessionCtx(makeRouter());
+
+        auto in = inputStream(aoCtx, "POST /unknown"s + request);
+        auto out = nhope::StringWritter::create(aoCtx);
+        startSession(aoCtx, SessionParams{
+                              .ctx = testSessionCtx,
+                              .in = *in,
+                              .out = *out,
+                              .log = nullLogger(),
+                            });
+
+        EXPECT_TRUE(testSessionCtx.wait(1s));
+
+        const auto response = out->takeContent();
+        EXPECT_TRUE(response.starts_with("HTTP/1.1 404 "));
+        EXPECT_TRUE(response.find("Connection: close\r\n") != std::string::npos);
+    }
+}
+
+TEST(Session, ContentEncoding)   // NOLINT
+{
+    const auto makeRouter = [] {
+        auto router = Router();
+        router.post("/upload", [](RequestContext& ctx) {
+            return nhope::readAll(*ctx.request.body).then([&ctx](const std::vector<std::uint8_t>& body) {
+                ctx.response.status = HttpStatus::Ok;
+                ctx.response.headers["Body"] = std::string(body.begin(), body.end());
+            });
+        });
+        return router;
+    };
+
+    const auto send = [&makeRouter](const std::string& request, const RequestLimits& limits = {}) {
+        auto executor = nhope::ThreadExecutor();
+        auto aoCtx = nhope::AOContext(executor);
+        TestSessionCtx testSessionCtx(makeRouter());
+
+        auto in = inputStream(aoCtx, request);
+        auto out = nhope::StringWritter::create(aoCtx);
+        startSession(aoCtx, SessionParams{
+                              .ctx = testSessionCtx,
+                              .in = *in,
+                              .out = *out,
+                              .log = nullLogger(),
+                              .limits = limits,
+                            });
+
+        EXPECT_TRUE(testSessionCtx.wait(1s));
+        return out->takeContent();
+    };
+
+    const auto unsupported = send("POST /upload HTTP/1.1\r\nContent-Encoding: zstd\r\nContent-Length: 4\r\n\r\n1234");
+    EXPECT_TRUE(unsupported.starts_with("HTTP/1.1 415 "));
+
+    const auto identity = send("POST /upload HTTP/1.1\r\nContent-Encoding: identity\r\nContent-Length: 4\r\n\r\n1234");
+    EXPECT_TRUE(identity.starts_with("HTTP/1.1 200 "));
+    EXPECT_TRUE(identity.find("Body: 1234\r\n") != std::string::npos);
+
+#ifdef ROYALBED_ZLIB_ENABLED
+    const auto plain = std::string(1000, 'a');
+    auto compressed = std::vector<Bytef>(compressBound(plain.size()));
+    auto compressedSize = static_cast<uLongf>(compressed.size());
+    ASSERT_EQ(compress(compressed.data(), &compressedSize, reinterpret_cast<const Bytef*>(plain.data()), plain.size()),
+              Z_OK);
+    const auto body = std::string(compressed.begin(), compressed.begin() + static_cast<std::ptrdiff_t>(compressedSize));
+    const auto request = fmt::format(
+      "POST /upload HTTP/1.1\r\nContent-Encoding: deflate\r\nContent-Length: {}\r\n\r\n{}", body.size(), body);
+
+    const auto decoded = send(request);
+    EXPECT_TRUE(decoded.starts_with("HTTP/1.1 200 "));
+    EXPECT_TRUE(decoded.find(fmt::format("Body: {}\r\n", plain)) != std::string::npos);
+
+    // The limit applies to the decoded body as well
+    const auto bomb = send(request, {.maxBodySize = 500});
+    EXPECT_TRUE(bomb.starts_with("HTTP/1.1 413 "));
+
+    // The decoded body is limited even if the body size is not
+    const auto unlimitedBomb = send(request, {.maxDecodedBodySize = 500});
+    EXPECT_TRUE(unlimitedBomb.starts_with("HTTP/1.1 413 "));
+
+    // Bytes after the compressed stream are not taken for the next request
+    const auto smuggled = "GET / HTTP/1.1\r\n\r\n"s;
+    const auto trailing = send(fmt::format(
+      "POST /upload HTTP/1.1\r\nContent-Encoding: deflate\r\nContent-Length: {}\r\n\r\n{}{}",
+      body.size() + smuggled.size(), body, smuggled));
+    EXPECT_TRUE(trailing.starts_with("HTTP/1.1 400 "));
+
+    // A gzip body of several members is decoded up to the end
+    const auto gzip = [](std::string_view data) {
+        z_stream stream{};
+        EXPECT_EQ(deflateInit2(&stream, Z_DEFAULT_COMPRESSION, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY), Z_OK);
+        std::string result(deflateBound(&stream, data.size()), '\0');
+        stream.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(data.data()));
+        stream.avail_in = static_cast<uInt>(data.size());
+        stream.next_out = reinterpret_cast<Bytef*>(result.data());
+        stream.avail_out = static_cast<uInt>(result.size());
+        EXPECT_EQ(deflate(&stream, Z_FINISH), Z_STREAM_END);
+        result.resize(stream.total_out);
+        deflateEnd(&stream);
+        return result;
+    };
+    const auto members = gzip("first-") + gzip("second");
+    const auto concatenated = send(fmt::format(
+      "POST /upload HTTP/1.1\r\nContent-Encoding: gzip\r\nContent-Length: {}\r\n\r\n{}", members.size(), members));
+    EXPECT_TRUE(concatenated.starts_with("HTTP/1.1 200 "));
+    EXPECT_TRUE(concatenated.find("Body: first-second\r\n") != std::string::npos);
+#endif
+}
+
+TEST(Session, UnreadBodyPipelined)   // NOLINT
+{
+    const auto makeRouter = [] {
+        auto router = Router();
+        router.post("/items", [](const royalbed::common::Body<std::vector<int>>& body) {
+            return body.get().size();
+        });
+        router.get("/ping", [] {
+            return "pong"s;
+        });
+        return router;
+    };
+
+    const auto run = [&makeRouter](const std::string& body) {
+        auto executor = nhope::ThreadExecutor();
+        auto aoCtx = nhope::AOContext(executor);
+
+        // The parse error stops reading the body long before its end
+        auto in = inputStream(aoCtx, fmt::format("POST /items HTTP/1.1\r\nContent-Type: application/json\r\n"
+                                                 "Content-Length: {}\r\n\r\n{}"
+                                                 "GET /ping HTTP/1.1\r\nConnection: close\r\n\r\n",
+                                                 body.size(), body));
+        auto out = nhope::StringWritter::create(aoCtx);
+
+        TestSessionCtx first(makeRouter());
+        startSession(aoCtx, SessionParams{.ctx = first, .in = *in, .out = *out, .log = nullLogger()});
+        EXPECT_TRUE(first.wait(1s));
+        const auto firstResponse = out->takeContent();
+        EXPECT_TRUE(firstResponse.starts_with("HTTP/1.1 400 "));
+        if (!first.keepAlive()) {
+            EXPECT_TRUE(firstResponse.find("Connection: close\r\n") != std::string::npos);
+            return std::string();
+        }
+
+        TestSessionCtx second(makeRouter());
+        startSession(aoCtx, SessionParams{.ctx = second, .in = *in, .out = *out, .log = nullLogger()});
+        EXPECT_TRUE(second.wait(1s));
+        return out->takeContent();
+    };
+
+    // The short rest of the body is skipped, the next request is served
+    const auto next = run("[1, x, 2" + std::string(10000, ' ') + "]");
+    EXPECT_TRUE(next.starts_with("HTTP/1.1 200 OK\r\n"));
+    EXPECT_TRUE(next.find("pong") != std::string::npos);
+
+    // A long rest closes the connection
+    EXPECT_TRUE(run("[1, x, 2" + std::string(1024 * 1024, ' ') + "]").empty());
+}
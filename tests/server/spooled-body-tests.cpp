@@ -0,0 +1,96 @@
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <utility>
+
+#include <gtest/gtest.h>
+
+#include "nhope/async/ao-context.h"
+#include "nhope/async/future.h"
+#include "nhope/async/thread-executor.h"
+#include "nhope/io/io-device.h"
+#include "nhope/io/string-reader.h"
+
+#include "nlohmann/json.hpp"
+
+#include "royalbed/server/request-context.h"
+#include "royalbed/server/router.h"
+#include "royalbed/server/spooled-body.h"
+
+namespace {
+
+using namespace std::literals;
+using namespace royalbed::server;
+
+nlohmann::json post(Router& router, std::string_view path, std::string content)
+{
+    nhope::ThreadExecutor th;
+    nhope::AOContext aoCtx(th);
+
+    Request req;
+    req.body = nhope::StringReader::create(aoCtx, std::move(content));
+
+    RequestContext ctx{
+      .num = 1,
+      .router = router,
+      .request = std::move(req),
+      .aoCtx = nhope::AOContext(th),
+    };
+    auto route = router.route("POST", path);
+    for (const auto& middleware : route.middlewares) {
+        middleware(ctx).get();
+    }
+    route.handler(ctx).get();
+
+    const auto respBody = nhope::readAll(*ctx.response.body).get();
+    return nlohmann::json::parse(respBody.begin(), respBody.end());
+}
+
+}   // namespace
+
+TEST(SpooledBody, Threshold)   // NOLINT
+{
+    const auto describe = [](const SpooledBody& body) {
+        const auto data = body.data();
+        return nlohmann::json{
+          {"spooled", body.spooled()},
+          {"content", std::string(data.begin(), data.end())},
+        };
+    };
+
+    Router largeRouter;
+    largeRouter.addMiddleware(spoolBodyAbove(1024));
+    largeRouter.post("/", describe);
+
+    Router router;
+    router.post("/upload", describe);
+    router.use("/large", std::move(largeRouter));
+
+    const auto content = std::string(4096, 'x');
+
+    const auto inMemory = post(router, "/upload", content);
+    EXPECT_FALSE(inMemory["spooled"].get<bool>());
+    EXPECT_EQ(inMemory["content"], content);
+
+    const auto spooled = post(router, "/large/", content);
+    EXPECT_TRUE(spooled["spooled"].get<bool>());
+    EXPECT_EQ(spooled["content"], content);
+}
+
+TEST(SpooledBody, Receive)   // NOLINT
+{
+    nhope::ThreadExecutor th;
+    nhope::AOContext aoCtx(th);
+
+    const auto content = std::string(100 * 1024, 'y');
+    auto reader = nhope::StringReader::create(aoCtx, content);
+    const auto body = SpooledBody::receive(aoCtx, *reader, 0).get();
+
+    EXPECT_TRUE(body.spooled());
+    EXPECT_EQ(body.size(), content.size());
+    EXPECT_EQ(std::string(body.data().begin(), body.data().end()), content);
+
+    auto empty = nhope::StringReader::create(aoCtx, {});
+    EXPECT_EQ(SpooledBody::receive(aoCtx, *empty, 0).get().size(), 0);
+}
@@ -10,6 +10,7 @@
 #include <gtest/gtest.h>
 
 #include "cmrc/cmrc.hpp"
+#include "fmt/format.h"
 #include "spdlog/spdlog.h"
 
 #include "nhope/async/ao-context.h"
@@ -151,6 +152,31 @@ TEST(StaticFiles, getFiles)   // NOLINT
     }
 }
 
+TEST(StaticFiles, Range)   // NOLINT
+{
+    const auto router = staticFiles(testFs());
+
+    nhope::ThreadExecutor th;
+    nhope::AOContext aoCtx(th);
+
+    RequestContext reqCtx{
+      .num = 1,
+      .log = nullLogger(),
+      .router = router,
+      .aoCtx = nhope::AOContext(aoCtx),
+    };
+    reqCtx.request.headers["Range"] = "bytes=1000000-";
+    router.route("GET", "/folder2/big-file.bin").handler(reqCtx).get();
+
+    EXPECT_EQ(reqCtx.response.status, HttpStatus::PartialContent);
+    EXPECT_EQ(reqCtx.response.headers["Accept-Ranges"], "bytes");
+    EXPECT_EQ(reqCtx.response.headers["Content-Range"],
+              fmt::format("bytes 1000000-{}/{}", bigFileSize - 1, bigFileSize));
+
+    const auto body = nhope::readAll(*reqCtx.response.body).get();
+    EXPECT_TRUE(eq(std::span(bigFileData).subspan(1000000), body));   // NOLINT(readability-magic-numbers)
+}
+
 TEST(Swagger, Api)   // NOLINT
 {
     nhope::ThreadExecutor th;
@@ -0,0 +1,92 @@
+#include <chrono>
+#include <cstdint>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "nhope/async/ao-context.h"
+#include "nhope/async/event.h"
+#include "nhope/async/thread-executor.h"
+
+#include "royalbed/server/detail/timer-wheel.h"
+
+namespace {
+using namespace std::literals;
+using namespace royalbed::server::detail;
+
+// The wheel is moved by hand, its own timer is too slow to interfere
+constexpr auto tick = 1h;
+
+}   // namespace
+
+TEST(TimerWheel, ExpiresOnTime)   // NOLINT
+{
+    nhope::ThreadExecutor executor;
+    nhope::AOContext aoCtx(executor);
+    TimerWheel wheel(aoCtx, tick);
+
+    // Delays on every level of the wheel and beyond it
+    const std::vector<std::uint64_t> delays{1, 2, 63, 64, 65, 4095, 4096, 4097, 300000, 20000000};
+    std::vector<std::uint64_t> firedAt(delays.size());
+    std::uint64_t now = 0;
+    for (std::size_t i = 0; i < delays.size(); ++i) {
+        wheel.schedule(tick * delays[i], [&firedAt, &now, i] {
+            firedAt[i] = now;
+        });
+    }
+
+    while (wheel.size() > 0) {
+        ++now;
+        wheel.advance(1);
+    }
+
+    EXPECT_EQ(firedAt, delays);
+}
+
+TEST(TimerWheel, Cancel)   // NOLINT
+{
+    nhope::ThreadExecutor executor;
+    nhope::AOContext aoCtx(executor);
+    TimerWheel wheel(aoCtx, tick);
+
+    int fired = 0;
+    const auto id = wheel.schedule(tick * 10, [&fired] {
+        ++fired;
+    });
+    wheel.schedule(tick * 100, [&fired] {
+        fired += 10;
+    });
+
+    wheel.advance(5);
+    wheel.cancel(id);
+    wheel.advance(200);
+
+    EXPECT_EQ(fired, 10);
+    EXPECT_EQ(wheel.size(), 0);
+}
+
+TEST(TimerWheel, Deadline)   // NOLINT
+{
+    nhope::ThreadExecutor executor;
+    nhope::AOContext aoCtx(executor);
+    auto wheel = std::make_shared<TimerWheel>(aoCtx, 10ms);
+
+    nhope::Event expired;
+    int count = 0;
+    Deadline deadline(wheel, aoCtx);
+    aoCtx.exec([&] {
+        deadline.arm(50ms, [&] {
+            ++count;
+        });
+
+        // Rearming replaces the first timer
+        deadline.arm(100ms, [&] {
+            ++count;
+            expired.set();
+        });
+    });
+
+    EXPECT_FALSE(expired.waitFor(50ms));
+    EXPECT_TRUE(expired.waitFor(1s));
+    EXPECT_EQ(count, 1);
+}
@@ -0,0 +1,199 @@
+#ifdef ROYALBED_TLS_ENABLED
+
+#include <array>
+#include <cstdint>
+#include <cstdio>
+#include <filesystem>
+#include <memory>
+#include <string>
+#include <string_view>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <openssl/ec.h>
+#include <openssl/evp.h>
+#include <openssl/pem.h>
+#include <openssl/ssl.h>
+#include <openssl/x509.h>
+
+#include "gtest/gtest.h"
+#include "spdlog/spdlog.h"
+
+#include "nhope/async/ao-context.h"
+#include "nhope/async/future.h"
+#include "nhope/async/thread-executor.h"
+#include "nhope/io/string-reader.h"
+
+#include "royalbed/server/http-status.h"
+#include "royalbed/server/router.h"
+#include "royalbed/server/server.h"
+#include "royalbed/server/tls.h"
+
+namespace {
+using namespace std::literals;
+using namespace royalbed::server;
+
+constexpr auto port = 7891;
+
+// A self-signed certificate for localhost, written next to the test temporary files
+class TestCertificate final
+{
+public:
+    TestCertificate()
+      : m_dir(std::filesystem::temp_directory_path())
+    {
+        EVP_PKEY* rawKey = nullptr;
+        std::unique_ptr<EVP_PKEY_CTX, decltype(&EVP_PKEY_CTX_free)> keyCtx(EVP_PKEY_CTX_new_id(EVP_PKEY_EC, nullptr),
+                                                                           EVP_PKEY_CTX_free);
+        EVP_PKEY_keygen_init(keyCtx.get());
+        EVP_PKEY_CTX_set_ec_paramgen_curve_nid(keyCtx.get(), NID_X9_62_prime256v1);
+        EVP_PKEY_keygen(keyCtx.get(), &rawKey);
+        std::unique_ptr<EVP_PKEY, decltype(&EVP_PKEY_free)> key(rawKey, EVP_PKEY_free);
+        std::unique_ptr<X509, decltype(&X509_free)> cert(X509_new(), X509_free);
+
+        X509_set_version(cert.get(), 2);
+        ASN1_INTEGER_set(X509_get_serialNumber(cert.get()), 1);
+        X509_gmtime_adj(X509_getm_notBefore(cert.get()), 0);
+        X509_gmtime_adj(X509_getm_notAfter(cert.get()), 3600);   // NOLINT
+        X509_set_pubkey(cert.get(), key.get());
+        auto* name = X509_get_subject_name(cert.get());
+        X509_NAME_add_entry_by_txt(name, "CN", MBSTRING_ASC, reinterpret_cast<const unsigned char*>("localhost"), -1,
+                                   -1, 0);
+        X509_set_issuer_name(cert.get(), name);
+        X509_sign(cert.get(), key.get(), EVP_sha256());
+
+        auto* file = std::fopen(certificateFile().c_str(), "w");
+        PEM_write_X509(file, cert.get());
+        std::fclose(file);
+
+        file = std::fopen(privateKeyFile().c_str(), "w");
+        PEM_write_PrivateKey(file, key.get(), nullptr, nullptr, 0, nullptr, nullptr);
+        std::fclose(file);
+    }
+
+    ~TestCertificate()
+    {
+        std::filesystem::remove(certificateFile());
+        std::filesystem::remove(privateKeyFile());
+    }
+
+    [[nodiscard]] std::string certificateFile() const
+    {
+        return (m_dir / "royalbed-test-cert.pem").string();
+    }
+
+    [[nodiscard]] std::string privateKeyFile() const
+    {
+        return (m_dir / "royalbed-test-key.pem").string();
+    }
+
+private:
+    std::filesystem::path m_dir;
+};
+
+struct ClientResult
+{
+    std::string response;
+    std::string alpn;
+    bool resumed = false;
+    SSL_SESSION* session = nullptr;
+};
+
+// A blocking TLS client, sends the request and reads the response until the connection is closed
+ClientResult tlsRequest(SSL_CTX* ctx, std::string_view alpn, SSL_SESSION* session)
+{
+    const int fd = ::socket(AF_INET, SOCK_STREAM, 0);
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    ::inet_pton(AF_INET, "127.0.0.1", &addr.sin_addr);
+    EXPECT_EQ(::connect(fd, reinterpret_cast<const sockaddr*>(&addr), sizeof(addr)), 0);
+
+    auto* ssl = SSL_new(ctx);
+    SSL_set_fd(ssl, fd);
+    SSL_set_alpn_protos(ssl, reinterpret_cast<const unsigned char*>(alpn.data()), static_cast<unsigned>(alpn.size()));
+    if (session != nullptr) {
+        SSL_set_session(ssl, session);
+    }
+
+    ClientResult result;
+    EXPECT_EQ(SSL_connect(ssl), 1);
+
+    const unsigned char* selected = nullptr;
+    unsigned int selectedSize = 0;
+    SSL_get0_alpn_selected(ssl, &selected, &selectedSize);
+    if (selected != nullptr) {
+        result.alpn.assign(reinterpret_cast<const char*>(selected), selectedSize);
+    }
+    result.resumed = SSL_session_reused(ssl) == 1;
+
+    if (result.alpn != "h2") {
+        const auto request = "GET /hello HTTP/1.1\r\nHost: localhost\r\nConnection: close\r\n\r\n"sv;
+        SSL_write(ssl, request.data(), static_cast<int>(request.size()));
+
+        std::array<char, 1024> buf{};   // NOLINT
+        int n = 0;
+        while ((n = SSL_read(ssl, buf.data(), static_cast<int>(buf.size()))) > 0) {
+            result.response.append(buf.data(), static_cast<std::size_t>(n));
+        }
+    }
+
+    result.session = SSL_get1_session(ssl);
+    SSL_shutdown(ssl);
+    SSL_free(ssl);
+    ::close(fd);
+    return result;
+}
+
+}   // namespace
+
+TEST(Tls, RequestAndResumption)   // NOLINT
+{
+    TestCertificate cert;
+
+    nhope::ThreadExecutor executor;
+    nhope::AOContext aoCtx(executor);
+
+    Router router;
+    router.get("/hello", [](RequestContext& ctx) {
+        ctx.response.status = HttpStatus::Ok;
+        ctx.response.headers["Content-Length"] = "5";
+        ctx.response.body = nhope::StringReader::create(ctx.aoCtx, "Hello");
+    });
+
+    auto srv = Server::start(aoCtx, {
+                                      .bindAddress = "127.0.0.1",
+                                      .port = port,
+                                      .router = std::move(router),
+                                      .log = spdlog::default_logger(),
+                                      .tls = TlsParams{
+                                        .certificateFile = cert.certificateFile(),
+                                        .privateKeyFile = cert.privateKeyFile(),
+                                      },
+                                    });
+
+    std::unique_ptr<SSL_CTX, decltype(&SSL_CTX_free)> clientCtx(SSL_CTX_new(TLS_client_method()), SSL_CTX_free);
+
+    auto first = tlsRequest(clientCtx.get(), "\x08http/1.1", nullptr);
+    EXPECT_EQ(first.alpn, "http/1.1");
+    EXPECT_FALSE(first.resumed);
+    EXPECT_TRUE(first.response.starts_with("HTTP/1.1 200"));
+    EXPECT_TRUE(first.response.ends_with("\r\n\r\nHello"));
+
+    // The ticket of the first connection lets the second one skip the full handshake
+    auto second = tlsRequest(clientCtx.get(), "\x08http/1.1", first.session);
+    EXPECT_TRUE(second.resumed);
+    EXPECT_TRUE(second.response.ends_with("\r\n\r\nHello"));
+
+    auto http2 = tlsRequest(clientCtx.get(), "\x08http/1.1\x02h2", nullptr);
+    EXPECT_EQ(http2.alpn, "h2");
+
+    SSL_SESSION_free(first.session);
+    SSL_SESSION_free(second.session);
+    SSL_SESSION_free(http2.session);
+}
+
+#endif
@@ -0,0 +1,298 @@
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <gsl/span>
+#include <gtest/gtest.h>
+
+#include "nhope/async/ao-context.h"
+#include "nhope/async/future.h"
+#include "nhope/async/thread-executor.h"
+#include "nhope/io/string-reader.h"
+#include "nhope/io/string-writter.h"
+
+#include "royalbed/server/detail/websocket-frame.h"
+#include "royalbed/server/error.h"
+#include "royalbed/server/http-status.h"
+#include "royalbed/server/request-context.h"
+#include "royalbed/server/router.h"
+#include "royalbed/server/websocket.h"
+
+namespace {
+
+using namespace std::literals;
+using namespace royalbed::server;
+
+constexpr std::array<std::uint8_t, 4> testMask{0x37, 0xfa, 0x21, 0x3d};
+
+// Encodes a frame as a client does: with the masked payload
+std::string clientFrame(WsOpcode opcode, std::string_view payload, bool fin = true)
+{
+    auto frame = detail::encodeWsFrame(opcode, payload, fin);
+    const auto header = detail::parseWsFrameHeader(
+      gsl::span(reinterpret_cast<const std::uint8_t*>(frame.data()), frame.size()));
+
+    std::string masked = frame.substr(0, header->headerSize);
+    masked[1] = static_cast<char>(masked[1] | 0x80);
+    masked.append(reinterpret_cast<const char*>(testMask.data()), testMask.size());
+
+    std::string data(payload);
+    detail::unmaskWsPayload(gsl::span(reinterpret_cast<std::uint8_t*>(data.data()), data.size()), testMask);
+    return masked + data;
+}
+
+Request upgradeRequest()
+{
+    Request req;
+    req.method = "GET";
+    req.headers = {
+      {"Upgrade", "websocket"},
+      {"Connection", "keep-alive, Upgrade"},
+      {"Sec-WebSocket-Version", "13"},
+      {"Sec-WebSocket-Key", "dGhlIHNhbXBsZSBub25jZQ=="},
+    };
+    return req;
+}
+
+}   // namespace
+
+TEST(WebSocket, AcceptKey)   // NOLINT
+{
+    // RFC 6455, 1.3
+    EXPECT_EQ(wsAcceptKey("dGhlIHNhbXBsZSBub25jZQ=="), "s3pPLMBiTxaQ9kYGzzhZRbK+xOo=");
+}
+
+TEST(WebSocket, FrameHeader)   // NOLINT
+{
+    for (const std::size_t size : {0UL, 125UL, 126UL, 65535UL, 65536UL}) {
+        const std::string payload(size, 'x');
+        const auto frame = detail::encodeWsFrame(WsOpcode::Binary, payload);
+        const auto data = gsl::span(reinterpret_cast<const std::uint8_t*>(frame.data()), frame.size());
+
+        const auto header = detail::parseWsFrameHeader(data);
+        ASSERT_TRUE(header.has_value());
+        EXPECT_TRUE(header->fin);
+        EXPECT_EQ(header->opcode, WsOpcode::Binary);
+        EXPECT_FALSE(header->masked);
+        EXPECT_EQ(header->payloadSize, size);
+        EXPECT_EQ(header->headerSize + size, frame.size());
+
+        EXPECT_FALSE(detail::parseWsFrameHeader(data.first(header->headerSize - 1)).has_value());
+    }
+}
+
+TEST(WebSocket, Unmask)   // NOLINT
+{
+    std::vector<std::uint8_t> data(67);   // NOLINT
+    for (std::size_t i = 0; i < data.size(); ++i) {
+        data[i] = static_cast<std::uint8_t>(i * 7);
+    }
+
+    for (std::size_t offset = 0; offset < testMask.size(); ++offset) {
+        auto expected = data;
+        for (std::size_t i = 0; i < expected.size(); ++i) {
+            expected[i] ^= testMask[(offset + i) % testMask.size()];
+        }
+
+        auto actual = data;
+        detail::unmaskWsPayload(actual, testMask, offset);
+        EXPECT_EQ(actual, expected);
+    }
+}
+
+TEST(WebSocket, Utf8)   // NOLINT
+{
+    EXPECT_TRUE(detail::isValidUtf8("text"));
+    EXPECT_TRUE(detail::isValidUtf8("\xd1\x82\xd0\xb5\xd0\xba\xd1\x81\xd1\x82"));
+    EXPECT_TRUE(detail::isValidUtf8("\xf0\x9f\x98\x80"));
+    EXPECT_FALSE(detail::isValidUtf8("\xd1"));
+    EXPECT_FALSE(detail::isValidUtf8("\xc0\xaf"));           // overlong
+    EXPECT_FALSE(detail::isValidUtf8("\xed\xa0\x80"));       // surrogate
+    EXPECT_FALSE(detail::isValidUtf8("\xf4\x90\x80\x80"));   // > U+10FFFF
+}
+
+TEST(WebSocket, Handshake)   // NOLINT
+{
+    nhope::ThreadExecutor th;
+
+    Router router;
+    router.ws("/ws", [](RequestContext& ctx) {
+        return WebSocketUpgrade(ctx);
+    });
+
+    RequestContext ctx{
+      .num = 1,
+      .router = router,
+      .request = upgradeRequest(),
+      .aoCtx = nhope::AOContext(th),
+    };
+    router.route("GET", "/ws").handler(ctx).get();
+
+    EXPECT_EQ(ctx.response.status, HttpStatus::SwitchingProtocols);
+    EXPECT_EQ(ctx.response.headers["Upgrade"], "websocket");
+    EXPECT_EQ(ctx.response.headers["Sec-WebSocket-Accept"], "s3pPLMBiTxaQ9kYGzzhZRbK+xOo=");
+    EXPECT_TRUE(ctx.upgrade != nullptr);
+
+    RequestContext plainCtx{
+      .num = 2,
+      .router = router,
+      .aoCtx = nhope::AOContext(th),
+    };
+    EXPECT_THROW(router.route("GET", "/ws").handler(plainCtx).get(), HttpError);   // NOLINT
+
+    for (const auto* key : {"", "c2hvcnQ=", "dGhlIHNhbXBsZSBub25jZQ", "dGhlIHNhbXBsZSBub25j*Q=="}) {
+        RequestContext badKeyCtx{
+          .num = 3,
+          .router = router,
+          .request = upgradeRequest(),
+          .aoCtx = nhope::AOContext(th),
+        };
+        badKeyCtx.request.headers["Sec-WebSocket-Key"] = key;
+        EXPECT_THROW(router.route("GET", "/ws").handler(badKeyCtx).get(), HttpError);   // NOLINT
+    }
+}
+
+TEST(WebSocket, UnsupportedVersion)   // NOLINT
+{
+    nhope::ThreadExecutor th;
+
+    Router router;
+    router.ws("/ws", [](RequestContext& ctx) {
+        return WebSocketUpgrade(ctx);
+    });
+
+    RequestContext ctx{
+      .num = 1,
+      .router = router,
+      .request = upgradeRequest(),
+      .aoCtx = nhope::AOContext(th),
+    };
+    ctx.request.headers["Sec-WebSocket-Version"] = "8";
+    router.route("GET", "/ws").handler(ctx).get();
+
+    EXPECT_EQ(ctx.response.status, HttpStatus::UpgradeRequired);
+    EXPECT_EQ(ctx.response.headers["Sec-WebSocket-Version"], "13");
+    EXPECT_TRUE(ctx.upgrade == nullptr);
+}
+
+TEST(WebSocket, Echo)   // NOLINT
+{
+    nhope::ThreadExecutor th;
+    nhope::AOContext aoCtx(th);
+
+    std::vector<std::string> received;
+    auto closeCode = WsCloseCode::Abnormal;
+
+    Router router;
+    router.ws("/ws", [&](RequestContext& ctx) {
+        WebSocketUpgrade upgrade(ctx, {.pingInterval = 0ms});
+        upgrade
+          .onMessage([&received](const WebSocketPtr& ws, WsMessage msg) {
+              received.push_back(msg.data);
+              ws->send(msg.data);
+          })
+          .onClose([&closeCode](WsCloseCode code, const std::string& /*reason*/) {
+              closeCode = code;
+          });
+        return upgrade;
+    });
+
+    RequestContext ctx{
+      .num = 1,
+      .router = router,
+      .request = upgradeRequest(),
+      .aoCtx = nhope::AOContext(th),
+    };
+    router.route("GET", "/ws").handler(ctx).get();
+    ASSERT_TRUE(ctx.upgrade != nullptr);
+
+    // A fragmented message with a ping in between, then the close handshake
+    const auto input = clientFrame(WsOpcode::Text, "hello", false) + clientFrame(WsOpcode::Ping, "p") +
+                       clientFrame(WsOpcode::Continuation, " world") + clientFrame(WsOpcode::Binary, "bin") +
+                       clientFrame(WsOpcode::Close, "\x03\xe8"sv);
+
+    auto in = nhope::StringReader::create(aoCtx, input);
+    auto out = nhope::StringWritter::create(aoCtx);
+    nhope::makeReadyFuture()
+      .then(aoCtx,
+            [&] {
+                return ctx.upgrade(aoCtx, *in, *out);
+            })
+      .get();
+
+    EXPECT_EQ(received, (std::vector<std::string>{"hello world", "bin"}));
+    EXPECT_EQ(closeCode, WsCloseCode::Normal);
+    EXPECT_EQ(out->takeContent(), detail::encodeWsFrame(WsOpcode::Pong, "p") +
+                                    detail::encodeWsFrame(WsOpcode::Text, "hello world") +
+                                    detail::encodeWsFrame(WsOpcode::Text, "bin") +
+                                    detail::encodeWsCloseFrame(WsCloseCode::Normal, {}));
+}
+
+TEST(WebSocket, PingFlood)   // NOLINT
+{
+    nhope::ThreadExecutor th;
+    nhope::AOContext aoCtx(th);
+
+    Router router;
+    router.ws("/ws", [](RequestContext& ctx) {
+        return WebSocketUpgrade(ctx, {.pingInterval = 0ms});
+    });
+
+    RequestContext ctx{
+      .num = 1,
+      .router = router,
+      .request = upgradeRequest(),
+      .aoCtx = nhope::AOContext(th),
+    };
+    router.route("GET", "/ws").handler(ctx).get();
+
+    // The pings arrive while the first Pong is written, only the latest one waits for an answer
+    const auto input = clientFrame(WsOpcode::Ping, "1") + clientFrame(WsOpcode::Ping, "2") +
+                       clientFrame(WsOpcode::Ping, "3") + clientFrame(WsOpcode::Close, "\x03\xe8"sv);
+
+    auto in = nhope::StringReader::create(aoCtx, input);
+    auto out = nhope::StringWritter::create(aoCtx);
+    nhope::makeReadyFuture()
+      .then(aoCtx,
+            [&] {
+                return ctx.upgrade(aoCtx, *in, *out);
+            })
+      .get();
+
+    EXPECT_EQ(out->takeContent(), detail::encodeWsFrame(WsOpcode::Pong, "1") +
+                                    detail::encodeWsFrame(WsOpcode::Pong, "3") +
+                                    detail::encodeWsCloseFrame(WsCloseCode::Normal, {}));
+}
+
+TEST(WebSocket, UnmaskedFrame)   // NOLINT
+{
+    nhope::ThreadExecutor th;
+    nhope::AOContext aoCtx(th);
+
+    Router router;
+    router.ws("/ws", [](RequestContext& ctx) {
+        return WebSocketUpgrade(ctx, {.pingInterval = 0ms});
+    });
+
+    RequestContext ctx{
+      .num = 1,
+      .router = router,
+      .request = upgradeRequest(),
+      .aoCtx = nhope::AOContext(th),
+    };
+    router.route("GET", "/ws").handler(ctx).get();
+
+    auto in = nhope::StringReader::create(aoCtx, detail::encodeWsFrame(WsOpcode::Text, "unmasked"));
+    auto out = nhope::StringWritter::create(aoCtx);
+    nhope::makeReadyFuture()
+      .then(aoCtx,
+            [&] {
+                return ctx.upgrade(aoCtx, *in, *out);
+            })
+      .get();
+
+    EXPECT_EQ(out->takeContent(), detail::encodeWsCloseFrame(WsCloseCode::ProtocolError, {}));
+}
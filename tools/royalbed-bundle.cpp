@@ -0,0 +1,27 @@
+// Builds an asset bundle, see royalbed_add_asset_bundle in cmake/RoyalbedAssetBundle.cmake
+//   royalbed-bundle <output> <base dir> <files>...
+
+#include <exception>
+#include <filesystem>
+#include <iostream>
+#include <vector>
+
+#include "royalbed/server/asset-bundle.h"
+
+int main(int argc, char* argv[])
+{
+    if (argc < 3) {
+        std::cerr << "Usage: royalbed-bundle <output> <base dir> <files>..." << std::endl;
+        return 2;
+    }
+
+    try {
+        // NOLINTNEXTLINE(cppcoreguidelines-pro-bounds-pointer-arithmetic)
+        const std::vector<std::filesystem::path> files(argv + 3, argv + argc);
+        royalbed::server::AssetBundle::build(argv[1], argv[2], files);   // NOLINT
+    } catch (const std::exception& e) {
+        std::cerr << "royalbed-bundle: " << e.what() << std::endl;
+        return 1;
+    }
+    return 0;
+}